@@ -0,0 +1,322 @@
+
+/*
+ * Encoder and decoder for the binary game of life wire format. See GlifeProto.h for the format.
+ */
+
+#include <string.h>
+#include "GlifeProto.h"
+
+/*
+ * Write and read the big endian header fields.
+ */
+
+static void PutU32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char) (v >> 24);
+    p[1] = (unsigned char) (v >> 16);
+    p[2] = (unsigned char) (v >> 8);
+    p[3] = (unsigned char) v;
+}
+
+static uint32_t GetU32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static void PutHeader(unsigned char *out, int type, int flags, uint32_t width, uint32_t height,
+                      uint32_t generation, uint32_t x, uint32_t y, uint32_t tileWidth, uint32_t tileHeight)
+{
+    out[0] = 'G';
+    out[1] = 'L';
+    out[2] = GLP_VERSION;
+    out[3] = (unsigned char) type;
+    out[4] = (unsigned char) flags;
+    out[5] = out[6] = out[7] = 0;
+    PutU32(out + 8, width);
+    PutU32(out + 12, height);
+    PutU32(out + 16, generation);
+    PutU32(out + 20, x);
+    PutU32(out + 24, y);
+    PutU32(out + 28, tileWidth);
+    PutU32(out + 32, tileHeight);
+}
+
+/*
+ * Varints hold 7 bits per byte, least significant group first.
+ */
+
+static size_t PutVarint(unsigned char *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char) v;
+    return n;
+}
+
+static int GetVarint(const unsigned char **p, const unsigned char *end, uint64_t * v)
+{
+    int shift = 0;
+    *v = 0;
+    while (*p < end && shift < 64)
+    {
+        unsigned char b = *(*p)++;
+        *v |= (uint64_t) (b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return GLP_OK;
+        shift += 7;
+    }
+    return GLP_CORRUPT;                                         // Ran off the end of the message
+}
+
+/*
+ * Set or clear the board cell (x,y) if it is inside of the window.
+ */
+
+static void SetInWindow(unsigned char *bitmap, uint32_t viewX, uint32_t viewY, uint32_t viewWidth,
+                        uint32_t viewHeight, uint64_t x, uint64_t y, int alive)
+{
+    if (x >= viewX && x - viewX < viewWidth && y >= viewY && y - viewY < viewHeight)
+        glpSetCell(bitmap, (y - viewY) * viewWidth + (x - viewX), alive);
+}
+
+/*
+ * The part of [start,start+len) that is also in [viewStart,viewStart+viewLen). Returns 0 if they don't meet.
+ */
+
+static int Clip(uint64_t start, uint64_t len, uint64_t viewStart, uint64_t viewLen, uint64_t * from,
+                uint64_t * to)
+{
+    *from = start > viewStart ? start : viewStart;
+    *to = start + len < viewStart + viewLen ? start + len : viewStart + viewLen;
+    return *from < *to;
+}
+
+size_t glpBitmapBytes(uint32_t width, uint32_t height)
+{
+    return (size_t) (((uint64_t) width * height + 7) / 8);
+}
+
+size_t glpFullBound(uint32_t width, uint32_t height)
+{
+    // The run length encoding is never kept when it is longer than the bitmap
+    return GLP_HEADER_SIZE + glpBitmapBytes(width, height);
+}
+
+size_t glpEncodeFull(unsigned char *out, uint32_t width, uint32_t height, uint32_t generation,
+                     const unsigned char *bitmap, int rle)
+{
+    return glpEncodeTile(out, width, height, generation, 0, 0, width, height, bitmap, rle);
+}
+
+size_t glpEncodeTile(unsigned char *out, uint32_t width, uint32_t height, uint32_t generation, uint32_t x,
+                     uint32_t y, uint32_t tileWidth, uint32_t tileHeight, const unsigned char *bitmap, int rle)
+{
+    size_t bytes = glpBitmapBytes(tileWidth, tileHeight);
+    unsigned char *p = out + GLP_HEADER_SIZE;
+    uint64_t row, i, j;
+    if (rle)                                                    // Try the run length encoding first
+    {
+        unsigned char *end = p + bytes;
+        uint64_t run = 0;
+        int alive = 0;                                          // The first run is dead
+        for (row = 0; row < tileHeight; row++)
+        {
+            uint64_t first = (uint64_t) (y + row) * width + x;  // Runs continue across the rows of the tile
+            uint64_t last = first + tileWidth;
+            for (i = first; i < last;)
+            {
+                if (glpGetCell(bitmap, i) == alive)
+                {
+                    // Skip whole bytes of equal cells
+                    if ((i & 7) == 0 && i + 8 <= last && bitmap[i >> 3] == (alive ? 0xff : 0x00))
+                    {
+                        i += 8;
+                        run += 8;
+                    }
+                    else
+                    {
+                        i++;
+                        run++;
+                    }
+                    continue;
+                }
+                if (end - p < 10)                               // Might not fit, use the bitmap
+                    break;
+                p += PutVarint(p, run);
+                run = 0;
+                alive = !alive;
+            }
+            if (i < last)
+                break;
+        }
+        if (row == tileHeight && end - p >= 10)
+        {
+            p += PutVarint(p, run);                             // The last run
+            PutHeader(out, GLP_FULL, GLP_FLAG_RLE, width, height, generation, x, y, tileWidth, tileHeight);
+            return p - out;
+        }
+        p = out + GLP_HEADER_SIZE;
+    }
+    PutHeader(out, GLP_FULL, 0, width, height, generation, x, y, tileWidth, tileHeight);
+    if (x == 0 && tileWidth == width && ((uint64_t) y * width) % 8 == 0)
+    {
+        memcpy(p, bitmap + (uint64_t) y * width / 8, bytes);   // The tile is a contiguous part of the board
+        return GLP_HEADER_SIZE + bytes;
+    }
+    memset(p, 0, bytes);
+    for (row = 0, j = 0; row < tileHeight; row++)
+    {
+        uint64_t first = (uint64_t) (y + row) * width + x;
+        for (i = 0; i < tileWidth; i++, j++)
+        {
+            if (glpGetCell(bitmap, first + i))
+                glpSetCell(p, j, 1);
+        }
+    }
+    return GLP_HEADER_SIZE + bytes;
+}
+
+size_t glpDeltaBound(size_t count)
+{
+    // A varint of 64 bits needs at most 10 bytes
+    return GLP_HEADER_SIZE + 10 * (count + 1);
+}
+
+size_t glpEncodeDelta(unsigned char *out, uint32_t width, uint32_t height, uint32_t generation,
+                      const uint64_t * changes, size_t count)
+{
+    unsigned char *p = out + GLP_HEADER_SIZE;
+    uint64_t next = 0;                                          // Index of the first cell not yet covered
+    size_t j;
+    PutHeader(out, GLP_DELTA, 0, width, height, generation, 0, 0, width, height);
+    p += PutVarint(p, count);
+    for (j = 0; j < count; j++)
+    {
+        uint64_t index = changes[j] >> 1;
+        p += PutVarint(p, ((index - next) << 1) | (changes[j] & 1));
+        next = index + 1;
+    }
+    return p - out;
+}
+
+int glpDecodeHeader(const unsigned char *buf, size_t len, glpHeader * header)
+{
+    if (len < GLP_HEADER_SIZE_V1 || buf[0] != 'G' || buf[1] != 'L')
+        return GLP_NOT_BINARY;
+    header->version = buf[2];
+    header->type = buf[3];
+    header->flags = buf[4];
+    header->width = GetU32(buf + 8);
+    header->height = GetU32(buf + 12);
+    header->generation = GetU32(buf + 16);
+    if (header->version > GLP_VERSION)                          // Written by a newer publisher
+        return GLP_BAD_VERSION;
+    if (header->type != GLP_FULL && header->type != GLP_DELTA)
+        return GLP_CORRUPT;
+    if (header->version < 2)                                    // The message covers the whole board
+    {
+        header->x = header->y = 0;
+        header->tileWidth = header->width;
+        header->tileHeight = header->height;
+        header->size = GLP_HEADER_SIZE_V1;
+        return GLP_OK;
+    }
+    if (len < GLP_HEADER_SIZE)
+        return GLP_CORRUPT;
+    header->x = GetU32(buf + 20);
+    header->y = GetU32(buf + 24);
+    header->tileWidth = GetU32(buf + 28);
+    header->tileHeight = GetU32(buf + 32);
+    header->size = GLP_HEADER_SIZE;
+    if ((uint64_t) header->x + header->tileWidth > header->width ||
+        (uint64_t) header->y + header->tileHeight > header->height)
+        return GLP_CORRUPT;                                     // The tile is not on the board
+    return GLP_OK;
+}
+
+int glpOverlaps(const glpHeader * header, uint32_t viewX, uint32_t viewY, uint32_t viewWidth,
+                uint32_t viewHeight)
+{
+    uint64_t from, to;
+    return Clip(header->x, header->tileWidth, viewX, viewWidth, &from, &to) &&
+        Clip(header->y, header->tileHeight, viewY, viewHeight, &from, &to);
+}
+
+int glpApply(const unsigned char *buf, size_t len, const glpHeader * header, unsigned char *bitmap)
+{
+    return glpApplyWindow(buf, len, header, 0, 0, header->width, header->height, bitmap);
+}
+
+int glpApplyWindow(const unsigned char *buf, size_t len, const glpHeader * header, uint32_t viewX,
+                   uint32_t viewY, uint32_t viewWidth, uint32_t viewHeight, unsigned char *bitmap)
+{
+    const unsigned char *p = buf + header->size;
+    const unsigned char *end = buf + len;
+    uint64_t tw = header->tileWidth;
+    uint64_t cells = tw * header->tileHeight;
+    uint64_t i = 0, v, count, x0 = 0, x1 = 0, y0 = 0, y1 = 0, x, y;
+    int alive = 0;
+
+    if (header->type == GLP_FULL)
+    {
+        int overlaps = Clip(header->x, tw, viewX, viewWidth, &x0, &x1) &&
+            Clip(header->y, header->tileHeight, viewY, viewHeight, &y0, &y1);
+        if (!(header->flags & GLP_FLAG_RLE))                    // Copy the rows of the tile in the window
+        {
+            if ((size_t) (end - p) != glpBitmapBytes(header->tileWidth, header->tileHeight))
+                return GLP_CORRUPT;
+            for (y = y0; overlaps && y < y1; y++)
+            {
+                for (x = x0; x < x1; x++)
+                    glpSetCell(bitmap, (y - viewY) * viewWidth + (x - viewX),
+                               glpGetCell(p, (y - header->y) * tw + (x - header->x)));
+            }
+            return GLP_OK;
+        }
+        for (y = y0; overlaps && y < y1; y++)                   // Run length encoded tile
+        {
+            for (x = x0; x < x1; x++)                           // The runs only list the living cells
+                glpSetCell(bitmap, (y - viewY) * viewWidth + (x - viewX), 0);
+        }
+        while (i < cells)
+        {
+            if (GetVarint(&p, end, &v) != GLP_OK || v > cells - i)
+                return GLP_CORRUPT;
+            if (!alive)
+                i += v;
+            while (alive && v > 0)                              // One row of the tile at a time
+            {
+                uint64_t col = i % tw, row = i / tw, from, to;
+                uint64_t n = tw - col < v ? tw - col : v;
+                if (overlaps && header->y + row >= y0 && header->y + row < y1 &&
+                    Clip(header->x + col, n, x0, x1 - x0, &from, &to))
+                {
+                    for (x = from; x < to; x++)
+                        glpSetCell(bitmap, (header->y + row - viewY) * viewWidth + (x - viewX), 1);
+                }
+                i += n;
+                v -= n;
+            }
+            alive = !alive;
+        }
+        return GLP_OK;
+    }
+    if (GetVarint(&p, end, &count) != GLP_OK)                   // Delta frame
+        return GLP_CORRUPT;
+    for (; count > 0; count--)
+    {
+        if (GetVarint(&p, end, &v) != GLP_OK)
+            return GLP_CORRUPT;
+        i += v >> 1;
+        if (i >= cells)
+            return GLP_CORRUPT;
+        SetInWindow(bitmap, viewX, viewY, viewWidth, viewHeight, header->x + i % tw, header->y + i / tw,
+                    (int) (v & 1));
+        i++;
+    }
+    return GLP_OK;
+}
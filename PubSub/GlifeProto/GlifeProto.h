@@ -0,0 +1,141 @@
+/*
+ * Binary wire format for the game of life channel.
+ *
+ * Every binary message starts with a fixed size header. All multi byte fields are in network (big endian)
+ * byte order:
+ *
+ * offset size field
+ *      0    2 magic      'G' 'L'. Text records never start with these bytes.
+ *      2    1 version    GLP_VERSION
+ *      3    1 type       GLP_FULL or GLP_DELTA
+ *      4    1 flags      GLP_FLAG_RLE when the payload of a full frame is run length encoded
+ *      5    3 reserved   zero
+ *      8    4 width      cellspace width
+ *     12    4 height     cellspace height
+ *     16    4 generation frame counter, incremented by one for each published frame
+ *     20    4 x          tile origin (version 2 and later)
+ *     24    4 y
+ *     28    4 tile width
+ *     32    4 tile height
+ *
+ * A message covers the tile of tile width x tile height cells at (x,y) on the board. Version 1 headers end
+ * at offset 20 and their tile is always the whole board. The cell at (x+i,y+j) has the tile index
+ * j*tile_width+i. The payloads are:
+ *
+ * GLP_FULL            => the tile as a bitmap, one bit per cell, least significant bit first.
+ * GLP_FULL + RLE      => the tile as varint run lengths. The runs alternate between dead and alive cells and
+ *                        the first run is dead (it may have length zero).
+ * GLP_DELTA           => the cells of the tile that changed since generation-1. A varint count followed by
+ *                        one varint per cell holding (gap << 1) | alive, where gap is the number of cells
+ *                        skipped since the previous changed cell. Cells are listed in increasing index order.
+ *
+ * A large board is sent as several full messages of the same generation, one per tile and in row major tile
+ * order, so a subscriber can skip the tiles outside of its view without decoding them. Delta messages are
+ * sparse and always cover the whole board.
+ *
+ * A varint is 7 bits per byte, least significant group first, with the high bit set on all but the last byte.
+ */
+
+#ifndef __glife_proto_h_
+#define __glife_proto_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GLP_VERSION 2                                           // Highest version this code understands
+#define GLP_HEADER_SIZE 36                                      // Header size of the version we write
+#define GLP_HEADER_SIZE_V1 20
+
+#define GLP_FULL 1                                              // Message types
+#define GLP_DELTA 2
+
+#define GLP_FLAG_RLE 0x01                                       // Full frame payload is run length encoded
+
+#define GLP_OK 0                                                // Decoder status codes
+#define GLP_NOT_BINARY -1
+#define GLP_BAD_VERSION -2
+#define GLP_CORRUPT -3
+
+typedef struct glpHeader
+{
+    int version;
+    int type;
+    int flags;
+    uint32_t width;
+    uint32_t height;
+    uint32_t generation;
+    uint32_t x;                                                 // The tile covered by the message
+    uint32_t y;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    size_t size;                                                // Length of the header on the wire
+} glpHeader;
+
+/*
+ * Bitmap helpers. A bitmap for a width x height board is glpBitmapBytes(width,height) bytes long.
+ */
+
+size_t glpBitmapBytes(uint32_t width, uint32_t height);
+
+static inline int glpGetCell(const unsigned char *bitmap, uint64_t index)
+{
+    return (bitmap[index >> 3] >> (index & 7)) & 1;
+}
+
+static inline void glpSetCell(unsigned char *bitmap, uint64_t index, int alive)
+{
+    if (alive)
+        bitmap[index >> 3] |= (unsigned char) (1 << (index & 7));
+    else
+        bitmap[index >> 3] &= (unsigned char) ~(1 << (index & 7));
+}
+
+/*
+ * Encoders. The output buffer must hold at least the number of bytes given by the matching bound
+ * function (glpFullBound of the tile dimensions for glpEncodeTile). Each returns the length of the encoded
+ * message. The bitmap is always the whole width x height board; glpEncodeTile only reads its tile.
+ */
+
+size_t glpFullBound(uint32_t width, uint32_t height);
+size_t glpEncodeFull(unsigned char *out, uint32_t width, uint32_t height, uint32_t generation,
+                     const unsigned char *bitmap, int rle);
+size_t glpEncodeTile(unsigned char *out, uint32_t width, uint32_t height, uint32_t generation, uint32_t x,
+                     uint32_t y, uint32_t tileWidth, uint32_t tileHeight, const unsigned char *bitmap, int rle);
+size_t glpDeltaBound(size_t count);
+size_t glpEncodeDelta(unsigned char *out, uint32_t width, uint32_t height, uint32_t generation,
+                      const uint64_t * changes, size_t count);
+
+/*
+ * A delta entry for glpEncodeDelta. The entries must be sorted by index.
+ */
+
+static inline uint64_t glpChange(uint64_t index, int alive)
+{
+    return (index << 1) | (alive ? 1 : 0);
+}
+
+/*
+ * Decoders. glpDecodeHeader returns GLP_NOT_BINARY for text records so callers can fall back to the text
+ * protocol. glpApply updates a bitmap of header->width x header->height cells with a full or delta message.
+ *
+ * glpApplyWindow keeps only a window of the board: bitmap holds the viewWidth x viewHeight cells at
+ * (viewX,viewY) and the cells of the message outside of the window are dropped. glpOverlaps tells if a
+ * message touches the window at all, so tiles that don't can be skipped without decoding.
+ */
+
+int glpDecodeHeader(const unsigned char *buf, size_t len, glpHeader * header);
+int glpApply(const unsigned char *buf, size_t len, const glpHeader * header, unsigned char *bitmap);
+int glpApplyWindow(const unsigned char *buf, size_t len, const glpHeader * header, uint32_t viewX,
+                   uint32_t viewY, uint32_t viewWidth, uint32_t viewHeight, unsigned char *bitmap);
+int glpOverlaps(const glpHeader * header, uint32_t viewX, uint32_t viewY, uint32_t viewWidth,
+                uint32_t viewHeight);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
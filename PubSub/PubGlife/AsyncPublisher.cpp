@@ -0,0 +1,115 @@
+#include "AsyncPublisher.h"
+#include <cstdio>
+#include "adapters/ae.h"
+using namespace std;
+
+AsyncPublisher::AsyncPublisher(const char *channel, SpscQueue < Frame * >*frames, SpscQueue < Frame * >*spare,
+                               int maxInflight):
+channel(channel), frames(frames), spare(spare), maxInflight(maxInflight), inflight(0), done(false), lost(false),
+disconnecting(false), loop(NULL), ac(NULL), messages(0), replies(0), stalls(0)
+{
+}
+
+AsyncPublisher::~AsyncPublisher()
+{
+    if (loop != NULL)
+        aeDeleteEventLoop(loop);
+}
+
+bool AsyncPublisher::connect(const char *hostip, int hostport)
+{
+    ac = redisAsyncConnect(hostip, hostport);                   // Get the redis context
+    if (ac == NULL || ac->err)                                  // Handle connection errors
+    {
+        if (ac != NULL)
+            printf("Error: %s\n", ac->errstr);
+        else
+            printf("Can't allocate redis context\n");
+        return false;
+    }
+    ac->data = this;                                            // The callbacks find the publisher here
+    loop = aeCreateEventLoop(64);
+    redisAeAttach(loop, ac);
+    redisAsyncSetConnectCallback(ac, connectCallback);
+    redisAsyncSetDisconnectCallback(ac, disconnectCallback);
+    aeCreateTimeEvent(loop, 1, pumpTimer, this, NULL);          // Look for new frames every millisecond
+    return true;
+}
+
+void AsyncPublisher::run()
+{
+    aeMain(loop);                                               // Runs until the connection is closed
+}
+
+int AsyncPublisher::pump()
+{
+    Frame *frame;
+    if (ac == NULL)                                             // The connection is gone
+        return AE_NOMORE;
+    for (;;)
+    {
+        if (inflight >= maxInflight)                            // Let redis catch up
+        {
+            stalls++;
+            break;
+        }
+        if (!frames->pop(frame))
+            break;
+        for (size_t i = 0; i < frame->size(); i++)              // The event loop does the writing
+        {
+            const string & msg = (*frame)[i];
+            redisAsyncCommand(ac, replyCallback, this, "PUBLISH %b %b", channel.data(), channel.size(),
+                              msg.data(), msg.size());
+            inflight++;
+            messages++;
+        }
+        frame->clear();                                         // Give the frame back for reuse
+        if (!spare->push(frame))
+            delete frame;
+    }
+    // Close the connection when the last frame has been acknowledged
+    if (done.load(std::memory_order_acquire) && frames->empty() && inflight == 0 && !disconnecting)
+    {
+        disconnecting = true;
+        redisAsyncDisconnect(ac);
+        return AE_NOMORE;
+    }
+    return 1;
+}
+
+int AsyncPublisher::pumpTimer(aeEventLoop * loop, long long id, void *clientData)
+{
+    return static_cast < AsyncPublisher * >(clientData)->pump();
+}
+
+void AsyncPublisher::replyCallback(redisAsyncContext * ac, void *reply, void *privdata)
+{
+    AsyncPublisher *pub = static_cast < AsyncPublisher * >(privdata);
+    pub->inflight--;
+    if (reply != NULL)                                          // NULL when the connection is closing
+        pub->replies++;
+}
+
+void AsyncPublisher::connectCallback(const redisAsyncContext * ac, int status)
+{
+    AsyncPublisher *pub = static_cast < AsyncPublisher * >(ac->data);
+    if (status != REDIS_OK)                                     // Handel errors
+    {
+        printf("Error: %s\n", ac->errstr);
+        pub->ac = NULL;
+        pub->lost.store(true, std::memory_order_release);
+        aeStop(pub->loop);
+    }
+}
+
+void AsyncPublisher::disconnectCallback(const redisAsyncContext * ac, int status)
+{
+    AsyncPublisher *pub = static_cast < AsyncPublisher * >(ac->data);
+    if (status != REDIS_OK)                                     // Handel errors
+    {
+        printf("Error: %s\n", ac->errstr);
+        pub->lost.store(true, std::memory_order_release);
+    }
+    pub->ac = NULL;
+    aeStop(pub->loop);
+}
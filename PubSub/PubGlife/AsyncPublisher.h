@@ -0,0 +1,79 @@
+#ifndef __async_publisher_h_
+#define __async_publisher_h_
+#include <cstdlib>
+#include <atomic>
+#include <string>
+extern "C"
+{
+#include <ae.h>
+}
+#include "hiredis.h"
+#include "async.h"
+#include "Publisher.h"
+#include "SpscQueue.h"
+
+/*
+ * Sends frames to the redis channel from its own thread.
+ *
+ * The simulation thread pushes captured frames (see Publisher) into the frames queue. The publisher thread
+ * runs a redis ae event loop that takes frames from the queue, issues one asynchronous PUBLISH per message
+ * and returns the emptied frames through the spare queue so they can be reused. At most maxInflight
+ * PUBLISH commands are waiting for a reply; when redis falls behind the publisher stops taking frames, the
+ * frames queue fills and the simulation thread has to wait. That is the backpressure.
+ */
+
+class AsyncPublisher
+{
+  public:
+    AsyncPublisher(const char *channel, SpscQueue < Frame * >*frames, SpscQueue < Frame * >*spare,
+                   int maxInflight = 4096);
+    // Connect to the server. Returns false and prints the error on failure.
+    bool connect(const char *hostip, int hostport);
+    // Body of the publisher thread. Returns when finish() was called and every frame has been sent.
+    void run();
+    // Tell the publisher thread that no more frames will be pushed
+    void finish()
+    {
+        done.store(true, std::memory_order_release);
+    }
+    // Returns true if the connection to the server was lost
+    bool failed() const
+    {
+        return lost.load(std::memory_order_acquire);
+    }
+    // Number of PUBLISH commands sent and acknowledged
+    long int getMessageCount() const
+    {
+        return messages;
+    }
+    long int getReplyCount() const
+    {
+        return replies;
+    }
+    // Number of times the publisher waited because too many commands were in flight
+    long int getStallCount() const
+    {
+        return stalls;
+    }
+    ~AsyncPublisher();
+
+  private:
+    std::string channel;
+    SpscQueue < Frame * >*frames, *spare;
+    int maxInflight, inflight;
+    std::atomic < bool > done, lost;
+    bool disconnecting;
+    aeEventLoop *loop;
+    redisAsyncContext *ac;
+    long int messages, replies, stalls;
+
+    // Move frames from the queue to the connection
+    int pump();
+    // Callbacks from the event loop
+    static int pumpTimer(aeEventLoop * loop, long long id, void *clientData);
+    static void replyCallback(redisAsyncContext * ac, void *reply, void *privdata);
+    static void connectCallback(const redisAsyncContext * ac, int status);
+    static void disconnectCallback(const redisAsyncContext * ac, int status);
+};
+
+#endif
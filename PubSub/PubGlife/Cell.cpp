@@ -4,6 +4,8 @@ using namespace std;
 // Cellspace dimensions
 long int Cell::w = 0;
 long int Cell::h = 0;
+bool Cell::stencil = false;
+long int Cell::outputs = 0;
 
 Cell::Cell(long int x, long int y, long int w, long int h,
            Phase phase, short int nalive, Phase * vis_phase):adevs::Atomic < CellEvent > (),
@@ -74,6 +76,16 @@ void Cell::output_func(adevs::Bag < CellEvent > &yb)
     // Set the initial visualization value
     if (vis_phase != NULL)
         *vis_phase = e.value;
+    outputs++;
+    // Let the CellSpace send the event to the neighborhood
+    if (stencil)
+    {
+        e.x = x;
+        e.y = y;
+        e.stencil = true;
+        yb.insert(e);
+        return;
+    }
     // Generate an event for each neighbor
     for (long int dx = -1; dx <= 1; dx++)
     {
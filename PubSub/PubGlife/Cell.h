@@ -33,6 +33,30 @@ class Cell:public adevs::Atomic < CellEvent >
     void gc_output(adevs::Bag < CellEvent > &g)
     {
     }
+    // Location of the cell
+    long int getX() const
+    {
+        return x;
+    }
+    long int getY() const
+    {
+        return y;
+    }
+    // Current phase of the cell
+    Phase getPhase() const
+    {
+        return phase;
+    }
+    // Send one stencil event to the neighborhood of the CellSpace instead of an event per neighbor
+    static void setStencil(bool on)
+    {
+        stencil = on;
+    }
+    // Output events sent by all of the cells
+    static long int getOutputs()
+    {
+        return outputs;
+    }
     // Destructor
     ~Cell()
     {
@@ -43,6 +67,10 @@ class Cell:public adevs::Atomic < CellEvent >
     long int x, y;
     // dimensions of the 2D space
     static long int w, h;
+    // Use the Moore neighborhood of the CellSpace
+    static bool stencil;
+    // Count of output events
+    static long int outputs;
     // Current cell phase
     Phase phase;
     // number of living neighbors.
@@ -0,0 +1,40 @@
+#ifndef __cell_listener_h_
+#define __cell_listener_h_
+#include "adevs.h"
+#include "FrameEncoder.h"
+#include "Publisher.h"
+
+/*
+ * Publishes the game of life from the simulator's state change notifications.
+ *
+ * Simulator::exec_event notifies the listener after every state transition of a cell. The listener puts
+ * the cell's phase into the FrameEncoder, which only records the cells whose phase actually changed. Calling
+ * publish() after each execNextEvent() emits the changes of that step as one frame, so nothing scans the
+ * whole board. CellType must provide getX(), getY() and getPhase().
+ */
+
+template < class CellType > class CellListener:public adevs::EventListener < CellEvent >
+{
+  public:
+    CellListener(FrameEncoder * enc, Publisher * pub):
+    adevs::EventListener < CellEvent > (), enc(enc), pub(pub)
+    {
+    }
+    // Record the new phase of a cell
+    void stateChange(adevs::Atomic < CellEvent > *model, double t)
+    {
+        CellType *cell = static_cast < CellType * >(model);
+        enc->setCell(cell->getX(), cell->getY(), cell->getPhase() == Alive);
+    }
+    // Publish the changes since the last call as one frame
+    void publish()
+    {
+        enc->publish(*pub);
+    }
+
+  private:
+    FrameEncoder * enc;
+    Publisher *pub;
+};
+
+#endif
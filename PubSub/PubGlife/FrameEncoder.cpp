@@ -0,0 +1,112 @@
+#include "FrameEncoder.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+FrameEncoder::FrameEncoder(long int width, long int height, Encoding encoding, int keyframe, long int tileSize):
+width(width), height(height), tileSize(tileSize), encoding(encoding), keyframe(keyframe), generation(0),
+frameBytes(0), cur(glpBitmapBytes(width, height), 0), prev(glpBitmapBytes(width, height), 0)
+{
+    if (this->keyframe < 1)                                     // Every frame is a key frame
+        this->keyframe = 1;
+    if (this->tileSize < 8)                                     // Keep the per tile header small in comparison
+        this->tileSize = 8;
+}
+
+bool FrameEncoder::parseEncoding(const char *name, Encoding & encoding)
+{
+    if (strcmp(name, "text") == 0)
+        encoding = Text;
+    else if (strcmp(name, "full") == 0)
+        encoding = Full;
+    else if (strcmp(name, "rle") == 0)
+        encoding = Rle;
+    else if (strcmp(name, "delta") == 0)
+        encoding = Delta;
+    else
+        return false;
+    return true;
+}
+
+void FrameEncoder::publish(Publisher & pub)
+{
+    static const char *names[] = { "text", "full", "rle", "delta" };
+    char ioBuff[64];
+    if (generation == 0)                                        // Tell the subscribers what is coming
+    {
+        snprintf(ioBuff, sizeof(ioBuff), "size %ld %ld", width, height);
+        pub.publish(ioBuff);
+    }
+    if (encoding == Text)
+    {
+        publishText(pub);
+    }
+    else
+    {
+        if (generation == 0)
+        {
+            snprintf(ioBuff, sizeof(ioBuff), "proto %d %s", GLP_VERSION, names[encoding]);
+            pub.publish(ioBuff);
+        }
+        if (encoding == Delta && generation % keyframe != 0)
+            publishDelta(pub);
+        else                                                    // Full frame or a delta key frame
+            publishTiles(pub);
+    }
+    for (size_t i = 0; i < changes.size(); i++)                 // Bring the published board up to date
+        glpSetCell(&prev[0], changes[i], glpGetCell(&cur[0], changes[i]));
+    changes.clear();
+    generation++;
+}
+
+void FrameEncoder::publishText(Publisher & pub)
+{
+    long int before = pub.getByteCount();
+    pub.publish("clear");                                       // Put the clear command on the channel
+    for (long int x = 0; x < width; x++)                        // loop throught the board
+    {
+        for (long int y = 0; y < height; y++)
+        {
+            if (glpGetCell(&cur[0], (uint64_t) y * width + x))
+                pub.publishCell(x, y);                          // Put the data on the channel
+        }
+    }
+    pub.publish("swap");                                        // Put the swap command on the channel
+    frameBytes = pub.getByteCount() - before;
+}
+
+void FrameEncoder::publishTiles(Publisher & pub)
+{
+    frameBytes = 0;
+    msg.resize(glpFullBound(min(width, tileSize), min(height, tileSize)));
+    for (long int y = 0; y < height; y += tileSize)             // Row major tile order, (0,0) first
+    {
+        for (long int x = 0; x < width; x += tileSize)
+        {
+            size_t bytes = glpEncodeTile(&msg[0], width, height, generation, x, y, min(tileSize, width - x),
+                                         min(tileSize, height - y), &cur[0], encoding != Full);
+            pub.publishMessage(&msg[0], bytes);
+            frameBytes += bytes;
+        }
+    }
+}
+
+void FrameEncoder::publishDelta(Publisher & pub)
+{
+    delta.clear();
+    sort(changes.begin(), changes.end());                       // Delta entries are in index order
+    for (size_t i = 0; i < changes.size(); i++)
+    {
+        uint64_t index = changes[i];
+        if (i > 0 && changes[i - 1] == index)                   // Set more than once
+            continue;
+        int alive = glpGetCell(&cur[0], index);
+        if (alive != glpGetCell(&prev[0], index))               // Skip cells that changed back
+            delta.push_back(glpChange(index, alive));
+    }
+    msg.resize(glpDeltaBound(delta.size()));
+    frameBytes = glpEncodeDelta(&msg[0], width, height, generation, delta.empty() ? NULL : &delta[0],
+                                delta.size());
+    pub.publishMessage(&msg[0], frameBytes);
+}
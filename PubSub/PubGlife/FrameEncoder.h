@@ -0,0 +1,76 @@
+#ifndef __frame_encoder_h_
+#define __frame_encoder_h_
+#include <vector>
+#include "GlifeProto.h"
+#include "Publisher.h"
+
+/*
+ * Turns the board into messages for the channel.
+ *
+ * Text  => the "clear", "data x y Alive", "swap" records
+ * Full  => one binary bitmap frame per generation
+ * Rle   => one binary run length encoded frame per generation
+ * Delta => binary frames with only the changed cells. A run length encoded key frame is sent every
+ *          keyframe generations so that late subscribers can synchronize.
+ *
+ * Every encoding starts with a "size width height" text record and the binary encodings then announce
+ * themselves with a "proto version encoding" text record before the first frame. See GlifeProto.h for the
+ * binary format. Full and key frames of boards larger than tileSize x tileSize are sent as one message per
+ * tile so subscribers that only show part of the board can skip the rest.
+ *
+ * The encoder keeps a list of the cells that changed since the last frame, so a delta frame costs time in
+ * proportion to the activity on the board and not to its area.
+ */
+
+class FrameEncoder
+{
+  public:
+    typedef enum
+    { Text, Full, Rle, Delta } Encoding;
+
+    FrameEncoder(long int width, long int height, Encoding encoding = Text, int keyframe = 30,
+                 long int tileSize = 256);
+    // Set a cell of the board for the next frame
+    void setCell(long int x, long int y, bool alive)
+    {
+        uint64_t index = (uint64_t) y * width + x;
+        if (glpGetCell(&cur[0], index) != (int) alive)
+        {
+            glpSetCell(&cur[0], index, alive);
+            changes.push_back(index);
+        }
+    }
+    // Get a cell of the board
+    bool getCell(long int x, long int y) const
+    {
+        return glpGetCell(&cur[0], (uint64_t) y * width + x);
+    }
+    // Publish the board as the next frame
+    void publish(Publisher & pub);
+    // Bytes of the last published frame
+    size_t getFrameBytes() const
+    {
+        return frameBytes;
+    }
+    // Get the encoding from its name (text, full, rle, delta). Returns false if unknown.
+    static bool parseEncoding(const char *name, Encoding & encoding);
+
+  private:
+    long int width, height, tileSize;
+    Encoding encoding;
+    int keyframe;
+    uint32_t generation;
+    size_t frameBytes;
+    // Board being built and the board that was last published
+    std::vector < unsigned char >cur, prev;
+    // Encoded message
+    std::vector < unsigned char >msg;
+    // Cells set since the last frame, and the delta entries built from them
+    std::vector < uint64_t > changes, delta;
+
+    void publishText(Publisher & pub);
+    void publishDelta(Publisher & pub);
+    void publishTiles(Publisher & pub);
+};
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Game of life engine benchmark.
+ *
+ * Runs the same random board with the DEVS CellSpace model (one Cell atomic per cell, as in PubGlife -s devs)
+ * and with the bit parallel LifeEngine, without and with AVX2, and reports the cells computed per second.
+ * The DEVS model runs twice: with an event per neighbor routed by the CellSpace, and with one stencil event
+ * per cell that the simulator gives to the Moore neighborhood. For those runs the neighbor events delivered
+ * per second are reported as well.
+ * The boards of the engines are compared after the last generation. No display or redis server is needed.
+ * The DEVS runs also report the heap allocations of the simulator per state transition; -a 1 gives the
+ * simulator a step arena for its bags (see Simulator::setStepArena).
+ *
+ * By default the boards are 100x100, 1000x1000 and 4000x4000 cells. The DEVS model and its simulator peak at
+ * about 4 KB per cell, so the model is skipped for boards larger than -m cells (10^6 by default, about 4.5 GB).
+ * Build with "make OPTFLAG=-O2 LifeBench" for a fair comparison.
+ */
+
+#include "adevs.h"
+#include "Cell.h"
+#include "LifeEngine.h"
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
+using namespace std;
+
+/*
+ * Get the wall clock time in seconds.
+ */
+
+double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+/*
+ * Living neighbors of a cell on the wrapped board
+ */
+
+short int CountLivingCells(const LifeEngine & board, long int width, long int height, long int x, long int y)
+{
+    short int nalive = 0;
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            if ((dx != 0 || dy != 0) && board.getCell((x + dx + width) % width, (y + dy + height) % height))
+                nalive++;
+        }
+    }
+    return nalive;
+}
+
+/*
+ * Simulate generations of the board with the DEVS model. Returns the cells per second, sets the neighbor
+ * events per second and the simulator's allocations per state transition, and leaves the final board in result.
+ */
+
+double RunDevs(const LifeEngine & board, long int width, long int height, int generations, bool stencil,
+               bool arena, double &events, double &allocs, LifeEngine & result)
+{
+    adevs::CellSpace < Phase > *cell_space = new adevs::CellSpace < Phase > (width, height);
+    Cell::setStencil(stencil);
+    if (stencil)
+        cell_space->setMooreNeighborhood(adevs::CellSpace < Phase >::TORUS);
+    for (long int x = 0; x < width; x++)
+    {
+        for (long int y = 0; y < height; y++)
+            cell_space->add(new Cell(x, y, width, height, board.getPhase(x, y),
+                                     CountLivingCells(board, width, height, x, y)), x, y);
+    }
+    adevs::Simulator < CellEvent > *sim = new adevs::Simulator < CellEvent > (cell_space);
+    sim->setStepArena(arena);
+    long int outputs = Cell::getOutputs();
+    double start = Now();
+    int g;
+    for (g = 0; g < generations && sim->nextEventTime() < DBL_MAX; g++)
+        sim->execNextEvent();
+    double elapsed = Now() - start;
+    events = 8.0 * (Cell::getOutputs() - outputs) / elapsed;   // Every output reaches 8 neighbors
+    allocs = sim->getEventCount() > 0 ? (double) sim->getAllocationCount() / sim->getEventCount() : 0.0;
+    for (long int x = 0; x < width; x++)
+    {
+        for (long int y = 0; y < height; y++)
+            result.setCell(x, y, static_cast < Cell * >(cell_space->getModel(x, y))->getPhase() == Alive);
+    }
+    delete sim;
+    delete cell_space;
+    return (double) width * height * g / elapsed;            // The board may settle early
+}
+
+/*
+ * Run generations of the board with the bit parallel engine.
+ */
+
+double RunBits(const LifeEngine & board, int generations, bool avx2, LifeEngine & result)
+{
+    result = board;
+    result.setAvx2(avx2);
+    double start = Now();
+    for (int g = 0; g < generations; g++)
+        result.step();
+    return (double) board.getWidth() * board.getHeight() * generations / (Now() - start);
+}
+
+bool SameBoard(const LifeEngine & a, const LifeEngine & b)
+{
+    for (long int x = 0; x < a.getWidth(); x++)
+    {
+        for (long int y = 0; y < a.getHeight(); y++)
+        {
+            if (a.getCell(x, y) != b.getCell(x, y))
+                return false;
+        }
+    }
+    return true;
+}
+
+void RunSize(long int size, int generations, long int maxDevs, bool arena)
+{
+    long int width = size, height = size;
+    LifeEngine board(width, height), bits(width, height), devs(width, height);
+    srand(1);
+    for (long int x = 0; x < width; x++)
+    {
+        for (long int y = 0; y < height; y++)
+            board.setCell(x, y, rand() % 8 == 0);
+    }
+    printf("%ldx%ld cells, %d generations\n", width, height, generations);
+    double devsRate = 0.0, events, allocs;
+    if (width * height <= maxDevs)
+    {
+        devsRate = RunDevs(board, width, height, generations, false, arena, events, allocs, devs);
+        printf("  devs        %14.0f cells/sec  %12.0f events/sec  %.4f allocs/event\n", devsRate, events, allocs);
+        LifeEngine stencil(width, height);
+        double rate = RunDevs(board, width, height, generations, true, arena, events, allocs, stencil);
+        printf("  devs stencil%14.0f cells/sec  %12.0f events/sec  %.4f allocs/event  %4.1fx  %s\n", rate, events,
+               allocs, rate / devsRate, SameBoard(stencil, devs) ? "same board" : "BOARDS DIFFER");
+    }
+    else
+        printf("  devs        skipped, more than %ld cells\n", maxDevs);
+    double rate = RunBits(board, generations, false, bits);
+    printf("  bits        %14.0f cells/sec", rate);
+    if (devsRate > 0.0)
+        printf("  %8.1fx devs  %s", rate / devsRate, SameBoard(bits, devs) ? "same board" : "BOARDS DIFFER");
+    printf("\n");
+    if (LifeEngine::hasAvx2())
+    {
+        LifeEngine wide(width, height);
+        rate = RunBits(board, generations, true, wide);
+        printf("  bits avx2   %14.0f cells/sec", rate);
+        if (devsRate > 0.0)
+            printf("  %8.1fx devs", rate / devsRate);
+        printf("  %s\n", SameBoard(bits, wide) ? "same board" : "BOARDS DIFFER");
+    }
+}
+
+/*
+ * Display the command line usage on error.
+ */
+
+void Usage(char *command)
+{
+    printf("\nUsage: %s [-g generations] [-s size] [-m maxdevscells] [-a steparena]\n\n", command);
+}
+
+int main(int argc, char **argv)
+{
+    char sChar;
+    int i;
+    int generations = 20;                                       // Generations per run
+    long int size = 0;                                          // Side of the board, 0 runs the default sizes
+    long int maxDevs = 1000000;                                 // Largest board for the DEVS model
+    bool arena = false;                                         // Step arena for the DEVS simulator
+
+    if ((argc - 1) % 2 == 1)                                    // If argc odd arg miss match
+    {
+        printf("\nInsufficient arguments");
+        Usage(argv[0]);
+        return -1;
+    }
+    for (i = 1; i < argc; i += 2)                               // Loop through the arguments. Assume pairs
+    {
+        sChar = *(argv[i] + 1);                                 // Get the option
+        switch (sChar)
+        {
+        case 'g':                                              // Generations per run
+            generations = atoi(argv[i + 1]);
+            break;
+        case 's':                                              // Board size
+            size = atol(argv[i + 1]);
+            break;
+        case 'm':                                              // Largest board for the DEVS model
+            maxDevs = atol(argv[i + 1]);
+            break;
+        case 'a':                                              // Step arena on or off
+            arena = atoi(argv[i + 1]) != 0;
+            break;
+        default:                                               // Unknowen option print error message
+            printf("\nError Option %s not found\n\n", argv[i]);
+            Usage(argv[0]);
+            return -1;
+        }
+    }
+    if (size > 0)
+        RunSize(size, generations, maxDevs, arena);
+    else
+    {
+        RunSize(100, generations, maxDevs, arena);
+        RunSize(1000, generations, maxDevs, arena);
+        RunSize(4000, generations, maxDevs, arena);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "LifeEngine.h"
+#include <cstring>
+using namespace std;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIFE_AVX2 1
+#endif
+
+/*
+ * Four words for the AVX2 kernel. The bitwise operators of the gcc vector extension compile to single AVX2
+ * instructions inside of a function built for that target.
+ */
+
+typedef uint64_t Word4 __attribute__ ((vector_size(32)));
+
+/*
+ * The rule for one word (or vector of words) of cells. a..h are the eight neighbors, each shifted so the
+ * neighbor of a cell is in the cell's bit. The neighbors are added with full adders into the bits ones, twos
+ * and fours of the count; a count of 8 wraps to 0 which, like 0, is neither 2 nor 3.
+ */
+
+template < class W > static inline __attribute__ ((always_inline))
+void Rule(W & out, const W & alive, const W & a, const W & b, const W & c, const W & d, const W & e,
+          const W & f, const W & g, const W & h)
+{
+    W s1 = a ^ b ^ c, c1 = (a & b) | (c & (a ^ b));
+    W s2 = d ^ e ^ f, c2 = (d & e) | (f & (d ^ e));
+    W s3 = g ^ h, c3 = g & h;
+    W ones = s1 ^ s2 ^ s3, c4 = (s1 & s2) | (s3 & (s1 ^ s2));
+    W t1 = c1 ^ c2 ^ c3, k1 = (c1 & c2) | (c3 & (c1 ^ c2));
+    W twos = t1 ^ c4, fours = k1 ^ (t1 & c4);
+    out = twos & ~fours & (ones | alive);                       // 3 neighbors, or 2 and alive
+}
+
+/*
+ * Compute n words of a row from the rows above (up) and below (dn). Each row comes as the board (C) and
+ * the board shifted west (W) and east (E).
+ */
+
+template < class W > static inline __attribute__ ((always_inline))
+long int StepRow(uint64_t * out, const uint64_t * alive, const uint64_t * upW, const uint64_t * upC,
+                 const uint64_t * upE, const uint64_t * w, const uint64_t * e, const uint64_t * dnW,
+                 const uint64_t * dnC, const uint64_t * dnE, long int n)
+{
+    const long int lanes = sizeof(W) / sizeof(uint64_t);
+    long int i;
+    W v[10];
+    for (i = 0; i + lanes <= n; i += lanes)
+    {
+        memcpy(&v[0], alive + i, sizeof(W));                    // Unaligned loads
+        memcpy(&v[1], upW + i, sizeof(W));
+        memcpy(&v[2], upC + i, sizeof(W));
+        memcpy(&v[3], upE + i, sizeof(W));
+        memcpy(&v[4], w + i, sizeof(W));
+        memcpy(&v[5], e + i, sizeof(W));
+        memcpy(&v[6], dnW + i, sizeof(W));
+        memcpy(&v[7], dnC + i, sizeof(W));
+        memcpy(&v[8], dnE + i, sizeof(W));
+        Rule(v[9], v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+        memcpy(out + i, &v[9], sizeof(W));
+    }
+    return i;                                                   // Words done
+}
+
+static void StepRowScalar(uint64_t * out, const uint64_t * alive, const uint64_t * upW, const uint64_t * upC,
+                          const uint64_t * upE, const uint64_t * w, const uint64_t * e, const uint64_t * dnW,
+                          const uint64_t * dnC, const uint64_t * dnE, long int n)
+{
+    StepRow < uint64_t > (out, alive, upW, upC, upE, w, e, dnW, dnC, dnE, n);
+}
+
+#ifdef LIFE_AVX2
+__attribute__ ((target("avx2")))
+static void StepRowAvx2(uint64_t * out, const uint64_t * alive, const uint64_t * upW, const uint64_t * upC,
+                        const uint64_t * upE, const uint64_t * w, const uint64_t * e, const uint64_t * dnW,
+                        const uint64_t * dnC, const uint64_t * dnE, long int n)
+{
+    long int i = StepRow < Word4 > (out, alive, upW, upC, upE, w, e, dnW, dnC, dnE, n);
+    StepRow < uint64_t > (out + i, alive + i, upW + i, upC + i, upE + i, w + i, e + i, dnW + i, dnC + i,
+                          dnE + i, n - i);                      // The words left over
+}
+#endif
+
+LifeEngine::LifeEngine(long int width, long int height):
+width(width), height(height), words((width + 63) / 64), avx2(false),
+cur(words * height, 0), next(words * height, 0), west(words * height, 0), east(words * height, 0)
+{
+    lastMask = (width % 64 == 0) ? ~(uint64_t) 0 : (((uint64_t) 1 << (width % 64)) - 1);
+    setAvx2(true);
+}
+
+bool LifeEngine::hasAvx2()
+{
+#ifdef LIFE_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void LifeEngine::shiftRows()
+{
+    long int last = width - 1;
+    for (long int y = 0; y < height; y++)
+    {
+        const uint64_t *c = &cur[y * words];
+        uint64_t *w = &west[y * words], *e = &east[y * words];
+        // Each bit of w gets its western neighbor, each bit of e its eastern neighbor
+        for (long int i = 0; i < words; i++)
+        {
+            w[i] = (c[i] << 1) | (i > 0 ? c[i - 1] >> 63 : 0);
+            e[i] = (c[i] >> 1) | (i + 1 < words ? c[i + 1] << 63 : 0);
+        }
+        // Wrap around the edges of the board
+        w[0] |= (c[last >> 6] >> (last & 63)) & 1;
+        e[last >> 6] |= (c[0] & 1) << (last & 63);
+    }
+}
+
+size_t LifeEngine::step()
+{
+    shiftRows();
+    for (long int y = 0; y < height; y++)
+    {
+        long int up = (y == 0 ? height - 1 : y - 1) * words;
+        long int dn = (y == height - 1 ? 0 : y + 1) * words;
+        long int row = y * words;
+#ifdef LIFE_AVX2
+        if (avx2)
+            StepRowAvx2(&next[row], &cur[row], &west[up], &cur[up], &east[up], &west[row], &east[row],
+                        &west[dn], &cur[dn], &east[dn], words);
+        else
+#endif
+            StepRowScalar(&next[row], &cur[row], &west[up], &cur[up], &east[up], &west[row], &east[row],
+                          &west[dn], &cur[dn], &east[dn], words);
+        next[row + words - 1] &= lastMask;                      // Keep the cells past the edge dead
+    }
+    changes.clear();                                            // List the cells that flipped
+    for (long int y = 0; y < height; y++)
+    {
+        for (long int i = 0; i < words; i++)
+        {
+            uint64_t diff = cur[y * words + i] ^ next[y * words + i];
+            while (diff != 0)
+            {
+                changes.push_back((uint64_t) y * width + i * 64 + __builtin_ctzll(diff));
+                diff &= diff - 1;
+            }
+        }
+    }
+    cur.swap(next);
+    return changes.size();
+}
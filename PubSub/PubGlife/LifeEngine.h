@@ -0,0 +1,81 @@
+#ifndef __life_engine_h_
+#define __life_engine_h_
+#include <vector>
+#include <stdint.h>
+#include "Cell.h"
+
+/*
+ * Bit parallel game of life.
+ *
+ * An alternative to simulating every cell as a DEVS atomic model. The board is stored one bit per cell, 64
+ * cells to a word, and a generation is computed a whole word at a time: the eight neighbors of each cell are
+ * added with bitwise full adders (bit slicing), so no per cell events, bags or routing are involved. When the
+ * processor has AVX2 four words are computed per instruction. The edges wrap around like in the DEVS model.
+ *
+ * After each step() the engine lists the cells that changed, with the same y*width+x index the
+ * FrameEncoder uses, so it can feed a publisher just like the CellListener does.
+ */
+
+class LifeEngine
+{
+  public:
+    LifeEngine(long int width, long int height);
+    // Set the phase of a cell
+    void setCell(long int x, long int y, bool alive)
+    {
+        uint64_t &word = cur[y * words + (x >> 6)];
+        if (alive)
+            word |= (uint64_t) 1 << (x & 63);
+        else
+            word &= ~((uint64_t) 1 << (x & 63));
+    }
+    bool getCell(long int x, long int y) const
+    {
+        return (cur[y * words + (x >> 6)] >> (x & 63)) & 1;
+    }
+    Phase getPhase(long int x, long int y) const
+    {
+        return getCell(x, y) ? Alive : Dead;
+    }
+    // Compute the next generation. Returns the number of cells that changed.
+    size_t step();
+    // Cells that changed in the last step as y*width+x
+    const std::vector < uint64_t > &getChanges() const
+    {
+        return changes;
+    }
+    long int getWidth() const
+    {
+        return width;
+    }
+    long int getHeight() const
+    {
+        return height;
+    }
+    // Use the AVX2 kernel if the processor has it. On by default.
+    void setAvx2(bool enable)
+    {
+        avx2 = enable && hasAvx2();
+    }
+    bool usesAvx2() const
+    {
+        return avx2;
+    }
+    // Returns true if the processor has AVX2
+    static bool hasAvx2();
+
+  private:
+    long int width, height;
+    // Words per row
+    long int words;
+    // Bits of the last word in a row that are on the board
+    uint64_t lastMask;
+    bool avx2;
+    // The board, the next board and the board shifted one cell to the west and east
+    std::vector < uint64_t > cur, next, west, east;
+    std::vector < uint64_t > changes;
+
+    void shiftRows();
+};
+
+#endif
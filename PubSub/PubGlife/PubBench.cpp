@@ -0,0 +1,161 @@
+
+/*
+ * Publishing benchmark.
+ *
+ * Publishes random game of life boards to the redis channel with each of the Publisher modes and frame
+ * encodings and reports the frames per second, messages per second and bytes per frame. The boards start with
+ * the density of the initial PubGlife board (one cell in eight alive) and a small fraction of the cells flip
+ * in each frame. No display is needed, but a redis server must be running, for example a local one started
+ * with redis-3.2.0/src/redis-server. Use -x and -y for larger boards; the text modes are skipped above
+ * 10^6 cells.
+ */
+
+#include "Publisher.h"
+#include "FrameEncoder.h"
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/time.h>
+#include "hiredis.h"
+using namespace std;
+
+// Cellspace dimensions
+static long int width = 100;
+static long int height = 100;
+static vector < unsigned char >alive;
+// One cell in this many flips in each frame
+#define FLIP 50
+
+/*
+ * Get the wall clock time in seconds.
+ */
+
+double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+/*
+ * Publish frames boards with the given mode and encoding and print the rates.
+ */
+
+bool RunMode(redisContext * c, const char *name, const char *encName, int frames, int batchSize)
+{
+    Publisher::Mode mode;
+    FrameEncoder::Encoding encoding;
+    Publisher::parseMode(name, mode);
+    FrameEncoder::parseEncoding(encName, encoding);
+    Publisher pub(c, "sscpactest", mode, batchSize);
+    FrameEncoder enc(width, height, encoding);
+    srand(1);                                                   // Every mode sees the same boards
+    alive.assign(width * height, 0);
+    for (long int i = 0; i < width * height; i++)
+        alive[i] = (rand() % 8 == 0);
+    double start = Now();
+    for (int f = 0; f < frames; f++)
+    {
+        for (long int y = 0; y < height; y++)
+        {
+            for (long int x = 0; x < width; x++)
+            {
+                unsigned char &cell = alive[y * width + x];
+                if (rand() % FLIP == 0)                         // Change the board a little
+                    cell = !cell;
+                enc.setCell(x, y, cell);
+            }
+        }
+        enc.publish(pub);
+        if (!pub.flush())                                       // Wait for the whole frame
+        {
+            printf("Error: %s\n", c->errstr);
+            return false;
+        }
+    }
+    double elapsed = Now() - start;
+    printf("%-9s %-6s batch %5d  %10.1f frames/sec  %11.1f messages/sec  %9.1f bytes/frame\n",
+           name, encName, batchSize, frames / elapsed, pub.getMessageCount() / elapsed,
+           (double) pub.getByteCount() / frames);
+    return true;
+}
+
+/*
+ * Display the command line usage on error.
+ */
+
+void Usage(char *command)
+{
+    printf("\nUsage: %s [-h host] [-p port] [-f frames] [-b batchsize] [-x width] [-y height]\n\n", command);
+}
+
+int main(int argc, char **argv)
+{
+    char hostip[256], sChar;
+    int hostport, i;
+    int frames = 20;                                            // Frames to publish in each mode
+    int batchSize = 256;                                        // Commands in flight or records per message
+    strcpy(hostip, "127.0.0.1");                                // Radis default host
+    hostport = 6379;                                            // Redis default port
+
+    if ((argc - 1) % 2 == 1)                                    // If argc odd arg miss match
+    {
+        printf("\nInsufficient arguments");
+        Usage(argv[0]);
+        return -1;
+    }
+    for (i = 1; i < argc; i += 2)                               // Loop through the arguments. Assume pairs
+    {
+        sChar = *(argv[i] + 1);                                 // Get the option
+        switch (sChar)
+        {
+        case 'h':                                              // Host option set get host name/IP
+            strcpy(hostip, argv[i + 1]);
+            break;
+        case 'p':                                              // Port option set get port number
+            hostport = atoi(argv[i + 1]);
+            break;
+        case 'f':                                              // Number of frames per mode
+            frames = atoi(argv[i + 1]);
+            break;
+        case 'b':                                              // Batch size
+            batchSize = atoi(argv[i + 1]);
+            break;
+        case 'x':                                              // Cellspace dimensions
+            width = atol(argv[i + 1]);
+            break;
+        case 'y':
+            height = atol(argv[i + 1]);
+            break;
+        default:                                               // Unknowen option print error message
+            printf("\nError Option %s not found\n\n", argv[i]);
+            Usage(argv[0]);
+            return -1;
+        }
+    }
+
+    redisContext *c = redisConnect(hostip, hostport);           // Get the redis context
+    if (c == NULL || c->err)                                    // Handle connection errors
+    {
+        if (c != NULL)
+            printf("Error: %s\n", c->errstr);
+        else
+            printf("Can't allocate redis context\n");
+        return -1;
+    }
+    printf("Publishing %d frames of %ldx%ld cells to %s:%d\n", frames, width, height, hostip, hostport);
+    bool text = width * height <= 1000000;                      // A text frame of a large board takes minutes
+    if ((text && !RunMode(c, "blocking", "text", frames, 1)) ||
+        (text && !RunMode(c, "pipeline", "text", frames, batchSize)) ||
+        (text && !RunMode(c, "frame", "text", frames, batchSize)) ||
+        !RunMode(c, "pipeline", "full", frames, batchSize) ||
+        !RunMode(c, "pipeline", "rle", frames, batchSize) ||
+        !RunMode(c, "pipeline", "delta", frames, batchSize))
+    {
+        redisFree(c);
+        return -1;
+    }
+    redisFree(c);
+    return 0;
+}
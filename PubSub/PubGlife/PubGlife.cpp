@@ -4,8 +4,9 @@
  * 
  * Publish the game of life data, as it is generated, to the redis channel. This is done synchronously so the process
  * starts calculating and publishing data. The process turminates when the life span is reached and a end of file
- * (_EOF_) is published. You need to have a functioning redis server running and the hiredis library installed. The
- * source code can be downloaded from:
+ * (_EOF_) is published. By default the PUBLISH commands are pipelined, see Publisher.h for the other modes.
+ * You need to have a functioning redis server running and the hiredis library installed. The source code can
+ * be downloaded from:
  *
  * https://github.com/redis/hiredis.git
  *
@@ -24,6 +25,22 @@
  * clear           => in the glife program the screen buffer is cleared so clear the buffer
  * _EOF_           => This is the End Of File so the the program will terminate
  *
+ * In the frame publishing mode (-m frame) several commands are sent in one message separated by '\n'.
+ *
+ * With -e full, rle or delta the frames are sent in the binary format described in GlifeProto.h instead
+ * of as text records. The binary stream starts with a "proto version encoding" text record.
+ *
+ * With -d off the program runs headless, without GLUT or an X server. The simulation then runs in its own
+ * loop at up to -r generations per second and hands the frames through a queue of -q frames to a publisher
+ * thread that sends them with asynchronous hiredis commands (see AsyncPublisher.h).
+ *
+ * The cellspace is -x cells wide and -y cells high. The board is kept as one bit per cell in the FrameEncoder,
+ * the window only shows the top left corner of large boards. The frames start with a "size width height"
+ * record and the binary frames carry the dimensions in their header.
+ *
+ * With -s bits the generations are computed by the bit parallel LifeEngine instead of the DEVS CellSpace
+ * model. Both produce the same boards; see LifeBench for the difference in speed.
+ *
  */
 
 #include "adevs.h"
@@ -32,25 +49,35 @@
 #include <ctime>
 #include <iostream>
 #include <string.h>
+#include <thread>
+#include <sys/time.h>
+#include <unistd.h>
 #include <GL/freeglut_std.h>
 #include <GL/freeglut_ext.h>
 #include "hiredis.h"
+#include "Publisher.h"
+#include "FrameEncoder.h"
+#include "CellListener.h"
+#include "AsyncPublisher.h"
+#include "LifeEngine.h"
 using namespace std;
 
 // Cellspace dimensions
-#define WIDTH 100
-#define HEIGHT 100
-// Phase space to visualize
-Phase phase[WIDTH][HEIGHT];
+static long int width = 100;
+static long int height = 100;
 
-// Window and cell dimensions. 
+// Window and cell dimensions. The window shows at most VIEW_SIZE x VIEW_SIZE cells
 #define CELL_SIZE 6
-const GLint win_width = WIDTH * CELL_SIZE;
-const GLint win_height = HEIGHT * CELL_SIZE;
+#define VIEW_SIZE 150
+static GLint win_width, win_height;
 
 redisContext *c;                                                // Redis context for publishing to the channel
+Publisher *pub;                                                 // Publisher for the channel
+FrameEncoder *enc;                                              // Encodes the board for the channel
+CellListener < Cell > *listener;                                // Collects the cells changed by the simulator
 static int life = 0;                                            // Loop vareable
 static int lifeSpan = 6;                                        // Default life span
+static bool bits = false;                                       // Use the LifeEngine instead of the DEVS model
 
 /*
  * This function is a callback that displays the game of life data calculated by the simulatoin
@@ -59,7 +86,6 @@ static int lifeSpan = 6;                                        // Default life
 void drawSpace()
 {
     static bool init = true;                                    // initilize the displey on the first call
-    char ioBuff[1024];
     if (init)
     {
         init = false;
@@ -72,29 +98,35 @@ void drawSpace()
     }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);         // Clear the display
-    redisCommand(c, "PUBLISH sscpactest clear");                // Put the clear command on the channel
-    for (int x = 0; x < WIDTH; x++)                             // loop throught the phase data
+    for (int x = 0; x < width && x < VIEW_SIZE; x++)            // loop throught the cells in the window
     {
-        for (int y = 0; y < HEIGHT; y++)
+        for (int y = 0; y < height && y < VIEW_SIZE; y++)
         {
-            if (phase[x][y] == Alive)                           // Phase is calculated in the simulation function
+            if (enc->getCell(x, y))                             // The board is updated by the simulation function
             {
                 GLint wx = CELL_SIZE * x;                       // If the cell is alive plot the cell
                 GLint wy = CELL_SIZE * y;
                 glRecti(wx, wy, wx + CELL_SIZE, wy + CELL_SIZE);
-                sprintf(ioBuff, "data %i %i Alive", x, y);      // Build the data buffer
             }
-            redisCommand(c, "PUBLISH sscpactest %s", ioBuff);   // Put the data on the channel
         }
     }
-    redisCommand(c, "PUBLISH sscpactest swap");                 // Put the swap command on the channel
     glutSwapBuffers();
+}
+
+/*
+ * Publish the cells that changed in the last simulation step as one frame
+ */
+
+void publishSpace()
+{
+    listener->publish();                                        // Put the frame on the channel
+    pub->flush();                                               // Wait for the server to take the frame
     if (life++ > lifeSpan)                                      // Exit the simulation after the life span is exceded
     {
-        redisCommand(c, "PUBLISH sscpactest _EOF_");            // Put end of file on the channel
+        pub->publish("_EOF_");                                  // Put end of file on the channel
+        pub->flush();
         glutLeaveMainLoop();
     }
-
 }
 
 /*
@@ -103,20 +135,20 @@ void drawSpace()
  *
  */
 
-short int count_living_cells(int x, int y)
+short int count_living_cells(long int x, long int y)
 {
     short int nalive = 0;
     for (int dx = -1; dx <= 1; dx++)
     {
         for (int dy = -1; dy <= 1; dy++)
         {
-            int xx = (x + dx) % WIDTH;
-            int yy = (y + dy) % HEIGHT;
+            long int xx = (x + dx) % width;
+            long int yy = (y + dy) % height;
             if (xx < 0)
-                xx = WIDTH - 1;
+                xx = width - 1;
             if (yy < 0)
-                yy = HEIGHT - 1;
-            if (phase[xx][yy] == Alive && !(xx == x && yy == y))
+                yy = height - 1;
+            if (enc->getCell(xx, yy) && !(xx == x && yy == y))
             {
                 nalive++;
             }
@@ -125,40 +157,54 @@ short int count_living_cells(int x, int y)
     return nalive;
 }
 
-void simulateSpace()
+/*
+ * Put a random board into the next frame
+ */
+
+void randomSpace()
 {
     // Seed the random number generator
     srand(time(NULL));
+    for (long int x = 0; x < width; x++)
+    {
+        for (long int y = 0; y < height; y++)
+            enc->setCell(x, y, rand() % 8 == 0);
+    }
+}
+
+/*
+ * Advance the DEVS simulation by one step. A new random space is created when everything has died. The step
+ * that creates a space only seeds the board, so the seed is published as its own frame (generation 0).
+ */
+
+void stepDevs()
+{
     // Dynamic cellspace model and simulator
     static adevs::CellSpace < Phase > *cell_space = NULL;
     static adevs::Simulator < CellEvent > *sim = NULL;
     // Reset the space if everything has died
     if (cell_space == NULL)
     {
-        // Create the cell state variable array
-        for (int x = 0; x < WIDTH; x++)
-        {
-            for (int y = 0; y < HEIGHT; y++)
-            {
-                if (rand() % 8 == 0)
-                    phase[x][y] = Alive;
-                else
-                    phase[x][y] = Dead;
-            }
-        }
+        randomSpace();
         // Create the cellspace model
-        cell_space = new adevs::CellSpace < Phase > (WIDTH, HEIGHT);
-        for (int x = 0; x < WIDTH; x++)
+        cell_space = new adevs::CellSpace < Phase > (width, height);
+        for (long int x = 0; x < width; x++)
         {
-            for (int y = 0; y < HEIGHT; y++)
+            for (long int y = 0; y < height; y++)
             {
                 // Count the living neighbors
                 short int nalive = count_living_cells(x, y);
-                cell_space->add(new Cell(x, y, WIDTH, HEIGHT, phase[x][y], nalive, &(phase[x][y])), x, y);
+                Phase phase = enc->getCell(x, y) ? Alive : Dead;
+                cell_space->add(new Cell(x, y, width, height, phase, nalive), x, y);
             }
         }
-        // Create a simulator for the model
+        // Each cell sends one event that the simulator gives to its 8 neighbors
+        Cell::setStencil(true);
+        cell_space->setMooreNeighborhood(adevs::CellSpace < Phase >::TORUS);
+        // Create a simulator for the model and listen for the cells that change
         sim = new adevs::Simulator < CellEvent > (cell_space);
+        sim->addEventListener(listener);
+        return;                                                 // Publish the seed before the first step
     }
     // If everything has died, then restart on the next call
     if (sim->nextEventTime() == DBL_MAX)
@@ -173,23 +219,165 @@ void simulateSpace()
     {
         sim->execNextEvent();
     }
-    // Draw the updated display
+}
+
+/*
+ * Advance the bit parallel engine by one generation. The engine lists the changed cells, so they go into the
+ * next frame the same way the CellListener puts them there for the DEVS model. As for the DEVS model, a new
+ * space is published as its own frame before the first generation is computed.
+ */
+
+void stepBits()
+{
+    static LifeEngine *engine = NULL;
+    if (engine == NULL)
+    {
+        randomSpace();
+        engine = new LifeEngine(width, height);
+        for (long int x = 0; x < width; x++)
+        {
+            for (long int y = 0; y < height; y++)
+                engine->setCell(x, y, enc->getCell(x, y));
+        }
+        return;                                                 // Publish the seed before the first step
+    }
+    // If nothing changes anymore, then restart on the next call
+    if (engine->step() == 0)
+    {
+        delete engine;
+        engine = NULL;
+        return;
+    }
+    const vector < uint64_t > &changes = engine->getChanges();
+    for (size_t i = 0; i < changes.size(); i++)
+    {
+        long int x = changes[i] % width, y = changes[i] / width;
+        enc->setCell(x, y, engine->getCell(x, y));
+    }
+}
+
+/*
+ * Advance the simulation by one step with the selected engine
+ */
+
+void stepSpace()
+{
+    if (bits)
+        stepBits();
+    else
+        stepDevs();
+}
+
+/*
+ * The GLUT idle callback simulates, publishes and draws the space
+ */
+
+void simulateSpace()
+{
+    stepSpace();
+    publishSpace();
     drawSpace();
 }
 
+/*
+ * Get the wall clock time in seconds.
+ */
+
+double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+/*
+ * Run without a display. The simulation runs on this thread at up to rate generations per second (0 runs as
+ * fast as possible). Each frame is captured by the publisher and handed through a queue of depth frames to
+ * the publisher thread. When the queue is full the simulation waits for the publisher.
+ */
+
+int runHeadless(const char *hostip, int hostport, double rate, int depth)
+{
+    SpscQueue < Frame * >frames(depth), spare(depth + 1);
+    AsyncPublisher apub("sscpactest", &frames, &spare);
+    if (!apub.connect(hostip, hostport))
+        return -1;
+    thread pubThread(&AsyncPublisher::run, &apub);              // Start the publisher thread
+    Frame *frame;
+    long int waits = 0;
+    int generations = 0;
+    bool last = false;
+    double start = Now(), next = start;
+    while (!last && !apub.failed())
+    {
+        if (!spare.pop(frame))                                  // Reuse a frame that has been sent
+            frame = new Frame;
+        pub->setOutput(frame);                                  // Capture the next frame
+        stepSpace();
+        listener->publish();
+        generations++;
+        if (life++ > lifeSpan)                                  // Exit the simulation after the life span is exceded
+        {
+            pub->publish("_EOF_");                              // Put end of file on the channel
+            last = true;
+        }
+        pub->flush();
+        while (!frames.push(frame))                             // Wait for the publisher to catch up
+        {
+            if (apub.failed())
+            {
+                delete frame;
+                break;
+            }
+            waits++;
+            usleep(100);
+        }
+        if (rate > 0.0)                                         // Hold the generation rate
+        {
+            next += 1.0 / rate;
+            double wait = next - Now();
+            if (wait > 0.0)
+                usleep((useconds_t) (wait * 1E6));
+            else if (wait < -1.0)                               // Don't try to make up for a long stall
+                next = Now();
+        }
+    }
+    apub.finish();                                              // Send what is left and disconnect
+    pubThread.join();
+    double elapsed = Now() - start;
+    while (frames.pop(frame))                                   // Frames left after a lost connection
+        delete frame;
+    while (spare.pop(frame))
+        delete frame;
+    printf("%d generations in %.3f sec, %.1f generations/sec\n", generations, elapsed, generations / elapsed);
+    printf("%ld messages published, %ld simulator waits, %ld publisher stalls\n", apub.getReplyCount(), waits,
+           apub.getStallCount());
+    return apub.failed() ? -1 : 0;
+}
+
 /*
  * Display the command line usage on error.
  */
 
 void Usage(char *command)
 {
-    printf("\nUsage: %s [-h host] [-p port] [-l lifespan\n\n", command);
+    printf("\nUsage: %s [-h host] [-p port] [-l lifespan] [-m blocking|pipeline|frame] [-b batchsize]\n"
+           "       [-e text|full|rle|delta] [-k keyframe] [-t tilesize] [-x width] [-y height]\n"
+           "       [-s devs|bits] [-d on|off] [-r generations/sec] [-q queuedepth]\n\n", command);
 }
 
 int main(int argc, char **argv)
 {
     char hostip[256], sChar;
     int hostport, i;
+    Publisher::Mode mode = Publisher::Pipelined;                // Publishing mode
+    int batchSize = 256;                                        // Commands in flight or records per message
+    FrameEncoder::Encoding encoding = FrameEncoder::Text;       // Wire format of the frames
+    int keyframe = 30;                                          // Generations between delta key frames
+    long int tileSize = 256;                                    // Cells per side of a full frame tile
+    bool display = true;                                        // Run with a GLUT display
+    double rate = 0.0;                                          // Headless generations per second, 0 is unlimited
+    int depth = 8;                                              // Headless frame queue depth
     strcpy(hostip, "127.0.0.1");                                // Radis default host
     hostport = 6379;                                            // Redis default port
 
@@ -226,6 +414,60 @@ int main(int argc, char **argv)
             case 'l':                                          // Port option set get port number
                 lifeSpan = atoi(argv[i + 1]);
                 break;
+            case 'm':                                          // Publishing mode
+                if (!Publisher::parseMode(argv[i + 1], mode))
+                {
+                    printf("\nError unknown mode %s\n\n", argv[i + 1]);
+                    Usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'b':                                          // Batch size for the publishing mode
+                batchSize = atoi(argv[i + 1]);
+                break;
+            case 'e':                                          // Frame encoding
+                if (!FrameEncoder::parseEncoding(argv[i + 1], encoding))
+                {
+                    printf("\nError unknown encoding %s\n\n", argv[i + 1]);
+                    Usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'k':                                          // Generations between delta key frames
+                keyframe = atoi(argv[i + 1]);
+                break;
+            case 't':                                          // Tile size of the full frames
+                tileSize = atol(argv[i + 1]);
+                break;
+            case 'x':                                          // Cellspace dimensions
+                width = atol(argv[i + 1]);
+                break;
+            case 'y':
+                height = atol(argv[i + 1]);
+                break;
+            case 's':                                          // Simulation engine
+                if (strcmp(argv[i + 1], "bits") == 0)
+                    bits = true;
+                else if (strcmp(argv[i + 1], "devs") == 0)
+                    bits = false;
+                else
+                {
+                    printf("\nError unknown engine %s\n\n", argv[i + 1]);
+                    Usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'd':                                          // Display on or off
+                display = (strcmp(argv[i + 1], "off") != 0);
+                break;
+            case 'r':                                          // Headless generations per second
+                rate = atof(argv[i + 1]);
+                break;
+            case 'q':                                          // Headless frame queue depth
+                depth = atoi(argv[i + 1]);
+                if (depth < 1)
+                    depth = 1;
+                break;
             default:                                           // Unknowen option print error message
                 printf("\nError Option %s not found\n\n", argv[i]);
                 Usage(argv[0]);
@@ -234,6 +476,24 @@ int main(int argc, char **argv)
         }
         printf("\nUsing host %s port %i\n\n", hostip, hostport);
     }
+    if (width < 1 || height < 1)
+    {
+        printf("\nError the cellspace needs at least one row and column");
+        Usage(argv[0]);
+        return -1;
+    }
+
+    if (!display)                                               // Run headless with a publisher thread
+    {
+        pub = new Publisher((Frame *) NULL, mode, batchSize);
+        enc = new FrameEncoder(width, height, encoding, keyframe, tileSize);
+        listener = new CellListener < Cell > (enc, pub);
+        int status = runHeadless(hostip, hostport, rate, depth);
+        delete listener;
+        delete enc;
+        delete pub;
+        return status;
+    }
 
     c = redisConnect(hostip, hostport);                         // Get the redis context
     if (c == NULL || c->err)                                    // Handle connection errors
@@ -248,9 +508,14 @@ int main(int argc, char **argv)
         }
         return -1;                                              // Return error status
     }
+    pub = new Publisher(c, "sscpactest", mode, batchSize);
+    enc = new FrameEncoder(width, height, encoding, keyframe, tileSize);
+    listener = new CellListener < Cell > (enc, pub);
     // Setup the display
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
+    win_width = min(width, (long int) VIEW_SIZE) * CELL_SIZE;
+    win_height = min(height, (long int) VIEW_SIZE) * CELL_SIZE;
     glutInitWindowSize(win_width, win_height);
     glutCreateWindow("PubGlife");
     glutPositionWindow(0, 0);
@@ -258,5 +523,9 @@ int main(int argc, char **argv)
     glutIdleFunc(simulateSpace);
     glutMainLoop();
     // Done
+    delete listener;
+    delete enc;
+    delete pub;
+    redisFree(c);
     return 0;
 }
@@ -0,0 +1,125 @@
+#include "Publisher.h"
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+Publisher::Publisher(redisContext * c, const char *channel, Mode mode, int batchSize):
+c(c), out(NULL), channel(channel), mode(mode), batchSize(batchSize), pending(0), frameRecords(0), messages(0), records(0),
+bytes(0)
+{
+    if (this->batchSize < 1)                                    // A batch always holds at least one record
+        this->batchSize = 1;
+    if (mode == Blocking)                                       // Blocking is a pipeline of depth one
+        this->batchSize = 1;
+}
+
+Publisher::Publisher(Frame * out, Mode mode, int batchSize):
+c(NULL), out(out), mode(mode), batchSize(batchSize), pending(0), frameRecords(0), messages(0), records(0),
+bytes(0)
+{
+    if (this->batchSize < 1)
+        this->batchSize = 1;
+}
+
+Publisher::~Publisher()
+{
+    flush();
+}
+
+bool Publisher::parseMode(const char *name, Mode & mode)
+{
+    if (strcmp(name, "blocking") == 0)
+        mode = Blocking;
+    else if (strcmp(name, "pipeline") == 0)
+        mode = Pipelined;
+    else if (strcmp(name, "frame") == 0)
+        mode = Framed;
+    else
+        return false;
+    return true;
+}
+
+void Publisher::publish(const char *record)
+{
+    size_t len = strlen(record);
+    records++;
+    bytes += len;
+    if (mode != Framed)                                         // One message per record
+    {
+        append(record, len);
+        if (pending >= batchSize)                               // Read the replies when the pipeline is full
+            drain();
+        return;
+    }
+    if (frameRecords > 0)                                       // Records in a frame are separated by newlines
+        frame += '\n';
+    frame.append(record, len);
+    if (++frameRecords >= batchSize)                            // Send the frame when it is full
+        sendFrame();
+}
+
+void Publisher::publishCell(int x, int y)
+{
+    char ioBuff[64];
+    snprintf(ioBuff, sizeof(ioBuff), "data %i %i Alive", x, y);
+    publish(ioBuff);
+}
+
+void Publisher::publishMessage(const void *data, size_t len)
+{
+    records++;
+    bytes += len;
+    if (frameRecords > 0)                                       // Keep the order of the records
+        sendFrame();
+    append((const char *) data, len);
+    if (mode != Framed && pending >= batchSize)
+        drain();
+}
+
+bool Publisher::flush()
+{
+    if (frameRecords > 0)                                       // Send a partial frame
+        sendFrame();
+    return drain();
+}
+
+void Publisher::append(const char *data, size_t len)
+{
+    if (c == NULL)                                              // Capture the message
+    {
+        out->push_back(std::string(data, len));
+        messages++;
+        return;
+    }
+    if (c->err)                                                 // Nothing can be sent on a failed connection
+        return;
+    if (redisAppendCommand(c, "PUBLISH %b %b", channel.data(), channel.size(), data, len) != REDIS_OK)
+        return;
+    pending++;
+    messages++;
+}
+
+bool Publisher::drain()
+{
+    void *reply;
+    if (c == NULL)                                              // Captured messages have no replies
+        return true;
+    while (pending > 0)                                         // redisGetReply writes the buffer then reads
+    {
+        if (redisGetReply(c, &reply) != REDIS_OK)
+        {
+            pending = 0;
+            return false;
+        }
+        freeReplyObject(reply);
+        pending--;
+    }
+    return c->err == 0;
+}
+
+void Publisher::sendFrame()
+{
+    append(frame.data(), frame.size());
+    frame.clear();
+    frameRecords = 0;                                           // Replies are read by flush()
+}
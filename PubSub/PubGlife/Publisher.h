@@ -0,0 +1,100 @@
+#ifndef __publisher_h_
+#define __publisher_h_
+#include <string>
+#include <vector>
+#include "hiredis.h"
+
+/// The messages of one frame, used when the publisher captures messages instead of sending them
+typedef std::vector < std::string > Frame;
+
+/*
+ * Publishes the game of life records to a redis channel.
+ *
+ * The original program issued one blocking PUBLISH per record, which costs a full round trip to the
+ * server for every cell. The Publisher supports three modes:
+ *
+ * Blocking  => one PUBLISH per record, waiting for each reply (the original behaviour)
+ * Pipelined => one PUBLISH per record, but up to batchSize commands are written before the replies are read
+ * Framed    => up to batchSize records are joined with '\n' and sent as a single PUBLISH, the messages
+ *              of a frame are pipelined and their replies read by flush()
+ *
+ * A publisher created without a redis context captures the messages into a Frame instead of sending them,
+ * so another thread can send the frame later (see AsyncPublisher.h).
+ *
+ * The records are the same in every mode ("clear", "data x y Alive", "swap", "_EOF_"), so a subscriber
+ * that splits each message on '\n' understands all three.
+ */
+
+class Publisher
+{
+  public:
+    typedef enum
+    { Blocking, Pipelined, Framed } Mode;
+
+    /**
+     * Create a publisher for channel on the connected context c. The batchSize is the number of
+     * commands in flight (Pipelined) or the number of records per message (Framed).
+     */
+    Publisher(redisContext * c, const char *channel, Mode mode = Pipelined, int batchSize = 256);
+    // Create a publisher that captures its messages into out
+    Publisher(Frame * out, Mode mode = Pipelined, int batchSize = 256);
+    // Capture the following messages into out
+    void setOutput(Frame * out)
+    {
+        this->out = out;
+    }
+    // Queue a record for the channel
+    void publish(const char *record);
+    // Queue a "data x y Alive" record
+    void publishCell(int x, int y);
+    // Queue a message that is sent on its own, e.g. a binary frame. Framed records are sent first.
+    void publishMessage(const void *data, size_t len);
+    // Send everything that is queued and wait for the replies. Returns false on a redis error.
+    bool flush();
+    // Number of PUBLISH commands sent to the server
+    long int getMessageCount() const
+    {
+        return messages;
+    }
+    // Number of records given to the publisher
+    long int getRecordCount() const
+    {
+        return records;
+    }
+    // Number of payload bytes given to the publisher
+    long int getByteCount() const
+    {
+        return bytes;
+    }
+    // Returns true if the connection has failed
+    bool error() const
+    {
+        return c != NULL && c->err != 0;
+    }
+    // Get the publishing mode from its name (blocking, pipeline, frame). Returns false if unknown.
+    static bool parseMode(const char *name, Mode & mode);
+    // Destructor flushes anything that is still queued
+    ~Publisher();
+
+  private:
+    redisContext *c;
+    Frame *out;
+    std::string channel;
+    Mode mode;
+    int batchSize;
+    // Number of PUBLISH commands whose replies have not been read
+    int pending;
+    // Records waiting to be sent as one message in Framed mode
+    std::string frame;
+    int frameRecords;
+    long int messages, records, bytes;
+
+    // Append a PUBLISH command to the output buffer
+    void append(const char *data, size_t len);
+    // Read the replies of the pending commands
+    bool drain();
+    // Send the queued Framed records as one message
+    void sendFrame();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __spsc_queue_h_
+#define __spsc_queue_h_
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/*
+ * A bounded, lock free queue for exactly one producer thread and one consumer thread.
+ *
+ * The producer only writes tail and the consumer only writes head, so each side needs nothing more than
+ * an acquire load of the other's index. push() and pop() never block; they return false when the queue
+ * is full or empty and the caller decides how to wait.
+ */
+
+template < class T > class SpscQueue
+{
+  public:
+    // Create a queue that holds up to capacity items
+    SpscQueue(size_t capacity):
+    slots(capacity + 1), head(0), tail(0)
+    {
+    }
+    // Add an item. Returns false if the queue is full. Only called by the producer.
+    bool push(const T & item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) % slots.size();
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        slots[t] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+    // Remove the oldest item. Returns false if the queue is empty. Only called by the consumer.
+    bool pop(T & item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = slots[h];
+        head.store((h + 1) % slots.size(), std::memory_order_release);
+        return true;
+    }
+    // Returns true if the queue is empty. Exact only when called by the consumer.
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::vector < T > slots;
+    // Keep the indices on separate cache lines so the threads don't share one
+    alignas(64) std::atomic < size_t > head;
+    alignas(64) std::atomic < size_t > tail;
+};
+
+#endif
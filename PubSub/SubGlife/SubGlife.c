@@ -9,6 +9,9 @@
  *
  * https://github.com/redis/hiredis.git
  *
+ * The board may be much larger than the window. Only the view of -c columns and -r rows at -x, -y is kept and
+ * drawn; the parts of the binary frames outside of the view are skipped (see GlifeProto.h).
+ *
  */
 
 #include <stdio.h>
@@ -22,21 +25,157 @@
 #include <async.h>
 #include <adapters/ae.h>
 
+#include "GlifeProto.h"
+
 #define FALSE 0
 #define TRUE 1
 
-// Cellspace dimensions
-#define WIDTH 100
-#define HEIGHT 100
+// The part of the cellspace that is shown
+static uint32_t viewX = 0, viewY = 0;
+static uint32_t viewWidth = 100, viewHeight = 100;
 
 // Window and cell dimensions. 
 #define CELL_SIZE 6
-const GLint win_width = WIDTH * CELL_SIZE;
-const GLint win_height = HEIGHT * CELL_SIZE;
+static GLint win_width, win_height;
 
 static aeEventLoop *loop;                                       // Put event loop in the global scope, so it
                                                                 // can be explicitly stopped 
 
+static unsigned char *board = NULL;                             // The view of the board built from the binary frames
+static uint32_t boardWidth = 0, boardHeight = 0;                // Dimensions of the whole board
+static uint32_t boardGen = 0;                                   // Generation of the board
+static int synced = FALSE;                                      // TRUE once a full frame was received
+
+/*
+ * Draw the view built from the binary frames.
+ */
+
+void DrawBoard()
+{
+    uint32_t x, y;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (x = 0; x < viewWidth; x++)
+    {
+        for (y = 0; y < viewHeight; y++)
+        {
+            if (glpGetCell(board, (uint64_t) y * viewWidth + x))
+            {
+                GLint wx = CELL_SIZE * x;
+                GLint wy = CELL_SIZE * y;
+                glRecti(wx, wy, wx + CELL_SIZE, wy + CELL_SIZE);
+            }
+        }
+    }
+    glutSwapBuffers();
+}
+
+/*
+ * Handle a binary message, see GlifeProto.h. A full frame may come as several tiles; it starts with the tile
+ * at (0,0) and is drawn after its last tile. A delta frame is only applied to the board of the previous
+ * generation, so a subscriber that joins late or misses a frame waits for the next full frame.
+ */
+
+void HandleFrame(const unsigned char *buf, size_t len, const glpHeader * header)
+{
+    if (header->width != boardWidth || header->height != boardHeight)
+    {
+        boardWidth = header->width;                             // The view stays the same size
+        boardHeight = header->height;
+        memset(board, 0, glpBitmapBytes(viewWidth, viewHeight));
+        synced = FALSE;
+        printf("Board %u x %u, showing %u x %u at %u %u\n", boardWidth, boardHeight, viewWidth, viewHeight,
+               viewX, viewY);
+    }
+    if (header->type == GLP_DELTA)
+    {
+        if (!synced || header->generation != boardGen + 1)
+            return;                                             // Wait for a full frame
+    }
+    else if (header->x == 0 && header->y == 0)                  // The first tile of a full frame
+    {
+        synced = TRUE;
+        boardGen = header->generation;
+    }
+    else if (!synced || header->generation != boardGen)         // The rest of a frame we joined too late for
+        return;
+    if (glpOverlaps(header, viewX, viewY, viewWidth, viewHeight) &&
+        glpApplyWindow(buf, len, header, viewX, viewY, viewWidth, viewHeight, board) != GLP_OK)
+    {
+        printf("Corrupt frame %u\n", header->generation);
+        synced = FALSE;
+        return;
+    }
+    boardGen = header->generation;
+    if (header->x + header->tileWidth == header->width && header->y + header->tileHeight == header->height)
+        DrawBoard();                                            // The frame is complete
+}
+
+/*
+ * Handle one record from the channel. Returns TRUE if the record is the end of file.
+ *
+ * Commands that are included in the data are as follows:
+ *
+ * data x y status => the data to be plotted, x and y values, and the life status.
+ * swap            => in the glife program the screen buffer is swapped so swap the buffers
+ * clear           => in the glife program the screen buffer is cleared so clear the buffer
+ * _EOF_           => This is the End Of File so the the program will terminate
+ * proto v enc     => the publisher sends binary frames of version v with the given encoding
+ * size w h        => the dimensions of the cellspace
+ */
+
+int HandleRecord(char *rec)
+{
+    int x, y;
+    char *startnum, *endnum;
+
+    if (strncmp("data", rec, 4) == 0)                           // If this is a data element extract the data
+    {
+        if (strstr(rec, "Alive"))                               // Plot the data if the cell is alive
+        {
+            startnum = index(rec, ' ') + 1;                     // Get the X and Y data
+            endnum = index(startnum, ' ');
+            *endnum = '\0';
+            x = atoi(startnum);
+            startnum = endnum + 1;
+            endnum = index(startnum, ' ');
+            *endnum = '\0';
+            y = atoi(startnum);
+            x -= viewX;                                         // Skip the cells outside of the view
+            y -= viewY;
+            if (x >= 0 && x < (int) viewWidth && y >= 0 && y < (int) viewHeight)
+            {
+                GLint wx = CELL_SIZE * x;                       // Convert to the display space and set the cell
+                GLint wy = CELL_SIZE * y;
+                glRecti(wx, wy, wx + CELL_SIZE, wy + CELL_SIZE);
+            }
+        }
+    }
+    else if (strncmp("swap", rec, 4) == 0)                      // The publish program send when to swap buffers
+    {
+        glutSwapBuffers();
+    }
+    else if (strncmp("clear", rec, 5) == 0)                     // The publish program send when to clear and start over
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    else if (strcmp("_EOF_", rec) == 0)                         // Check for end of file
+    {
+        return TRUE;                                            // If so exit the program
+    }
+    else if (strncmp("proto ", rec, 6) == 0)                    // The publisher announces a binary stream
+    {
+        if (atoi(rec + 6) > GLP_VERSION)
+            printf("Publisher uses protocol %s, this subscriber supports version %d\n", rec + 6, GLP_VERSION);
+        else
+            printf("Receiving binary frames, protocol %s\n", rec + 6);
+    }
+    else if (strncmp("size ", rec, 5) == 0)                     // The publisher announces the cellspace
+    {
+        printf("Board %s, showing %u x %u at %u %u\n", rec + 5, viewWidth, viewHeight, viewX, viewY);
+    }
+    return FALSE;
+}
+
 /*
  * This function will be called when data is received on the redis channel. See main routine
  * and the redisAsyncCommand function call.
@@ -49,8 +188,9 @@ void SubscribeCallback(redisAsyncContext * c, redisReply * r, void *privdata)
     redisReply *reply = r;                                      // Save the redisReply for use
     redisReply *rp;                                             // A pointer to loop throught the elements
     size_t j;                                                   // A loop varabil
-    int x, y;
-    char *startnum, *endnum;
+    char *rec, *next;
+    glpHeader header;
+    int status;
     int exitSubPub = FALSE;                                     // A switch so that the async loop can be stopped
 
     if (reply == NULL)                                          // Handel error
@@ -77,13 +217,8 @@ void SubscribeCallback(redisAsyncContext * c, redisReply * r, void *privdata)
  * "sscpactest"
  * "data 99 84 Alive"
  *
- * Commands that are included in the data are as follows:
- *
- * data x y status => the data to be plotted, x and y values, and the life status.
- * swap            => in the glife program the screen buffer is swapped so swap the buffers
- * clear           => in the glife program the screen buffer is cleared so clear the buffer
- * _EOF_           => This is the End Of File so the the program will terminate
- *
+ * A message may hold several records separated by '\n' when the publisher sends whole frames
+ * (PubGlife -m frame), for example "clear\ndata 99 84 Alive\nswap".
  */
     if (reply->element != NULL)                                 // Check to make sure that data was returned
     {
@@ -92,37 +227,23 @@ void SubscribeCallback(redisAsyncContext * c, redisReply * r, void *privdata)
             if (reply->element[j] != NULL)                      // Handle elements with data
             {
                 rp = reply->element[j];                         // Set a pointer to the element to access it data
-                if (rp->str != NULL)                            // If we have a stirng display it on the terminal
+                if (rp->str == NULL)
+                    continue;
+                status = glpDecodeHeader((unsigned char *) rp->str, rp->len, &header);
+                if (status == GLP_OK)                           // A binary frame
                 {
-                    if (strncmp("data", rp->str, 4) == 0)       // If this is a data element extract the data
-                    {
-                        if (strstr(rp->str, "Alive"))           // Plot the data if the cell is alive
-                        {
-                            startnum = index(rp->str, ' ') + 1; // Get the X and Y data
-                            endnum = index(startnum, ' ');
-                            *endnum = '\0';
-                            x = atoi(startnum);
-                            startnum = endnum + 1;
-                            endnum = index(startnum, ' ');
-                            *endnum = '\0';
-                            y = atoi(startnum);
-                            GLint wx = CELL_SIZE * x;           // Convert to the display space and set the cell
-                            GLint wy = CELL_SIZE * y;
-                            glRecti(wx, wy, wx + CELL_SIZE, wy + CELL_SIZE);
-                        }
-                    }
-                    else if (strncmp("swap", rp->str, 4) == 0)  // The publish program send when to swap buffers
-                    {
-                        glutSwapBuffers();
-                    }
-                    else if (strncmp("clear", rp->str, 5) == 0) // The publish program send when to clear and start over
-                    {
-                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                    }
-                    else if (strcmp("_EOF_", rp->str) == 0)     // Check for end of file
-                    {
-                        exitSubPub = TRUE;                      // If so exit the program
-                    }
+                    HandleFrame((unsigned char *) rp->str, rp->len, &header);
+                    continue;
+                }
+                if (status != GLP_NOT_BINARY)                   // A binary frame we can't read
+                    continue;
+                for (rec = rp->str; rec != NULL; rec = next)    // Handle each record in the element
+                {
+                    next = index(rec, '\n');                    // Split off the next record
+                    if (next != NULL)
+                        *next++ = '\0';
+                    if (HandleRecord(rec))
+                        exitSubPub = TRUE;
                 }
             }
         }
@@ -173,7 +294,7 @@ void disconnectCallback(const redisAsyncContext * c, int status)
 
 void Usage(char *command)
 {
-    printf("\nUsage: %s [-h host] [-p port]\n\n", command);
+    printf("\nUsage: %s [-h host] [-p port] [-x viewx] [-y viewy] [-c columns] [-r rows]\n\n", command);
 }
 
 int main(int argc, char **argv)
@@ -213,6 +334,18 @@ int main(int argc, char **argv)
             case 'p':                                          // Port option set get port number
                 hostport = atoi(argv[i + 1]);
                 break;
+            case 'x':                                          // Origin of the view
+                viewX = atoi(argv[i + 1]);
+                break;
+            case 'y':
+                viewY = atoi(argv[i + 1]);
+                break;
+            case 'c':                                          // Size of the view in cells
+                viewWidth = atoi(argv[i + 1]);
+                break;
+            case 'r':
+                viewHeight = atoi(argv[i + 1]);
+                break;
             default:                                           // Unknowen option print error message
                 printf("\nError Option %s not found\n\n", argv[i]);
                 Usage(argv[0]);
@@ -221,6 +354,15 @@ int main(int argc, char **argv)
         }
         printf("\nUsing host %s port %i\n\n", hostip, hostport);
     }
+    if (viewWidth < 1 || viewHeight < 1)
+    {
+        printf("\nError the view needs at least one column and row");
+        Usage(argv[0]);
+        return -1;
+    }
+    win_width = viewWidth * CELL_SIZE;
+    win_height = viewHeight * CELL_SIZE;
+    board = calloc(glpBitmapBytes(viewWidth, viewHeight), 1); // Only the view is kept, whatever the board size
 
     redisAsyncContext *c = redisAsyncConnect(hostip, hostport); // Get the redis context
     if (c == NULL || c->err)                                    // Handle connection errors
@@ -39,6 +39,8 @@
 #include "adevs_exception.h"
 #include "adevs_models.h"
 #include "adevs_simulator.h"
+#include "adevs_heap4_sched.h"
+#include "adevs_calendar_sched.h"
 #include "adevs_digraph.h"
 #include "adevs_simpledigraph.h"
 #include "adevs_cellspace.h"
@@ -47,8 +49,10 @@
 #include "adevs_corrected_euler.h"
 #include "adevs_event_locators.h"
 #include "adevs_rk_45.h"
+#include "adevs_batch_hybrid.h"
 #include "adevs_poly.h"
 #include "adevs_wrapper.h"
 #ifdef _OPENMP
 #include "adevs_par_simulator.h"
+#include "adevs_opt_simulator.h"
 #endif
@@ -59,6 +59,8 @@ template <class X, class T = double> class AbstractSimulator
 		{
 			listeners.erase(l);
 		}
+		/// Returns true if there is at least one event listener
+		bool hasEventListeners() const { return !listeners.empty(); }
 		/// Get the model's next event time
 		virtual T nextEventTime() = 0;
 		/// Execute the simulator until the next event time is greater than tend
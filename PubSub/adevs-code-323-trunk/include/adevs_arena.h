@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_arena_h_
+#define __adevs_arena_h_
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace adevs
+{
+
+/**
+ * A bump allocator for objects that live for one step of a simulator.
+ * Memory is taken from the end of a block, and reset() makes all of it
+ * free at once. The destructors of the objects are not called by the
+ * arena. When a step needs more than one block, reset() replaces the
+ * blocks with a single block that is large enough for all of them, so
+ * that later steps of the same size do not go to the heap.
+ */
+class StepArena
+{
+	public:
+		/// Create an arena whose first block has the given size.
+		StepArena(size_t block_size = 4096):
+			block_size(block_size),used(0),total(0),blocks(0){}
+		/// Get size bytes with the given alignment, which must be a power of two.
+		void* allocate(size_t size, size_t align)
+		{
+			if (block.empty() || pad(align)+size > sizes.back()-used)
+			{
+				// Start a new block that can hold the request
+				size_t n = block_size;
+				while (n < size+align) n *= 2;
+				add_block(n);
+			}
+			char* p = block.back()+used+pad(align);
+			used = (p-block.back())+size;
+			return p;
+		}
+		/// Free everything that was allocated since the last reset().
+		void reset()
+		{
+			if (block.size() > 1)
+			{
+				size_t n = total;
+				release();
+				add_block(n);
+			}
+			used = 0;
+		}
+		/// Get the number of blocks taken from the heap.
+		unsigned long getBlockCount() const { return blocks; }
+		~StepArena() { release(); }
+	private:
+		StepArena(const StepArena&);
+		StepArena& operator=(const StepArena&);
+		size_t block_size, used, total;
+		unsigned long blocks;
+		std::vector<char*> block;
+		std::vector<size_t> sizes;
+		// Bytes to skip in the current block for the alignment
+		size_t pad(size_t align) const
+		{
+			return (align-(reinterpret_cast<uintptr_t>(block.back()+used)&(align-1)))&(align-1);
+		}
+		void add_block(size_t n)
+		{
+			used = 0;
+			char* b = static_cast<char*>(malloc(n));
+			if (b == NULL) throw std::bad_alloc();
+			block.push_back(b);
+			sizes.push_back(n);
+			total += n;
+			blocks++;
+			if (n > block_size) block_size = n;
+		}
+		void release()
+		{
+			for (unsigned i = 0; i < block.size(); i++)
+				free(block[i]);
+			block.clear();
+			sizes.clear();
+			total = 0;
+		}
+};
+
+} // end of namespace
+
+#endif
@@ -30,7 +30,12 @@
  */
 #ifndef _adevs_bag_h
 #define _adevs_bag_h
+#include "adevs_arena.h"
+#include <atomic>
 #include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace adevs
 {
@@ -41,8 +46,12 @@ namespace adevs
  * does not satisfy the STL complexity requirements. Neither does it implement
  * the full set of required methods, but those methods that are implemented
  * conform to the standard (except for the time complexity requirement).
+ * The first N elements are kept inside of the Bag, so a small bag does
+ * not use the heap. Only the slots that hold elements are constructed.
+ * A bag can be given a StepArena to hold the elements that do not fit
+ * inside of it, and a counter for the arrays that it takes from the heap.
  */
-template <class T> class Bag
+template <class T, unsigned N = 4> class Bag
 {
 	public:
 		/// A bidirectional iterator for the Bag
@@ -68,48 +77,75 @@ template <class T> class Bag
 				iterator& operator++(int) { ++i; return *this; }
 				iterator& operator--(int) { --i; return *this; }
 			private:
-				friend class Bag<T>;	
+				friend class Bag<T,N>;	
 				unsigned int i;
 				T* b;
 		};
 		typedef iterator const_iterator;
-		/// Create an empty bag with an initial capacity
-		Bag(unsigned int cap = 8):
-		cap_(cap),size_(0),b(new T[cap]){}
-		/// Copy constructor uses the = operator of T
-		Bag(const Bag<T>& src):
-		cap_(src.cap_),
-		size_(src.size_)
-		{
-			b = new T[src.cap_];
-			for (unsigned int i = 0; i < size_; i++) 
-				b[i] = src.b[i];
-		}
-		/// Assignment operator uses the = operator of T
-		const Bag<T>& operator=(const Bag<T>& src)
-		{
-			cap_ = src.cap_;
+		/// Number of elements that are kept inside of the bag
+		static const unsigned inline_capacity = N;
+		/**
+		 * Create an empty bag with an initial capacity. If arena is not
+		 * NULL, then the elements that do not fit inside of the bag are
+		 * put into the arena, and the bag must be cleared or destroyed
+		 * before the arena is reset. The arena stays with the bag. It
+		 * is not given to copies of the bag or to bags that take its
+		 * elements by a move or swap.
+		 */
+		Bag(unsigned int cap = N, StepArena* arena = NULL):
+		cap_(N),size_(0),b(local()),arena(arena),heap_count(NULL)
+		{
+			if (cap > N) reserve(cap);
+		}
+		/// Copy constructor uses the copy constructor of T
+		Bag(const Bag<T,N>& src):
+		cap_(N),size_(0),b(local()),arena(NULL),heap_count(NULL)
+		{
+			reserve(src.size_);
+			for (unsigned int i = 0; i < src.size_; i++)
+				new(b+i) T(src.b[i]);
+			size_ = src.size_;
+		}
+		/// Move constructor takes the elements of src and leaves it empty
+		Bag(Bag<T,N>&& src) noexcept(std::is_nothrow_move_constructible<T>::value):
+		cap_(N),size_(0),b(local()),arena(NULL),heap_count(NULL)
+		{
+			take(src);
+		}
+		/// Assignment operator uses the copy constructor of T
+		const Bag<T,N>& operator=(const Bag<T,N>& src)
+		{
+			if (this == &src) return *this;
+			clear();
+			reserve(src.size_);
+			for (unsigned int i = 0; i < src.size_; i++)
+				new(b+i) T(src.b[i]);
 			size_ = src.size_;
-			delete [] b;
-			b = new T[src.cap_];
-			for (unsigned int i = 0; i < size_; i++) 
-				b[i] = src.b[i];
+			return *this;
+		}
+		/// Move assignment takes the elements of src and leaves it empty
+		Bag<T,N>& operator=(Bag<T,N>&& src) noexcept(std::is_nothrow_move_constructible<T>::value)
+		{
+			if (this == &src) return *this;
+			clear();
+			take(src);
 			return *this;
 		}
 		/// Swaps contents of this bag with the contents of the supplied bag. Returns this bag.
-		Bag<T>& swap(Bag<T>& src)
-		{
-			unsigned tmp_cap_, tmp_size_;
-			T* tmp_b;
-			tmp_cap_ = src.cap_;
-			tmp_size_ = src.size_;
-			tmp_b = src.b;
-			src.cap_ = cap_;
-			src.size_ = size_;
-			src.b = b;
-			cap_ = tmp_cap_;
-			size_ = tmp_size_;
-			b = tmp_b;
+		Bag<T,N>& swap(Bag<T,N>& src)
+		{
+			if (this == &src) return *this;
+			// Bags on the heap trade their arrays
+			if (b != local() && src.b != src.local() && arena == src.arena)
+			{
+				std::swap(b,src.b);
+				std::swap(cap_,src.cap_);
+				std::swap(size_,src.size_);
+				return *this;
+			}
+			Bag<T,N> tmp(std::move(src));
+			src = std::move(*this);
+			*this = std::move(tmp);
 			return *this;
 		}
 		/// Count the instances of a stored in the bag
@@ -124,6 +160,16 @@ template <class T> class Bag
 		unsigned size() const { return size_; }
 		/// Same as size()==0
 		bool empty() const { return size_ == 0; }
+		/// Get the number of elements that fit without allocating more memory
+		unsigned capacity() const { return cap_; }
+		/// Get the arena that holds the elements past the first N, or NULL
+		StepArena* getArena() const { return arena; }
+		/**
+		 * Add one to count each time that the bag takes an array from
+		 * the heap, or stop counting if count is NULL. As with the arena,
+		 * the counter stays with the bag.
+		 */
+		void setHeapCounter(std::atomic<unsigned long>* count) { heap_count = count; }
 		/// Get an iterator pointing to the first element in the bag
 		iterator begin() const { return iterator(0,b); }
 		/// Get an iterator to the end of the bag (i.e., just after the last element)
@@ -138,10 +184,16 @@ template <class T> class Bag
 		void erase(iterator p)
 		{
 			size_--;
-			b[p.i] = b[size_];
+			if (p.i != size_) b[p.i] = std::move(b[size_]);
+			b[size_].~T();
 		}
 		/// Remove all of the elements from the bag
-		void clear() { size_ = 0; }
+		void clear()
+		{
+			for (unsigned i = 0; i < size_; i++)
+				b[i].~T();
+			size_ = 0;
+		}
 		/// Find the first instance of k, or end() if no instance is found. Uses == for comparing T.
 		iterator find(const T& k) const
 		{
@@ -150,25 +202,89 @@ template <class T> class Bag
 			return end();
 		}
 		/// Put t into the bag
-		void insert(const T& t)
+		void insert(const T& t) { emplace(t); }
+		/// Move t into the bag
+		void insert(T&& t) { emplace(std::move(t)); }
+		/**
+		 * Construct an element in the bag from the arguments and
+		 * return an iterator that points to it.
+		 */
+		template <class... Args> iterator emplace(Args&&... args)
+		{
+			if (cap_ == size_)
+			{
+				// Build the new element first because the arguments
+				// may refer to elements of this bag
+				T* rb = allocate(2*cap_);
+				new(rb+size_) T(std::forward<Args>(args)...);
+				move_to(rb,2*cap_);
+			}
+			else new(b+size_) T(std::forward<Args>(args)...);
+			return iterator(size_++,b);
+		}
+		/// Make room for at least cap elements
+		void reserve(unsigned cap)
 		{
-			if (cap_ == size_) enlarge(2*cap_);
-			b[size_] = t;
-			size_++;
+			if (cap > cap_) move_to(allocate(cap),cap);
+		}
+		~Bag()
+		{
+			clear();
+			if (b != local()) deallocate(b);
 		}
-		~Bag() { delete [] b; }
 	private:	
 		unsigned cap_, size_;
 		T* b;
-		/// Adds the specified capacity to the bag.
-		void enlarge(unsigned adjustment)
-		{
-			cap_ = cap_ + adjustment;
-			T* rb = new T[cap_];
-			for (unsigned i = 0; i < size_; i++) 
-				rb[i] = b[i];
-			delete [] b;
+		// Holds the elements past the first N, or NULL for the heap
+		StepArena* arena;
+		// Counts the arrays taken from the heap, or NULL
+		std::atomic<unsigned long>* heap_count;
+		// Storage for the first N elements
+		alignas(T) unsigned char inline_store[N*sizeof(T)];
+		T* local() { return reinterpret_cast<T*>(inline_store); }
+		T* allocate(unsigned cap)
+		{
+			if (arena != NULL)
+				return static_cast<T*>(arena->allocate(cap*sizeof(T),alignof(T)));
+			if (heap_count != NULL)
+				heap_count->fetch_add(1,std::memory_order_relaxed);
+			return static_cast<T*>(::operator new(cap*sizeof(T)));
+		}
+		void deallocate(T* rb)
+		{
+			if (arena == NULL) ::operator delete(rb);
+		}
+		// Move the elements into the array rb with capacity cap
+		void move_to(T* rb, unsigned cap)
+		{
+			for (unsigned i = 0; i < size_; i++)
+			{
+				new(rb+i) T(std::move(b[i]));
+				b[i].~T();
+			}
+			if (b != local()) deallocate(b);
 			b = rb;
+			cap_ = cap;
+		}
+		// Take the elements of src into this empty bag and leave src empty
+		void take(Bag<T,N>& src)
+		{
+			if (src.b != src.local() && src.arena == arena)
+			{
+				if (b != local()) deallocate(b);
+				b = src.b;
+				cap_ = src.cap_;
+				size_ = src.size_;
+				src.b = src.local();
+				src.cap_ = N;
+				src.size_ = 0;
+				return;
+			}
+			reserve(src.size_);
+			for (unsigned i = 0; i < src.size_; i++)
+				new(b+i) T(std::move(src.b[i]));
+			size_ = src.size_;
+			src.clear();
 		}
 	};
 
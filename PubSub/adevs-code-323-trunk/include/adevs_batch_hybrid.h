@@ -0,0 +1,762 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies, 
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef _adevs_batch_hybrid_h_
+#define _adevs_batch_hybrid_h_
+#include "adevs_hybrid.h"
+#include "adevs_event_locators.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <typeinfo>
+#include <vector>
+
+namespace adevs
+{
+
+/**
+ * An ode_system that can compute the derivatives of many of its instances
+ * in one call. A hybrid_batch whose members are all of one such type uses
+ * batch_der_func() in place of calling der_func() for each member.
+ */
+template <typename X> class batch_ode_system:
+	public ode_system<X>
+{
+	public:
+		/// Make a system with N state variables and M state event functions
+		batch_ode_system(int N_vars, int M_event_funcs):
+			ode_system<X>(N_vars,M_event_funcs){}
+		/**
+		 * Compute the derivatives of n instances of this system. The state
+		 * variable j of the instance sys[i] is q[j*n+i] and its derivative
+		 * must be put in dq[j*n+i]. This is called on sys[0], and all of
+		 * the instances have the same type as it.
+		 */
+		virtual void batch_der_func(const double* q, double* dq, int n,
+				batch_ode_system<X>* const* sys) = 0;
+		/// Destructor
+		virtual ~batch_ode_system(){}
+};
+
+template <typename X, class T> class BatchHybrid;
+
+/**
+ * <p>A hybrid_batch integrates many instances of an ode_system together.
+ * Each instance is simulated by a BatchHybrid model, and the models that
+ * need a new tentative step at the same instant are given it by one
+ * batched step of the rk_45 method. The states of the instances are
+ * packed into arrays where a state variable of every instance is
+ * contiguous, and so the loops of the method run over the instances.</p>
+ * <p>Each instance keeps its own step size and finds its own state events
+ * as the rk_45 solver and an event_locator_impl in the given mode would,
+ * so a BatchHybrid produces the trajectory of a Hybrid with those
+ * objects. All of the instances must have the same number of state
+ * variables and state events.</p>
+ * <p>The batch is adopted by its members and is deleted with the last of
+ * them. The members of a batch may be simulated by several threads, as
+ * they are by a Simulator with setParallel(), a ParSimulator, or an
+ * OptSimulator. The batch is locked while a member uses it, and the
+ * tentative steps that are waiting are taken by the first member that
+ * needs one of them.</p>
+ */
+template <typename X> class hybrid_batch
+{
+	public:
+		/**
+		 * The per step error tolerance and maximum step size are used as
+		 * by rk_45, and the event tolerance and mode as by
+		 * event_locator_impl.
+		 */
+		hybrid_batch(double err_tol, double h_max, double event_tol,
+			typename event_locator_impl<X>::Mode mode =
+				event_locator_impl<X>::INTERPOLATE):
+			err_tol(err_tol),h_max(h_max),event_tol(event_tol),mode(mode),
+			N(0),M(0),members(0),batch_der(false),type(NULL){}
+		/// Get the number of models that use this batch
+		int numMembers() const { return members; }
+		/// Returns true if the derivatives are computed by batch_der_func()
+		bool usesBatchDerivative() const { return batch_der; }
+	private:
+		template <typename A, class B> friend class BatchHybrid;
+		// The state of one instance as seen by the batch
+		struct lane
+		{
+			ode_system<X>* sys;
+			batch_ode_system<X>* bsys;
+			double *q, *q_trial; // Current and tentative states
+			bool* event; // Event flags, with the time event last
+			hermite_step<X>* dense; // Interpolant for the last step
+			double h_cur; // Previous successful step size
+			double sigma; // Time to the next internal event
+			bool event_exists; // True if there is at least one event
+			bool pending; // True if the tentative step is not done
+		};
+		// Most lanes in one trial step
+		enum { block_size = 64 };
+		const double err_tol, h_max, event_tol;
+		const typename event_locator_impl<X>::Mode mode;
+		int N, M, members;
+		bool batch_der;
+		const std::type_info* type;
+		// Lanes that are waiting for a tentative step
+		std::vector<lane*> pending;
+		// Work space for the steps, with the lanes innermost
+		std::vector<double> qq, t, dq, k[6], h, err, x, y;
+		std::vector<batch_ode_system<X>*> bsys;
+		// Work space for flush(), integrate(), advance() and find_events()
+		std::vector<lane*> fl_lanes, in_lanes, adv_lanes, adv_next, ev_lanes, ev_next;
+		std::vector<double*> fl_q, fl_qt, adv_q, adv_qa, ev_qs, ev_qe, ev_qs_next, ev_qe_next;
+		std::vector<double> fl_te, fl_step, in_h, adv_rem, adv_rema, adv_dt, ev_h, ev_h_next, z0, z1;
+		std::vector<bool> fl_found, ev_found;
+		std::vector<int> in_act, in_next, ev_idx, ev_idx_next, ev_how, ev_how_next;
+		// How find_events() treats a lane: search the interpolant if the
+		// step has one, check the events found on the interpolant, or
+		// search without the interpolant
+		enum { EV_DENSE, EV_CHECK, EV_PLAIN };
+		// Held by the members while they use the batch
+		std::mutex mtx;
+
+		// Add a member and check that it matches the others
+		void join(lane* l);
+		// Remove a member and return true if it was the last one
+		bool leave(lane* l);
+		// Ask for a tentative step of the lane
+		void request(lane* l)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!l->pending)
+			{
+				l->pending = true;
+				pending.push_back(l);
+			}
+		}
+		// Make sure that the tentative step of the lane is done
+		void step(lane* l)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (l->pending) flush();
+		}
+		// The advance() and find_events() of a member
+		void member_advance(const std::vector<lane*>& lanes, double* const* q,
+			const double* dt)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			advance(lanes,q,dt);
+		}
+		void member_find_events(const std::vector<lane*>& lanes,
+			double* const* qstart, double* const* qend, double* step,
+			std::vector<bool>& found)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			find_events(lanes,qstart,qend,step,found);
+		}
+		// Do the tentative steps of all the lanes that asked for one
+		void flush();
+		// The rk_45 integrate() for each lane, with its step put in step
+		void integrate(const std::vector<lane*>& lanes, double* const* q,
+			const double* h_lim, double* step);
+		// The rk_45 advance() for each lane
+		void advance(const std::vector<lane*>& lanes, double* const* q,
+			const double* dt);
+		// The event_locator_impl find_events() for each lane
+		void find_events(const std::vector<lane*>& lanes, double* const* qstart,
+			double* const* qend, double* step, std::vector<bool>& found);
+		// A trial step of the m lanes in qq, leaving the errors in err
+		void trial_step(const std::vector<lane*>& lanes, int m);
+		// Compute the derivatives of the m lanes in in and put them in out
+		void der_func(const std::vector<lane*>& lanes, int m,
+			const double* in, double* out);
+		// Scale the derivatives of the m lanes by their step sizes
+		void stage(double* k, const double* dq, const double* h, int m)
+		{
+			for (int v = 0; v < N; v++)
+				for (int i = 0; i < m; i++)
+					k[v*m+i] = h[i]*dq[v*m+i];
+		}
+		static int sign(double x)
+		{
+			if (x < 0.0) return -1;
+			else if (x > 0.0) return 1;
+			else return 0;
+		}
+};
+
+template <typename X>
+void hybrid_batch<X>::join(lane* l)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (members == 0)
+	{
+		N = l->sys->numVars();
+		M = l->sys->numEvents();
+		batch_der = (l->bsys != NULL);
+		type = &typeid(*(l->sys));
+	}
+	else if (N != l->sys->numVars() || M != l->sys->numEvents())
+	{
+		exception err("The systems in a hybrid_batch must have the same size");
+		throw err;
+	}
+	else if (*type != typeid(*(l->sys)))
+		batch_der = false;
+	members++;
+}
+
+template <typename X>
+bool hybrid_batch<X>::leave(lane* l)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (l->pending)
+		pending.erase(std::find(pending.begin(),pending.end(),l));
+	return --members == 0;
+}
+
+template <typename X>
+void hybrid_batch<X>::flush()
+{
+	// Requests made while the steps are taken wait for the next flush
+	fl_lanes.swap(pending);
+	pending.clear();
+	unsigned n = fl_lanes.size();
+	fl_q.resize(n); fl_qt.resize(n); fl_te.resize(n); fl_step.resize(n);
+	for (unsigned i = 0; i < n; i++)
+	{
+		fl_lanes[i]->pending = false;
+		fl_q[i] = fl_lanes[i]->q;
+		fl_qt[i] = fl_lanes[i]->q_trial;
+		// Check for a time event
+		fl_te[i] = fl_lanes[i]->sys->time_event_func(fl_q[i]);
+	}
+	// Integrate up to that time at most
+	integrate(fl_lanes,&fl_qt[0],&fl_te[0],&fl_step[0]);
+	// Look for state events inside of the interval [0,step_size]
+	fl_found.assign(n,false);
+	if (M > 0) find_events(fl_lanes,&fl_q[0],&fl_qt[0],&fl_step[0],fl_found);
+	// Find the time advance and set the time event flag
+	for (unsigned i = 0; i < n; i++)
+	{
+		lane* l = fl_lanes[i];
+		l->sigma = std::min(fl_step[i],fl_te[i]);
+		l->event[M] = fl_te[i] <= l->sigma;
+		l->event_exists = l->event[M] || fl_found[i];
+	}
+	fl_lanes.clear();
+}
+
+template <typename X>
+void hybrid_batch<X>::integrate(const std::vector<lane*>& lanes,
+	double* const* q, const double* h_lim, double* step)
+{
+	unsigned n = lanes.size();
+	// Initial step sizes
+	in_h.resize(n);
+	in_act.clear();
+	for (unsigned i = 0; i < n; i++)
+	{
+		in_h[i] = std::min(lanes[i]->h_cur*1.1,std::min(h_max,h_lim[i]));
+		in_act.push_back(i);
+	}
+	// Repeat the trial step for the lanes whose error is too large
+	while (!in_act.empty())
+	{
+		in_next.clear();
+		// Steps are taken in blocks that fit in the cache
+		for (unsigned first = 0; first < in_act.size(); first += block_size)
+		{
+			const int* act = &in_act[first];
+			int m = std::min<unsigned>(block_size,in_act.size()-first);
+			qq.resize(N*m);
+			h.resize(m);
+			in_lanes.resize(m);
+			for (int i = 0; i < m; i++)
+			{
+				in_lanes[i] = lanes[act[i]];
+				h[i] = in_h[act[i]];
+			}
+			// Copy q to the trial vector
+			for (int j = 0; j < N; j++)
+				for (int i = 0; i < m; i++)
+					qq[j*m+i] = q[act[i]][j];
+			trial_step(in_lanes,m);
+			for (int i = 0; i < m; i++)
+			{
+				int l = act[i];
+				// If the error is ok, then we have found the proper step size
+				if (err[i] <= err_tol)
+				{
+					if (lanes[l]->h_cur <= h_lim[l]) lanes[l]->h_cur = h[i];
+					// Remember the step for the dense output
+					x.resize(N); y.resize(N);
+					for (int j = 0; j < N; j++)
+					{
+						x[j] = k[0][j*m+i];
+						y[j] = qq[j*m+i];
+					}
+					lanes[l]->dense->set(q[l],&x[0],&y[0],h[i]);
+					for (int j = 0; j < N; j++) q[l][j] = y[j];
+					step[l] = h[i];
+				}
+				// Otherwise shrink the step size and try again
+				else
+				{
+					double h_guess = 0.8*pow(err_tol*pow(h[i],4.0)/fabs(err[i]),0.25);
+					if (h[i] < h_guess) in_h[l] = h[i]*0.8;
+					else in_h[l] = h_guess;
+					in_next.push_back(l);
+				}
+			}
+		}
+		in_act.swap(in_next);
+	}
+}
+
+template <typename X>
+void hybrid_batch<X>::advance(const std::vector<lane*>& lanes,
+	double* const* q, const double* dt)
+{
+	adv_lanes.assign(lanes.begin(),lanes.end());
+	adv_qa.assign(q,q+lanes.size());
+	adv_rema.assign(dt,dt+lanes.size());
+	// Integrate until each lane has gone through its interval
+	while (!adv_lanes.empty())
+	{
+		unsigned n = adv_lanes.size();
+		adv_dt.resize(n);
+		integrate(adv_lanes,&adv_qa[0],&adv_rema[0],&adv_dt[0]);
+		adv_next.clear(); adv_q.clear(); adv_rem.clear();
+		for (unsigned i = 0; i < n; i++)
+		{
+			if (adv_dt[i] < adv_rema[i])
+			{
+				adv_next.push_back(adv_lanes[i]);
+				adv_q.push_back(adv_qa[i]);
+				adv_rem.push_back(adv_rema[i]-adv_dt[i]);
+			}
+		}
+		adv_lanes.swap(adv_next);
+		adv_qa.swap(adv_q);
+		adv_rema.swap(adv_rem);
+	}
+}
+
+template <typename X>
+void hybrid_batch<X>::find_events(const std::vector<lane*>& lanes,
+	double* const* qstart, double* const* qend, double* step,
+	std::vector<bool>& found)
+{
+	unsigned n = lanes.size();
+	// Calculate the state event functions at the start of the interval
+	z0.resize(n*M);
+	z1.resize(2*M);
+	x.resize(N);
+	for (unsigned i = 0; i < n; i++)
+		lanes[i]->sys->state_event_func(qstart[i],&z0[i*M]);
+	ev_lanes.assign(lanes.begin(),lanes.end());
+	ev_qs.assign(qstart,qstart+n);
+	ev_qe.assign(qend,qend+n);
+	ev_h.assign(step,step+n);
+	ev_idx.resize(n);
+	for (unsigned i = 0; i < n; i++) ev_idx[i] = i;
+	ev_how.assign(n,EV_DENSE);
+	// Look for the first event inside of each interval
+	while (!ev_lanes.empty())
+	{
+		ev_lanes.swap(ev_next);
+		ev_qs.swap(ev_qs_next);
+		ev_qe.swap(ev_qe_next);
+		ev_h.swap(ev_h_next);
+		ev_idx.swap(ev_idx_next);
+		ev_how.swap(ev_how_next);
+		ev_lanes.clear(); ev_qs.clear(); ev_qe.clear();
+		ev_h.clear(); ev_idx.clear(); ev_how.clear();
+		for (unsigned i = 0; i < ev_next.size(); i++)
+		{
+			lane* l = ev_next[i];
+			int k = ev_idx_next[i], how = ev_how_next[i];
+			double h = ev_h_next[i];
+			const double* zs = &z0[k*M];
+			// If the step can be interpolated, then search the interpolant
+			if (how == EV_DENSE && l->dense->matches(ev_qs_next[i],h))
+			{
+				double tend = h;
+				found[k] = event_locator_impl<X>::find_dense_events(l->sys,
+					l->dense,event_tol,mode,l->event,zs,ev_qe_next[i],h,&z1[0],&x[0]);
+				step[k] = h;
+				if (!found[k]) continue;
+				// Integrate to the event for the state at that time and
+				// check its events in the next round
+				how = EV_CHECK;
+				if (h < tend)
+				{
+					for (int j = 0; j < N; j++)
+						ev_qe_next[i][j] = ev_qs_next[i][j];
+					ev_lanes.push_back(l);
+					ev_qs.push_back(ev_qs_next[i]);
+					ev_qe.push_back(ev_qe_next[i]);
+					ev_h.push_back(h);
+					ev_idx.push_back(k);
+					ev_how.push_back(how);
+					continue;
+				}
+			}
+			l->sys->state_event_func(ev_qe_next[i],&z1[0]);
+			// Done if the events are those of the solver's state, and
+			// otherwise search on from that state
+			if (how == EV_CHECK)
+			{
+				if (event_locator_impl<X>::check_events(M,event_tol,mode,
+					l->event,zs,&z1[0]))
+				{
+					step[k] = h;
+					found[k] = true;
+					continue;
+				}
+				how = EV_PLAIN;
+			}
+			double tguess = h;
+			bool event_in_interval = false, found_event = false;
+			// Do any of the z functions change sign? Have we found an event?
+			for (int e = 0; e < M; e++)
+			{
+				l->event[e] = false;
+				if (sign(z1[e]) != sign(zs[e]))
+				{
+					// Event at h > 0
+					if (((mode != event_locator_impl<X>::DISCONTINUOUS) &&
+						(fabs(z1[e]) <= event_tol)) ||
+						((mode == event_locator_impl<X>::DISCONTINUOUS) &&
+						(h <= event_tol)))
+					{
+						l->event[e] = found_event = true;
+					}
+					// There is an event in (0,h)
+					else
+					{
+						if (mode == event_locator_impl<X>::INTERPOLATE)
+						{
+							double tcandidate = zs[e]*h/(zs[e]-z1[e]);
+							// Don't let the step size go to zero
+							if (tcandidate < h/4.0) tcandidate = h/4.0;
+							if (tcandidate < tguess) tguess = tcandidate;
+						}
+						event_in_interval = true;
+					}
+				}
+			}
+			// Guess at a new h and calculate qend for that time
+			if (event_in_interval)
+			{
+				if (mode == event_locator_impl<X>::INTERPOLATE) h = tguess;
+				else h /= 2.0;
+				for (int j = 0; j < N; j++)
+					ev_qe_next[i][j] = ev_qs_next[i][j];
+				ev_lanes.push_back(l);
+				ev_qs.push_back(ev_qs_next[i]);
+				ev_qe.push_back(ev_qe_next[i]);
+				ev_h.push_back(h);
+				ev_idx.push_back(k);
+				ev_how.push_back(how);
+			}
+			else
+			{
+				step[k] = h;
+				found[k] = found_event;
+			}
+		}
+		if (!ev_lanes.empty())
+			advance(ev_lanes,&ev_qe[0],&ev_h[0]);
+	}
+}
+
+template <typename X>
+void hybrid_batch<X>::der_func(const std::vector<lane*>& lanes, int m,
+	const double* in, double* out)
+{
+	if (batch_der)
+	{
+		bsys.resize(m);
+		for (int i = 0; i < m; i++) bsys[i] = lanes[i]->bsys;
+		bsys[0]->batch_der_func(in,out,m,&bsys[0]);
+		return;
+	}
+	// Otherwise gather the state of each lane for its der_func
+	x.resize(N); y.resize(N);
+	for (int i = 0; i < m; i++)
+	{
+		for (int j = 0; j < N; j++) x[j] = in[j*m+i];
+		lanes[i]->sys->der_func(&x[0],&y[0]);
+		for (int j = 0; j < N; j++) out[j*m+i] = y[j];
+	}
+}
+
+template <typename X>
+void hybrid_batch<X>::trial_step(const std::vector<lane*>& lanes, int m)
+{
+	int n = N*m;
+	t.resize(n); dq.resize(n); err.resize(m);
+	for (int s = 0; s < 6; s++) k[s].resize(n);
+	double *qq = &(this->qq[0]), *t = &(this->t[0]), *dq = &(this->dq[0]),
+		*k0 = &k[0][0], *k1 = &k[1][0], *k2 = &k[2][0], *k3 = &k[3][0],
+		*k4 = &k[4][0], *k5 = &k[5][0];
+	const double* h = &(this->h[0]);
+	// Compute k1
+	der_func(lanes,m,qq,dq);
+	stage(k0,dq,h,m);
+	// Compute k2
+	for (int j = 0; j < n; j++) t[j] = qq[j] + 0.5*k0[j];
+	der_func(lanes,m,t,dq);
+	stage(k1,dq,h,m);
+	// Compute k3
+	for (int j = 0; j < n; j++) t[j] = qq[j] + 0.25*(k0[j]+k1[j]);
+	der_func(lanes,m,t,dq);
+	stage(k2,dq,h,m);
+	// Compute k4
+	for (int j = 0; j < n; j++) t[j] = qq[j] - k1[j] + 2.0*k2[j];
+	der_func(lanes,m,t,dq);
+	stage(k3,dq,h,m);
+	// Compute k5
+	for (int j = 0; j < n; j++)
+		t[j] = qq[j] + (7.0/27.0)*k0[j] + (10.0/27.0)*k1[j] + (1.0/27.0)*k3[j];
+	der_func(lanes,m,t,dq);
+	stage(k4,dq,h,m);
+	// Compute k6
+	for (int j = 0; j < n; j++)
+		t[j] = qq[j] + (28.0/625.0)*k0[j] - 0.2*k1[j] + (546.0/625.0)*k2[j]
+			+ (54.0/625.0)*k3[j] - (378.0/625.0)*k4[j];
+	der_func(lanes,m,t,dq);
+	stage(k5,dq,h,m);
+	// Compute next state and the approximate error of each lane
+	for (int i = 0; i < m; i++) err[i] = 0.0;
+	for (int v = 0; v < N; v++)
+	{
+		for (int i = 0; i < m; i++)
+		{
+			int j = v*m+i;
+			// Next state
+			qq[j] += (1.0/24.0)*k0[j] + (5.0/48.0)*k3[j] +
+				(27.0/56.0)*k4[j] + (125.0/336.0)*k5[j];
+			// Componennt wise maximum of the approximate error
+			err[i] = std::max(err[i],
+				fabs(k0[j]/8.0+2.0*k2[j]/3.0+k3[j]/16.0-27.0*k4[j]/56.0
+					-125.0*k5[j]/336.0));
+		}
+	}
+}
+
+/**
+ * This Atomic model simulates an ode_system as the Hybrid model does,
+ * and can be used in its place, but its tentative steps are taken by a
+ * hybrid_batch that it shares with other instances of the system. A
+ * tentative step is put off until the time advance of the model is
+ * needed, so that the steps of all the models that change state at one
+ * instant are taken together.
+ */
+template <typename X, class T = double> class BatchHybrid:
+	public Atomic<X,T>
+{
+	public:
+		/**
+		 * Create and initialize a simulator for the system. The system
+		 * is adopted by the model, and the batch is deleted with the last
+		 * model that uses it.
+		 */
+		BatchHybrid(ode_system<X>* sys, hybrid_batch<X>* batch):
+			Atomic<X,T>(),
+			sys(sys),batch(batch),event_happened(false),e_accum(0.0),
+			self(1,&l),found(1,false)
+		{
+			l.sys = sys;
+			l.bsys = dynamic_cast<batch_ode_system<X>*>(sys);
+			l.q = new double[sys->numVars()];
+			l.q_trial = new double[sys->numVars()];
+			l.event = new bool[sys->numEvents()+1];
+			l.dense = new hermite_step<X>(sys);
+			l.h_cur = batch->h_max;
+			l.sigma = 0.0;
+			l.event_exists = false;
+			l.pending = false;
+			batch->join(&l);
+			sys->init(l.q_trial); // Get the initial state of the model
+			for (int i = 0; i < sys->numVars(); i++) l.q[i] = l.q_trial[i];
+			batch->request(&l); // Ask for the first tentative step
+		}
+		/// Get the value of the kth continuous state variable
+		double getState(int k) const { return l.q[k]; }
+		/// Get the array of state variables
+		const double* getState() const { return l.q; }
+		/// Get the system that this solver is operating on
+		ode_system<X>* getSystem() { return sys; }
+		/// Get the batch that takes the steps of this model
+		hybrid_batch<X>* getBatch() { return batch; }
+		/// Did a discrete event occur at the last state transition?
+		bool eventHappened() const { return event_happened; }
+		/// Do not override. See Hybrid::delta_int().
+		void delta_int()
+		{
+			if (!missedOutput.empty())
+			{
+				missedOutput.clear();
+				return;
+			}
+			e_accum += ta();
+			// Execute any discrete events
+			event_happened = l.event_exists;
+			if (l.event_exists) // Execute the internal event
+			{
+				sys->internal_event(l.q_trial,l.event);
+				e_accum = 0.0;
+			}
+			// Copy the new state vector to q
+			for (int i = 0; i < sys->numVars(); i++) l.q[i] = l.q_trial[i];
+			batch->request(&l); // Take a tentative step
+		}
+		/// Do not override. See Hybrid::delta_ext().
+		void delta_ext(T e, const Bag<X>& xb)
+		{
+			batch->step(&l);
+			bool state_event_exists = false;
+			event_happened = true;
+			// Check that we have not missed a state event
+			if (l.event_exists)
+			{
+				for (int i = 0; i < sys->numVars(); i++)
+					l.q_trial[i] = l.q[i];
+				state_event_exists = missed_event(e);
+				// We missed an event
+				if (state_event_exists)
+				{
+					output_func(missedOutput);
+					sys->confluent_event(l.q_trial,l.event,xb);
+					for (int i = 0; i < sys->numVars(); i++)
+						l.q[i] = l.q_trial[i];
+				}
+			}
+			if (!state_event_exists)// We didn't miss an event
+			{
+				advance(l.q,e); // Advance the state q by e
+				// Let the model adjust algebraic variables, etc. for the new state
+				sys->postStep(l.q);
+				// Process the discrete input
+				sys->external_event(l.q,e+e_accum,xb);
+			}
+			e_accum = 0.0;
+			// Copy the new state to the trial solution
+			for (int i = 0; i < sys->numVars(); i++) l.q_trial[i] = l.q[i];
+			batch->request(&l); // Take a tentative step
+		}
+		/// Do not override. See Hybrid::delta_conf().
+		void delta_conf(const Bag<X>& xb)
+		{
+			batch->step(&l);
+			if (!missedOutput.empty())
+			{
+				missedOutput.clear();
+				if (l.sigma > 0.0) l.event_exists = false;
+			}
+			// Execute any discrete events
+			event_happened = true;
+			if (l.event_exists)
+				sys->confluent_event(l.q_trial,l.event,xb);
+			else sys->external_event(l.q_trial,e_accum+ta(),xb);
+			e_accum = 0.0;
+			// Copy the new state vector to q
+			for (int i = 0; i < sys->numVars(); i++) l.q[i] = l.q_trial[i];
+			batch->request(&l); // Take a tentative step
+		}
+		/**
+		 * Do not override. The tentative steps that the batch has put off
+		 * are taken here.
+		 */
+		T ta()
+		{
+			batch->step(&l);
+			if (missedOutput.empty()) return l.sigma;
+			else return 0.0;
+		}
+		/// Do not override. Invokes the ode_system output function as needed.
+		void output_func(Bag<X>& yb)
+		{
+			batch->step(&l);
+			if (!missedOutput.empty())
+			{
+				typename Bag<X>::iterator iter = missedOutput.begin();
+				for (; iter != missedOutput.end(); iter++)
+					yb.insert(*iter);
+				if (l.sigma == 0.0) // Confluent event
+					sys->output_func(l.q_trial,l.event,yb);
+			}
+			else
+			{
+				// Let the model adjust algebraic variables, etc. for the new state
+				sys->postStep(l.q_trial);
+				if (l.event_exists)
+					sys->output_func(l.q_trial,l.event,yb);
+			}
+		}
+		/// Do not override. Invokes the ode_system gc_output method as needed.
+		void gc_output(Bag<X>& gb) { sys->gc_output(gb); }
+		/// Destructor deletes the system, and the batch if it is the last user.
+		virtual ~BatchHybrid()
+		{
+			if (batch->leave(&l)) delete batch;
+			delete [] l.q; delete [] l.q_trial; delete [] l.event;
+			delete l.dense;
+			delete sys;
+		}
+	private:
+		ode_system<X>* sys; // The ODE system
+		hybrid_batch<X>* batch; // Integrator for the ode set
+		typename hybrid_batch<X>::lane l; // State of the system
+		bool event_happened; // True if a discrete event in the ode_system took place
+		double e_accum; // Accumlated time between discrete events
+		Bag<X> missedOutput; // Output missed at an external event
+		// This model as a batch of one, and its event flag
+		std::vector<typename hybrid_batch<X>::lane*> self;
+		std::vector<bool> found;
+		// Advance q by exactly h units of time
+		void advance(double* q, double h)
+		{
+			batch->member_advance(self,&q,&h);
+		}
+		// Look for a state event in [0,e] that was missed
+		bool missed_event(T& e)
+		{
+			double h = e;
+			batch->member_advance(self,&l.q_trial,&h);
+			found[0] = false;
+			batch->member_find_events(self,&l.q,&l.q_trial,&h,found);
+			e = h;
+			return found[0];
+		}
+};
+
+} // end of namespace
+
+#endif
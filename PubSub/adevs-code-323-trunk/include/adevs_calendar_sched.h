@@ -0,0 +1,322 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies, 
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_calendar_schedule_h_
+#define __adevs_calendar_schedule_h_
+#include "adevs_sched.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace adevs
+{
+
+/**
+ * A calendar queue for scheduling Atomic models. It has the same interface
+ * as the binary heap in Schedule and can be given to the Simulator in its
+ * place, as in Simulator<X,T,CalendarSchedule<X,T> >. Time is divided into
+ * days of equal width, and the models are kept in one bucket per day
+ * modulo the number of buckets. Adding, moving, and removing a model takes
+ * constant time, and so does finding the next event when the width of the
+ * day suits the spacing of the event times. The bucket count follows the
+ * size of the queue and the width is estimated again from the event times
+ * whenever the buckets are resized, or when the next event is found to be
+ * more than a year (one pass over the buckets) away.
+ *
+ * The time type must convert to double. Like the Schedule, the calendar
+ * queue keeps a handle for the model in the model's q_index attribute.
+ */
+template <class X, class T = double> class CalendarSchedule
+{
+	public:
+		/// The visitor interface is shared with the Schedule
+		typedef typename Schedule<X,T>::ImminentVisitor ImminentVisitor;
+		/// Creates a scheduler with the default or specified initial capacity.
+		CalendarSchedule(unsigned int capacity = 100);
+		/// Get the model at the front of the queue.
+		Atomic<X,T>* getMinimum() const
+		{
+			findMinimum();
+			return slots[min_slot].item;
+		}
+		/// Get the time of the next event.
+		T minPriority() const
+		{
+			findMinimum();
+			return slots[min_slot].priority;
+		}
+		/// Visit the imminent models.
+		void visitImminent(ImminentVisitor* visitor) const;
+		/// Remove the model at the front of the queue.
+		void removeMinimum()
+		{
+			findMinimum();
+			if (min_slot != 0) remove(min_slot);
+		}
+		/// Add, remove, or move a model as required by its priority.
+		void schedule(Atomic<X,T>* model, T priority);
+		/// Returns true if the queue is empty, and false otherwise.
+		bool empty() const { return size == 0; }
+		/// Get the number of elements in the queue.
+		unsigned int getSize() const { return size; }
+	private:
+		// A model in the queue. The models in a bucket, and the free
+		// slots, are linked by slot number. Slot 0 is the end of a list
+		// and the minimum of an empty queue.
+		struct slot
+		{
+			Atomic<X,T>* item;
+			T priority;
+			long long day;
+			unsigned int next, prev;
+			slot():
+				item(NULL),priority(adevs_inf<T>()),day(0),next(0),prev(0){}
+		};
+		std::vector<slot> slots;
+		unsigned int free_slots, size;
+		// First slot of each bucket. The count is a power of two.
+		std::vector<unsigned int> buckets;
+		// Width of a day
+		double width;
+		// The next event, found when it is asked for
+		mutable unsigned int min_slot;
+		mutable bool min_valid;
+		// No model has an earlier event than this
+		mutable T lower;
+		// Set when the width no longer suits the event times
+		mutable bool retune;
+		static const unsigned int min_buckets = 16;
+		long long dayOf(T priority) const;
+		unsigned int bucketOf(long long day) const
+		{
+			return (unsigned int)((unsigned long long)day & (buckets.size()-1));
+		}
+		void link(unsigned int s);
+		void unlink(unsigned int s);
+		void remove(unsigned int s);
+		/// Estimate the width and put the models into nbuckets buckets
+		void resize(unsigned int nbuckets);
+		void findMinimum() const;
+};
+
+template <class X, class T>
+CalendarSchedule<X,T>::CalendarSchedule(unsigned int capacity):
+	slots(1),free_slots(0),size(0),buckets(min_buckets,0),width(1.0),
+	min_slot(0),min_valid(true),lower(adevs_inf<T>()),retune(false)
+{
+	slots.reserve(capacity+1);
+}
+
+template <class X, class T>
+long long CalendarSchedule<X,T>::dayOf(T priority) const
+{
+	// Events too far apart to count in days share the first or last day
+	double day = floor(double(priority)/width);
+	if (day > 1E18) return (long long)1E18;
+	if (day < -1E18) return -(long long)1E18;
+	return (long long)day;
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::link(unsigned int s)
+{
+	unsigned int b = bucketOf(slots[s].day);
+	slots[s].prev = 0;
+	slots[s].next = buckets[b];
+	if (buckets[b] != 0) slots[buckets[b]].prev = s;
+	buckets[b] = s;
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::unlink(unsigned int s)
+{
+	if (slots[s].prev != 0) slots[slots[s].prev].next = slots[s].next;
+	else buckets[bucketOf(slots[s].day)] = slots[s].next;
+	if (slots[s].next != 0) slots[slots[s].next].prev = slots[s].prev;
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::remove(unsigned int s)
+{
+	unlink(s);
+	slots[s].item->q_index = 0;
+	slots[s].item = NULL;
+	slots[s].next = free_slots;
+	free_slots = s;
+	size--;
+	if (size == 0)
+	{
+		min_slot = 0;
+		min_valid = true;
+	}
+	else if (s == min_slot) min_valid = false;
+	if (buckets.size() > min_buckets && size < buckets.size()/2)
+		resize(buckets.size()/2);
+	else if (retune)
+		resize(buckets.size());
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::schedule(Atomic<X,T>* model, T priority)
+{
+	unsigned int s = model->q_index;
+	if (s != 0)
+	{
+		// Remove the model if the next event time is infinite
+		if (priority >= adevs_inf<T>())
+		{
+			remove(s);
+			return;
+		}
+		// Don't do anything if the priority is unchanged
+		if (!(priority < slots[s].priority) && !(slots[s].priority < priority))
+			return;
+		unlink(s);
+		if (s == min_slot && slots[s].priority < priority)
+			min_valid = false;
+	}
+	else if (priority < adevs_inf<T>())
+	{
+		if (free_slots != 0)
+		{
+			s = free_slots;
+			free_slots = slots[s].next;
+		}
+		else
+		{
+			s = slots.size();
+			slots.push_back(slot());
+		}
+		slots[s].item = model;
+		model->q_index = s;
+		if (size++ == 0) lower = priority;
+	}
+	// Otherwise, the model is not enqueued and has no next event
+	else return;
+	slots[s].priority = priority;
+	slots[s].day = dayOf(priority);
+	link(s);
+	if (priority < lower) lower = priority;
+	if (min_valid && priority < slots[min_slot].priority) min_slot = s;
+	if (size > 2*buckets.size()) resize(2*buckets.size());
+	else if (retune) resize(buckets.size());
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::findMinimum() const
+{
+	if (min_valid) return;
+	min_valid = true;
+	min_slot = 0;
+	// Look at the days from the lower bound for up to one year
+	long long day = dayOf(lower);
+	for (unsigned int n = 0; n < buckets.size(); n++, day++)
+	{
+		for (unsigned int s = buckets[bucketOf(day)]; s != 0; s = slots[s].next)
+		{
+			if (slots[s].day == day &&
+				(min_slot == 0 || slots[s].priority < slots[min_slot].priority))
+			{
+				min_slot = s;
+				// Nothing is earlier than the lower bound
+				if (!(lower < slots[s].priority)) break;
+			}
+		}
+		if (min_slot != 0)
+		{
+			lower = slots[min_slot].priority;
+			return;
+		}
+	}
+	// The next event is more than a year away. Search every bucket and
+	// ask for a better width.
+	for (unsigned int b = 0; b < buckets.size(); b++)
+	{
+		for (unsigned int s = buckets[b]; s != 0; s = slots[s].next)
+		{
+			if (min_slot == 0 || slots[s].priority < slots[min_slot].priority)
+				min_slot = s;
+		}
+	}
+	lower = slots[min_slot].priority;
+	retune = true;
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::visitImminent(ImminentVisitor* visitor) const
+{
+	findMinimum();
+	if (min_slot == 0) return;
+	// The imminent models share a day and so a bucket
+	T tN = slots[min_slot].priority;
+	unsigned int s = buckets[bucketOf(slots[min_slot].day)];
+	for (; s != 0; s = slots[s].next)
+	{
+		if (!(tN < slots[s].priority))
+			visitor->visit(slots[s].item);
+	}
+}
+
+template <class X, class T>
+void CalendarSchedule<X,T>::resize(unsigned int nbuckets)
+{
+	std::vector<unsigned int> live;
+	live.reserve(size);
+	for (unsigned int b = 0; b < buckets.size(); b++)
+	{
+		for (unsigned int s = buckets[b]; s != 0; s = slots[s].next)
+			live.push_back(s);
+	}
+	// The width is three times the average distance between the events
+	// in the earlier half of the queue, which ignores the outliers.
+	if (live.size() > 1)
+	{
+		std::vector<double> t;
+		t.reserve(live.size());
+		for (unsigned int i = 0; i < live.size(); i++)
+			t.push_back(double(slots[live[i]].priority));
+		unsigned int half = t.size()/2;
+		std::nth_element(t.begin(),t.begin()+half,t.end());
+		double first = *std::min_element(t.begin(),t.begin()+half);
+		double gap = (t[half]-first)/half;
+		if (gap > 0.0 && gap*3.0 < DBL_MAX) width = gap*3.0;
+	}
+	retune = false;
+	buckets.assign(nbuckets,0);
+	for (unsigned int i = 0; i < live.size(); i++)
+	{
+		slots[live[i]].day = dayOf(slots[live[i]].priority);
+		link(live[i]);
+	}
+}
+
+} // end of namespace
+
+#endif
@@ -32,6 +32,8 @@
 #define __adevs_cellspace_h_
 #include "adevs.h"
 #include <cstdlib>
+#include <vector>
+#include <algorithm>
 
 namespace adevs
 {
@@ -44,15 +46,16 @@ namespace adevs
 template <class X> class CellEvent
 {
 	public:
-		/// Default constructor. Sets x = y = z = 0.
-		CellEvent(){ x = y = z = 0; }
+		/// Default constructor. Sets x = y = z = 0 and stencil = false.
+		CellEvent(){ x = y = z = 0; stencil = false; }
 		/// Copy constructor
 		CellEvent(const CellEvent<X>& src):
-		x(src.x),y(src.y),z(src.z),value(src.value){}
+		x(src.x),y(src.y),z(src.z),stencil(src.stencil),value(src.value){}
 		/// Assignment operator
 		const CellEvent& operator=(const CellEvent<X>& src)
 		{
-			x = src.x; y = src.y; z = src.z; value = src.value;
+			x = src.x; y = src.y; z = src.z; stencil = src.stencil;
+			value = src.value;
 			return *this;
 		}
 		/// The x coordinate of the event target
@@ -61,6 +64,13 @@ template <class X> class CellEvent
 		long int y;
 		/// The z coordinate of the event target
 		long int z;
+		/**
+		 * If true, the event goes to every cell in the neighborhood of the
+		 * cell at x,y,z instead of to that cell (see
+		 * CellSpace::setNeighborhood()). The neighbors receive the event
+		 * unchanged, so x,y,z is the location of the sender.
+		 */
+		bool stencil;
 		/// The event value
 		X value;
 };
@@ -81,23 +91,40 @@ template <class X, class T = double> class CellSpace: public Network<CellEvent<X
 	public:
 		/// A component model in the CellSpace
 		typedef Devs<CellEvent<X>,T> Cell;
+		/// How a neighborhood is treated at the edges of the CellSpace.
+		typedef enum
+		{
+			/// The space wraps around at its edges
+			TORUS,
+			/// Neighbors outside of the space are dropped
+			CLAMP,
+			/// Neighbors outside of the space make an output of the CellSpace
+			EXTERNAL
+		} Boundary;
+		/// The location of a neighbor relative to a cell
+		struct Offset
+		{
+			Offset(long int dx = 0, long int dy = 0, long int dz = 0):
+				dx(dx),dy(dy),dz(dz){}
+			long int dx, dy, dz;
+		};
 		/// Create an Width x Height x Depth CellSpace with NULL entries in the cell locations.
 		CellSpace(long int width, long int height = 1, long int depth = 1);
 		/// Insert a model at the x,y,z position.
 		void add(Cell* model, long int x, long int y = 0, long int z = 0) 
 		{
-			space[x][y][z] = model;
+			space[index(x,y,z)] = model;
 			model->setParent(this);
 		}
 		/// Get the model at location x,y,z.
 		const Cell* getModel(long int x, long int y = 0, long int z = 0) const
 		{
-			return space[x][y][z];
+			return space[index(x,y,z)];
 		}
 		/// Get a mutable version of the model at x,y,z.
 		Cell* getModel(long int x, long int y = 0, long int z = 0)
 		{
-			return space[x][y][z];
+			return space[index(x,y,z)];
 		}
 		/// Get the width of the CellSpace.
 		long int getWidth() const { return w; }
@@ -105,62 +132,106 @@ template <class X, class T = double> class CellSpace: public Network<CellEvent<X
 		long int getHeight() const { return h; }
 		/// Get the depth of the CellSpace.
 		long int getDepth() const { return d; }
+		/// Get the number of cell locations, which is width x height x depth.
+		long int getSize() const { return (long int)space.size(); }
+		/**
+		 * Get the position of x,y,z in the cell array. The cells are
+		 * stored with z varying fastest, then y, then x.
+		 */
+		long int index(long int x, long int y = 0, long int z = 0) const
+		{
+			return (x*h+y)*d+z;
+		}
+		/**
+		 * Get the model at position i of the cell array, which may be NULL.
+		 * Iterating i from 0 to getSize()-1 enumerates the cells in
+		 * the same order as getComponents() without building a set.
+		 */
+		Cell* getModelAt(long int i) { return space[i]; }
+		/**
+		 * Set the neighborhood that receives the CellEvents whose stencil
+		 * flag is true. A cell that sends one such event to its neighbors
+		 * replaces an event per neighbor, and the Simulator gives it to the
+		 * neighbors without calling route(). The offset 0,0,0 is ignored,
+		 * as is any neighbor that is the sending cell itself.
+		 * @param offsets The locations of the neighbors relative to a cell
+		 * @param boundary How to treat neighbors outside of the space
+		 */
+		void setNeighborhood(const std::vector<Offset>& offsets,
+			Boundary boundary = TORUS);
+		/**
+		 * Use the Moore neighborhood of the given radius, which is every
+		 * cell within radius steps along each dimension of the space that
+		 * is larger than one. For radius 1 this is 8 cells in a 2D space
+		 * and 26 cells in a 3D space.
+		 */
+		void setMooreNeighborhood(Boundary boundary = TORUS, long int radius = 1);
+		/**
+		 * Use the von Neumann neighborhood of the given radius, which is
+		 * every cell within radius steps in the Manhattan distance. For
+		 * radius 1 this is 4 cells in a 2D space.
+		 */
+		void setVonNeumannNeighborhood(Boundary boundary = TORUS, long int radius = 1);
 		/// Get the model's set of components
 		void getComponents(Set<Cell*>& c);
+		/// Visit every cell that contains a model
+		void visitComponents(typename Network<CellEvent<X>,T>::ComponentVisitor* visitor);
 		/// Route events within the Cellspace
 		void route(const CellEvent<X>& event, Cell* model, 
 		Bag<Event<CellEvent<X>,T> >& r);
+		/// Give stencil events directly to the neighborhood of the sender
+		bool scatter(const CellEvent<X>& event, Cell* model,
+			typename Network<CellEvent<X>,T>::ComponentVisitor* visitor);
+		/**
+		 * Visit each cell and the members of its neighborhood. A cell can
+		 * send an event to any location, so this returns true only if a
+		 * neighborhood is set, and then assumes that each cell sends only
+		 * to its neighbors. A cell that also sends to other cells must be
+		 * simulated by a ParSimulator with an explicit LpGraph. Without a
+		 * neighborhood, nothing is visited and the result is false.
+		 */
+		bool visitCouplings(typename Network<CellEvent<X>,T>::CouplingVisitor* visitor);
 		/// Destructor; this destroys the components as well.
 		~CellSpace();
 	private:	
 		long int w, h, d;
-		Cell**** space;
+		// The cells in a single block, indexed by index()
+		std::vector<Cell*> space;
+		// The neighborhood and its edge treatment
+		std::vector<Offset> nbrs;
+		Boundary boundary;
+		// Offsets of the neighbors in the space array
+		std::vector<long int> nbr_index;
+		// Largest offset along each dimension
+		long int rx, ry, rz;
+		// Add the neighbors of a cell near the edges of the space
+		void scatter_edge(const CellEvent<X>& event, Cell* model,
+			typename Network<CellEvent<X>,T>::ComponentVisitor* visitor);
 };
 
 // Implementation of constructor
 template <class X, class T>
 CellSpace<X,T>::CellSpace(long int width, long int height, long int depth):
-Network<CellEvent<X>,T>()
+Network<CellEvent<X>,T>(),
+w(width),h(height),d(depth),
+space(width*height*depth,NULL),
+boundary(TORUS),
+rx(0),ry(0),rz(0)
 {
-	w = width;
-	h = height;
-	d = depth;
-	// Allocate space for the cells and set the entries to NULL
-	space = new Cell***[w];
-	for (long int x = 0; x < w; x++)
-	{
-		space[x] = new Cell**[h];
-		for (long int y = 0; y < h; y++)
-		{
-			space[x][y] = new Cell*[h];
-			for (long int z = 0; z < d; z++)
-			{
-				space[x][y][z] = NULL;
-			}
-		}
-	}
 }
 
 // Implementation of destructor
 template <class X, class T>
 CellSpace<X,T>::~CellSpace()
 {
-	for (long int x = 0; x < w; x++)
+	for (typename std::vector<Cell*>::iterator iter = space.begin();
+	iter != space.end(); iter++)
 	{
-		for (long int y = 0; y < h; y++)
+		if (*iter != NULL)
 		{
-			for (long int z = 0; z < d; z++)
-			{
-				if (space[x][y][z] != NULL)
-				{
-					delete space[x][y][z];
-				}
-			}
-			delete [] space[x][y];
+			delete *iter;
 		}
-		delete [] space[x];
 	}
-	delete [] space;
 }
 
 // Implementation of the getComponents() method
@@ -168,17 +239,26 @@ template <class X, class T>
 void CellSpace<X,T>::getComponents(Set<Cell*>& c)
 {
 	// Add all non-null entries to the set c
-	for (long int x = 0; x < w; x++)
+	for (typename std::vector<Cell*>::iterator iter = space.begin();
+	iter != space.end(); iter++)
 	{
-		for (long int y = 0; y < h; y++)
+		if (*iter != NULL)
 		{
-			for (long int z = 0; z < d; z++)
-			{
-				if (space[x][y][z] != NULL)
-				{
-					c.insert(space[x][y][z]);
-				}
-			}
+			c.insert(*iter);
+		}
+	}
+}
+
+template <class X, class T>
+void CellSpace<X,T>::visitComponents(
+typename Network<CellEvent<X>,T>::ComponentVisitor* visitor)
+{
+	for (typename std::vector<Cell*>::iterator iter = space.begin();
+	iter != space.end(); iter++)
+	{
+		if (*iter != NULL)
+		{
+			visitor->visit(*iter);
 		}
 	}
 }
@@ -195,7 +275,7 @@ const CellEvent<X>& event, Cell* model, Bag<Event<CellEvent<X>,T> >& r)
 	event.z >= 0 && event.z < d) // check z dimension
 	{
 		// Get the interior target
-		target = space[event.x][event.y][event.z];
+		target = space[index(event.x,event.y,event.z)];
 	}
 	else
 	{
@@ -211,6 +291,142 @@ const CellEvent<X>& event, Cell* model, Bag<Event<CellEvent<X>,T> >& r)
 	}
 }
 
+template <class X, class T>
+void CellSpace<X,T>::setNeighborhood(const std::vector<Offset>& offsets,
+	Boundary boundary)
+{
+	this->boundary = boundary;
+	nbrs.clear();
+	nbr_index.clear();
+	rx = ry = rz = 0;
+	for (typename std::vector<Offset>::const_iterator iter = offsets.begin();
+	iter != offsets.end(); iter++)
+	{
+		if ((*iter).dx == 0 && (*iter).dy == 0 && (*iter).dz == 0)
+			continue;
+		nbrs.push_back(*iter);
+		nbr_index.push_back(((*iter).dx*h+(*iter).dy)*d+(*iter).dz);
+		rx = std::max(rx,labs((*iter).dx));
+		ry = std::max(ry,labs((*iter).dy));
+		rz = std::max(rz,labs((*iter).dz));
+	}
+}
+
+template <class X, class T>
+void CellSpace<X,T>::setMooreNeighborhood(Boundary boundary, long int radius)
+{
+	long int sx = (w > 1) ? radius : 0;
+	long int sy = (h > 1) ? radius : 0;
+	long int sz = (d > 1) ? radius : 0;
+	std::vector<Offset> offsets;
+	for (long int dx = -sx; dx <= sx; dx++)
+		for (long int dy = -sy; dy <= sy; dy++)
+			for (long int dz = -sz; dz <= sz; dz++)
+				offsets.push_back(Offset(dx,dy,dz));
+	setNeighborhood(offsets,boundary);
+}
+
+template <class X, class T>
+void CellSpace<X,T>::setVonNeumannNeighborhood(Boundary boundary, long int radius)
+{
+	long int sx = (w > 1) ? radius : 0;
+	long int sy = (h > 1) ? radius : 0;
+	long int sz = (d > 1) ? radius : 0;
+	std::vector<Offset> offsets;
+	for (long int dx = -sx; dx <= sx; dx++)
+		for (long int dy = -sy; dy <= sy; dy++)
+			for (long int dz = -sz; dz <= sz; dz++)
+				if (labs(dx)+labs(dy)+labs(dz) <= radius)
+					offsets.push_back(Offset(dx,dy,dz));
+	setNeighborhood(offsets,boundary);
+}
+
+template <class X, class T>
+bool CellSpace<X,T>::scatter(const CellEvent<X>& event, Cell* model,
+	typename Network<CellEvent<X>,T>::ComponentVisitor* visitor)
+{
+	if (!event.stencil) return false;
+	if (nbrs.empty())
+	{
+		exception err("CellSpace has no neighborhood for a stencil event",model);
+		throw err;
+	}
+	// Cells away from the edges find their neighbors at fixed offsets
+	if (event.x-rx >= 0 && event.x+rx < w &&
+		event.y-ry >= 0 && event.y+ry < h &&
+		event.z-rz >= 0 && event.z+rz < d)
+	{
+		Cell** cell = &(space[index(event.x,event.y,event.z)]);
+		for (std::vector<long int>::const_iterator iter = nbr_index.begin();
+		iter != nbr_index.end(); iter++)
+		{
+			if (cell[*iter] != NULL)
+				visitor->visit(cell[*iter]);
+		}
+	}
+	else scatter_edge(event,model,visitor);
+	return true;
+}
+
+template <class X, class T>
+bool CellSpace<X,T>::visitCouplings(
+	typename Network<CellEvent<X>,T>::CouplingVisitor* visitor)
+{
+	if (nbrs.empty()) return false;
+	// Find the neighbors of each cell with scatter()
+	struct neighbor_visitor:
+		public Network<CellEvent<X>,T>::ComponentVisitor
+	{
+		void visit(Devs<CellEvent<X>,T>* model) { couplings->visit(src,model); }
+		Cell* src;
+		typename Network<CellEvent<X>,T>::CouplingVisitor* couplings;
+	} nbr;
+	nbr.couplings = visitor;
+	CellEvent<X> event;
+	event.stencil = true;
+	for (event.x = 0; event.x < w; event.x++)
+		for (event.y = 0; event.y < h; event.y++)
+			for (event.z = 0; event.z < d; event.z++)
+			{
+				nbr.src = space[index(event.x,event.y,event.z)];
+				if (nbr.src != NULL) scatter(event,nbr.src,&nbr);
+			}
+	return true;
+}
+
+template <class X, class T>
+void CellSpace<X,T>::scatter_edge(const CellEvent<X>& event, Cell* model,
+	typename Network<CellEvent<X>,T>::ComponentVisitor* visitor)
+{
+	bool outside = false;
+	for (typename std::vector<Offset>::const_iterator iter = nbrs.begin();
+	iter != nbrs.end(); iter++)
+	{
+		long int x = event.x+(*iter).dx;
+		long int y = event.y+(*iter).dy;
+		long int z = event.z+(*iter).dz;
+		if (x < 0 || x >= w || y < 0 || y >= h || z < 0 || z >= d)
+		{
+			if (boundary == CLAMP) continue;
+			else if (boundary == EXTERNAL)
+			{
+				outside = true;
+				continue;
+			}
+			x = ((x%w)+w)%w;
+			y = ((y%h)+h)%h;
+			z = ((z%d)+d)%d;
+		}
+		Cell* target = space[index(x,y,z)];
+		// A small torus can wrap the neighborhood onto the sender
+		if (target != NULL && target != model)
+			visitor->visit(target);
+	}
+	// The event leaves the space once no matter how many neighbors are outside
+	if (outside)
+		visitor->visit(this);
+}
+
 } // end of namespace
 
 #endif
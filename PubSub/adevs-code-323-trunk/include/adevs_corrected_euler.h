@@ -53,6 +53,7 @@ template <typename X> class corrected_euler:
 		~corrected_euler();
 		double integrate(double* q, double h_lim);
 		void advance(double* q, double h);
+		hermite_step<X>* denseOutput(const double* qstart, double h);
 	private:
 		double *dq, // derivative
 			   *qq, // trial solution
@@ -61,6 +62,7 @@ template <typename X> class corrected_euler:
 		const double err_tol; // Error tolerance
 		const double h_max; // Maximum time step
 		double h_cur; // Previous time step that satisfied error constraint
+		hermite_step<X> dense; // Interpolant for the last step
 		// Compute a step of size h, put it in qq, and return the error
 		double trial_step(double h);
 };
@@ -68,7 +70,7 @@ template <typename X> class corrected_euler:
 template <typename X>
 corrected_euler<X>::corrected_euler(ode_system<X>* sys, double err_tol,
 		double h_max):
-	ode_solver<X>(sys),err_tol(err_tol),h_max(h_max),h_cur(h_max)
+	ode_solver<X>(sys),err_tol(err_tol),h_max(h_max),h_cur(h_max),dense(sys)
 {
 	for (int i = 0; i < 2; i++) k[i] = new double[sys->numVars()];
 	dq = new double[sys->numVars()];
@@ -90,6 +92,13 @@ void corrected_euler<X>::advance(double* q, double h)
 	while ((dt = integrate(q,h)) < h) h -= dt;
 }
 
+template <typename X>
+hermite_step<X>* corrected_euler<X>::denseOutput(const double* qstart, double h)
+{
+	if (dense.matches(qstart,h)) return &dense;
+	return NULL;
+}
+
 template <typename X>
 double corrected_euler<X>::integrate(double* q, double h_lim)
 {
@@ -112,6 +121,8 @@ double corrected_euler<X>::integrate(double* q, double h_lim)
 			else h = h_guess;
 		}
 	}
+	// Remember the step for the dense output
+	dense.set(q,k[0],qq,h);
 	// Put the trial solution in q and return the selected step size
 	for (int i = 0; i < this->sys->numVars(); i++) q[i] = qq[i];
 	return h;
@@ -33,6 +33,8 @@
 #include "adevs.h"
 #include <map>
 #include <set>
+#include <vector>
+#include <algorithm>
 #include <cstdlib>
 
 namespace adevs
@@ -96,7 +98,8 @@ public Network<PortValue<VALUE,PORT>,T>
 
 		/// Construct a network with no components.
 		Digraph():
-		Network<IO_Type,T>()
+		Network<IO_Type,T>(),
+		frozen(false)
 		{
 		}
 		/// Add a model to the network.
@@ -106,9 +109,27 @@ public Network<PortValue<VALUE,PORT>,T>
 		Component* dst, PORT dstPort);
 		/// Puts the network's components into to c
 		void getComponents(Set<Component*>& c);
+		/// Visit the network's components without copying the set
+		void visitComponents(typename Network<IO_Type,T>::ComponentVisitor* visitor);
+		/// Visit each pair of coupled models
+		bool visitCouplings(typename Network<IO_Type,T>::CouplingVisitor* visitor);
 		/// Route an event based on the coupling information.
 		void route(const IO_Type& x, Component* model, 
 		Bag<Event<IO_Type,T> >& r);
+		/**
+		 * Flatten the couplings into a table that route() searches in
+		 * place of the coupling graph. An input to a component Digraph is
+		 * followed down to the models that receive it, so that Digraph
+		 * does not route the event again. Outputs that leave a Digraph are
+		 * still routed by its parent, so the event listeners see them as
+		 * before. The components that are Digraphs are frozen too. A call
+		 * to add() or couple() on this Digraph, or on a Digraph inside of
+		 * it, discards the table, and routing uses the coupling graph
+		 * until freeze() is called again.
+		 */
+		void freeze();
+		/// Returns true if route() uses the table built by freeze().
+		bool isFrozen() const { return frozen; }
 		/// Destructor.  Destroys all of the component models.
 		~Digraph();
 
@@ -146,12 +167,35 @@ public Network<PortValue<VALUE,PORT>,T>
 		Set<Component*> models;
 		// Coupling information
 		std::map<node,Bag<node> > graph;
+		// The receivers of src are table_dst[first] to table_dst[last-1]
+		struct frozen_src
+		{
+			node src;
+			unsigned first, last;
+		};
+		static bool src_less(const frozen_src& entry, const node& src)
+		{
+			return entry.src < src;
+		}
+		// Sources in the order of node::operator<, and their receivers
+		std::vector<frozen_src> table;
+		std::vector<node> table_dst;
+		bool frozen;
+		// Discard the table of this Digraph and of the Digraphs above it
+		void thaw();
+		// Append the receivers of src to table_dst
+		void flatten(const node& src);
+		// Append the receivers of an input to this Digraph
+		void flatten_input(const node& input, std::vector<node>& dst);
+		// Is an input on the port coupled directly to an output?
+		bool feeds_through(const PORT& port);
 };
 
 template <class VALUE, class PORT, class T>
 void Digraph<VALUE,PORT,T>::add(Component* model)
 {
 	assert(model != this);
+	thaw();
 	models.insert(model);
 	model->setParent(this);
 }
@@ -160,6 +204,7 @@ template <class VALUE, class PORT, class T>
 void Digraph<VALUE,PORT,T>::couple(Component* src, PORT srcPort, 
 Component* dst, PORT dstPort)
 {
+	thaw();
 	if (src != this) add(src);
 	if (dst != this) add(dst);
 	node src_node(src,srcPort);
@@ -173,6 +218,34 @@ void Digraph<VALUE,PORT,T>::getComponents(Set<Component*>& c)
 	c = models;
 }
 
+template <class VALUE, class PORT, class T>
+void Digraph<VALUE,PORT,T>::visitComponents(
+typename Network<IO_Type,T>::ComponentVisitor* visitor)
+{
+	typename Set<Component*>::iterator i;
+	for (i = models.begin(); i != models.end(); i++)
+	{
+		visitor->visit(*i);
+	}
+}
+
+template <class VALUE, class PORT, class T>
+bool Digraph<VALUE,PORT,T>::visitCouplings(
+typename Network<IO_Type,T>::CouplingVisitor* visitor)
+{
+	typename std::map<node,Bag<node> >::iterator graph_iter;
+	for (graph_iter = graph.begin(); graph_iter != graph.end(); graph_iter++)
+	{
+		typename Bag<node>::iterator node_iter;
+		for (node_iter = (*graph_iter).second.begin();
+		node_iter != (*graph_iter).second.end(); node_iter++)
+		{
+			visitor->visit((*graph_iter).first.model,(*node_iter).model);
+		}
+	}
+	return true;
+}
+
 template <class VALUE, class PORT, class T>
 void Digraph<VALUE,PORT,T>::
 route(const IO_Type& x, Component* model, 
@@ -180,6 +253,15 @@ Bag<Event<IO_Type,T> >& r)
 {
 	// Find the list of target models and ports
 	node src_node(model,x.port);
+	if (frozen)
+	{
+		typename std::vector<frozen_src>::const_iterator iter =
+			std::lower_bound(table.begin(),table.end(),src_node,src_less);
+		if (iter == table.end() || src_node < (*iter).src) return;
+		for (unsigned i = (*iter).first; i < (*iter).last; i++)
+			r.emplace(table_dst[i].model,IO_Type(table_dst[i].port,x.value));
+		return;
+	}
 	typename std::map<node,Bag<node> >::iterator graph_iter;
 	graph_iter = graph.find(src_node);
 	// If no target, just return
@@ -196,6 +278,84 @@ Bag<Event<IO_Type,T> >& r)
 		r.insert(event);
 	}
 }
+template <class VALUE, class PORT, class T>
+void Digraph<VALUE,PORT,T>::freeze()
+{
+	typename Set<Component*>::iterator i;
+	for (i = models.begin(); i != models.end(); i++)
+	{
+		Digraph<VALUE,PORT,T>* sub = dynamic_cast<Digraph<VALUE,PORT,T>*>(*i);
+		if (sub != NULL) sub->freeze();
+	}
+	table.clear();
+	table_dst.clear();
+	// The map is sorted, so the table is too
+	typename std::map<node,Bag<node> >::iterator graph_iter;
+	for (graph_iter = graph.begin(); graph_iter != graph.end(); graph_iter++)
+		flatten((*graph_iter).first);
+	frozen = true;
+}
+
+template <class VALUE, class PORT, class T>
+void Digraph<VALUE,PORT,T>::thaw()
+{
+	// The Digraphs above a frozen one are frozen only if it is
+	if (!frozen) return;
+	frozen = false;
+	table.clear();
+	table_dst.clear();
+	Digraph<VALUE,PORT,T>* parent =
+		dynamic_cast<Digraph<VALUE,PORT,T>*>(this->getParent());
+	if (parent != NULL) parent->thaw();
+}
+
+template <class VALUE, class PORT, class T>
+void Digraph<VALUE,PORT,T>::flatten(const node& src)
+{
+	frozen_src entry;
+	entry.src = src;
+	entry.first = table_dst.size();
+	flatten_input(src,table_dst);
+	entry.last = table_dst.size();
+	table.push_back(entry);
+}
+
+template <class VALUE, class PORT, class T>
+void Digraph<VALUE,PORT,T>::flatten_input(const node& input, std::vector<node>& dst)
+{
+	typename std::map<node,Bag<node> >::iterator graph_iter = graph.find(input);
+	if (graph_iter == graph.end()) return;
+	// The receivers are listed in the order that route() would find them
+	typename Bag<node>::iterator node_iter;
+	for (node_iter = (*graph_iter).second.begin();
+	node_iter != (*graph_iter).second.end(); node_iter++)
+	{
+		Digraph<VALUE,PORT,T>* sub = NULL;
+		if ((*node_iter).model != this)
+			sub = dynamic_cast<Digraph<VALUE,PORT,T>*>((*node_iter).model);
+		// An input that passes straight through to an output of the
+		// component must be routed by it to be seen as its output
+		if (sub != NULL && !sub->feeds_through((*node_iter).port))
+			sub->flatten_input(node(sub,(*node_iter).port),dst);
+		else dst.push_back(*node_iter);
+	}
+}
+
+template <class VALUE, class PORT, class T>
+bool Digraph<VALUE,PORT,T>::feeds_through(const PORT& port)
+{
+	typename std::map<node,Bag<node> >::iterator graph_iter =
+		graph.find(node(this,port));
+	if (graph_iter == graph.end()) return false;
+	typename Bag<node>::iterator node_iter;
+	for (node_iter = (*graph_iter).second.begin();
+	node_iter != (*graph_iter).second.end(); node_iter++)
+	{
+		if ((*node_iter).model == this) return true;
+	}
+	return false;
+}
+
 template <class VALUE, class PORT, class T>
 Digraph<VALUE,PORT,T>::~Digraph()
 { 
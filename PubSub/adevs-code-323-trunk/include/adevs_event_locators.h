@@ -39,7 +39,13 @@ namespace adevs
 
 /**
  * This is a state event locator that uses either bisection or
- * linear interpolation to pinpoints events in time.
+ * linear interpolation to pinpoints events in time. If the ode_solver
+ * provides an interpolant for the step being searched, then the events
+ * are located on that interpolant using bisection or the Illinois variant
+ * of regula falsi. The state at the event is then calculated by the
+ * solver with one integration to the event time. If the events of that
+ * state are not the events found on the interpolant, then the search
+ * goes on from that state without the interpolant.
  */
 template <typename X> class event_locator_impl:
 	public event_locator<X>
@@ -56,17 +62,54 @@ template <typename X> class event_locator_impl:
 		~event_locator_impl();
 		bool find_events(bool* events, const double* qstart, double* qend,
 				ode_solver<X>* solver, double& h);
+		/**
+		 * Find the time of the first event in the interval [0,h] of a step
+		 * using the interpolant for that step. The z0 array holds the state
+		 * event functions at the start of the step and qend is the state
+		 * at its end. If an event is found, then h is overwritten with its
+		 * time and the caller must compute the state at that time with its
+		 * solver; qend is not changed. The z and q arrays are work space
+		 * with room for 2*sys->numEvents() and sys->numVars() entries. The
+		 * events and return value are otherwise as for find_events.
+		 */
+		static bool find_dense_events(ode_system<X>* sys, hermite_step<X>* dense,
+				double err_tol, Mode mode, bool* events, const double* z0,
+				const double* qend, double& h, double* z, double* q);
+		/**
+		 * Returns true if the events found by find_dense_events() are the
+		 * events of the state computed by the solver. The z0 and z arrays
+		 * hold the M state event functions at the start of the step and
+		 * at that state. The functions that change sign must be those in
+		 * events and, if they are continuous, be within err_tol of zero.
+		 */
+		static bool check_events(int M, double err_tol, Mode mode,
+				const bool* events, const double* z0, const double* z)
+		{
+			for (int i = 0; i < M; i++)
+			{
+				bool changed = (sign(z[i]) != sign(z0[i]));
+				if (changed != events[i]) return false;
+				if (changed && mode != DISCONTINUOUS && fabs(z[i]) > err_tol)
+					return false;
+			}
+			return true;
+		}
 	private:
 		double *z[2]; // State events at the start and end of [0,h]
+		double *q; // Work space for interpolated states
 		const double err_tol; // Error tolerance
 		Mode mode;
 
-		int sign(double x) const
+		static int sign(double x)
 		{
 			if (x < 0.0) return -1;
 			else if (x > 0.0) return 1;
 			else return 0;
 		}
+		// Find the first instant in [0,h] where z[i] changes sign on the interpolant
+		static double find_root(ode_system<X>* sys, hermite_step<X>* dense,
+				double err_tol, Mode mode, int i, double z0, double z1,
+				double h, double* z, double* q);
 };
 
 template <typename X>
@@ -77,13 +120,15 @@ event_locator_impl<X>::event_locator_impl(ode_system<X>* sys,
 	mode(mode)
 {
 	z[0] = new double[sys->numEvents()];
-	z[1] = new double[sys->numEvents()];
+	z[1] = new double[2*sys->numEvents()]; // Extra room for find_dense_events
+	q = new double[sys->numVars()];
 }
 
 template <typename X>
 event_locator_impl<X>::~event_locator_impl()
 {
 	delete [] z[0]; delete [] z[1];
+	delete [] q;
 }
 
 template <typename X>
@@ -93,12 +138,34 @@ bool event_locator_impl<X>::find_events(bool* events,
 	// Calculate the state event functions at the start 
 	// of the interval
 	this->sys->state_event_func(qstart,z[0]);
+	bool use_dense = true;
 	// Look for the first event inside of the interval [0,h]
 	for (;;)
 	{
+		// If the solver can interpolate the step, then search the interpolant
+		hermite_step<X>* dense = (use_dense) ? solver->denseOutput(qstart,h) : NULL;
+		if (dense != NULL)
+		{
+			double tend = h;
+			if (!find_dense_events(this->sys,dense,err_tol,mode,events,z[0],qend,h,z[1],q))
+				return false;
+			// Integrate to the event for the state at that time
+			if (h < tend)
+			{
+				for (int i = 0; i < this->sys->numVars(); i++)
+					qend[i] = qstart[i];
+				solver->advance(qend,h);
+			}
+			// Done if the events are those of the solver's state, and
+			// otherwise search on from that state
+			this->sys->state_event_func(qend,z[1]);
+			if (check_events(this->sys->numEvents(),err_tol,mode,events,z[0],z[1]))
+				return true;
+			use_dense = false;
+		}
+		else this->sys->state_event_func(qend,z[1]);
 		double tguess = h;
 		bool event_in_interval = false, found_event = false;
-		this->sys->state_event_func(qend,z[1]);
 		// Do any of the z functions change sign? Have we found an event?
 		for (int i = 0; i < this->sys->numEvents(); i++)
 		{
@@ -144,6 +211,88 @@ bool event_locator_impl<X>::find_events(bool* events,
 	return false;
 }
 
+template <typename X>
+bool event_locator_impl<X>::find_dense_events(ode_system<X>* sys,
+	hermite_step<X>* dense, double err_tol, Mode mode, bool* events,
+	const double* z0, const double* qend, double& h, double* z, double* q)
+{
+	// Find the earliest root among the functions that change sign
+	int first = -1;
+	double tfirst = h;
+	sys->state_event_func(qend,z);
+	for (int i = 0; i < sys->numEvents(); i++)
+	{
+		events[i] = false;
+		if (sign(z[i]) != sign(z0[i]))
+		{
+			double t = find_root(sys,dense,err_tol,mode,i,z0[i],z[i],h,z+sys->numEvents(),q);
+			if (first < 0 || t < tfirst)
+			{
+				first = i;
+				tfirst = t;
+			}
+		}
+	}
+	if (first < 0)
+		return false;
+	// Move the end of the step to the event and flag every function
+	// that has changed sign by then
+	if (tfirst < h)
+	{
+		h = tfirst;
+		dense->interpolate(q,h);
+		sys->state_event_func(q,z);
+	}
+	for (int i = 0; i < sys->numEvents(); i++)
+		events[i] = (sign(z[i]) != sign(z0[i]));
+	events[first] = true;
+	return true;
+}
+
+template <typename X>
+double event_locator_impl<X>::find_root(ode_system<X>* sys,
+	hermite_step<X>* dense, double err_tol, Mode mode, int i,
+	double z0, double z1, double h, double* z, double* q)
+{
+	// The bracket [a,b] always has the sign of z0 at a and has changed sign at b.
+	// The weighted values fa and fb are used by the Illinois method.
+	double a = 0.0, b = h, fa = z0, fb = z1, zb = z1;
+	int side = 0; // Which end of the bracket moved last: -1 for a and 1 for b
+	for (int iter = 0; iter < 100; iter++)
+	{
+		// End condition when z is continuous
+		if (mode != DISCONTINUOUS && fabs(zb) <= err_tol)
+			break;
+		// End condition when z is discontinuous
+		if (mode == DISCONTINUOUS && b-a <= err_tol)
+			break;
+		double c = 0.5*(a+b);
+		if (mode == INTERPOLATE && fb != fa)
+		{
+			double cguess = b-fb*(b-a)/(fb-fa);
+			if (a < cguess && cguess < b) c = cguess;
+		}
+		// The bracket can not be made any smaller
+		if (!(a < c && c < b))
+			break;
+		dense->interpolate(q,c);
+		sys->state_event_func(q,z);
+		if (sign(z[i]) != sign(z0))
+		{
+			b = c; fb = zb = z[i];
+			if (side == 1) fa *= 0.5;
+			side = 1;
+		}
+		else
+		{
+			a = c; fa = z[i];
+			if (side == -1) fb *= 0.5;
+			side = -1;
+		}
+	}
+	return b;
+}
+
 /**
  * Locate events using the bisection method.
  */
@@ -0,0 +1,236 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies, 
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_heap4_schedule_h_
+#define __adevs_heap4_schedule_h_
+#include "adevs_sched.h"
+#include <vector>
+
+namespace adevs
+{
+
+/**
+ * A 4-ary heap for scheduling Atomic models. It has the same interface as
+ * the binary heap in Schedule and can be given to the Simulator in its
+ * place, as in Simulator<X,T,Heap4Schedule<X,T> >. The heap is half as
+ * deep as a binary heap, and the four children of a node sit in one 64
+ * byte cache line when the time type is a double, so a step down the tree
+ * costs at most one cache miss. Like the Schedule, it keeps the position
+ * of a model in the model's q_index attribute.
+ */
+template <class X, class T = double> class Heap4Schedule
+{
+	public:
+		/// The visitor interface is shared with the Schedule
+		typedef typename Schedule<X,T>::ImminentVisitor ImminentVisitor;
+		/// Creates a scheduler with the default or specified initial capacity.
+		Heap4Schedule(unsigned int capacity = 100):
+		capacity(0),size(0),mem(NULL),heap(NULL)
+		{
+			enlarge(capacity);
+		}
+		/// Get the model at the front of the queue.
+		Atomic<X,T>* getMinimum() const { return heap[root].item; }
+		/// Get the time of the next event.
+		T minPriority() const { return heap[root].priority; }
+		/// Visit the imminent models.
+		void visitImminent(ImminentVisitor* visitor) const;
+		/// Remove the model at the front of the queue.
+		void removeMinimum() { if (size != 0) remove(root); }
+		/// Add, remove, or move a model as required by its priority.
+		void schedule(Atomic<X,T>* model, T priority);
+		/// Returns true if the queue is empty, and false otherwise.
+		bool empty() const { return size == 0; }
+		/// Get the number of elements in the heap.
+		unsigned int getSize() const { return size; }
+		/// Destructor.
+		~Heap4Schedule() { delete [] mem; }
+	private:
+		// Definition of an element in the heap.
+		struct heap_element
+		{
+			Atomic<X,T>* item;
+			T priority;
+			heap_element():
+				item(NULL),priority(adevs_inf<T>()){}
+		};
+		// The root is at 3 and the children of i are 4i-8 to 4i-5, so
+		// every family starts at a multiple of four. Index 0 stays free
+		// for models that are not in the heap. The elements past the end
+		// have an infinite priority, so a family can be compared without
+		// checking where the heap ends.
+		static const unsigned int root = 3;
+		unsigned int capacity, size;
+		heap_element *mem, *heap;
+		// Stack for walking the imminent models
+		mutable std::vector<unsigned int> visit_stack;
+		static unsigned int parent(unsigned int i) { return i/4+2; }
+		static unsigned int first_child(unsigned int i) { return 4*i-8; }
+		unsigned int last() const { return root+size-1; }
+		/// Make room for at least n models
+		void enlarge(unsigned int n);
+		/// Remove the model at index
+		void remove(unsigned int index);
+		/// Move the item at index down and return its new position
+		unsigned int percolate_down(unsigned int index, T priority);
+		/// Move the item at index up and return its new position
+		unsigned int percolate_up(unsigned int index, T priority);
+};
+
+template <class X, class T>
+const unsigned int Heap4Schedule<X,T>::root;
+
+template <class X, class T>
+void Heap4Schedule<X,T>::enlarge(unsigned int n)
+{
+	// Room for the last family of n models and for aligning the heap
+	unsigned int new_capacity = (capacity < 16) ? 16 : capacity;
+	while (new_capacity < n) new_capacity *= 2;
+	heap_element* new_mem = new heap_element[first_child(root+new_capacity)+8];
+	heap_element* new_heap = new_mem;
+	// Put the families on a 64 byte boundary if the element size allows it
+	if (64 % sizeof(heap_element) == 0)
+	{
+		while (((size_t)(new_heap+4)) % 64 != 0 && new_heap < new_mem+4)
+			new_heap++;
+	}
+	for (unsigned int i = root; i < root+size; i++)
+		new_heap[i] = heap[i];
+	delete [] mem;
+	mem = new_mem;
+	heap = new_heap;
+	capacity = new_capacity;
+}
+
+template <class X, class T>
+void Heap4Schedule<X,T>::visitImminent(ImminentVisitor* visitor) const
+{
+	if (size == 0) return;
+	// The imminent models are a subtree at the root
+	visit_stack.push_back(root);
+	while (!visit_stack.empty())
+	{
+		unsigned int i = visit_stack.back();
+		visit_stack.pop_back();
+		visitor->visit(heap[i].item);
+		for (unsigned int c = first_child(i); c < first_child(i)+4 && c <= last(); c++)
+		{
+			if (!(heap[root].priority < heap[c].priority))
+				visit_stack.push_back(c);
+		}
+	}
+}
+
+template <class X, class T>
+void Heap4Schedule<X,T>::remove(unsigned int index)
+{
+	heap[index].item->q_index = 0;
+	heap_element tail = heap[last()];
+	heap[last()] = heap_element();
+	size--;
+	if (index > last()) return;
+	// Fill the hole with the last element
+	if (tail.priority < heap[index].priority)
+		index = percolate_up(index,tail.priority);
+	else
+		index = percolate_down(index,tail.priority);
+	heap[index] = tail;
+	tail.item->q_index = index;
+}
+
+template <class X, class T>
+void Heap4Schedule<X,T>::schedule(Atomic<X,T>* model, T priority)
+{
+	unsigned int index = model->q_index;
+	if (index != 0)
+	{
+		// Remove the model if the next event time is infinite
+		if (priority >= adevs_inf<T>())
+		{
+			remove(index);
+			return;
+		}
+		else if (priority < heap[index].priority)
+			index = percolate_up(index,priority);
+		else if (heap[index].priority < priority)
+			index = percolate_down(index,priority);
+		// Don't do anything if the priority is unchanged
+		else return;
+	}
+	// Add the model if its next event time is not at infinity
+	else if (priority < adevs_inf<T>())
+	{
+		if (size == capacity) enlarge(capacity+1);
+		size++;
+		index = percolate_up(last(),priority);
+	}
+	else return;
+	heap[index].priority = priority;
+	heap[index].item = model;
+	model->q_index = index;
+}
+
+template <class X, class T>
+unsigned int Heap4Schedule<X,T>::percolate_down(unsigned int index, T priority)
+{
+	for (;;)
+	{
+		unsigned int child = first_child(index);
+		// The family is past the end of the heap
+		if (child > last()) break;
+		// Find the earliest child. Those past the end are at infinity.
+		if (heap[child+1].priority < heap[child].priority) child++;
+		if (heap[first_child(index)+2].priority < heap[child].priority)
+			child = first_child(index)+2;
+		if (heap[first_child(index)+3].priority < heap[child].priority)
+			child = first_child(index)+3;
+		if (!(heap[child].priority < priority)) break;
+		heap[index] = heap[child];
+		heap[index].item->q_index = index;
+		index = child;
+	}
+	return index;
+}
+
+template <class X, class T>
+unsigned int Heap4Schedule<X,T>::percolate_up(unsigned int index, T priority)
+{
+	while (index > root && priority <= heap[parent(index)].priority)
+	{
+		heap[index] = heap[parent(index)];
+		heap[index].item->q_index = index;
+		index = parent(index);
+	}
+	return index;
+}
+
+} // end of namespace
+
+#endif
@@ -360,6 +360,98 @@ void dae_se1_system<X>::solve(const double* q)
 		max_err = err;
 }
 
+/**
+ * This is a cubic Hermite interpolant for a single integration step. It
+ * is built from the states and derivatives at the two ends of the step
+ * and is used by the ode_solvers to provide a continuous extension of
+ * their last step. The derivative at the end of the step is calculated
+ * only if the interpolant is actually used.
+ */
+template <typename X> class hermite_step
+{
+	public:
+		/// Create an empty interpolant for the supplied system
+		hermite_step(ode_system<X>* sys);
+		/// Destructor
+		~hermite_step();
+		/**
+		 * Record a step of size h from state q0 to state q1. The k0
+		 * array is h times the derivative at q0.
+		 */
+		void set(const double* q0, const double* k0, const double* q1, double h);
+		/**
+		 * Returns true if the recorded step started at state q and
+		 * was h units of time long.
+		 */
+		bool matches(const double* q, double h) const;
+		/// Put the state at time t in [0,h] of the recorded step into q
+		void interpolate(double* q, double t);
+	private:
+		ode_system<X>* sys;
+		double *q0, *k0, *q1, *k1;
+		double h;
+		bool valid, // Is there a recorded step?
+			 k1_ok; // Has k1 been calculated for the recorded step?
+};
+
+template <typename X>
+hermite_step<X>::hermite_step(ode_system<X>* sys):
+	sys(sys),h(0.0),valid(false),k1_ok(false)
+{
+	q0 = new double[sys->numVars()];
+	k0 = new double[sys->numVars()];
+	q1 = new double[sys->numVars()];
+	k1 = new double[sys->numVars()];
+}
+
+template <typename X>
+hermite_step<X>::~hermite_step()
+{
+	delete [] q0; delete [] k0; delete [] q1; delete [] k1;
+}
+
+template <typename X>
+void hermite_step<X>::set(const double* q0, const double* k0, const double* q1, double h)
+{
+	for (int i = 0; i < sys->numVars(); i++)
+	{
+		this->q0[i] = q0[i];
+		this->k0[i] = k0[i];
+		this->q1[i] = q1[i];
+	}
+	this->h = h;
+	valid = true;
+	k1_ok = false;
+}
+
+template <typename X>
+bool hermite_step<X>::matches(const double* q, double h) const
+{
+	if (!valid || h != this->h)
+		return false;
+	for (int i = 0; i < sys->numVars(); i++)
+		if (q[i] != q0[i]) return false;
+	return true;
+}
+
+template <typename X>
+void hermite_step<X>::interpolate(double* q, double t)
+{
+	if (!k1_ok)
+	{
+		sys->der_func(q1,k1);
+		for (int i = 0; i < sys->numVars(); i++)
+			k1[i] *= h;
+		k1_ok = true;
+	}
+	// Hermite basis functions at s = t/h
+	double s = t/h;
+	double h00 = (1.0+2.0*s)*(1.0-s)*(1.0-s), h10 = s*(1.0-s)*(1.0-s),
+		   h01 = s*s*(3.0-2.0*s), h11 = s*s*(s-1.0);
+	for (int i = 0; i < sys->numVars(); i++)
+		q[i] = h00*q0[i]+h10*k0[i]+h01*q1[i]+h11*k1[i];
+}
+
 /**
  * This is the interface for numerical integrators that are to be used with the
  * Hybrid class.
@@ -382,6 +474,17 @@ template <typename X> class ode_solver
 		 * Advance the system through exactly h units of time.
 		 */
 		virtual void advance(double* q, double h) = 0;
+		/**
+		 * If the last step taken by integrate started at state qstart and
+		 * was h units of time long, then return an interpolant for that
+		 * step. Otherwise return NULL. Event locators use this to find
+		 * events without integrating the step again. The default
+		 * implementation returns NULL.
+		 */
+		virtual hermite_step<X>* denseOutput(const double* qstart, double h)
+		{
+			return NULL;
+		}
 		/// Destructor
 		virtual ~ode_solver(){}
 	protected:
@@ -32,6 +32,7 @@
 #define adevs_lp_graph_h
 #include <vector>
 #include <map>
+#include <algorithm>
 
 namespace adevs
 {
@@ -48,6 +49,17 @@ class LpGraph
 	public:
 		/// Create a graph without any edges
 		LpGraph():nodes(0){}
+		/// Add node A if it is not in the graph, with no edges
+		void addNode(int A)
+		{
+			if (E.find(A) == E.end()
+					&& I.find(A) == I.end())
+			{
+				nodes++;
+				E[A];
+				I[A];
+			}
+		}
 		/// Create an edge from node A to node B
 		void addEdge(int A, int B)
 		{
@@ -66,6 +78,13 @@ class LpGraph
 		const std::vector<int>& getI(int B) { return I[B]; }
 		/// Get the influencees of node A
 		const std::vector<int>& getE(int A) { return E[A]; }
+		/// Returns true if there is an edge from node A to node B
+		bool hasEdge(int A, int B) const
+		{
+			std::map<int,std::vector<int> >::const_iterator iter = E.find(A);
+			return iter != E.end() &&
+				std::find((*iter).second.begin(),(*iter).second.end(),B) != (*iter).second.end();
+		}
 		/// Destructor
 		~LpGraph(){}
 	private:
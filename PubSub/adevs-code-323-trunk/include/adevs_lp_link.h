@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_lp_link_h_
+#define __adevs_lp_link_h_
+#include "adevs_models.h"
+#include "adevs_time.h"
+
+namespace adevs
+{
+
+/**
+ * Connects the logical process of a ParSimulator to the logical processes
+ * in other processes. The logical process gives its outputs and earliest
+ * input times for processes elsewhere to the link, and the link puts
+ * what arrives from them into the input queues of the logical process.
+ * The TransportLink in adevs_transport_link.h implements this with a
+ * Transport.
+ */
+template <class X, class T = double> class LpLink
+{
+	public:
+		/// Send the output value at time t for the model target to process dst.
+		virtual void sendOutput(int dst, const Time<T>& t, Atomic<X,T>* target,
+			const X& value) = 0;
+		/// Send a new earliest input time to the process dst.
+		virtual void sendEIT(int dst, const Time<T>& t) = 0;
+		/// Put the input that has arrived into the queues of the local process.
+		virtual void poll() = 0;
+		/**
+		 * Wait for every process to call barrier(). The input that arrives
+		 * meanwhile goes into the input queues.
+		 */
+		virtual void barrier() = 0;
+		/// Destructor
+		virtual ~LpLink(){}
+};
+
+} // end of namespace
+
+#endif
@@ -38,14 +38,45 @@
 #include <iostream>
 #include <vector>
 #include <list>
-#include <map>
 #include <queue>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <cassert>
 
 namespace adevs
 {
 
+template <class X, class T> class LpLink;
+
+/**
+ * How a logical process waits for its earliest input time to advance.
+ * SPIN polls its input queues without pause. YIELD polls spin_limit times
+ * and then gives up the processor between polls. PARK polls spin_limit
+ * times and then sleeps until another logical process sends it a message.
+ */
+typedef enum { LP_SPIN, LP_YIELD, LP_PARK } LpWaitStrategy;
+
+/**
+ * Counters that a logical process keeps over all calls to execUntil.
+ */
+struct LpStats
+{
+	LpStats():blocked_time(0.0),spins(0),wakeups(0),messages(0),null_messages(0){}
+	/// Seconds of wall clock time spent waiting for input
+	double blocked_time;
+	/// Polls of the input queues that did not advance the earliest input time
+	unsigned long spins;
+	/// Times that the process was woken after it parked
+	unsigned long wakeups;
+	/// Output messages sent to other logical processes
+	unsigned long messages;
+	/// Earliest output time (null) messages sent to other logical processes
+	unsigned long null_messages;
+};
+
 /**
  * A logical process is assigned to every atomic model and it simulates
  * that model conservatively. 
@@ -68,9 +99,33 @@ template <class X, class T = double> class LogicalProcess:
 		void addModel(Devs<X,T>* model);
 		/**
 		 * Send a message to the logical process. This will put the 
-		 * message into the back of the input queue.
+		 * message into the back of the queue from the sender.
 		 */
-		void sendMessage(Message<X,T>& msg) { input_q.insert(msg); }
+		void sendMessage(Message<X,T>& msg)
+		{
+			getQueue(msg.src->getID())->insert(msg);
+			wake();
+		}
+		/// Set the earliest input time from the LP src.
+		void sendEIT(int src, const Time<T>& t)
+		{
+			getQueue(src)->setEIT(t);
+			wake();
+		}
+		/// Set how run() waits for input. This must not be called while it runs.
+		void setWaitStrategy(LpWaitStrategy strategy, unsigned int spin_limit)
+		{
+			wait_strategy = strategy;
+			this->spin_limit = spin_limit;
+		}
+		/// Get the counters for this LP.
+		const LpStats& getStats() const { return stats; }
+		/**
+		 * Send the outputs and earliest output times of this LP to other
+		 * processes through the link, and take input from the link. This
+		 * must not be called while it runs.
+		 */
+		void setLink(LpLink<X,T>* link) { this->link = link; }
 		/**
 		 * Get the smallest of the local time of next event. 
 		 */
@@ -104,13 +159,59 @@ template <class X, class T = double> class LogicalProcess:
 		// Lookahead for this LP
 		T lookahead;
 		bool looking_ahead;
-		// Earliest input times 
-		std::map<int,Time<T> > eit_map;
-		// Input messages to the LP
-		MessageQ<X,T> input_q;
+		// Earliest input time from each influencer
+		std::vector<Time<T> > eit_in;
+		// Queues of input messages from each influencer
+		std::vector<MessageQ<X,T>*> input_q;
+		// Position of each influencer in eit_in and input_q, or -1
+		std::vector<int> input_index;
+		// Get the queue for messages from the LP src
+		MessageQ<X,T>* getQueue(int src)
+		{
+			if (src < 0 || src >= (int)input_index.size() || input_index[src] < 0)
+			{
+				exception err("Message sent on an edge that is not in the LpGraph");
+				throw err;
+			}
+			return input_q[input_index[src]];
+		}
 		// Priority queue of messages to process
 		std::priority_queue<Message<X,T> > xq;
+		// Moves the messages from an input queue into xq
+		struct xq_sink
+		{
+			xq_sink(std::priority_queue<Message<X,T> >& xq):xq(xq){}
+			void push(const Message<X,T>& msg) { xq.push(msg); last = msg.t; }
+			std::priority_queue<Message<X,T> >& xq;
+			// Time of the last message
+			Time<T> last;
+		};
 		Bag<Event<X,T> > xb;
+		LpWaitStrategy wait_strategy;
+		unsigned int spin_limit;
+		LpStats stats;
+		// Link to the LPs in other processes, or NULL
+		LpLink<X,T>* link;
+		// Incremented by the senders when the LP may be parked
+		std::atomic<unsigned int> wake_seq;
+		// Value of wake_seq before the last poll of the input queues
+		unsigned int wake_seen;
+		std::atomic<bool> parked;
+		std::mutex park_mtx;
+		std::condition_variable park_cv;
+		// Wait after a poll of the input queues that found nothing useful
+		void wait(unsigned int polls);
+		// Wake the LP if it is parked. This is called by the senders.
+		void wake()
+		{
+			if (wait_strategy != LP_PARK) return;
+			wake_seq.fetch_add(1);
+			if (parked.load())
+			{
+				std::lock_guard<std::mutex> lock(park_mtx);
+				park_cv.notify_one();
+			}
+		}
 		// Smallest of the earliest input times
 		Time<T> eit, eot, tNow, tOut, tL;
 		// Abstract simulator for notifying listeners
@@ -133,8 +234,10 @@ template <typename X, class T>
 LogicalProcess<X,T>::LogicalProcess(int ID, const std::vector<int>& I, 
 	const std::vector<int>& E, LogicalProcess<X,T>** all_lps,
 	AbstractSimulator<X,T>* psim, MessageManager<X>* msg_manager):
-	ID(ID),E(E),I(I),all_lps(all_lps),psim(psim),
-	msg_manager(msg_manager),sim(this)
+	ID(ID),E(E),I(I),all_lps(all_lps),
+	wait_strategy(LP_SPIN),spin_limit(1000),link(NULL),
+	wake_seq(0),wake_seen(0),parked(false),
+	psim(psim),msg_manager(msg_manager),sim(this)
 {
 	tL = tOut = tNow = eot = eit = Time<T>(0,0);
 	all_lps[ID] = this;
@@ -142,7 +245,14 @@ LogicalProcess<X,T>::LogicalProcess(int ID, const std::vector<int>& I,
 	looking_ahead = false;
 	for (typename std::vector<int>::const_iterator iter = I.begin();
 			iter != I.end(); iter++)
-		if (*iter != ID) eit_map[*iter] = Time<T>(0,0);
+	{
+		if (*iter == ID) continue;
+		if (*iter >= (int)input_index.size()) input_index.resize(*iter+1,-1);
+		if (input_index[*iter] >= 0) continue;
+		input_index[*iter] = input_q.size();
+		input_q.push_back(new MessageQ<X,T>());
+		eit_in.push_back(Time<T>(0,0));
+	}
 	sim.addEventListener(this);
 }
 
@@ -184,12 +294,20 @@ void LogicalProcess<X,T>::notifyInput(Atomic<X,T>* model, X& value)
 	// Don't send messages that have already been sent
 	if (tNow <= tOut) return;
 	assert(model->getProc() != ID);
+	// The link copies the value into its frame
+	if (link != NULL)
+	{
+		stats.messages++;
+		link->sendOutput(model->getProc(),tNow,model,value);
+		return;
+	}
 	// Send the event to the proper LP
 	Message<X,T> msg(msg_manager->clone(value));
 	msg.t = tNow;
 	msg.src = this;
 	msg.target = model;
 	msg.type = Message<X,T>::OUTPUT;
+	stats.messages++;
 	all_lps[model->getProc()]->sendMessage(msg);
 }
 
@@ -311,38 +429,67 @@ void LogicalProcess<X,T>::sendEOT(Time<T> tNext)
 	if (eot < newEot)
 	{
 		eot = newEot;
-		Message<X,T> msg;
-		msg.target = NULL;
-		msg.src = this;
-		msg.type = Message<X,T>::EIT;
-		msg.t = eot; 
 		for (std::vector<int>::const_iterator iter = E.begin();
 			iter != E.end(); iter++)
-			if (*iter != ID) all_lps[(*iter)]->sendMessage(msg);
+		{
+			if (*iter == ID) continue;
+			stats.null_messages++;
+			if (link != NULL) link->sendEIT(*iter,eot);
+			else all_lps[(*iter)]->sendEIT(ID,eot);
+		}
 	}
 }
 
 template <typename X, class T>
 void LogicalProcess<X,T>::processInputMessages()
 {
-	while (!input_q.empty())
+	if (link != NULL) link->poll();
+	xq_sink sink(xq);
+	eit = Time<T>::Inf();
+	for (unsigned int i = 0; i < input_q.size(); i++)
 	{
-		Message<X,T> msg(input_q.remove());
-		eit_map[msg.src->getID()] = msg.t;
-		if (msg.type == Message<X,T>::OUTPUT)
-			xq.push(msg);
+		// Get the EIT before the outputs so that every output sent
+		// ahead of it is in the queue
+		Time<T> t;
+		if (input_q[i]->getEIT(t) && eit_in[i] < t)
+			eit_in[i] = t;
+		// The messages on an edge come in time order, and an output at t
+		// also promises no earlier input
+		if (input_q[i]->drain(sink) != 0 && eit_in[i] < sink.last)
+			eit_in[i] = sink.last;
+		eit = std::min(eit_in[i],eit);
 	}
-	eit = Time<T>::Inf();
-    typename std::map<int,Time<T> >::iterator iter;
-	for (iter = eit_map.begin();
-			iter != eit_map.end(); iter++)	
-		eit = std::min((*iter).second,eit);
+}
+
+template <typename X, class T>
+void LogicalProcess<X,T>::wait(unsigned int polls)
+{
+	stats.spins++;
+	if (wait_strategy == LP_SPIN || polls <= spin_limit) return;
+	// Senders in other processes can not wake a parked LP
+	if (wait_strategy == LP_YIELD || link != NULL)
+	{
+		std::this_thread::yield();
+		return;
+	}
+	// A sender increments wake_seq after its message is in the queue and
+	// then looks at parked. Either it sees parked and wakes us, or we see
+	// the new wake_seq here and poll again.
+	std::unique_lock<std::mutex> lock(park_mtx);
+	parked.store(true);
+	while (wake_seq.load() == wake_seen)
+		park_cv.wait(lock);
+	parked.store(false);
+	stats.wakeups++;
 }
 
 template <typename X, class T>
 void LogicalProcess<X,T>::run(T t_stop)
 {
 	bool try_again = true;
+	// Polls since the EIT last advanced and when the first of them started
+	unsigned int polls = 0;
+	double t_blocked = 0.0;
 	// Run until advanceState reaches the stopping time
 	while (
 		eit.t <= t_stop ||
@@ -354,13 +501,25 @@ void LogicalProcess<X,T>::run(T t_stop)
 
 		if (try_again)
 		{
+			if (polls != 0)
+			{
+				stats.blocked_time += omp_get_wtime()-t_blocked;
+				polls = 0;
+			}
 			advanceState(t_stop);
 			advanceOutput();
 		}
+		else
+		{
+			if (polls++ == 0) t_blocked = omp_get_wtime();
+			wait(polls);
+		}
 		Time<T> eit_now(eit);
+		wake_seen = wake_seq.load();
 		processInputMessages();
 		try_again = eit_now < eit; 
 	}
+	if (polls != 0) stats.blocked_time += omp_get_wtime()-t_blocked;
 }
 
 template <class X, class T>
@@ -375,6 +534,13 @@ void LogicalProcess<X,T>::cleanup_xb()
 template <class X, class T>
 LogicalProcess<X,T>::~LogicalProcess()
 {
+	// Collect the messages that were never received
+	xq_sink sink(xq);
+	for (unsigned int i = 0; i < input_q.size(); i++)
+	{
+		input_q[i]->drain(sink);
+		delete input_q[i];
+	}
 	while (!xq.empty())
 	{
 		Message<X,T> msg(xq.top());
@@ -0,0 +1,523 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies, 
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_lp_partition_h_
+#define __adevs_lp_partition_h_
+#include "adevs_models.h"
+#include "adevs_lp_graph.h"
+#include <vector>
+#include <set>
+#include <utility>
+#include <unordered_map>
+
+namespace adevs
+{
+
+/**
+ * This class assigns the atomic models of a ParSimulator to its processors.
+ * A model that has an assignment, its own or its parent's, keeps it. The
+ * others are split into balanced parts with few couplings between the
+ * parts, using the couplings reported by Network::visitCouplings(). The
+ * models are put in order, the order is cut into parts of equal size, and
+ * then models on the border of a part move to the part that holds most of
+ * their neighbors if this does not upset the balance. Two orders are
+ * tried and the one that cuts fewer couplings is kept. The first is the
+ * order of Network::visitComponents(), which cuts the cells of a CellSpace
+ * into slabs along the x axis. The second is breadth first through the
+ * couplings, starting from a model at the periphery of the coupling
+ * graph, and it finds the pieces of networks such as a Digraph whose
+ * components are not in a useful order.
+ */
+template <class X, class T = double> class LpPartition
+{
+	public:
+		/// Partition the atomic components of model among lp_count processors.
+		LpPartition(Devs<X,T>* model, int lp_count);
+		/**
+		 * Move the models without an assignment so that every pair of
+		 * models that exchange messages is on one processor or on two
+		 * processors joined by an edge of g. First the parts are renamed,
+		 * if there is a renaming that fits g, and then each model that
+		 * still needs a missing edge moves to the least loaded processor
+		 * where all of its couplings have an edge. Returns false if some pair is still not joined by an edge, which
+		 * happens if the models given a processor by the user need an edge
+		 * that g does not have or if the search fails. The search relies
+		 * on the couplings and so it is complete only if isComplete().
+		 */
+		bool fit(const LpGraph& g);
+		/**
+		 * Set the processor of every atomic model that does not have an
+		 * assignment by inheritance or otherwise. The assignment is made
+		 * with Devs::setProc() and so it stays with the model after the
+		 * partition and the simulator are gone, where it takes the place
+		 * of any processor number that was not valid for lp_count.
+		 */
+		void assign();
+		/// Returns true if every Network in the model reported all of its couplings.
+		bool isComplete() const { return complete; }
+		/**
+		 * Add every processor and an edge for each pair of processors that
+		 * exchange messages to g. If isComplete(), this is the smallest
+		 * LpGraph that will simulate the model.
+		 */
+		void getLpGraph(LpGraph& g) const;
+		/// Get the number of atomic models.
+		int getModelCount() const { return (int)atomics.size(); }
+		/// Get the number of atomic models assigned to a processor.
+		int getLoad(int proc) const { return load[proc]; }
+		/// Get the number of couplings between models on different processors.
+		int getCut() const;
+	private:
+		int lp_count;
+		bool complete;
+		// The atomic models and their processors
+		std::vector<Atomic<X,T>*> atomics;
+		std::vector<int> part;
+		// True if the processor was assigned by the user
+		std::vector<bool> fixed;
+		std::vector<int> load;
+		// Node of each model in the coupling graph. A network has two
+		// nodes, one for its inputs and one for its outputs.
+		std::unordered_map<Devs<X,T>*,int> node;
+		// Atomic model at each node or -1
+		std::vector<int> node_atomic;
+		// Couplings between nodes
+		std::vector<std::pair<int,int> > couplings;
+		// Atomic models that send to each other, as pairs of indices
+		std::vector<std::pair<int,int> > links;
+		// Undirected adjacency lists of the atomic models
+		std::vector<int> adj_start, adj;
+		void walk(Devs<X,T>* model, int proc);
+		void find_links();
+		void order(std::vector<int>& seq);
+		void cut(const std::vector<int>& seq);
+		int bfs(int start, std::vector<int>& seq, std::vector<int>& mark, int stamp);
+		bool rename(const LpGraph& g, const std::vector<std::pair<int,int> >& pairs,
+			int k, std::vector<int>& label, std::vector<bool>& used, int& budget) const;
+		bool fits(const LpGraph& g, int i, int proc,
+			const std::vector<std::vector<int> >& out,
+			const std::vector<std::vector<int> >& in) const;
+		void refine();
+		class component_walker;
+		class coupling_recorder;
+};
+
+template <class X, class T>
+class LpPartition<X,T>::component_walker:
+	public Network<X,T>::ComponentVisitor
+{
+	public:
+		component_walker(LpPartition<X,T>* p, int proc):p(p),proc(proc){}
+		void visit(Devs<X,T>* model) { p->walk(model,proc); }
+	private:
+		LpPartition<X,T>* p;
+		int proc;
+};
+
+template <class X, class T>
+class LpPartition<X,T>::coupling_recorder:
+	public Network<X,T>::CouplingVisitor
+{
+	public:
+		coupling_recorder(LpPartition<X,T>* p, Network<X,T>* net):p(p),net(net){}
+		void visit(Devs<X,T>* src, Devs<X,T>* dst)
+		{
+			int s, d;
+			// Inputs to the network enter at its first node and outputs
+			// leave from its second
+			if (src == net) s = p->node[net];
+			else
+			{
+				typename std::unordered_map<Devs<X,T>*,int>::iterator iter =
+					p->node.find(src);
+				if (iter == p->node.end()) return;
+				s = (*iter).second;
+				if (src->typeIsNetwork() != NULL) s++;
+			}
+			if (dst == net) d = p->node[net]+1;
+			else
+			{
+				typename std::unordered_map<Devs<X,T>*,int>::iterator iter =
+					p->node.find(dst);
+				if (iter == p->node.end()) return;
+				d = (*iter).second;
+			}
+			p->couplings.push_back(std::pair<int,int>(s,d));
+		}
+	private:
+		LpPartition<X,T>* p;
+		Network<X,T>* net;
+};
+
+template <class X, class T>
+LpPartition<X,T>::LpPartition(Devs<X,T>* model, int lp_count):
+	lp_count(lp_count),
+	complete(true),
+	load(lp_count,0)
+{
+	walk(model,-1);
+	find_links();
+	// Try the order of the components
+	std::vector<int> seq;
+	for (unsigned int i = 0; i < atomics.size(); i++)
+		if (!fixed[i]) seq.push_back(i);
+	cut(seq);
+	// and a breadth first order
+	std::vector<int> best_part(part), best_load(load);
+	int best_cut = getCut();
+	seq.clear();
+	order(seq);
+	cut(seq);
+	if (best_cut <= getCut())
+	{
+		part.swap(best_part);
+		load.swap(best_load);
+	}
+}
+
+template <class X, class T>
+void LpPartition<X,T>::cut(const std::vector<int>& seq)
+{
+	// Models with an assignment count toward the load of their processor
+	load.assign(lp_count,0);
+	for (unsigned int i = 0; i < atomics.size(); i++)
+		if (fixed[i]) load[part[i]]++;
+	// Cut the order into parts of equal size
+	int target = ((int)atomics.size()+lp_count-1)/lp_count;
+	int p = 0;
+	for (unsigned int i = 0; i < seq.size(); i++)
+	{
+		while (p < lp_count-1 && load[p] >= target) p++;
+		part[seq[i]] = p;
+		load[p]++;
+	}
+	refine();
+}
+
+template <class X, class T>
+void LpPartition<X,T>::walk(Devs<X,T>* model, int proc)
+{
+	if (proc < 0 && model->getProc() >= 0 && model->getProc() < lp_count)
+		proc = model->getProc();
+	Atomic<X,T>* a = model->typeIsAtomic();
+	if (a != NULL)
+	{
+		node[model] = node_atomic.size();
+		node_atomic.push_back(atomics.size());
+		atomics.push_back(a);
+		part.push_back(proc);
+		fixed.push_back(proc >= 0);
+		return;
+	}
+	Network<X,T>* net = model->typeIsNetwork();
+	node[model] = node_atomic.size();
+	node_atomic.push_back(-1);
+	node_atomic.push_back(-1);
+	component_walker components(this,proc);
+	net->visitComponents(&components);
+	// The components have their nodes now
+	coupling_recorder recorder(this,net);
+	if (!net->visitCouplings(&recorder)) complete = false;
+}
+
+template <class X, class T>
+void LpPartition<X,T>::find_links()
+{
+	// The couplings leaving each node
+	int nodes = node_atomic.size();
+	std::vector<int> start(nodes+1,0), dst(couplings.size());
+	for (unsigned int i = 0; i < couplings.size(); i++)
+		start[couplings[i].first+1]++;
+	for (int i = 0; i < nodes; i++)
+		start[i+1] += start[i];
+	std::vector<int> next(start.begin(),start.end()-1);
+	for (unsigned int i = 0; i < couplings.size(); i++)
+		dst[next[couplings[i].first]++] = couplings[i].second;
+	// Follow the couplings from each atomic model through the networks
+	// to the atomic models that receive its output
+	std::vector<int> mark(nodes,-1), stack;
+	for (int i = 0; i < nodes; i++)
+	{
+		if (node_atomic[i] < 0) continue;
+		mark[i] = i;
+		stack.push_back(i);
+		while (!stack.empty())
+		{
+			int n = stack.back();
+			stack.pop_back();
+			for (int j = start[n]; j < start[n+1]; j++)
+			{
+				int m = dst[j];
+				if (mark[m] == i) continue;
+				mark[m] = i;
+				if (node_atomic[m] < 0) stack.push_back(m);
+				else links.push_back(std::pair<int,int>(node_atomic[i],node_atomic[m]));
+			}
+		}
+	}
+	couplings.clear();
+	// Adjacency lists that ignore the direction of the links
+	adj_start.assign(atomics.size()+1,0);
+	adj.resize(2*links.size());
+	for (unsigned int i = 0; i < links.size(); i++)
+	{
+		adj_start[links[i].first+1]++;
+		adj_start[links[i].second+1]++;
+	}
+	for (unsigned int i = 0; i < atomics.size(); i++)
+		adj_start[i+1] += adj_start[i];
+	next.assign(adj_start.begin(),adj_start.end()-1);
+	for (unsigned int i = 0; i < links.size(); i++)
+	{
+		adj[next[links[i].first]++] = links[i].second;
+		adj[next[links[i].second]++] = links[i].first;
+	}
+}
+
+template <class X, class T>
+int LpPartition<X,T>::bfs(int start, std::vector<int>& seq,
+	std::vector<int>& mark, int stamp)
+{
+	unsigned int first = seq.size();
+	mark[start] = stamp;
+	seq.push_back(start);
+	for (unsigned int i = first; i < seq.size(); i++)
+	{
+		int n = seq[i];
+		for (int j = adj_start[n]; j < adj_start[n+1]; j++)
+		{
+			int m = adj[j];
+			if (fixed[m] || mark[m] == stamp) continue;
+			mark[m] = stamp;
+			seq.push_back(m);
+		}
+	}
+	return seq.back();
+}
+
+template <class X, class T>
+void LpPartition<X,T>::order(std::vector<int>& seq)
+{
+	std::vector<int> mark(atomics.size(),-1), scratch;
+	for (unsigned int i = 0; i < atomics.size(); i++)
+	{
+		if (fixed[i] || mark[i] >= 0) continue;
+		// The last model reached from i is far from the center of its
+		// component, so the search from it grows across the component
+		// like a front
+		scratch.clear();
+		int start = bfs(i,scratch,mark,0);
+		bfs(start,seq,mark,1);
+	}
+}
+
+template <class X, class T>
+void LpPartition<X,T>::refine()
+{
+	int target = ((int)atomics.size()+lp_count-1)/lp_count;
+	int slack = target/32+1;
+	std::vector<int> conn(lp_count,0);
+	for (int pass = 0; pass < 4; pass++)
+	{
+		int moved = 0;
+		for (unsigned int i = 0; i < atomics.size(); i++)
+		{
+			if (fixed[i]) continue;
+			for (int j = adj_start[i]; j < adj_start[i+1]; j++)
+				conn[part[adj[j]]]++;
+			int p = part[i], best = p;
+			for (int j = adj_start[i]; j < adj_start[i+1]; j++)
+			{
+				int q = part[adj[j]];
+				if (conn[q] > conn[best] && load[q] < target+slack)
+					best = q;
+			}
+			if (best != p && load[p] > target-slack)
+			{
+				part[i] = best;
+				load[p]--;
+				load[best]++;
+				moved++;
+			}
+			for (int j = adj_start[i]; j < adj_start[i+1]; j++)
+				conn[part[adj[j]]] = 0;
+			conn[p] = 0;
+		}
+		if (moved == 0) break;
+	}
+}
+
+template <class X, class T>
+bool LpPartition<X,T>::fits(const LpGraph& g, int i, int proc,
+	const std::vector<std::vector<int> >& out,
+	const std::vector<std::vector<int> >& in) const
+{
+	for (unsigned int j = 0; j < out[i].size(); j++)
+	{
+		int q = (out[i][j] == i) ? proc : part[out[i][j]];
+		if (q != proc && !g.hasEdge(proc,q)) return false;
+	}
+	for (unsigned int j = 0; j < in[i].size(); j++)
+	{
+		int p = (in[i][j] == i) ? proc : part[in[i][j]];
+		if (p != proc && !g.hasEdge(p,proc)) return false;
+	}
+	return true;
+}
+
+template <class X, class T>
+bool LpPartition<X,T>::rename(const LpGraph& g,
+	const std::vector<std::pair<int,int> >& pairs,
+	int k, std::vector<int>& label, std::vector<bool>& used, int& budget) const
+{
+	if (k == lp_count) return true;
+	for (int p = 0; p < lp_count && budget > 0; p++)
+	{
+		if (used[p]) continue;
+		budget--;
+		label[k] = p;
+		bool ok = true;
+		for (unsigned int i = 0; ok && i < pairs.size(); i++)
+		{
+			if (pairs[i].first != k && pairs[i].second != k) continue;
+			int a = (pairs[i].first < lp_count) ? label[pairs[i].first] : pairs[i].first-lp_count;
+			int b = (pairs[i].second < lp_count) ? label[pairs[i].second] : pairs[i].second-lp_count;
+			ok = a < 0 || b < 0 || a == b || g.hasEdge(a,b);
+		}
+		used[p] = true;
+		if (ok && rename(g,pairs,k+1,label,used,budget)) return true;
+		used[p] = false;
+	}
+	label[k] = -1;
+	return false;
+}
+
+template <class X, class T>
+bool LpPartition<X,T>::fit(const LpGraph& g)
+{
+	// Pairs of parts that exchange messages. Parts 0 to lp_count-1 hold
+	// the models without an assignment and can be renamed. Part lp_count+p
+	// holds the models that the user assigned to processor p.
+	std::set<std::pair<int,int> > parts;
+	for (unsigned int i = 0; i < links.size(); i++)
+	{
+		int a = links[i].first, b = links[i].second;
+		a = fixed[a] ? lp_count+part[a] : part[a];
+		b = fixed[b] ? lp_count+part[b] : part[b];
+		if (a != b) parts.insert(std::pair<int,int>(a,b));
+	}
+	// Search the renamings, which begins with the one that changes
+	// nothing, until one fits or the budget runs out
+	std::vector<std::pair<int,int> > pairs(parts.begin(),parts.end());
+	std::vector<int> label(lp_count,-1);
+	std::vector<bool> used(lp_count,false);
+	int budget = 100000;
+	if (rename(g,pairs,0,label,used,budget))
+	{
+		load.assign(lp_count,0);
+		for (unsigned int i = 0; i < atomics.size(); i++)
+		{
+			if (!fixed[i]) part[i] = label[part[i]];
+			load[part[i]]++;
+		}
+	}
+	// The models that each model sends to and receives from
+	std::vector<std::vector<int> > out(atomics.size()), in(atomics.size());
+	for (unsigned int i = 0; i < links.size(); i++)
+	{
+		out[links[i].first].push_back(links[i].second);
+		in[links[i].second].push_back(links[i].first);
+	}
+	// Each pass moves the models whose couplings do not have an edge.
+	// A move can break the couplings of a neighbor, which is taken up
+	// in the next pass.
+	for (unsigned int pass = 0; pass <= atomics.size(); pass++)
+	{
+		bool ok = true, moved = false;
+		for (unsigned int i = 0; i < atomics.size(); i++)
+		{
+			if (fits(g,i,part[i],out,in)) continue;
+			ok = false;
+			if (fixed[i]) continue;
+			int best = -1;
+			for (int p = 0; p < lp_count; p++)
+			{
+				if (fits(g,i,p,out,in) && (best < 0 || load[p] < load[best]))
+					best = p;
+			}
+			if (best >= 0)
+			{
+				load[part[i]]--;
+				load[best]++;
+				part[i] = best;
+				moved = true;
+			}
+		}
+		if (ok) return true;
+		if (!moved) return false;
+	}
+	return false;
+}
+
+template <class X, class T>
+void LpPartition<X,T>::assign()
+{
+	for (unsigned int i = 0; i < atomics.size(); i++)
+		if (!fixed[i]) atomics[i]->setProc(part[i]);
+}
+
+template <class X, class T>
+void LpPartition<X,T>::getLpGraph(LpGraph& g) const
+{
+	std::set<std::pair<int,int> > edges;
+	for (unsigned int i = 0; i < links.size(); i++)
+	{
+		int p = part[links[i].first], q = part[links[i].second];
+		if (p != q) edges.insert(std::pair<int,int>(p,q));
+	}
+	for (int i = 0; i < lp_count; i++)
+		g.addNode(i);
+	for (std::set<std::pair<int,int> >::iterator iter = edges.begin();
+		iter != edges.end(); iter++)
+		g.addEdge((*iter).first,(*iter).second);
+}
+
+template <class X, class T>
+int LpPartition<X,T>::getCut() const
+{
+	int cut = 0;
+	for (unsigned int i = 0; i < links.size(); i++)
+		if (part[links[i].first] != part[links[i].second]) cut++;
+	return cut;
+}
+
+} // end of namespace
+
+#endif
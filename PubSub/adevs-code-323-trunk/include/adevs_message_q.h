@@ -32,8 +32,7 @@
 #define __adevs_message_q_h_
 #include "adevs_models.h"
 #include "adevs_time.h"
-#include <omp.h>
-#include <list>
+#include <atomic>
 #include <cassert>
 
 namespace adevs
@@ -80,48 +79,134 @@ template <typename X, class T = double> struct Message
 	~Message(){}
 };
 
-template <class X, class T = double> class MessageQ
+/**
+ * The messages from one logical process to another. There is one queue for
+ * each edge of the LpGraph. Only the sending LP puts messages into it and
+ * only the receiving LP takes them out, so the queue needs no lock.
+ * Output messages go into a list of fixed size blocks that grows when the
+ * receiver falls behind; the sender never waits, because two LPs that
+ * feed each other could otherwise block each other forever. The receiver
+ * hands each emptied block back to the sender for reuse.
+ *
+ * The earliest input time (EIT) sent on the edge is not queued. The sender
+ * overwrites a single value, so the receiver sees only the most recent of
+ * any EIT messages that arrive between two of its reads.
+ *
+ * The queue holds Message objects unless another type is given by M.
+ */
+template <class X, class T = double, class M = Message<X,T> > class MessageQ
 {
 	public:
-		MessageQ()
+		MessageQ():
+			eit_seq(0),
+			eit_read(0),
+			spare(NULL)
 		{
-			omp_init_lock(&lock);
-			qshare_empty = true;
-			qsafe = &q1;
-			qshare = &q2;
+			head = tail = new block();
+			read_pos = 0;
+		}
+		/// Add an output message. This is called by the sending LP.
+		void insert(const M& msg)
+		{
+			unsigned int n = tail->count.load(std::memory_order_relaxed);
+			if (n == block_size)
+			{
+				block* b = spare.exchange(NULL,std::memory_order_acquire);
+				if (b == NULL) b = new block();
+				b->count.store(0,std::memory_order_relaxed);
+				b->next.store(NULL,std::memory_order_relaxed);
+				b->msg[0] = msg;
+				b->count.store(1,std::memory_order_release);
+				tail->next.store(b,std::memory_order_release);
+				tail = b;
+				return;
+			}
+			tail->msg[n] = msg;
+			tail->count.store(n+1,std::memory_order_release);
 		}
-		void insert(const Message<X,T>& msg)
+		/// Set the EIT for the receiver. This is called by the sending LP.
+		void setEIT(const Time<T>& t)
 		{
-			omp_set_lock(&lock);
-			qshare->push_back(msg);
-			qshare_empty = false;
-			omp_unset_lock(&lock);
+			unsigned int seq = eit_seq.load(std::memory_order_relaxed);
+			eit_seq.store(seq+1,std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			eit = t;
+			eit_seq.store(seq+2,std::memory_order_release);
 		}
-		bool empty() const { return qsafe->empty() && qshare_empty; }
-		Message<X,T> remove()
+		/**
+		 * Get the newest EIT if it changed since the last call. The
+		 * outputs sent before that EIT can be removed after this returns.
+		 * This is called by the receiving LP.
+		 * @return true if t was set to a new EIT
+		 */
+		bool getEIT(Time<T>& t)
 		{
-			if (qsafe->empty())
+			for (;;)
 			{
-				std::list<Message<X,T> > *tmp = qshare;
-				omp_set_lock(&lock);
-				qshare = qsafe;
-				qshare_empty = true;
-				omp_unset_lock(&lock);
-				qsafe = tmp;
+				unsigned int seq = eit_seq.load(std::memory_order_acquire);
+				if (seq == eit_read) return false;
+				if (seq & 1) continue;
+				Time<T> tmp(eit);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (eit_seq.load(std::memory_order_relaxed) != seq) continue;
+				eit_read = seq;
+				t = tmp;
+				return true;
+			}
+		}
+		/**
+		 * Remove every waiting output message and pass it to
+		 * sink.push(msg). Returns the number of messages removed.
+		 * This is called by the receiving LP.
+		 */
+		template <class Sink> unsigned int drain(Sink& sink)
+		{
+			unsigned int removed = 0;
+			for (;;)
+			{
+				unsigned int n = head->count.load(std::memory_order_acquire);
+				for (; read_pos < n; read_pos++, removed++)
+					sink.push(head->msg[read_pos]);
+				if (n < block_size) return removed;
+				block* b = head->next.load(std::memory_order_acquire);
+				if (b == NULL) return removed;
+				// Give the empty block back to the sender
+				block* old = spare.exchange(head,std::memory_order_release);
+				if (old != NULL) delete old;
+				head = b;
+				read_pos = 0;
 			}
-			Message<X,T> msg(qsafe->front());
-			qsafe->pop_front();
-			return msg;
 		}
 		~MessageQ()
 		{
-			omp_destroy_lock(&lock);
+			while (head != NULL)
+			{
+				block* b = head->next.load(std::memory_order_relaxed);
+				delete head;
+				head = b;
+			}
+			delete spare.load(std::memory_order_relaxed);
 		}
 	private:
-		omp_lock_t lock;
-		std::list<Message<X,T> > q1, q2;
-		std::list<Message<X,T> > *qsafe, *qshare;
-		volatile bool qshare_empty;
+		static const unsigned int block_size = 256;
+		struct block
+		{
+			block():count(0),next(NULL){}
+			M msg[block_size];
+			std::atomic<unsigned int> count;
+			std::atomic<block*> next;
+		};
+		// Written by the sender
+		block* tail;
+		// The EIT and a sequence number that is odd while it changes
+		Time<T> eit;
+		std::atomic<unsigned int> eit_seq;
+		// Read by the receiver, on its own cache line
+		alignas(64) unsigned int eit_read;
+		block* head;
+		unsigned int read_pos;
+		// An empty block for the sender to reuse
+		alignas(64) std::atomic<block*> spare;
 };
 
 } // end of namespace
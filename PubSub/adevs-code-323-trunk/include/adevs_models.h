@@ -35,6 +35,7 @@
 #include "adevs_set.h"
 #include "adevs_exception.h"
 #include <cstdlib>
+#include <atomic>
 
 namespace adevs
 {
@@ -46,7 +47,10 @@ namespace adevs
 template <class X, class T> class Network;
 template <class X, class T> class Atomic;
 template <class X, class T> class Schedule;
-template <class X, class T> class Simulator;
+template <class X, class T> class Heap4Schedule;
+template <class X, class T> class CalendarSchedule;
+template <class X, class T = double, class Sched = Schedule<X,T> >
+	class Simulator;
 
 /*
  * Constant indicating no processor assignment for the model. This is used by the
@@ -66,7 +70,8 @@ template <class X, class T = double> class Devs
 		/// Default constructor.
 		Devs():
 		parent(NULL),
-		proc(ADEVS_NOT_ASSIGNED_TO_PROCESSOR)
+		proc(ADEVS_NOT_ASSIGNED_TO_PROCESSOR),
+		level(0)
 		{
 		}
 		/// Destructor.
@@ -91,9 +96,16 @@ template <class X, class T = double> class Devs
 		 * Assign a new parent to this model. Network model's should always
 		 * call this method to make themselves the parent of their components.
 		 * If the parent is not set correctly, then the event routing algorithm
-		 * in the simulator will fail.
+		 * in the simulator will fail. If this changes the level of the
+		 * model, then the levels of its components are updated too.
 		 */
-		void setParent(Network<X,T>* parent) { this->parent = parent; }
+		void setParent(Network<X,T>* parent);
+		/**
+		 * Get the number of networks above this model in the hierarchy. The
+		 * level is kept by setParent(), and so a model at the top of the
+		 * hierarchy is at level zero.
+		 */
+		unsigned int getLevel() const { return level; }
 		/**
 		 * This is the structure transition function, which is evaluated following
 		 * every change of the model's state. It should return true
@@ -105,7 +117,9 @@ template <class X, class T = double> class Devs
 		 * will also be evaluated. For network models, the model_transition() function is
 		 * preceded and anteceded by a call to getComponents(). The difference
 		 * of these two sets is used to determine if any models were added or removed
-		 * as part of the model transition.
+		 * as part of the model transition. A network with a change log
+		 * reports its added and removed components instead (see
+		 * Network::setChangeLog()).
 		 */
 		virtual bool model_transition() { return false; }
 		/**
@@ -130,8 +144,13 @@ template <class X, class T = double> class Devs
 		int getProc() { return proc; }
 
 	private:
+		friend class Network<X,T>;
 		Network<X,T>* parent;
 		int proc;
+		// Number of networks above this model
+		unsigned int level;
+		// Set the level of this model and of its components
+		void set_level(unsigned int level);
 };
 
 /**
@@ -197,6 +216,7 @@ template <class X, class T = double> class Atomic: public Devs<X,T>
 			tL_cp = adevs_sentinel<T>();
 			x = y = NULL;
 			q_index = 0; // The Schedule requires this to be zero
+			serial = next_serial().fetch_add(1);
 		}
 		/// Internal transition function.
 		virtual void delta_int() = 0;
@@ -249,6 +269,34 @@ template <class X, class T = double> class Atomic: public Devs<X,T>
 		 * do nothing.
 		 */
 		virtual void endLookahead(){}
+		/**
+		 * This method is called by the OptSimulator just before a
+		 * speculative change of the model's state. It must return an
+		 * object from which restore_state() can put the model back into
+		 * its current state. The simulator may hold many saved states
+		 * at once and frees each of them with gc_state(). If this method
+		 * is not supported then it must throw a
+		 * method_not_supported_exception, which is the default.
+		 */
+		virtual void* save_state()
+		{
+			method_not_supported_exception ns("save_state",this);
+			throw ns;
+		}
+		/**
+		 * Put the model into the state that was saved in data by
+		 * save_state(). The data remains valid until it is given to
+		 * gc_state(). The default implementation does nothing.
+		 */
+		virtual void restore_state(void* data){}
+		/// Free a state returned by save_state(). The default does nothing.
+		virtual void gc_state(void* data){}
+		/**
+		 * Get the number of atomic models that were created before this
+		 * one. A ParSimulator that runs in more than one process uses this
+		 * to find the same model in every process.
+		 */
+		unsigned long getSerial() const { return serial; }
 		/// Destructor.
 		virtual ~Atomic(){}
 		/// Returns a pointer to this model.
@@ -264,8 +312,11 @@ template <class X, class T = double> class Atomic: public Devs<X,T>
 
 	private:
 
-		friend class Simulator<X,T>;
+		template <class A, class B, class C> friend class Simulator;
+		template <class A, class B> friend class OptLogicalProcess;
 		friend class Schedule<X,T>;
+		friend class Heap4Schedule<X,T>;
+		friend class CalendarSchedule<X,T>;
 
 		// Time of last event
 		T tL;
@@ -275,6 +326,13 @@ template <class X, class T = double> class Atomic: public Devs<X,T>
 		Bag<X> *x, *y;
 		// When did the model start checkpointing?
 		T tL_cp;
+		// Order in which the model was created
+		unsigned long serial;
+		static std::atomic<unsigned long>& next_serial()
+		{
+			static std::atomic<unsigned long> count(0);
+			return count;
+		}
 };
 
 /**
@@ -285,7 +343,8 @@ template <class X, class T = double> class Network: public Devs<X,T>
 	public:
 		/// Constructor.
 		Network():
-		Devs<X,T>()
+		Devs<X,T>(),
+		change_log(false)
 		{
 		}
 		/**
@@ -295,6 +354,35 @@ template <class X, class T = double> class Network: public Devs<X,T>
 		 * @param c An empty set to the filled with the Network's components.
 		 */
 		virtual void getComponents(Set<Devs<X,T>*>& c) = 0;
+		/**
+		 * Interface for visiting the components of the Network without
+		 * building a set of them.
+		 */
+		class ComponentVisitor
+		{
+			public:
+				/// Called once for each component
+				virtual void visit(Devs<X,T>* model) = 0;
+				virtual ~ComponentVisitor(){}
+		};
+		/**
+		 * This method should call visitor->visit() once for each of the
+		 * Network's components, excluding the Network model itself. The
+		 * Simulator uses it to walk the model tree. The default
+		 * implementation visits the set filled by getComponents(); Networks
+		 * with many components should override it to skip the set.
+		 * @param visitor The visitor to call for each component
+		 */
+		virtual void visitComponents(ComponentVisitor* visitor)
+		{
+			Set<Devs<X,T>*> c;
+			getComponents(c);
+			for (typename Set<Devs<X,T>*>::iterator iter = c.begin();
+			iter != c.end(); iter++)
+			{
+				visitor->visit(*iter);
+			}
+		}
 		/**
 		 * This method is called by the Simulator to route an output value
 		 * produced by a model. This method should fill the bag r
@@ -307,6 +395,71 @@ template <class X, class T = double> class Network: public Devs<X,T>
 		 * @param r A bag to be filled with (target,value) pairs
 		 */
 		virtual void route(const X& value, Devs<X,T>* model, Bag<Event<X,T> >& r) = 0;
+		/**
+		 * This method lets a Network hand an output value directly to its
+		 * receivers without filling a bag of Events. It should call
+		 * visitor->visit() for each receiver and return true, and each
+		 * receiver gets the value unchanged. As with route(), the Network
+		 * itself is a receiver if the value becomes an output of the
+		 * Network. If the method returns false, the Simulator calls
+		 * route() instead. The default implementation returns false.
+		 * @param value The output value produced by the model
+		 * @param model The model that produced the output value
+		 * @param visitor The visitor to call for each receiver
+		 * @return true if the receivers were visited
+		 */
+		virtual bool scatter(const X& value, Devs<X,T>* model, ComponentVisitor* visitor)
+		{
+			return false;
+		}
+		/**
+		 * Interface for visiting the couplings of the Network.
+		 */
+		class CouplingVisitor
+		{
+			public:
+				/// Called for each pair of models where src can send to dst
+				virtual void visit(Devs<X,T>* src, Devs<X,T>* dst) = 0;
+				virtual ~CouplingVisitor(){}
+		};
+		/**
+		 * This method should call visitor->visit(src,dst) for each pair
+		 * of models where an output of src can become an input to dst.
+		 * The Network itself is the src of its external inputs and the
+		 * dst of the outputs that leave it. The ParSimulator uses the
+		 * couplings to put models that talk to each other on the same
+		 * thread and to find which threads exchange messages. 
+		 * @param visitor The visitor to call for each coupling
+		 * @return true if every coupling was visited. The default
+		 * implementation visits nothing and returns false.
+		 */
+		virtual bool visitCouplings(CouplingVisitor* visitor)
+		{
+			return false;
+		}
+		/**
+		 * Turn the change log on or off. A Network with a change log must
+		 * call componentAdded() for each new model that it gets and
+		 * componentRemoved() for each model that it gives up in its
+		 * model_transition(). The Simulator then schedules and deletes just
+		 * those models instead of comparing the sets of all the
+		 * components below the Network before and after the transition.
+		 * A model that is moved to another Network with setParent() is
+		 * neither added nor removed, and must not be reported. The moves
+		 * made by a Network without a change log are found, as before, by
+		 * comparing the components of the Networks without change logs
+		 * whose model_transition() is evaluated, and so one of those must
+		 * still have the moved model below it. The change log is off by
+		 * default.
+		 */
+		void setChangeLog(bool on)
+		{
+			change_log = on;
+			added_log.clear();
+			removed_log.clear();
+		}
+		/// Returns true if the Network keeps a change log.
+		bool hasChangeLog() const { return change_log; }
 		/**
 		 * Destructor.  This destructor does not delete any component models.
 		 * Any necessary cleanup should be done by the derived class.
@@ -316,8 +469,65 @@ template <class X, class T = double> class Network: public Devs<X,T>
 		}
 		/// Returns a pointer to this model.
 		Network<X,T>* typeIsNetwork() { return this; }
+	protected:
+		/**
+		 * Report a model that is new to the simulation and has become a
+		 * component of this Network. The Simulator will schedule it and
+		 * all of its components. This does nothing if the change log is
+		 * off.
+		 */
+		void componentAdded(Devs<X,T>* model)
+		{
+			if (change_log) added_log.insert(model);
+		}
+		/**
+		 * Report a component that this Network has given up. The Simulator
+		 * will unschedule and delete it and all of its components. This
+		 * does nothing if the change log is off.
+		 */
+		void componentRemoved(Devs<X,T>* model)
+		{
+			if (change_log) removed_log.insert(model);
+		}
+	private:
+		template <class A, class B, class C> friend class Simulator;
+		friend class Devs<X,T>;
+		bool change_log;
+		// Components added and removed since the log was last read
+		Bag<Devs<X,T>*> added_log, removed_log;
+		// Sets the levels of the components
+		class level_visitor:
+			public ComponentVisitor
+		{
+			public:
+				level_visitor(unsigned int level):level(level){}
+				void visit(Devs<X,T>* model) { model->set_level(level); }
+			private:
+				unsigned int level;
+		};
 };
 
+template <class X, class T>
+void Devs<X,T>::setParent(Network<X,T>* parent)
+{
+	this->parent = parent;
+	set_level((parent == NULL) ? 0 : parent->getLevel()+1);
+}
+
+template <class X, class T>
+void Devs<X,T>::set_level(unsigned int level)
+{
+	// Components are changed only if the level of the network does
+	if (this->level == level) return;
+	this->level = level;
+	Network<X,T>* network = typeIsNetwork();
+	if (network != NULL)
+	{
+		typename Network<X,T>::level_visitor visitor(level+1);
+		network->visitComponents(&visitor);
+	}
+}
+
 } // end of namespace
 
 #endif
@@ -30,6 +30,8 @@
  */
 #ifndef __adevs_msg_manager_h_
 #define __adevs_msg_manager_h_
+#include "adevs_exception.h"
+#include <vector>
 
 namespace adevs
 {
@@ -53,6 +55,28 @@ template <typename X> class MessageManager
 		 * called for the copy.
 		 */
 		virtual void destroy(X& value) = 0;
+		/**
+		 * Append the bytes of the value to buf. This is called by a
+		 * ParSimulator that runs in more than one process when the value
+		 * is sent to another process. The default throws a
+		 * method_not_supported_exception.
+		 */
+		virtual void serialize(const X& value, std::vector<char>& buf)
+		{
+			method_not_supported_exception err("serialize",NULL);
+			throw err;
+		}
+		/**
+		 * Make a value from the size bytes that were written by
+		 * serialize() in another process. The receiver frees the value
+		 * with destroy() when it is done with it. The default throws a
+		 * method_not_supported_exception.
+		 */
+		virtual X deserialize(const char* data, unsigned int size)
+		{
+			method_not_supported_exception err("deserialize",NULL);
+			throw err;
+		}
 		virtual ~MessageManager(){}
 };
 
@@ -0,0 +1,978 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_opt_simulator_h_
+#define __adevs_opt_simulator_h_
+#include "adevs_abstract_simulator.h"
+#include "adevs_msg_manager.h"
+#include "adevs_message_q.h"
+#include "adevs_lp_partition.h"
+#include "adevs_sched.h"
+#include "adevs_time.h"
+#include "object_pool.h"
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace adevs
+{
+
+/**
+ * A message between the logical processes of an OptSimulator. An anti
+ * message cancels the message from the same source with the same
+ * sequence number.
+ */
+template <class X, class T = double> struct OptMessage
+{
+	OptMessage():value(){}
+	Time<T> t;
+	int src;
+	unsigned long seq;
+	Atomic<X,T>* target;
+	X value;
+	bool anti;
+};
+
+/**
+ * Counters that an optimistic logical process keeps over all calls
+ * to execUntil.
+ */
+struct OptStats
+{
+	OptStats():events(0),committed(0),rollbacks(0),rolled_back(0),
+		messages(0),anti_messages(0){}
+	/// Simulation steps, including those that were later undone
+	unsigned long events;
+	/// Simulation steps that were committed
+	unsigned long committed;
+	/// Number of rollbacks
+	unsigned long rollbacks;
+	/// Simulation steps that were undone by a rollback
+	unsigned long rolled_back;
+	/// Output messages sent to other logical processes
+	unsigned long messages;
+	/// Anti messages sent to other logical processes
+	unsigned long anti_messages;
+};
+
+/**
+ * A logical process of the OptSimulator. It simulates its models
+ * optimistically, saving their states before each step, and rolls them
+ * back when a message arrives for a time that it has passed. This is
+ * used only by the OptSimulator.
+ */
+template <class X, class T> class OptLogicalProcess:
+	private Schedule<X,T>::ImminentVisitor
+{
+	public:
+		OptLogicalProcess(int ID, int lp_count, OptLogicalProcess<X,T>** all_lps,
+			AbstractSimulator<X,T>* psim, MessageManager<X>* msg_manager);
+		/// Assign a model and its components to this process.
+		void addModel(Devs<X,T>* model);
+		/// Put a message into the queue from its sender.
+		void sendMessage(const OptMessage<X,T>& msg)
+		{
+			input_q[msg.src]->insert(msg);
+		}
+		/**
+		 * Take the messages from the input queues and roll back if they
+		 * are in the past. Returns true if this sent any anti messages.
+		 */
+		bool receive();
+		/**
+		 * Execute at most max_steps steps whose time is not greater than
+		 * limit, stopping early if a step fails.
+		 */
+		void run(T limit, unsigned int max_steps);
+		/// Get the time of the next step to execute.
+		Time<T> nextStepTime();
+		/**
+		 * Commit every step that is earlier than gvt: tell the listeners
+		 * about it and free its saved states and messages.
+		 */
+		void commit(const Time<T>& gvt);
+		/// Undo every step at or after t.
+		void rollback(const Time<T>& t, bool keep_outputs);
+		/// True if the next step threw an exception.
+		bool hasFailed() const { return failed; }
+		/// The exception thrown by the step that failed.
+		std::exception_ptr getError() const { return error; }
+		const OptStats& getStats() const { return stats; }
+		/// Destructor leaves the models intact.
+		~OptLogicalProcess();
+	private:
+		// Identifies a message by its time, source, and sequence number
+		struct msg_key
+		{
+			msg_key(const Time<T>& t, int src, unsigned long seq):
+				t(t),src(src),seq(seq){}
+			Time<T> t;
+			int src;
+			unsigned long seq;
+			bool operator<(const msg_key& other) const
+			{
+				if (t < other.t) return true;
+				if (other.t < t) return false;
+				if (src != other.src) return src < other.src;
+				return seq < other.seq;
+			}
+		};
+		typedef std::map<msg_key,OptMessage<X,T> > input_map;
+		// The state of a model before the step at t
+		struct checkpoint
+		{
+			Time<T> t;
+			Atomic<X,T>* model;
+			T tL;
+			void* state;
+			// Checkpoints of the same model that are earlier and later
+			checkpoint *prev, *next;
+		};
+		// A message sent to another process
+		struct sent_msg
+		{
+			Time<T> t;
+			int dst;
+			unsigned long seq;
+			Atomic<X,T>* target;
+		};
+		// An output event held for the listeners
+		struct output
+		{
+			Time<T> t;
+			Devs<X,T>* model;
+			X value;
+		};
+		const int ID;
+		OptLogicalProcess<X,T>** all_lps;
+		AbstractSimulator<X,T>* psim;
+		MessageManager<X>* msg_manager;
+		// Queues of messages from each of the other processes
+		std::vector<MessageQ<X,T,OptMessage<X,T> >*> input_q;
+		Schedule<X,T> sched;
+		// Time of the last step and of the last committed step
+		Time<T> tL, tL_commit;
+		// Time of the step in progress
+		Time<T> tNow;
+		// Input messages that are not committed. Those at or before
+		// tL have been processed.
+		input_map inputs;
+		// Uncommitted steps, checkpoints, sent messages, and outputs in
+		// the order that they were made
+		std::deque<Time<T> > steps;
+		std::deque<checkpoint> cps;
+		std::deque<sent_msg> sent;
+		std::deque<output> outs;
+		// Last checkpoint of each model
+		std::unordered_map<Atomic<X,T>*,checkpoint*> last_cp;
+		// A rollback to a step keeps the outputs of that step because they
+		// depend only on the earlier states. They are not sent again when
+		// the step is repeated.
+		Time<T> kept;
+		bool kept_valid, restoring;
+		unsigned long seq;
+		bool failed;
+		std::exception_ptr error;
+		Time<T> fail_t;
+		OptStats stats;
+		std::vector<Atomic<X,T>*> activated;
+		object_pool<Bag<X> > io_pool;
+		object_pool<Bag<Event<X,T> > > recv_pool;
+		// Passes the messages from an input queue to accept()
+		struct input_sink
+		{
+			input_sink(OptLogicalProcess<X,T>* lp):lp(lp){}
+			void push(const OptMessage<X,T>& msg) { lp->accept(msg); }
+			OptLogicalProcess<X,T>* lp;
+		};
+		/**
+		 * Delivers an event to the receivers found by Network::scatter().
+		 */
+		class scatter_visitor:
+			public Network<X,T>::ComponentVisitor
+		{
+			public:
+				scatter_visitor(OptLogicalProcess<X,T>* lp, Network<X,T>* parent,
+					Devs<X,T>* src, X& x):
+					lp(lp),parent(parent),src(src),x(x){}
+				void visit(Devs<X,T>* target)
+				{
+					lp->deliver(parent,src,target,x);
+				}
+			private:
+				OptLogicalProcess<X,T>* lp;
+				Network<X,T>* parent;
+				Devs<X,T>* src;
+				X& x;
+		};
+		void accept(const OptMessage<X,T>& msg);
+		Time<T> tNextEvent();
+		void step(const Time<T>& t);
+		void visit(Atomic<X,T>* model);
+		void route(Network<X,T>* parent, Devs<X,T>* src, X& x);
+		void deliver(Network<X,T>* parent, Devs<X,T>* src, Devs<X,T>* target, X& x);
+		void inject_event(Atomic<X,T>* model, X& value);
+		void save(Atomic<X,T>* model);
+		void schedule(Atomic<X,T>* model);
+		void clean_up(Atomic<X,T>* model);
+		void send_anti(const sent_msg& s);
+		void cancel_kept();
+		void notify_state(checkpoint& cp);
+};
+
+/**
+ * This is an optimistic (Time Warp) simulator. The atomic models are
+ * assigned to threads as by the ParSimulator, but the threads do not wait
+ * for each other: each one simulates its models as far as it can, saving
+ * their states as it goes, and rolls back when it gets an input for a
+ * time that it has passed. Models need no lookahead, but every Atomic
+ * model must implement save_state(), restore_state(), and gc_state().
+ * The threads meet periodically to compute the global virtual time (GVT),
+ * the time before which no step can be undone. Event listeners are told
+ * about outputs and state changes only when they pass the GVT. The state
+ * seen by a stateChange() call is the state that the model had just after
+ * that change, and the listeners are called by one thread at a time.
+ *
+ * The values sent between threads, and the outputs held for listeners, are
+ * copied with the MessageManager. The simulator assumes that the output and
+ * time advance functions are deterministic. If a model throws an exception,
+ * the simulator rolls every model back to the state it had before the step
+ * in which the exception occurred and then throws it from execUntil.
+ * This simulator does not support dynamic structure models.
+ */
+template <class X, class T = double> class OptSimulator:
+	public AbstractSimulator<X,T>
+{
+	public:
+		/**
+		 * Create a simulator for the provided model with one logical
+		 * process for each thread. The models are assigned to processes
+		 * by an LpPartition. If msg_manager is NULL, values are copied with
+		 * their copy constructors (see the MessageManager documentation).
+		 */
+		OptSimulator(Devs<X,T>* model, MessageManager<X>* msg_manager = NULL);
+		/// Get the model's next event time
+		T nextEventTime();
+		/// Execute the simulator until the next event time is greater than tstop
+		void execUntil(T tstop);
+		/**
+		 * Do not execute a step that is more than window past the GVT.
+		 * A smaller window gives fewer rollbacks and less parallelism.
+		 * The default is no limit.
+		 */
+		void setOptimismWindow(T window) { this->window = window; }
+		/**
+		 * Compute the GVT after each thread executes at most steps steps.
+		 * Saved states and messages are freed only at the GVT computation,
+		 * so this bounds the memory used. The default is 256.
+		 */
+		void setGVTInterval(unsigned int steps) { gvt_interval = (steps > 0) ? steps : 1; }
+		/// Get the number of logical processes (threads).
+		int getLPCount() const { return lp_count; }
+		/**
+		 * Get the step and rollback counters of the logical process lp.
+		 * An adevs::exception is thrown if lp is not in [0,getLPCount()).
+		 */
+		const OptStats& getLPStats(int lp) const;
+		/**
+		 * Deletes the simulator, but leaves the model intact. The model must
+		 * exist when the simulator is deleted.
+		 */
+		~OptSimulator();
+	private:
+		OptLogicalProcess<X,T>** lp;
+		int lp_count;
+		MessageManager<X>* msg_manager;
+		T window;
+		unsigned int gvt_interval;
+		// The next step time of each process and whether it failed
+		std::vector<Time<T> > next_t;
+		std::vector<char> next_failed;
+		// Set by a process that sent an anti message in a round of receive()
+		std::vector<char> busy;
+		void init(Devs<X,T>* model);
+		Time<T> gvt();
+};
+
+template <class X, class T>
+OptLogicalProcess<X,T>::OptLogicalProcess(int ID, int lp_count,
+	OptLogicalProcess<X,T>** all_lps, AbstractSimulator<X,T>* psim,
+	MessageManager<X>* msg_manager):
+	Schedule<X,T>::ImminentVisitor(),
+	ID(ID),all_lps(all_lps),psim(psim),msg_manager(msg_manager),
+	tL(0,0),tL_commit(0,0),kept_valid(false),restoring(false),
+	seq(0),failed(false)
+{
+	for (int i = 0; i < lp_count; i++)
+		input_q.push_back((i == ID) ? NULL : new MessageQ<X,T,OptMessage<X,T> >());
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::addModel(Devs<X,T>* model)
+{
+	model->setProc(ID);
+	Atomic<X,T>* a = model->typeIsAtomic();
+	if (a != NULL)
+	{
+		a->tL = adevs_zero<T>();
+		schedule(a);
+	}
+	else
+	{
+		Set<Devs<X,T>*> components;
+		model->typeIsNetwork()->getComponents(components);
+		typename Set<Devs<X,T>*>::iterator iter = components.begin();
+		for (; iter != components.end(); iter++)
+			addModel(*iter);
+	}
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::schedule(Atomic<X,T>* model)
+{
+	T dt = model->ta();
+	if (dt < adevs_zero<T>())
+	{
+		exception err("Negative time advance",model);
+		throw err;
+	}
+	if (dt == adevs_inf<T>())
+		sched.schedule(model,adevs_inf<T>());
+	else
+		sched.schedule(model,model->tL+dt);
+}
+
+template <class X, class T>
+Time<T> OptLogicalProcess<X,T>::tNextEvent()
+{
+	Time<T> tSelf(tL);
+	if (tL.t < sched.minPriority())
+	{
+		tSelf.t = sched.minPriority();
+		tSelf.c = 0;
+	}
+	else tSelf.c++;
+	return tSelf;
+}
+
+template <class X, class T>
+Time<T> OptLogicalProcess<X,T>::nextStepTime()
+{
+	Time<T> t(tNextEvent());
+	typename input_map::iterator iter =
+		inputs.upper_bound(msg_key(tL,INT_MAX,ULONG_MAX));
+	if (iter != inputs.end() && iter->first.t < t) t = iter->first.t;
+	return t;
+}
+
+template <class X, class T>
+bool OptLogicalProcess<X,T>::receive()
+{
+	unsigned long antis = stats.anti_messages;
+	input_sink sink(this);
+	for (unsigned int i = 0; i < input_q.size(); i++)
+	{
+		if (input_q[i] != NULL)
+			input_q[i]->drain(sink);
+	}
+	return antis != stats.anti_messages;
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::accept(const OptMessage<X,T>& msg)
+{
+	// New input at or before a failed step may change its outcome
+	if (failed && msg.t <= fail_t) failed = false;
+	msg_key key(msg.t,msg.src,msg.seq);
+	if (!msg.anti)
+	{
+		if (msg.t <= tL) rollback(msg.t,true);
+		inputs.insert(std::make_pair(key,msg));
+		return;
+	}
+	// The message comes before its anti message in the same queue
+	typename input_map::iterator iter = inputs.find(key);
+	assert(iter != inputs.end());
+	if (msg.t <= tL) rollback(msg.t,true);
+	msg_manager->destroy(iter->second.value);
+	inputs.erase(iter);
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::run(T limit, unsigned int max_steps)
+{
+	for (unsigned int i = 0; i < max_steps; i++)
+	{
+		receive();
+		if (failed) return;
+		Time<T> t(nextStepTime());
+		if (t.t == adevs_inf<T>() || limit < t.t) return;
+		step(t);
+	}
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::step(const Time<T>& t)
+{
+	bool imminent = (t == tNextEvent());
+	// The kept outputs are wrong if an earlier step changes the state
+	if (kept_valid && t < kept) cancel_kept();
+	restoring = (kept_valid && t == kept);
+	kept_valid = false;
+	tNow = t;
+	steps.push_back(t);
+	stats.events++;
+	try
+	{
+		// Compute the outputs of the imminent models and route them
+		if (imminent) sched.visitImminent(this);
+		// Apply the inputs from the other processes
+		typename input_map::iterator iter = inputs.lower_bound(msg_key(t,-1,0));
+		for (; iter != inputs.end() && iter->first.t == t; iter++)
+			inject_event(iter->second.target,iter->second.value);
+		// Save the states and compute the next states
+		typename std::vector<Atomic<X,T>*>::iterator aiter;
+		for (aiter = activated.begin(); aiter != activated.end(); aiter++)
+		{
+			Atomic<X,T>* model = *aiter;
+			save(model);
+			if (model->x == NULL)
+				model->delta_int();
+			else if (model->y != NULL)
+				model->delta_conf(*(model->x));
+			else
+				model->delta_ext(t.t-model->tL,*(model->x));
+		}
+		for (aiter = activated.begin(); aiter != activated.end(); aiter++)
+		{
+			clean_up(*aiter);
+			(*aiter)->tL = t.t;
+			schedule(*aiter);
+		}
+		activated.clear();
+		tL = t;
+		restoring = false;
+	}
+	catch(...)
+	{
+		// Undo the partial step and try it again if new input arrives
+		error = std::current_exception();
+		failed = true;
+		fail_t = t;
+		typename std::vector<Atomic<X,T>*>::iterator aiter;
+		for (aiter = activated.begin(); aiter != activated.end(); aiter++)
+			clean_up(*aiter);
+		activated.clear();
+		restoring = false;
+		rollback(t,false);
+	}
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::visit(Atomic<X,T>* model)
+{
+	assert(model->y == NULL);
+	model->y = io_pool.make_obj();
+	if (model->x == NULL)
+		activated.push_back(model);
+	model->output_func(*(model->y));
+	for (typename Bag<X>::iterator y_iter = model->y->begin();
+		y_iter != model->y->end(); y_iter++)
+	{
+		route(model->getParent(),model,*y_iter);
+	}
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::route(Network<X,T>* parent, Devs<X,T>* src, X& x)
+{
+	// Hold output events for the listeners until they are committed
+	if (parent != src && !restoring && psim->hasEventListeners())
+	{
+		output out;
+		out.t = tNow;
+		out.model = src;
+		out.value = msg_manager->clone(x);
+		outs.push_back(out);
+	}
+	if (parent == NULL) return;
+	scatter_visitor scatter(this,parent,src,x);
+	if (parent->scatter(x,src,&scatter)) return;
+	Bag<Event<X,T> >* recvs = recv_pool.make_obj();
+	parent->route(x,src,*recvs);
+	typename Bag<Event<X,T> >::iterator recv_iter = recvs->begin();
+	for (; recv_iter != recvs->end(); recv_iter++)
+		deliver(parent,src,(*recv_iter).model,(*recv_iter).value);
+	recvs->clear();
+	recv_pool.destroy_obj(recvs);
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::deliver(Network<X,T>* parent, Devs<X,T>* src,
+	Devs<X,T>* target, X& x)
+{
+	if (src == target)
+	{
+		exception err("Model tried to influence self",src);
+		throw err;
+	}
+	Atomic<X,T>* amodel = target->typeIsAtomic();
+	if (amodel != NULL)
+	{
+		if (amodel->getProc() == ID)
+			inject_event(amodel,x);
+		// Send it to the process of the target
+		else if (!restoring)
+		{
+			OptMessage<X,T> msg;
+			msg.t = tNow;
+			msg.src = ID;
+			msg.seq = seq++;
+			msg.target = amodel;
+			msg.value = msg_manager->clone(x);
+			msg.anti = false;
+			sent_msg s;
+			s.t = tNow;
+			s.dst = amodel->getProc();
+			s.seq = msg.seq;
+			s.target = amodel;
+			sent.push_back(s);
+			stats.messages++;
+			all_lps[s.dst]->sendMessage(msg);
+		}
+	}
+	else if (target == parent)
+		route(parent->getParent(),parent,x);
+	else
+		route(target->typeIsNetwork(),target,x);
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::inject_event(Atomic<X,T>* model, X& value)
+{
+	if (model->x == NULL)
+	{
+		if (model->y == NULL)
+			activated.push_back(model);
+		model->x = io_pool.make_obj();
+	}
+	model->x->insert(value);
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::clean_up(Atomic<X,T>* model)
+{
+	if (model->x != NULL)
+	{
+		model->x->clear();
+		io_pool.destroy_obj(model->x);
+		model->x = NULL;
+	}
+	if (model->y != NULL)
+	{
+		model->gc_output(*(model->y));
+		model->y->clear();
+		io_pool.destroy_obj(model->y);
+		model->y = NULL;
+	}
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::save(Atomic<X,T>* model)
+{
+	checkpoint cp;
+	cp.t = tNow;
+	cp.model = model;
+	cp.tL = model->tL;
+	cp.state = model->save_state();
+	cp.next = NULL;
+	typename std::unordered_map<Atomic<X,T>*,checkpoint*>::iterator iter =
+		last_cp.find(model);
+	cp.prev = (iter == last_cp.end()) ? NULL : iter->second;
+	cps.push_back(cp);
+	if (cp.prev != NULL) cp.prev->next = &(cps.back());
+	last_cp[model] = &(cps.back());
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::send_anti(const sent_msg& s)
+{
+	OptMessage<X,T> msg;
+	msg.t = s.t;
+	msg.src = ID;
+	msg.seq = s.seq;
+	msg.target = s.target;
+	msg.anti = true;
+	stats.anti_messages++;
+	all_lps[s.dst]->sendMessage(msg);
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::cancel_kept()
+{
+	while (!sent.empty() && sent.back().t == kept)
+	{
+		send_anti(sent.back());
+		sent.pop_back();
+	}
+	while (!outs.empty() && outs.back().t == kept)
+	{
+		msg_manager->destroy(outs.back().value);
+		outs.pop_back();
+	}
+	kept_valid = false;
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::rollback(const Time<T>& t, bool keep_outputs)
+{
+	stats.rollbacks++;
+	while (!steps.empty() && t <= steps.back())
+	{
+		steps.pop_back();
+		stats.rolled_back++;
+	}
+	tL = steps.empty() ? tL_commit : steps.back();
+	// Restore the states from the latest to the earliest
+	while (!cps.empty() && t <= cps.back().t)
+	{
+		checkpoint& cp = cps.back();
+		cp.model->restore_state(cp.state);
+		cp.model->gc_state(cp.state);
+		cp.model->tL = cp.tL;
+		schedule(cp.model);
+		if (cp.prev != NULL)
+		{
+			cp.prev->next = NULL;
+			last_cp[cp.model] = cp.prev;
+		}
+		else last_cp.erase(cp.model);
+		cps.pop_back();
+	}
+	// Cancel the messages and outputs of the undone steps
+	while (!sent.empty() && (t < sent.back().t || (!keep_outputs && t == sent.back().t)))
+	{
+		send_anti(sent.back());
+		sent.pop_back();
+	}
+	while (!outs.empty() && (t < outs.back().t || (!keep_outputs && t == outs.back().t)))
+	{
+		msg_manager->destroy(outs.back().value);
+		outs.pop_back();
+	}
+	if (keep_outputs)
+	{
+		kept = t;
+		kept_valid = true;
+	}
+	else if (kept_valid && t <= kept)
+		kept_valid = false;
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::notify_state(checkpoint& cp)
+{
+	// The state after the change is saved by the next checkpoint
+	// of the model or is its current state
+	if (cp.next == NULL)
+	{
+		psim->notify_state_listeners(cp.model,cp.t.t);
+		return;
+	}
+	void* now = cp.model->save_state();
+	cp.model->restore_state(cp.next->state);
+	psim->notify_state_listeners(cp.model,cp.t.t);
+	cp.model->restore_state(now);
+	cp.model->gc_state(now);
+}
+
+template <class X, class T>
+void OptLogicalProcess<X,T>::commit(const Time<T>& gvt)
+{
+	// Tell the listeners about the outputs and then the state changes
+	// of each step
+	if (psim->hasEventListeners())
+	{
+		#pragma omp critical(adevs_opt_commit)
+		{
+			typename std::deque<output>::iterator oi = outs.begin();
+			typename std::deque<checkpoint>::iterator ci = cps.begin();
+			for (;;)
+			{
+				bool more_out = (oi != outs.end() && (*oi).t < gvt);
+				bool more_cp = (ci != cps.end() && (*ci).t < gvt);
+				if (more_out && (!more_cp || (*oi).t <= (*ci).t))
+				{
+					psim->notify_output_listeners((*oi).model,(*oi).value,(*oi).t.t);
+					oi++;
+				}
+				else if (more_cp)
+				{
+					notify_state(*ci);
+					ci++;
+				}
+				else break;
+			}
+		}
+	}
+	while (!steps.empty() && steps.front() < gvt)
+	{
+		tL_commit = steps.front();
+		steps.pop_front();
+		stats.committed++;
+	}
+	while (!cps.empty() && cps.front().t < gvt)
+	{
+		checkpoint& cp = cps.front();
+		cp.model->gc_state(cp.state);
+		if (cp.next != NULL) cp.next->prev = NULL;
+		else last_cp.erase(cp.model);
+		cps.pop_front();
+	}
+	while (!sent.empty() && sent.front().t < gvt)
+		sent.pop_front();
+	while (!outs.empty() && outs.front().t < gvt)
+	{
+		msg_manager->destroy(outs.front().value);
+		outs.pop_front();
+	}
+	while (!inputs.empty() && inputs.begin()->first.t < gvt)
+	{
+		msg_manager->destroy(inputs.begin()->second.value);
+		inputs.erase(inputs.begin());
+	}
+}
+
+template <class X, class T>
+OptLogicalProcess<X,T>::~OptLogicalProcess()
+{
+	receive();
+	for (unsigned int i = 0; i < input_q.size(); i++)
+		delete input_q[i];
+	for (typename std::deque<checkpoint>::iterator iter = cps.begin();
+		iter != cps.end(); iter++)
+		(*iter).model->gc_state((*iter).state);
+	for (typename std::deque<output>::iterator iter = outs.begin();
+		iter != outs.end(); iter++)
+		msg_manager->destroy((*iter).value);
+	for (typename input_map::iterator iter = inputs.begin();
+		iter != inputs.end(); iter++)
+		msg_manager->destroy(iter->second.value);
+}
+
+template <class X, class T>
+OptSimulator<X,T>::OptSimulator(Devs<X,T>* model, MessageManager<X>* msg_manager):
+	AbstractSimulator<X,T>(),
+	msg_manager(msg_manager),
+	window(adevs_inf<T>()),
+	gvt_interval(256)
+{
+	if (this->msg_manager == NULL)
+		this->msg_manager = new NullMessageManager<X>();
+#ifdef _OPENMP
+	lp_count = omp_get_max_threads();
+#else
+	lp_count = 1;
+#endif
+	LpPartition<X,T>(model,lp_count).assign();
+	lp = new OptLogicalProcess<X,T>*[lp_count];
+	for (int i = 0; i < lp_count; i++)
+		lp[i] = new OptLogicalProcess<X,T>(i,lp_count,lp,this,this->msg_manager);
+	next_t.resize(lp_count);
+	next_failed.resize(lp_count);
+	busy.resize(2,0);
+	init(model);
+}
+
+template <class X, class T>
+void OptSimulator<X,T>::init(Devs<X,T>* model)
+{
+	if (model->getProc() >= 0 && model->getProc() < lp_count)
+	{
+		lp[model->getProc()]->addModel(model);
+		return;
+	}
+	Atomic<X,T>* a = model->typeIsAtomic();
+	if (a != NULL)
+	{
+		// The partition assigned every other atomic model
+		lp[0]->addModel(a);
+	}
+	else
+	{
+		Set<Devs<X,T>*> components;
+		model->typeIsNetwork()->getComponents(components);
+		typename Set<Devs<X,T>*>::iterator iter = components.begin();
+		for (; iter != components.end(); iter++)
+			init(*iter);
+	}
+}
+
+template <class X, class T>
+Time<T> OptSimulator<X,T>::gvt()
+{
+	Time<T> g(Time<T>::Inf());
+	for (int i = 0; i < lp_count; i++)
+	{
+		if (next_t[i] < g) g = next_t[i];
+	}
+	return g;
+}
+
+template <class X, class T>
+T OptSimulator<X,T>::nextEventTime()
+{
+	Time<T> tN = Time<T>::Inf();
+	for (int i = 0; i < lp_count; i++)
+	{
+		if (lp[i]->nextStepTime() < tN)
+			tN = lp[i]->nextStepTime();
+	}
+	return tN.t;
+}
+
+template <class X, class T>
+void OptSimulator<X,T>::execUntil(T tstop)
+{
+	int failed_lp = -1;
+	Time<T> g_start(Time<T>::Inf());
+	for (int i = 0; i < lp_count; i++)
+	{
+		if (lp[i]->nextStepTime() < g_start)
+			g_start = lp[i]->nextStepTime();
+	}
+	#pragma omp parallel num_threads(lp_count)
+	{
+#ifdef _OPENMP
+		int first = omp_get_thread_num(), stride = omp_get_num_threads();
+#else
+		int first = 0, stride = 1;
+#endif
+		Time<T> g(g_start);
+		unsigned int round = 0;
+		for (;;)
+		{
+			// Execute optimistically
+			T limit = tstop;
+			if (window < adevs_inf<T>() && g.t+window < limit)
+				limit = g.t+window;
+			for (int i = first; i < lp_count; i += stride)
+				lp[i]->run(limit,gvt_interval);
+			// Receive the messages in transit until no more anti
+			// messages are sent
+			for (;;)
+			{
+				#pragma omp barrier
+				for (int i = first; i < lp_count; i += stride)
+				{
+					if (lp[i]->receive()) busy[round&1] = 1;
+				}
+				#pragma omp barrier
+				bool again = (busy[round&1] != 0);
+				if (first == 0) busy[(round+1)&1] = 0;
+				round++;
+				if (!again) break;
+			}
+			for (int i = first; i < lp_count; i += stride)
+			{
+				next_t[i] = lp[i]->nextStepTime();
+				next_failed[i] = lp[i]->hasFailed();
+			}
+			#pragma omp barrier
+			g = gvt();
+			// A failure is final if every process that can act at
+			// the GVT has failed there
+			int stuck = -1;
+			for (int i = 0; i < lp_count && g.t < adevs_inf<T>(); i++)
+			{
+				if (next_t[i] == g)
+				{
+					if (!next_failed[i])
+					{
+						stuck = -1;
+						break;
+					}
+					else if (stuck < 0) stuck = i;
+				}
+			}
+			for (int i = first; i < lp_count; i += stride)
+				lp[i]->commit(g);
+			if (stuck >= 0)
+			{
+				// Put every model into its state at the GVT
+				#pragma omp barrier
+				for (int i = first; i < lp_count; i += stride)
+					lp[i]->rollback(g,false);
+				#pragma omp barrier
+				for (int i = first; i < lp_count; i += stride)
+					lp[i]->receive();
+				if (first == 0) failed_lp = stuck;
+				break;
+			}
+			if (tstop < g.t || g.t == adevs_inf<T>()) break;
+		}
+	}
+	if (failed_lp >= 0)
+		std::rethrow_exception(lp[failed_lp]->getError());
+}
+
+template <class X, class T>
+const OptStats& OptSimulator<X,T>::getLPStats(int lp) const
+{
+	if (lp < 0 || lp >= lp_count)
+	{
+		char buffer[1000];
+		sprintf(buffer,"There is no LP %d. The LPs are 0 to %d.",lp,lp_count-1);
+		exception err(buffer);
+		throw err;
+	}
+	return this->lp[lp]->getStats();
+}
+
+template <class X, class T>
+OptSimulator<X,T>::~OptSimulator()
+{
+	for (int i = 0; i < lp_count; i++)
+		delete lp[i];
+	delete [] lp;
+	delete msg_manager;
+}
+
+} // end of namespace
+
+#endif
@@ -34,6 +34,9 @@
 #include "adevs_msg_manager.h"
 #include "adevs_lp.h"
 #include "adevs_lp_graph.h"
+#include "adevs_lp_partition.h"
+#include "adevs_lp_link.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
@@ -43,14 +46,24 @@
 namespace adevs
 {
 
+class Transport;
+
 /**
  * This is the conservative simulator described in "Building Software for Simulation".
  * Models, network and atomic, can be assigned to specific threads (processors) by calling the
  * setProc() method. The components of a network will inherit its thread assignment.
  * Model's with an explicit assignment must have a positive lookahead. Atomic models that are
  * unassigned, by inheritance or otherwise, must have a positive lookahead and will
- * be assigned randomly to a thread. Note that this simulator does not support dynamic
- * structure models.
+ * be assigned to threads by an LpPartition, which keeps models that are coupled
+ * to each other on the same thread and gives each thread a similar number of models.
+ * Note that this simulator does not support dynamic structure models.
+ *
+ * The simulator can also run in several processes that are connected by a
+ * Transport, with one logical process in each. Every process must build the
+ * same model by creating its atomic models in the same order, because
+ * the models are matched by their serial numbers (see Atomic::getSerial()).
+ * Each process simulates only the models assigned to it, and its event
+ * listeners are told only of those models.
  */
 template <class X, class T = double> class ParSimulator:
    public AbstractSimulator<X,T>	
@@ -58,31 +71,81 @@ template <class X, class T = double> class ParSimulator:
 	public:
 		/**
 		 * Create a simulator for the provided model. The Atomic components will
-		 * be assigned to the preferred processors, or assigned randomly if no
+		 * be assigned to the preferred processors, or by an LpPartition if no
 		 * preference is given or the preference can not be satisfied. The
 		 * message manager is used to handle inter-thread events. If msg_manager
 		 * is NULL, the assignment and copy constructors of output objects 
 		 * are used and their is no explicit cleanup (see the MessageManager
-		 * documentation). This constructor assumes all to all connection of the
-		 * processors.
+		 * documentation). If every Network in the model reports its couplings
+		 * (see Network::visitCouplings()), the processors are connected only
+		 * where the models on them are coupled. Otherwise this constructor
+		 * assumes all to all connection of the processors. The processors
+		 * chosen by the LpPartition are given to the models with setProc()
+		 * and stay with them after the simulator is deleted.
 		 */
 		ParSimulator(Devs<X,T>* model, MessageManager<X>* msg_manager = NULL);
 		/**
 		 * This constructor accepts a directed graph whose edges tell the
 		 * simulator which processes feed input to which other processes.
 		 * For example, a simulator with processors 1, 2, and 3 where 1 -> 2
-		 * and 2 -> 3 would have two edges: 1->2 and 2->3.
+		 * and 2 -> 3 would have two edges: 1->2 and 2->3. Atomic models that
+		 * are not assigned to a processor in g are given one by an
+		 * LpPartition that keeps every pair of coupled models on one
+		 * processor or on two processors joined by an edge of g (see
+		 * LpPartition::fit()). As with the other constructor, the processor
+		 * is given to the model with setProc() and stays with it after the
+		 * simulator is deleted. If every Network reports its couplings and
+		 * no such assignment is found, then an adevs::exception is thrown.
 		 */
 		ParSimulator(Devs<X,T>* model, LpGraph& g,
 			MessageManager<X>* msg_manager = NULL);
+		/**
+		 * Create a simulator for the part of the model that belongs to
+		 * this process. There is a logical process for each process that
+		 * is connected by the transport, and the logical process of this
+		 * process is the rank of the transport. Atomic models that are
+		 * not assigned to a process with setProc() are divided into
+		 * blocks of similar size in the order of their serial numbers.
+		 * Because the processes can not be told apart by their couplings,
+		 * every process is connected to every other. The message manager
+		 * must implement serialize() and deserialize(), and the time type
+		 * must be trivially copyable or have its own adevs_write_time() and
+		 * adevs_read_time(). The transport is not deleted by the simulator
+		 * and must exist until the simulator is deleted. This constructor
+		 * is in adevs_transport_link.h, which the header of each Transport
+		 * includes.
+		 */
+		ParSimulator(Devs<X,T>* model, Transport* transport,
+			MessageManager<X>* msg_manager);
 		/// Get the model's next event time
 		T nextEventTime();
 		/**
 		 * Execute the simulator until the next event time is greater
 		 * than the specified value. There is no global clock, 
 		 * so this must be the actual time that you want to stop.
+		 * If the simulator runs in several processes, every process must
+		 * call this with the same stop time, and it returns after all
+		 * of them have reached it.
 		 */
 		void execUntil(T stop_time);
+		/**
+		 * Set how each thread waits when it can not advance until it gets
+		 * input from another thread. LP_SPIN polls without pause and keeps
+		 * a core busy while it waits. LP_YIELD and LP_PARK poll spin_limit
+		 * times and then yield the processor or sleep until a message
+		 * arrives. See LpWaitStrategy. The default is LP_SPIN if there is
+		 * a processor for each thread and LP_YIELD otherwise, because a
+		 * spinning thread would take the processor from the thread that
+		 * it waits for.
+		 */
+		void setWaitStrategy(LpWaitStrategy strategy, unsigned int spin_limit = 1000);
+		/// Get the number of logical processes (threads).
+		int getLPCount() const { return lp_count; }
+		/**
+		 * Get the wait and message counters of the logical process lp.
+		 * An adevs::exception is thrown if lp is not in [0,getLPCount()).
+		 */
+		const LpStats& getLPStats(int lp) const;
 		/**
 		 * Deletes the simulator, but leaves the model intact. The model must
 		 * exist when the simulator is deleted, so delete the model only after
@@ -93,25 +156,38 @@ template <class X, class T = double> class ParSimulator:
 		LogicalProcess<X,T>** lp;
 		int lp_count;
 		MessageManager<X>* msg_manager;
+		// Link to the other processes and the LP of this process
+		LpLink<X,T>* link;
+		int rank;
 		void init(Devs<X,T>* model);
+		void collect(Devs<X,T>* model, int proc,
+			std::vector<std::pair<Atomic<X,T>*,int> >& atomics);
 		void init_sim(Devs<X,T>* model, LpGraph& g);
 }; 
 
 template <class X, class T>
 ParSimulator<X,T>::ParSimulator(Devs<X,T>* model, MessageManager<X>* msg_manager):
-	AbstractSimulator<X,T>(),msg_manager(msg_manager)
+	AbstractSimulator<X,T>(),msg_manager(msg_manager),link(NULL),rank(0)
 {
-	// Create an all to all coupling
 	lp_count = omp_get_max_threads();
+	LpPartition<X,T> partition(model,lp_count);
+	partition.assign();
 	LpGraph g;
-	for (int i = 0; i < lp_count; i++)
+	// Use the couplings if they are known and otherwise
+	// create an all to all coupling
+	if (partition.isComplete()) partition.getLpGraph(g);
+	else
 	{
-		for (int j = 0; j < lp_count; j++)
+		for (int i = 0; i < lp_count; i++)
 		{
-			if (i != j)
+			g.addNode(i);
+			for (int j = 0; j < lp_count; j++)
 			{
-				g.addEdge(i,j);
-				g.addEdge(j,i);
+				if (i != j)
+				{
+					g.addEdge(i,j);
+					g.addEdge(j,i);
+				}
 			}
 		}
 	}
@@ -121,11 +197,51 @@ ParSimulator<X,T>::ParSimulator(Devs<X,T>* model, MessageManager<X>* msg_manager
 template <class X, class T>
 ParSimulator<X,T>::ParSimulator(Devs<X,T>* model, LpGraph& g,
 		MessageManager<X>* msg_manager):
-	AbstractSimulator<X,T>(),msg_manager(msg_manager)
+	AbstractSimulator<X,T>(),msg_manager(msg_manager),link(NULL),rank(0)
 {
+	LpPartition<X,T> partition(model,g.getLPCount());
+	if (!partition.fit(g) && partition.isComplete())
+	{
+		exception err("The LpGraph does not have an edge for every pair of coupled models");
+		throw err;
+	}
+	partition.assign();
 	init_sim(model,g);
 }
 
+template <class X, class T>
+void ParSimulator<X,T>::collect(Devs<X,T>* model, int proc,
+	std::vector<std::pair<Atomic<X,T>*,int> >& atomics)
+{
+	// A valid assignment is inherited by the components
+	if (proc < 0 && model->getProc() >= 0 && model->getProc() < lp_count)
+		proc = model->getProc();
+	Atomic<X,T>* a = model->typeIsAtomic();
+	if (a != NULL)
+	{
+		atomics.push_back(std::pair<Atomic<X,T>*,int>(a,proc));
+		return;
+	}
+	Set<Devs<X,T>*> components;
+	model->typeIsNetwork()->getComponents(components);
+	typename Set<Devs<X,T>*>::iterator iter = components.begin();
+	for (; iter != components.end(); iter++)
+		collect(*iter,proc,atomics);
+}
+
+template <class X, class T>
+const LpStats& ParSimulator<X,T>::getLPStats(int lp) const
+{
+	if (lp < 0 || lp >= lp_count)
+	{
+		char buffer[1000];
+		sprintf(buffer,"There is no LP %d. The LPs are 0 to %d.",lp,lp_count-1);
+		exception err(buffer);
+		throw err;
+	}
+	return this->lp[lp]->getStats();
+}
+
 template <class X, class T>
 void ParSimulator<X,T>::init_sim(Devs<X,T>* model, LpGraph& g)
 {
@@ -146,12 +262,15 @@ void ParSimulator<X,T>::init_sim(Devs<X,T>* model, LpGraph& g)
 		lp[i] = new LogicalProcess<X,T>(i,g.getI(i),g.getE(i),
 			lp,this,msg_manager);
 	}
+	if (omp_get_num_procs() < lp_count) setWaitStrategy(LP_YIELD);
 	init(model);
 }
 
 template <class X, class T>
 T ParSimulator<X,T>::nextEventTime()
 {
+	// The other processes keep their own times
+	if (link != NULL) return lp[rank]->getNextEventTime().t;
 	Time<T> tN = Time<T>::Inf();
 	for (int i = 0; i < lp_count; i++)
 	{
@@ -167,12 +286,26 @@ ParSimulator<X,T>::~ParSimulator()
 	for (int i = 0; i < lp_count; i++)
 		delete lp[i];
 	delete [] lp;
+	if (link != NULL) delete link;
    delete msg_manager;	
 }
 
+template <class X, class T>
+void ParSimulator<X,T>::setWaitStrategy(LpWaitStrategy strategy, unsigned int spin_limit)
+{
+	for (int i = 0; i < lp_count; i++)
+		lp[i]->setWaitStrategy(strategy,spin_limit);
+}
+
 template <class X, class T>
 void ParSimulator<X,T>::execUntil(T tstop)
 {
+	if (link != NULL)
+	{
+		lp[rank]->run(tstop);
+		link->barrier();
+		return;
+	}
 	#pragma omp parallel
 	{
 		lp[omp_get_thread_num()]->run(tstop);
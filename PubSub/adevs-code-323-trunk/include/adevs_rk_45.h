@@ -54,6 +54,7 @@ template <typename X> class rk_45:
 		~rk_45();
 		double integrate(double* q, double h_lim);
 		void advance(double* q, double h);
+		hermite_step<X>* denseOutput(const double* qstart, double h);
 	private:
 		double *dq, // derivative
 			   *qq, // trial solution
@@ -62,13 +63,14 @@ template <typename X> class rk_45:
 		const double err_tol; // Error tolerance
 		const double h_max; // Maximum time step
 		double h_cur; // Previous successful step size
+		hermite_step<X> dense; // Interpolant for the last step
 		// Compute a trial step of size h, store the result in qq, and return the error
 		double trial_step(double h);
 };
 
 template <typename X>
 rk_45<X>::rk_45(ode_system<X>* sys, double err_tol, double h_max):
-	ode_solver<X>(sys),err_tol(err_tol),h_max(h_max),h_cur(h_max)
+	ode_solver<X>(sys),err_tol(err_tol),h_max(h_max),h_cur(h_max),dense(sys)
 {
 	for (int i = 0; i < 6; i++)
 		k[i] = new double[sys->numVars()];
@@ -93,6 +95,13 @@ void rk_45<X>::advance(double* q, double h)
 	while ((dt = integrate(q,h)) < h) h -= dt;
 }
 
+template <typename X>
+hermite_step<X>* rk_45<X>::denseOutput(const double* qstart, double h)
+{
+	if (dense.matches(qstart,h)) return &dense;
+	return NULL;
+}
+
 template <typename X>
 double rk_45<X>::integrate(double* q, double h_lim)
 {
@@ -115,6 +124,8 @@ double rk_45<X>::integrate(double* q, double h_lim)
 			else h = h_guess;
 		}
 	}
+	// Remember the step for the dense output
+	dense.set(q,k[0],qq,h);
 	// Copy the trial solution to q and return the step size that was selected
 	for (int i = 0; i < this->sys->numVars(); i++) q[i] = qq[i];
 	return h;
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_shm_transport_h_
+#define __adevs_shm_transport_h_
+#include "adevs_transport.h"
+#include "adevs_transport_link.h"
+#include "adevs_exception.h"
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace adevs
+{
+
+/**
+ * A Transport for processes on one host. The processes share a POSIX
+ * shared memory object with a ring buffer for each ordered pair of
+ * processes. Process 0 creates the object and every process must create
+ * a ShmTransport with the same name, which must begin with a '/' and
+ * be different for each run. The constructor returns when every process
+ * has attached to the object, and then the name is removed.
+ */
+class ShmTransport:
+	public Transport
+{
+	public:
+		/**
+		 * Attach to the shared memory of size processes as process rank.
+		 * Each ring holds ring_bytes bytes, rounded up to a power of two,
+		 * and a frame must fit in a ring. Throws an adevs::exception if
+		 * the other processes do not attach within timeout seconds.
+		 */
+		ShmTransport(const char* name, int rank, int size,
+			unsigned int ring_bytes = 1<<20, double timeout = 60.0):
+			rank(rank),size(size),base(NULL)
+		{
+			cap = 64;
+			while (cap < ring_bytes) cap *= 2;
+			bytes = sizeof(header)+size*size*(sizeof(ring)+cap);
+			int fd;
+			if (rank == 0)
+			{
+				shm_unlink(name);
+				fd = shm_open(name,O_CREAT|O_EXCL|O_RDWR,0600);
+				if (fd < 0 || ftruncate(fd,bytes) != 0)
+				{
+					exception err("Could not create the shared memory");
+					throw err;
+				}
+				map(fd);
+				new(base) header();
+				for (int i = 0; i < size*size; i++)
+					new(get_ring(i)) ring();
+				hdr()->ready.store(1,std::memory_order_release);
+			}
+			else
+			{
+				// Wait for process 0 to create and size the object
+				struct stat st;
+				double waited = 0.0;
+				while ((fd = shm_open(name,O_RDWR,0)) < 0 ||
+					fstat(fd,&st) != 0 || (size_t)st.st_size < bytes)
+				{
+					if (fd >= 0) close(fd);
+					waited += pause();
+					if (waited > timeout) timed_out();
+				}
+				map(fd);
+				while (hdr()->ready.load(std::memory_order_acquire) == 0)
+				{
+					waited += pause();
+					if (waited > timeout) timed_out();
+				}
+			}
+			hdr()->attached.fetch_add(1);
+			double waited = 0.0;
+			while (hdr()->attached.load() < size)
+			{
+				waited += pause();
+				if (waited > timeout) timed_out();
+			}
+			if (rank == 0) shm_unlink(name);
+		}
+		int getRank() const { return rank; }
+		int getSize() const { return size; }
+		bool send(int dst, const char* data, unsigned int n)
+		{
+			uint32_t len = n;
+			if (sizeof(len)+n > cap)
+			{
+				exception err("Frame is larger than the shared memory ring");
+				throw err;
+			}
+			ring* r = get_ring(rank*size+dst);
+			uint64_t tail = r->tail.load(std::memory_order_relaxed);
+			uint64_t head = r->head.load(std::memory_order_acquire);
+			if (cap-(tail-head) < sizeof(len)+n) return false;
+			char* d = data_of(r);
+			copy_in(d,tail,(const char*)&len,sizeof(len));
+			copy_in(d,tail+sizeof(len),data,n);
+			r->tail.store(tail+sizeof(len)+n,std::memory_order_release);
+			return true;
+		}
+		bool recv(int src, std::vector<char>& frame)
+		{
+			ring* r = get_ring(src*size+rank);
+			uint64_t head = r->head.load(std::memory_order_relaxed);
+			uint64_t tail = r->tail.load(std::memory_order_acquire);
+			if (tail == head) return false;
+			char* d = data_of(r);
+			uint32_t len;
+			copy_out(d,head,(char*)&len,sizeof(len));
+			frame.resize(len);
+			if (len > 0) copy_out(d,head+sizeof(len),&(frame[0]),len);
+			r->head.store(head+sizeof(len)+len,std::memory_order_release);
+			return true;
+		}
+		~ShmTransport()
+		{
+			if (base != NULL) munmap(base,bytes);
+		}
+	private:
+		struct header
+		{
+			header():ready(0),attached(0){}
+			std::atomic<int> ready;
+			std::atomic<int> attached;
+			char pad[56];
+		};
+		// Bytes are written at tail and read at head, which only grow
+		struct ring
+		{
+			ring():head(0),tail(0){}
+			alignas(64) std::atomic<uint64_t> head;
+			alignas(64) std::atomic<uint64_t> tail;
+		};
+		int rank, size;
+		size_t cap, bytes;
+		void* base;
+		header* hdr() { return static_cast<header*>(base); }
+		ring* get_ring(int i)
+		{
+			return reinterpret_cast<ring*>(
+				static_cast<char*>(base)+sizeof(header)+i*sizeof(ring));
+		}
+		char* data_of(ring* r)
+		{
+			int i = (int)(r-get_ring(0));
+			return static_cast<char*>(base)+sizeof(header)+
+				size*size*sizeof(ring)+i*cap;
+		}
+		void copy_in(char* d, uint64_t pos, const char* src, size_t n)
+		{
+			size_t at = pos&(cap-1), first = (n < cap-at) ? n : cap-at;
+			memcpy(d+at,src,first);
+			memcpy(d,src+first,n-first);
+		}
+		void copy_out(char* d, uint64_t pos, char* dst, size_t n)
+		{
+			size_t at = pos&(cap-1), first = (n < cap-at) ? n : cap-at;
+			memcpy(dst,d+at,first);
+			memcpy(dst+first,d,n-first);
+		}
+		void map(int fd)
+		{
+			base = mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+			close(fd);
+			if (base == MAP_FAILED)
+			{
+				base = NULL;
+				exception err("Could not map the shared memory");
+				throw err;
+			}
+		}
+		// Sleep for a millisecond and return the seconds slept
+		static double pause()
+		{
+			struct timespec ts = { 0, 1000000 };
+			nanosleep(&ts,NULL);
+			return 0.001;
+		}
+		static void timed_out()
+		{
+			exception err("Timed out waiting for the other processes");
+			throw err;
+		}
+};
+
+} // end of namespace
+
+#endif
@@ -33,6 +33,8 @@
 #include "adevs.h"
 #include <map>
 #include <set>
+#include <vector>
+#include <algorithm>
 #include <cstdlib>
 
 namespace adevs
@@ -52,7 +54,8 @@ public Network<VALUE,T>
 
 		/// Construct a network without components.
 		SimpleDigraph():
-		Network<VALUE,T>()
+		Network<VALUE,T>(),
+		frozen(false)
 		{
 		}
 		/// Add a model to the network.
@@ -61,9 +64,33 @@ public Network<VALUE,T>
 		void couple(Component* src, Component* dst);
 		/// Puts the network's set of components into c
 		void getComponents(Set<Component*>& c);
+		/// Visit the network's components without copying the set
+		void visitComponents(typename Network<VALUE,T>::ComponentVisitor* visitor);
+		/// Visit each pair of coupled models
+		bool visitCouplings(typename Network<VALUE,T>::CouplingVisitor* visitor);
 		/// Route an event according to the network's couplings
 		void route(const VALUE& x, Component* model, 
 		Bag<Event<VALUE,T> >& r);
+		/**
+		 * Give the value to the receivers in the table built by freeze().
+		 * Returns false, so that route() is used, if the network is not
+		 * frozen.
+		 */
+		bool scatter(const VALUE& x, Component* model,
+		typename Network<VALUE,T>::ComponentVisitor* visitor);
+		/**
+		 * Flatten the couplings into a table that scatter() searches in
+		 * place of the coupling graph. An input to a component
+		 * SimpleDigraph is followed down to the models that receive it,
+		 * and outputs that leave a network are still routed by its
+		 * parent. The components that are SimpleDigraphs are frozen too.
+		 * A call to add() or couple() on this network, or on a
+		 * SimpleDigraph inside of it, discards the table until freeze()
+		 * is called again.
+		 */
+		void freeze();
+		/// Returns true if scatter() uses the table built by freeze().
+		bool isFrozen() const { return frozen; }
 		/// Destructor.  Destroys all of the component models.
 		~SimpleDigraph();
 
@@ -72,12 +99,33 @@ public Network<VALUE,T>
 		Set<Component*> models;
 		// Coupling information
 		std::map<Component*,Bag<Component*> > graph;
+		// The receivers of src are table_dst[first] to table_dst[last-1]
+		struct frozen_src
+		{
+			Component* src;
+			unsigned first, last;
+		};
+		static bool src_less(const frozen_src& entry, Component* src)
+		{
+			return entry.src < src;
+		}
+		// Sources in address order, and their receivers
+		std::vector<frozen_src> table;
+		std::vector<Component*> table_dst;
+		bool frozen;
+		// Discard the table of this network and of the networks above it
+		void thaw();
+		// Append the receivers of an input from src to dst
+		void flatten_input(Component* src, std::vector<Component*>& dst);
+		// Is an input coupled directly to an output?
+		bool feeds_through();
 };
 
 template <class VALUE, class T>
 void SimpleDigraph<VALUE,T>::add(Component* model)
 {
 	assert(model != this);
+	thaw();
 	models.insert(model);
 	model->setParent(this);
 }
@@ -85,6 +133,7 @@ void SimpleDigraph<VALUE,T>::add(Component* model)
 template <class VALUE, class T>
 void SimpleDigraph<VALUE,T>::couple(Component* src, Component* dst) 
 {
+	thaw();
 	if (src != this) add(src);
 	if (dst != this) add(dst);
 	graph[src].insert(dst);
@@ -96,6 +145,34 @@ void SimpleDigraph<VALUE,T>::getComponents(Set<Component*>& c)
 	c = models;
 }
 
+template <class VALUE, class T>
+void SimpleDigraph<VALUE,T>::visitComponents(
+typename Network<VALUE,T>::ComponentVisitor* visitor)
+{
+	typename Set<Component*>::iterator i;
+	for (i = models.begin(); i != models.end(); i++)
+	{
+		visitor->visit(*i);
+	}
+}
+
+template <class VALUE, class T>
+bool SimpleDigraph<VALUE,T>::visitCouplings(
+typename Network<VALUE,T>::CouplingVisitor* visitor)
+{
+	typename std::map<Component*,Bag<Component*> >::iterator graph_iter;
+	for (graph_iter = graph.begin(); graph_iter != graph.end(); graph_iter++)
+	{
+		typename Bag<Component*>::iterator node_iter;
+		for (node_iter = (*graph_iter).second.begin();
+		node_iter != (*graph_iter).second.end(); node_iter++)
+		{
+			visitor->visit((*graph_iter).first,*node_iter);
+		}
+	}
+	return true;
+}
+
 template <class VALUE, class T>
 void SimpleDigraph<VALUE,T>::
 route(const VALUE& x, Component* model, 
@@ -118,6 +195,88 @@ Bag<Event<VALUE,T> >& r)
 	}
 }
 
+template <class VALUE, class T>
+bool SimpleDigraph<VALUE,T>::scatter(const VALUE& x, Component* model,
+typename Network<VALUE,T>::ComponentVisitor* visitor)
+{
+	if (!frozen) return false;
+	typename std::vector<frozen_src>::const_iterator iter =
+		std::lower_bound(table.begin(),table.end(),model,src_less);
+	if (iter == table.end() || (*iter).src != model) return true;
+	for (unsigned i = (*iter).first; i < (*iter).last; i++)
+		visitor->visit(table_dst[i]);
+	return true;
+}
+
+template <class VALUE, class T>
+void SimpleDigraph<VALUE,T>::freeze()
+{
+	typename Set<Component*>::iterator i;
+	for (i = models.begin(); i != models.end(); i++)
+	{
+		SimpleDigraph<VALUE,T>* sub = dynamic_cast<SimpleDigraph<VALUE,T>*>(*i);
+		if (sub != NULL) sub->freeze();
+	}
+	table.clear();
+	table_dst.clear();
+	// The map is sorted, so the table is too
+	typename std::map<Component*,Bag<Component*> >::iterator graph_iter;
+	for (graph_iter = graph.begin(); graph_iter != graph.end(); graph_iter++)
+	{
+		frozen_src entry;
+		entry.src = (*graph_iter).first;
+		entry.first = table_dst.size();
+		flatten_input(entry.src,table_dst);
+		entry.last = table_dst.size();
+		table.push_back(entry);
+	}
+	frozen = true;
+}
+
+template <class VALUE, class T>
+void SimpleDigraph<VALUE,T>::thaw()
+{
+	// The networks above a frozen one are frozen only if it is
+	if (!frozen) return;
+	frozen = false;
+	table.clear();
+	table_dst.clear();
+	SimpleDigraph<VALUE,T>* parent =
+		dynamic_cast<SimpleDigraph<VALUE,T>*>(this->getParent());
+	if (parent != NULL) parent->thaw();
+}
+
+template <class VALUE, class T>
+void SimpleDigraph<VALUE,T>::flatten_input(Component* src, std::vector<Component*>& dst)
+{
+	typename std::map<Component*,Bag<Component*> >::iterator graph_iter =
+		graph.find(src);
+	if (graph_iter == graph.end()) return;
+	// The receivers are listed in the order that route() would find them
+	typename Bag<Component*>::iterator node_iter;
+	for (node_iter = (*graph_iter).second.begin();
+	node_iter != (*graph_iter).second.end(); node_iter++)
+	{
+		SimpleDigraph<VALUE,T>* sub = NULL;
+		if (*node_iter != this)
+			sub = dynamic_cast<SimpleDigraph<VALUE,T>*>(*node_iter);
+		// An input that passes straight through to an output of the
+		// component must be routed by it to be seen as its output
+		if (sub != NULL && !sub->feeds_through())
+			sub->flatten_input(sub,dst);
+		else dst.push_back(*node_iter);
+	}
+}
+
+template <class VALUE, class T>
+bool SimpleDigraph<VALUE,T>::feeds_through()
+{
+	typename std::map<Component*,Bag<Component*> >::iterator graph_iter =
+		graph.find(this);
+	if (graph_iter == graph.end()) return false;
+	return (*graph_iter).second.count(this) > 0;
+}
+
 template <class VALUE, class T>
 SimpleDigraph<VALUE,T>::~SimpleDigraph()
 { 
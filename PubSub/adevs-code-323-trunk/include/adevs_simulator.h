@@ -35,6 +35,7 @@
 #include "adevs_event_listener.h"
 #include "adevs_sched.h"
 #include "adevs_bag.h"
+#include "adevs_arena.h"
 #include "adevs_set.h"
 #include "object_pool.h"
 #include "adevs_lp.h"
@@ -42,6 +43,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <vector>
+#include <exception>
 
 namespace adevs
 {
@@ -51,10 +53,13 @@ namespace adevs
  * Its methods throw adevs::exception objects if any of the DEVS model
  * constraints are violated (i.e., a negative time advance or a model
  * attempting to send an input directly to itself).
+ * The event schedule is the binary heap in Schedule unless another
+ * scheduler is given as the Sched argument: the Heap4Schedule, or the
+ * CalendarSchedule for large models with evenly spread event times.
  */
-template <class X, class T = double> class Simulator:
+template <class X, class T, class Sched> class Simulator:
 	public AbstractSimulator<X,T>,
-	private Schedule<X,T>::ImminentVisitor
+	private Sched::ImminentVisitor
 {
 	public:
 		/**
@@ -65,8 +70,12 @@ template <class X, class T = double> class Simulator:
 		 */
 		Simulator(Devs<X,T>* model):
 			AbstractSimulator<X,T>(),
-			Schedule<X,T>::ImminentVisitor(),
-			lps(NULL)
+			Sched::ImminentVisitor(),
+			lps(NULL),
+			use_arena(false),
+			events(0),
+			heap_arrays(0),
+			par_min(0)
 		{
 			schedule(model,adevs_zero<T>());
 		}
@@ -121,6 +130,63 @@ template <class X, class T = double> class Simulator:
 		{
 			schedule(model,adevs_zero<T>());
 		}
+		/**
+		 * <P>Compute the output and state transition functions of models
+		 * that change at the same time in parallel with the OpenMP
+		 * threads. This pays off when a step activates thousands of models,
+		 * as in a large CellSpace. The results are identical to a serial
+		 * run: the outputs are routed, and the EventListeners and
+		 * model_transition() methods are called, in the serial order once
+		 * every model has finished.</P>
+		 * <P>The output_func, delta_int, delta_ext, and delta_conf methods
+		 * must then change only their own model and the output bag they
+		 * are given. If any of them throws an exception, the exception
+		 * of the first model in the serial order is thrown when the other
+		 * models have finished. Without OpenMP the steps are computed
+		 * serially, and the option is ignored when the Simulator works
+		 * for a LogicalProcess.</P>
+		 * @param min_models Steps with fewer models are done serially.
+		 * Zero turns the parallel mode off, which is the default.
+		 */
+		void setParallel(unsigned int min_models = 1000)
+		{
+			par_min = min_models;
+		}
+		/**
+		 * <P>Take the input and output bags of the models, the bags of
+		 * receivers that are used to route each output, and the elements
+		 * that these bags hold, from an arena that is emptied at the end
+		 * of each computeNextState(). Otherwise, which is the default, the
+		 * bags are kept in pools by the simulator and their elements go
+		 * to the heap when they do not fit inside of the bag.</P>
+		 * <P>As with the pools, the bags given to output_func, delta_ext,
+		 * and delta_conf, and the values in them, must not be used by the
+		 * models after the step. Bags that are filled in parallel (see
+		 * setParallel()) keep their elements on the heap. This must not
+		 * be called between computeNextOutput() and computeNextState().</P>
+		 */
+		void setStepArena(bool on = true)
+		{
+			if (!activated.empty())
+			{
+				exception err("The step arena can not be changed during a step");
+				throw err;
+			}
+			use_arena = on;
+		}
+		/// Get the number of state transitions that have been computed.
+		unsigned long getEventCount() const { return events; }
+		/**
+		 * Get the number of times that the simulator took memory from
+		 * the heap for its bags and arena. Together with getEventCount()
+		 * this gives the allocations per event of the simulator itself.
+		 * Allocations by the models are not counted.
+		 */
+		unsigned long getAllocationCount() const
+		{
+			return io_pool.getCreated()+recv_pool.getCreated()+
+				arena.getBlockCount()+heap_arrays;
+		}
 		/**
 		 * Create a simulator that will be used by an LP as part of a parallel
 		 * simulation. This method is used by the parallel simulator.
@@ -168,66 +234,91 @@ template <class X, class T = double> class Simulator:
 		// Bogus input bag for execNextEvent() method
 		Bag<Event<X,T> > bogus_input;
 		// The event schedule
-		Schedule<X,T> sched;
+		Sched sched;
 		// List of models that are imminent or activated by input
 		Bag<Atomic<X,T>*> activated;
 		// Pools of preallocated, commonly used objects
 		object_pool<Bag<X> > io_pool;
 		object_pool<Bag<Event<X,T> > > recv_pool;
+		// Arena for the bags of a step when use_arena is true
+		bool use_arena;
+		StepArena arena;
+		// State transitions so far
+		unsigned long events;
+		// Arrays that the bags of the simulator took from the heap
+		std::atomic<unsigned long> heap_arrays;
+		/**
+		 * Get an input or output bag from the pool or the arena. The
+		 * elements of a bag that is filled by several threads must not
+		 * go into the arena.
+		 */
+		Bag<X>* make_io(bool elements_in_arena = true)
+		{
+			Bag<X>* b;
+			if (use_arena)
+				b = new(arena.allocate(sizeof(Bag<X>),alignof(Bag<X>)))
+					Bag<X>(Bag<X>::inline_capacity,
+						elements_in_arena ? &arena : NULL);
+			else b = io_pool.make_obj();
+			b->setHeapCounter(&heap_arrays);
+			return b;
+		}
+		/// Empty the bag and give it back.
+		void free_io(Bag<X>* b)
+		{
+			b->clear();
+			if (use_arena) b->~Bag<X>();
+			else io_pool.destroy_obj(b);
+		}
+		/// Get a bag for routing an output from the pool or the arena.
+		Bag<Event<X,T> >* make_recv()
+		{
+			typedef Bag<Event<X,T> > recv_bag;
+			if (use_arena)
+				return new(arena.allocate(sizeof(recv_bag),alignof(recv_bag)))
+					recv_bag(recv_bag::inline_capacity,&arena);
+			recv_bag* b = recv_pool.make_obj();
+			b->setHeapCounter(&heap_arrays);
+			return b;
+		}
+		/// Empty the bag and give it back.
+		void free_recv(Bag<Event<X,T> >* b)
+		{
+			typedef Bag<Event<X,T> > recv_bag;
+			b->clear();
+			if (use_arena) b->~recv_bag();
+			else recv_pool.destroy_obj(b);
+		}
+		// Smallest step done in parallel, or zero for serial steps only
+		unsigned int par_min;
+		// Models and their output bags for a parallel step
+		std::vector<Atomic<X,T>*> par_models;
+		std::vector<Bag<X>*> par_outputs;
 		// Sets for computing structure changes.
 		Bag<Devs<X,T>*> added;
 		Bag<Devs<X,T>*> removed;
 		Set<Devs<X,T>*> next;
 		Set<Devs<X,T>*> prev;
+		Set<Devs<X,T>*> before;
 		// Model transition functions are evaluated from the bottom up!
 		struct bottom_to_top_depth_compare
 		{
 			bool operator()(const Network<X,T>* m1, const Network<X,T>* m2) const
 			{
-				unsigned long int d1 = 0, d2 = 0;
-				// Compute depth of m1
-				const Network<X,T>* m = m1->getParent();
-				while (m != NULL) 
-				{
-					d1++;
-					m = m->getParent();
-				}
-				// Compute depth of m2
-				m = m2->getParent();
-				while (m != NULL)
-				{
-					d2++;
-					m = m->getParent();
-				}
 				// Models at the same depth are sorted by name
-				if (d1 == d2) return m1 < m2;
+				if (m1->getLevel() == m2->getLevel()) return m1 < m2;
 				// Otherwise, sort by depth
-				return d1 > d2;
+				return m1->getLevel() > m2->getLevel();
 			}
 		};
 		struct top_to_bottom_depth_compare
 		{
 			bool operator()(const Devs<X,T>* m1, const Devs<X,T>* m2) const
 			{
-				unsigned long int d1 = 0, d2 = 0;
-				// Compute depth of m1
-				const Network<X,T>* m = m1->getParent();
-				while (m != NULL) 
-				{
-					d1++;
-					m = m->getParent();
-				}
-				// Compute depth of m2
-				m = m2->getParent();
-				while (m != NULL)
-				{
-					d2++;
-					m = m->getParent();
-				}
 				// Models at the same depth are sorted by name
-				if (d1 == d2) return m1 < m2;
+				if (m1->getLevel() == m2->getLevel()) return m1 < m2;
 				// Otherwise, sort by depth
-				return d1 < d2;
+				return m1->getLevel() < m2->getLevel();
 			}
 		};
 		std::set<Network<X,T>*,bottom_to_top_depth_compare> model_func_eval_set;
@@ -239,6 +330,8 @@ template <class X, class T = double> class Simulator:
 		void schedule(Devs<X,T>* model, T t);
 		/// Route an event generated by the source model contained in the parent model.
 		void route(Network<X,T>* parent, Devs<X,T>* src, X& x);
+		/// Deliver an event that the parent model routed to the target.
+		void deliver(Network<X,T>* parent, Devs<X,T>* src, Devs<X,T>* target, X& x);
 		/**	
 		 * Add an input to the input bag of an an atomic model. If the 
 		 * model is not already active , then this method adds the model to
@@ -263,10 +356,23 @@ template <class X, class T = double> class Simulator:
 		 * and removed sets. 
 		 */
 		void exec_event(Atomic<X,T>* model, T t);
+		/// Apply the state transition function of the model at time t.
+		void exec_delta(Atomic<X,T>* model, T t);
+		/// Notify listeners and check for a model transition after exec_delta().
+		void end_event(Atomic<X,T>* model, T t);
+		/// Compute the outputs of the imminent models in parallel
+		void par_output();
+		/// Compute the transitions of the activated models in parallel
+		void par_state(T t);
 		/**
 		 * Construct the complete descendant set of a network model and store it in s.
 		 */
 		void getAllChildren(Network<X,T>* model, Set<Devs<X,T>*>& s);
+		/**
+		 * Move the contents of the network's change log to the
+		 * added and removed bags.
+		 */
+		void read_change_log(Network<X,T>* model);
 		/**
 		 * Update data structures needed for a reset of the simulator
 		 * following a speculative lookahead. Returns true if the
@@ -277,13 +383,69 @@ template <class X, class T = double> class Simulator:
 		 * Visit method inhereted from ImminentVisitor
 		 */
 		void visit(Atomic<X,T>* model);
+		/**
+		 * Applies schedule(), unschedule_model(), or clean_up() to
+		 * each component of a network.
+		 */
+		class component_visitor:
+			public Network<X,T>::ComponentVisitor
+		{
+			public:
+				typedef enum { SCHEDULE, UNSCHEDULE, CLEAN_UP } action_t;
+				component_visitor(Simulator<X,T,Sched>* sim, action_t action,
+					T t = adevs_zero<T>()):
+					sim(sim),action(action),t(t){}
+				void visit(Devs<X,T>* model)
+				{
+					if (action == SCHEDULE) sim->schedule(model,t);
+					else if (action == UNSCHEDULE) sim->unschedule_model(model);
+					else sim->clean_up(model);
+				}
+			private:
+				Simulator<X,T,Sched>* sim;
+				action_t action;
+				T t;
+		};
+		/**
+		 * Delivers an event to the receivers found by Network::scatter().
+		 */
+		class scatter_visitor:
+			public Network<X,T>::ComponentVisitor
+		{
+			public:
+				scatter_visitor(Simulator<X,T,Sched>* sim, Network<X,T>* parent,
+					Devs<X,T>* src, X& x):
+					sim(sim),parent(parent),src(src),x(x){}
+				void visit(Devs<X,T>* target)
+				{
+					sim->deliver(parent,src,target,x);
+				}
+			private:
+				Simulator<X,T,Sched>* sim;
+				Network<X,T>* parent;
+				Devs<X,T>* src;
+				X& x;
+		};
+		/**
+		 * Lists the imminent models for a parallel step.
+		 */
+		class imminent_collector:
+			public Sched::ImminentVisitor
+		{
+			public:
+				imminent_collector(std::vector<Atomic<X,T>*>& models):
+					models(models){}
+				void visit(Atomic<X,T>* model) { models.push_back(model); }
+			private:
+				std::vector<Atomic<X,T>*>& models;
+		};
 };
 
-template <class X, class T>
-void Simulator<X,T>::visit(Atomic<X,T>* model)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::visit(Atomic<X,T>* model)
 {
 	assert(model->y == NULL);
-	model->y = io_pool.make_obj();
+	model->y = make_io();
 	// Put it in the active list if it is not already there
 	if (model->x == NULL)
 		activated.insert(model);
@@ -298,17 +460,20 @@ void Simulator<X,T>::visit(Atomic<X,T>* model)
 	}
 }
 
-template <class X, class T>
-void Simulator<X,T>::computeNextOutput()
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::computeNextOutput()
 {
 	// If the imminent set is up to date, then just return
 	if (activated.empty() == false) return;
 	// Get the imminent models from the schedule. 
-	sched.visitImminent(this);
+	if (par_min == 0 || lps != NULL)
+		sched.visitImminent(this);
+	else
+		par_output();
 }
 
-template <class X, class T>
-void Simulator<X,T>::computeNextState(Bag<Event<X,T> >& input, T t)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::computeNextState(Bag<Event<X,T> >& input, T t)
 {
 	// Clean up if there was a previous IO calculation
 	if (t < sched.minPriority())
@@ -345,16 +510,22 @@ void Simulator<X,T>::computeNextState(Bag<Event<X,T> >& input, T t)
 	 * special container that will be used when the structure changes are
 	 * computed (see exec_event(.)).
 	 */
-	for (typename Bag<Atomic<X,T>*>::iterator iter = activated.begin(); 
-		iter != activated.end(); iter++)
+	if (par_min != 0 && lps == NULL && activated.size() >= par_min)
+		par_state(t);
+	else
 	{
-		exec_event(*iter,t); 
+		for (typename Bag<Atomic<X,T>*>::iterator iter = activated.begin(); 
+			iter != activated.end(); iter++)
+		{
+			exec_event(*iter,t); 
+		}
 	}
 	/**
 	 * Compute model transitions and build up the prev (pre-transition)
 	 * and next (post-transition) component sets. These sets are built
 	 * up from only the models that have the model_transition function
-	 * evaluated.
+	 * evaluated and that do not keep a change log. The changes to a
+	 * network with a change log are read from its log.
 	 */
 	if (model_func_eval_set.empty() == false)
 	{
@@ -362,13 +533,28 @@ void Simulator<X,T>::computeNextState(Bag<Event<X,T> >& input, T t)
 		{
 			Network<X,T>* network_model = *(model_func_eval_set.begin());
 			model_func_eval_set.erase(model_func_eval_set.begin());
-			getAllChildren(network_model,prev);
+			bool logged = network_model->hasChangeLog();
+			if (!logged)
+			{
+				/**
+				 * The components already found after an earlier transition
+				 * are not in the pre-transition set. Otherwise a model added
+				 * below this network would be in both sets and would not be
+				 * scheduled.
+				 */
+				getAllChildren(network_model,before);
+				typename Set<Devs<X,T>*>::iterator iter = before.begin();
+				for (; iter != before.end(); iter++)
+					if (next.find(*iter) == next.end()) prev.insert(*iter);
+				before.clear();
+			}
 			if (network_model->model_transition() &&
 					network_model->getParent() != NULL)
 			{
 				model_func_eval_set.insert(network_model->getParent());
 			}
-			getAllChildren(network_model,next);
+			if (!logged) getAllChildren(network_model,next);
+			else read_change_log(network_model);
 		}
 		// Find the set of models that were added.
 		set_assign_diff(added,next,prev);
@@ -438,6 +624,8 @@ void Simulator<X,T>::computeNextState(Bag<Event<X,T> >& input, T t)
 	}
 	// Empty the bags
 	activated.clear();
+	// Every bag of the step has been given back
+	if (use_arena) arena.reset();
 	// If we are looking ahead, throw an exception if a stop was forced
 	if (lps != NULL && lps->stop_forced)
 	{
@@ -446,40 +634,33 @@ void Simulator<X,T>::computeNextState(Bag<Event<X,T> >& input, T t)
 	}
 }
 
-template <class X, class T>
-void Simulator<X,T>::clean_up(Devs<X,T>* model)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::clean_up(Devs<X,T>* model)
 {
 	Atomic<X,T>* amodel = model->typeIsAtomic();
 	if (amodel != NULL)
 	{
 		if (amodel->x != NULL)
 		{
-			amodel->x->clear();
-			io_pool.destroy_obj(amodel->x);
+			free_io(amodel->x);
 			amodel->x = NULL;
 		}
 		if (amodel->y != NULL)
 		{
 			amodel->gc_output(*(amodel->y));
-			amodel->y->clear();
-			io_pool.destroy_obj(amodel->y);
+			free_io(amodel->y);
 			amodel->y = NULL;
 		}
 	}
 	else
 	{
-		Set<Devs<X,T>*> components;
-		model->typeIsNetwork()->getComponents(components);
-		for (typename Set<Devs<X,T>*>::iterator iter = components.begin();
-		iter != components.end(); iter++)
-		{
-			clean_up(*iter);
-		}
+		component_visitor visitor(this,component_visitor::CLEAN_UP);
+		model->typeIsNetwork()->visitComponents(&visitor);
 	}
 }
 
-template <class X, class T>
-void Simulator<X,T>::unschedule_model(Devs<X,T>* model)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::unschedule_model(Devs<X,T>* model)
 {
 	if (model->typeIsAtomic() != NULL)
 	{
@@ -488,18 +669,13 @@ void Simulator<X,T>::unschedule_model(Devs<X,T>* model)
 	}
 	else
 	{
-		Set<Devs<X,T>*> components;
-		model->typeIsNetwork()->getComponents(components);
-		for (typename Set<Devs<X,T>*>::iterator iter = components.begin();
-		iter != components.end(); iter++)
-		{
-			unschedule_model(*iter);
-		}
+		component_visitor visitor(this,component_visitor::UNSCHEDULE);
+		model->typeIsNetwork()->visitComponents(&visitor);
 	}
 }
 
-template <class X, class T>
-void Simulator<X,T>::schedule(Devs<X,T>* model, T t)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::schedule(Devs<X,T>* model, T t)
 {
 	Atomic<X,T>* a = model->typeIsAtomic();
 	if (a != NULL)
@@ -518,84 +694,96 @@ void Simulator<X,T>::schedule(Devs<X,T>* model, T t)
 	}
 	else
 	{
-		Set<Devs<X,T>*> components;
-		model->typeIsNetwork()->getComponents(components);
-		typename Set<Devs<X,T>*>::iterator iter = components.begin();
-		for (; iter != components.end(); iter++)
-		{
-			schedule(*iter,t);
-		}
+		// The whole network is scheduled, so its log has nothing new
+		model->typeIsNetwork()->added_log.clear();
+		model->typeIsNetwork()->removed_log.clear();
+		component_visitor visitor(this,component_visitor::SCHEDULE,t);
+		model->typeIsNetwork()->visitComponents(&visitor);
 	}
 }
 
-template <class X, class T>
-void Simulator<X,T>::inject_event(Atomic<X,T>* model, X& value)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::inject_event(Atomic<X,T>* model, X& value)
 {
 	if (model->x == NULL)
 	{
 		if (model->y == NULL)
 			activated.insert(model);
-		model->x = io_pool.make_obj();
+		model->x = make_io();
 	}
 	model->x->insert(value);
 }
 
-template <class X, class T>
-void Simulator<X,T>::route(Network<X,T>* parent, Devs<X,T>* src, X& x)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::route(Network<X,T>* parent, Devs<X,T>* src, X& x)
 {
 	// Notify event listeners if this is an output event
 	if (parent != src && (lps == NULL || lps->out_flag != RESTORING_OUTPUT))
 		this->notify_output_listeners(src,x,sched.minPriority());
 	// No one to do the routing, so return
 	if (parent == NULL) return;
+	// Give the event directly to its receivers if the parent can
+	scatter_visitor scatter(this,parent,src,x);
+	if (parent->scatter(x,src,&scatter)) return;
 	// Compute the set of receivers for this value
-	Bag<Event<X,T> >* recvs = recv_pool.make_obj();
+	Bag<Event<X,T> >* recvs = make_recv();
 	parent->route(x,src,*recvs);
 	// Deliver the event to each of its targets
-	Atomic<X,T>* amodel = NULL;
 	typename Bag<Event<X,T> >::iterator recv_iter = recvs->begin();
 	for (; recv_iter != recvs->end(); recv_iter++)
 	{
-		// Check for self-influencing error condition
-		if (src == (*recv_iter).model)
-		{
-			exception err("Model tried to influence self",src);
-			throw err;
-		}
-		/**
-		 * If the destination is an atomic model, add the event to the IO bag
-		 * for that model and add model to the list of activated models
-		 */
-		amodel = (*recv_iter).model->typeIsAtomic();
-		if (amodel != NULL)
-		{
-			// Inject it only if it is assigned to our processor
-			if (lps == NULL || amodel->getProc() == lps->lp->getID())
-				inject_event(amodel,(*recv_iter).value);
-			// Otherwise tell the lp about it
-			else if (lps->out_flag != RESTORING_OUTPUT)
-				lps->lp->notifyInput(amodel,(*recv_iter).value);
-		}
-		// if this is an external output from the parent model
-		else if ((*recv_iter).model == parent)
-		{
-			route(parent->getParent(),parent,(*recv_iter).value);
-		}
-		// otherwise it is an input to a coupled model
-		else
-		{
-			route((*recv_iter).model->typeIsNetwork(),
-			(*recv_iter).model,(*recv_iter).value);
-		}
+		deliver(parent,src,(*recv_iter).model,(*recv_iter).value);
+	}
+	free_recv(recvs);
+}
+
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::deliver(Network<X,T>* parent, Devs<X,T>* src,
+	Devs<X,T>* target, X& x)
+{
+	// Check for self-influencing error condition
+	if (src == target)
+	{
+		exception err("Model tried to influence self",src);
+		throw err;
+	}
+	/**
+	 * If the destination is an atomic model, add the event to the IO bag
+	 * for that model and add model to the list of activated models
+	 */
+	Atomic<X,T>* amodel = target->typeIsAtomic();
+	if (amodel != NULL)
+	{
+		// Inject it only if it is assigned to our processor
+		if (lps == NULL || amodel->getProc() == lps->lp->getID())
+			inject_event(amodel,x);
+		// Otherwise tell the lp about it
+		else if (lps->out_flag != RESTORING_OUTPUT)
+			lps->lp->notifyInput(amodel,x);
+	}
+	// if this is an external output from the parent model
+	else if (target == parent)
+	{
+		route(parent->getParent(),parent,x);
+	}
+	// otherwise it is an input to a coupled model
+	else
+	{
+		route(target->typeIsNetwork(),target,x);
 	}
-	recvs->clear();
-	recv_pool.destroy_obj(recvs);
 }
 
-template <class X, class T>
-void Simulator<X,T>::exec_event(Atomic<X,T>* model, T t)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::exec_event(Atomic<X,T>* model, T t)
 {
 	if (!manage_lookahead_data(model)) return;
+	exec_delta(model,t);
+	end_event(model,t);
+}
+
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::exec_delta(Atomic<X,T>* model, T t)
+{
 	// Internal event
 	if (model->x == NULL)
 		model->delta_int();
@@ -605,6 +793,12 @@ void Simulator<X,T>::exec_event(Atomic<X,T>* model, T t)
 	// External event
 	else
 		model->delta_ext(t-model->tL,*(model->x));
+}
+
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::end_event(Atomic<X,T>* model, T t)
+{
+	events++;
 	// Notify any listeners
 	this->notify_state_listeners(model,t);
 	// Check for a model transition
@@ -614,8 +808,114 @@ void Simulator<X,T>::exec_event(Atomic<X,T>* model, T t)
 	}
 }
 
-template <class X, class T>
-void Simulator<X,T>::getAllChildren(Network<X,T>* model, Set<Devs<X,T>*>& s)
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::par_output()
+{
+	imminent_collector collector(par_models);
+	sched.visitImminent(&collector);
+	long int n = (long int)par_models.size();
+	if (n < (long int)par_min)
+	{
+		for (long int i = 0; i < n; i++)
+			visit(par_models[i]);
+		par_models.clear();
+		return;
+	}
+	// The pool and arena are not thread safe, so take the bags first
+	for (long int i = 0; i < n; i++)
+		par_outputs.push_back(make_io(false));
+	std::exception_ptr err;
+	long int err_at = n;
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+	#endif
+	for (long int i = 0; i < n; i++)
+	{
+		try
+		{
+			par_models[i]->output_func(*(par_outputs[i]));
+		}
+		catch(...)
+		{
+			#ifdef _OPENMP
+			#pragma omp critical(adevs_simulator_error)
+			#endif
+			if (i < err_at)
+			{
+				err_at = i;
+				err = std::current_exception();
+			}
+		}
+	}
+	// Route the outputs in the order of a serial step. The bags become the
+	// models' output bags here, as they would in visit().
+	for (long int i = 0; i < n; i++)
+	{
+		Atomic<X,T>* model = par_models[i];
+		// A serial step would have stopped at the exception
+		if (i > err_at)
+		{
+			model->gc_output(*(par_outputs[i]));
+			free_io(par_outputs[i]);
+			continue;
+		}
+		assert(model->y == NULL);
+		model->y = par_outputs[i];
+		if (model->x == NULL)
+			activated.insert(model);
+		if (i == err_at) continue;
+		for (typename Bag<X>::iterator y_iter = model->y->begin(); 
+			y_iter != model->y->end(); y_iter++)
+		{
+			route(model->getParent(),model,*y_iter);
+		}
+	}
+	par_models.clear();
+	par_outputs.clear();
+	if (err) std::rethrow_exception(err);
+}
+
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::par_state(T t)
+{
+	for (typename Bag<Atomic<X,T>*>::iterator iter = activated.begin(); 
+		iter != activated.end(); iter++)
+	{
+		par_models.push_back(*iter);
+	}
+	long int n = (long int)par_models.size();
+	std::exception_ptr err;
+	long int err_at = n;
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+	#endif
+	for (long int i = 0; i < n; i++)
+	{
+		try
+		{
+			exec_delta(par_models[i],t);
+		}
+		catch(...)
+		{
+			#ifdef _OPENMP
+			#pragma omp critical(adevs_simulator_error)
+			#endif
+			if (i < err_at)
+			{
+				err_at = i;
+				err = std::current_exception();
+			}
+		}
+	}
+	// Listeners and model transitions see the models in the serial order
+	for (long int i = 0; i < n && i < err_at; i++)
+		end_event(par_models[i],t);
+	par_models.clear();
+	if (err) std::rethrow_exception(err);
+}
+
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::getAllChildren(Network<X,T>* model, Set<Devs<X,T>*>& s)
 {
 	Set<Devs<X,T>*> tmp;
 	// Get the component set
@@ -633,8 +933,20 @@ void Simulator<X,T>::getAllChildren(Network<X,T>* model, Set<Devs<X,T>*>& s)
 	}
 }
 
-template <class X, class T>
-Simulator<X,T>::~Simulator()
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::read_change_log(Network<X,T>* model)
+{
+	typename Bag<Devs<X,T>*>::iterator iter;
+	for (iter = model->added_log.begin(); iter != model->added_log.end(); iter++)
+		added.insert(*iter);
+	for (iter = model->removed_log.begin(); iter != model->removed_log.end(); iter++)
+		removed.insert(*iter);
+	model->added_log.clear();
+	model->removed_log.clear();
+}
+
+template <class X, class T, class Sched>
+Simulator<X,T,Sched>::~Simulator()
 {
 	// Clean up the models with stale IO
 	typename Bag<Atomic<X,T>*>::iterator iter;
@@ -644,10 +956,14 @@ Simulator<X,T>::~Simulator()
 	}
 }
 
-template <class X, class T>
-Simulator<X,T>::Simulator(LogicalProcess<X,T>* lp):
+template <class X, class T, class Sched>
+Simulator<X,T,Sched>::Simulator(LogicalProcess<X,T>* lp):
 	AbstractSimulator<X,T>()
 {
+	par_min = 0;
+	use_arena = false;
+	events = 0;
+	heap_arrays = 0;
 	lps = new lp_support;
 	lps->lp = lp;
 	lps->look_ahead = false;
@@ -655,8 +971,8 @@ Simulator<X,T>::Simulator(LogicalProcess<X,T>* lp):
 	lps->out_flag = OUTPUT_OK;
 }
 
-template <class X, class T>
-void Simulator<X,T>::beginLookahead()
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::beginLookahead()
 {
 	if (lps == NULL)
 	{
@@ -668,14 +984,14 @@ void Simulator<X,T>::beginLookahead()
 		lps->out_flag = OUTPUT_NOT_OK; 
 }
 
-template <class X, class T>
-void Simulator<X,T>::lookNextEvent()
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::lookNextEvent()
 {
 	execNextEvent();
 }
 
-template <class X, class T>
-void Simulator<X,T>::endLookahead()
+template <class X, class T, class Sched>
+void Simulator<X,T,Sched>::endLookahead()
 {
 	if (lps == NULL) return;
 	typename Bag<Atomic<X,T>*>::iterator iter = lps->to_restore.begin();
@@ -699,8 +1015,8 @@ void Simulator<X,T>::endLookahead()
 	lps->stop_forced = false;
 }
 
-template <class X, class T>
-bool Simulator<X,T>::manage_lookahead_data(Atomic<X,T>* model)
+template <class X, class T, class Sched>
+bool Simulator<X,T,Sched>::manage_lookahead_data(Atomic<X,T>* model)
 {
 	if (lps == NULL) return true;
 	if (lps->look_ahead && model->tL_cp < adevs_zero<T>())
@@ -0,0 +1,308 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_socket_transport_h_
+#define __adevs_socket_transport_h_
+#include "adevs_transport.h"
+#include "adevs_transport_link.h"
+#include "adevs_exception.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace adevs
+{
+
+/**
+ * A Transport that connects every pair of processes with a TCP socket.
+ * The address of each process is given as "host:port", and every process
+ * must be given the same list. A process listens on the port in its own
+ * address, connects to the processes with smaller numbers, and accepts
+ * connections from those with larger numbers. Frames that the socket can
+ * not take at once are kept by the sender until a later call to send() or
+ * recv(), so send() always succeeds. The processes must have the same byte
+ * order and the same sizes of the basic types. An adevs::exception is
+ * thrown if a connection fails, or if recv() is called for a process
+ * that has closed its connection and whose frames have all been read.
+ */
+class SocketTransport:
+	public Transport
+{
+	public:
+		/**
+		 * Connect to the other processes. Throws an adevs::exception if
+		 * a connection can not be made within timeout seconds.
+		 */
+		SocketTransport(int rank, const std::vector<std::string>& addresses,
+			double timeout = 60.0):
+			rank(rank),size((int)addresses.size()),
+			fd(addresses.size(),-1),out(addresses.size()),
+			in(addresses.size()),out_pos(addresses.size(),0),
+			in_pos(addresses.size(),0),closed(addresses.size(),false)
+		{
+			std::string host;
+			int listener = socket(AF_INET,SOCK_STREAM,0);
+			int on = 1;
+			setsockopt(listener,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+			struct sockaddr_in addr;
+			memset(&addr,0,sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_ANY);
+			addr.sin_port = htons(get_port(addresses[rank],host));
+			if (bind(listener,(struct sockaddr*)&addr,sizeof(addr)) != 0 ||
+				listen(listener,size) != 0)
+			{
+				close(listener);
+				fail("Could not listen for the other processes");
+			}
+			// Connect to the processes before this one and say who we are
+			for (int i = 0; i < rank; i++)
+			{
+				fd[i] = connect_to(addresses[i],timeout);
+				int32_t me = rank;
+				write_all(fd[i],(const char*)&me,sizeof(me));
+			}
+			// Accept the processes after this one
+			for (int i = rank+1; i < size; i++)
+			{
+				int s = accept(listener,NULL,NULL);
+				int32_t who = -1;
+				if (s < 0 || !read_all(s,(char*)&who,sizeof(who)) ||
+					who <= rank || who >= size || fd[who] >= 0)
+				{
+					if (s >= 0) close(s);
+					close(listener);
+					fail("Bad connection from another process");
+				}
+				fd[who] = s;
+			}
+			close(listener);
+			for (int i = 0; i < size; i++)
+			{
+				if (i == rank) continue;
+				setsockopt(fd[i],IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+				fcntl(fd[i],F_SETFL,fcntl(fd[i],F_GETFL)|O_NONBLOCK);
+			}
+		}
+		int getRank() const { return rank; }
+		int getSize() const { return size; }
+		bool send(int dst, const char* data, unsigned int n)
+		{
+			uint32_t len = n;
+			out[dst].insert(out[dst].end(),(const char*)&len,(const char*)&len+sizeof(len));
+			out[dst].insert(out[dst].end(),data,data+n);
+			flush(dst);
+			return true;
+		}
+		bool recv(int src, std::vector<char>& frame)
+		{
+			// Keep the data moving to every process
+			for (int i = 0; i < size; i++)
+			{
+				if (!out[i].empty()) flush(i);
+			}
+			if (!frame_ready(src))
+			{
+				fill(src);
+				if (!frame_ready(src))
+				{
+					if (closed[src]) fail("Another process closed its connection");
+					return false;
+				}
+			}
+			std::vector<char>& b = in[src];
+			uint32_t len;
+			memcpy(&len,&(b[in_pos[src]]),sizeof(len));
+			frame.assign(b.begin()+in_pos[src]+sizeof(len),
+				b.begin()+in_pos[src]+sizeof(len)+len);
+			in_pos[src] += sizeof(len)+len;
+			return true;
+		}
+		/// Sends any data that is waiting and closes the connections.
+		~SocketTransport()
+		{
+			for (int i = 0; i < size; i++)
+			{
+				if (fd[i] < 0) continue;
+				fcntl(fd[i],F_SETFL,fcntl(fd[i],F_GETFL)&~O_NONBLOCK);
+				if (!out[i].empty())
+					write_all(fd[i],&(out[i][out_pos[i]]),out[i].size()-out_pos[i]);
+				close(fd[i]);
+			}
+		}
+	private:
+		int rank, size;
+		std::vector<int> fd;
+		// Bytes waiting to be sent and bytes received from each process
+		std::vector<std::vector<char> > out, in;
+		// Start of the unsent bytes in each output buffer and of the
+		// next frame in each input buffer
+		std::vector<size_t> out_pos, in_pos;
+		// True if the process closed its connection
+		std::vector<bool> closed;
+		static void fail(const char* msg)
+		{
+			exception err(msg);
+			throw err;
+		}
+		static int get_port(const std::string& address, std::string& host)
+		{
+			size_t colon = address.rfind(':');
+			if (colon == std::string::npos) fail("An address must be host:port");
+			host = address.substr(0,colon);
+			return atoi(address.c_str()+colon+1);
+		}
+		static int connect_to(const std::string& address, double timeout)
+		{
+			std::string host;
+			std::string port = address.substr(address.rfind(':')+1);
+			get_port(address,host);
+			struct addrinfo hints, *res;
+			memset(&hints,0,sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+			if (getaddrinfo(host.c_str(),port.c_str(),&hints,&res) != 0)
+				fail("Could not find the host of another process");
+			// The other process may not be listening yet
+			for (double waited = 0.0; waited < timeout; waited += 0.01)
+			{
+				int s = socket(AF_INET,SOCK_STREAM,0);
+				if (connect(s,res->ai_addr,res->ai_addrlen) == 0)
+				{
+					freeaddrinfo(res);
+					return s;
+				}
+				close(s);
+				struct timespec ts = { 0, 10000000 };
+				nanosleep(&ts,NULL);
+			}
+			freeaddrinfo(res);
+			fail("Timed out connecting to another process");
+			return -1;
+		}
+		static void write_all(int s, const char* data, size_t n)
+		{
+			while (n > 0)
+			{
+				ssize_t w = ::send(s,data,n,MSG_NOSIGNAL);
+				if (w < 0 && errno == EINTR) continue;
+				if (w <= 0) return;
+				data += w;
+				n -= w;
+			}
+		}
+		static bool read_all(int s, char* data, size_t n)
+		{
+			while (n > 0)
+			{
+				ssize_t r = read(s,data,n);
+				if (r < 0 && errno == EINTR) continue;
+				if (r <= 0) return false;
+				data += r;
+				n -= r;
+			}
+			return true;
+		}
+		void flush(int dst)
+		{
+			std::vector<char>& b = out[dst];
+			while (out_pos[dst] < b.size())
+			{
+				ssize_t w = ::send(fd[dst],&(b[out_pos[dst]]),b.size()-out_pos[dst],MSG_NOSIGNAL);
+				if (w < 0)
+				{
+					if (errno == EINTR) continue;
+					if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+					fail("Lost the connection to another process");
+				}
+				out_pos[dst] += w;
+			}
+			// Drop the sent bytes when they are all sent or are most of
+			// the buffer, so that each byte is moved at most once more
+			if (out_pos[dst] == b.size()) b.clear();
+			else if (out_pos[dst] > b.size()/2) b.erase(b.begin(),b.begin()+out_pos[dst]);
+			else return;
+			out_pos[dst] = 0;
+		}
+		void fill(int src)
+		{
+			std::vector<char>& b = in[src];
+			// Drop the frames that were read
+			if (in_pos[src] > 0)
+			{
+				b.erase(b.begin(),b.begin()+in_pos[src]);
+				in_pos[src] = 0;
+			}
+			char chunk[65536];
+			for (;;)
+			{
+				ssize_t r = read(fd[src],chunk,sizeof(chunk));
+				if (r > 0)
+				{
+					b.insert(b.end(),chunk,chunk+r);
+					continue;
+				}
+				// The process is done. The frames that it sent are still
+				// read, and recv() fails when they are gone.
+				if (r == 0)
+				{
+					closed[src] = true;
+					return;
+				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+				if (errno == EINTR) continue;
+				fail("Lost the connection to another process");
+			}
+		}
+		bool frame_ready(int src)
+		{
+			std::vector<char>& b = in[src];
+			size_t avail = b.size()-in_pos[src];
+			if (avail < sizeof(uint32_t)) return false;
+			uint32_t len;
+			memcpy(&len,&(b[in_pos[src]]),sizeof(len));
+			return avail >= sizeof(len)+len;
+		}
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_transport_h_
+#define __adevs_transport_h_
+#include <vector>
+
+namespace adevs
+{
+
+/**
+ * A Transport moves frames of bytes between the processes of a
+ * ParSimulator that runs in more than one process. The processes are
+ * numbered from 0 to getSize()-1. Frames from one process to another
+ * must arrive in the order that they were sent. See the ShmTransport for
+ * processes on one host and the SocketTransport for processes on
+ * different hosts.
+ */
+class Transport
+{
+	public:
+		/// Get the number of this process.
+		virtual int getRank() const = 0;
+		/// Get the number of processes.
+		virtual int getSize() const = 0;
+		/**
+		 * Send a frame of size bytes to the process dst. Returns false,
+		 * without sending anything, if the frame can not be sent now. The
+		 * caller must then receive frames before it tries again, because
+		 * the receiver may be waiting to send to the caller.
+		 */
+		virtual bool send(int dst, const char* data, unsigned int size) = 0;
+		/**
+		 * Put the next frame from the process src into frame. Returns
+		 * false if there is no frame waiting.
+		 */
+		virtual bool recv(int src, std::vector<char>& frame) = 0;
+		virtual ~Transport(){}
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2013, James Nutaro
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of the FreeBSD Project.
+ *
+ * Bugs, comments, and questions can be sent to nutaro@gmail.com
+ */
+#ifndef __adevs_transport_link_h_
+#define __adevs_transport_link_h_
+#include "adevs_par_simulator.h"
+#include "adevs_lp_link.h"
+#include "adevs_transport.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Include this file, or the file of a Transport, to run a ParSimulator
+ * in several processes. It holds the LpLink that uses a Transport and
+ * the constructor of the ParSimulator that takes a Transport.
+ */
+
+/**
+ * Append the bytes of a time value to buf. The default is for a trivially
+ * copyable type. Specialize this and adevs_read_time() for other types.
+ */
+template <class T> inline void adevs_write_time(const T& t, std::vector<char>& buf)
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+		"Specialize adevs_write_time and adevs_read_time for this time type");
+	const char* p = reinterpret_cast<const char*>(&t);
+	buf.insert(buf.end(),p,p+sizeof(T));
+}
+
+/// Read a time value written by adevs_write_time() and move p past it.
+template <class T> inline T adevs_read_time(const char*& p)
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+		"Specialize adevs_write_time and adevs_read_time for this time type");
+	T t;
+	memcpy(&t,p,sizeof(T));
+	p += sizeof(T);
+	return t;
+}
+
+template <> inline void adevs_write_time(const adevs::double_fcmp& t, std::vector<char>& buf)
+{
+	adevs_write_time<double>(adevs::double_fcmp(t),buf);
+}
+
+template <> inline adevs::double_fcmp adevs_read_time(const char*& p)
+{
+	return adevs::double_fcmp(adevs_read_time<double>(p));
+}
+
+namespace adevs
+{
+
+/**
+ * An LpLink that writes outputs and earliest input times as frames to a
+ * Transport, and puts the frames that arrive into the input queues of
+ * the local logical process as if they came from the logical process of
+ * the sender in this process. Atomic models are named in the frames by
+ * their position in a list that every process builds in the same order.
+ */
+template <class X, class T = double> class TransportLink:
+	public LpLink<X,T>
+{
+	public:
+		/**
+		 * Create a link for the local logical process all_lps[rank], where
+		 * rank is the rank of the transport. The models are listed in the
+		 * same order by every process.
+		 */
+		TransportLink(Transport* transport, MessageManager<X>* msg_manager,
+			LogicalProcess<X,T>** all_lps, const std::vector<Atomic<X,T>*>& models):
+			LpLink<X,T>(),
+			transport(transport),msg_manager(msg_manager),all_lps(all_lps),
+			models(models),rank(transport->getRank()),epoch(0),
+			barriers(transport->getSize(),0)
+		{
+			for (unsigned int i = 0; i < models.size(); i++)
+				index[models[i]] = i;
+		}
+		void sendOutput(int dst, const Time<T>& t, Atomic<X,T>* target, const X& value)
+		{
+			begin(OUTPUT,t);
+			uint32_t id = index[target];
+			append(&id,sizeof(id));
+			msg_manager->serialize(value,buf);
+			put(dst);
+		}
+		void sendEIT(int dst, const Time<T>& t)
+		{
+			begin(EIT,t);
+			put(dst);
+		}
+		void poll()
+		{
+			for (int src = 0; src < transport->getSize(); src++)
+			{
+				if (src != rank) take(src);
+			}
+		}
+		/**
+		 * Wait for every process to call barrier(). A process that has
+		 * reached the barrier may go on to close its transport, so only
+		 * the processes that have not reached it are read.
+		 */
+		void barrier()
+		{
+			buf.assign(1,(char)BARRIER);
+			for (int dst = 0; dst < transport->getSize(); dst++)
+			{
+				if (dst != rank) put(dst);
+			}
+			for (int src = 0; src < transport->getSize(); src++)
+			{
+				while (src != rank && barriers[src] <= epoch)
+				{
+					take(src);
+					std::this_thread::yield();
+				}
+			}
+			epoch++;
+		}
+	private:
+		typedef enum { OUTPUT, EIT, BARRIER } frame_type;
+		Transport* transport;
+		MessageManager<X>* msg_manager;
+		LogicalProcess<X,T>** all_lps;
+		std::vector<Atomic<X,T>*> models;
+		std::unordered_map<Atomic<X,T>*,uint32_t> index;
+		int rank;
+		// Number of barriers passed here and reached by each of the other processes
+		unsigned long epoch;
+		std::vector<unsigned long> barriers;
+		std::vector<char> buf, frame;
+		void append(const void* data, size_t n)
+		{
+			buf.insert(buf.end(),(const char*)data,(const char*)data+n);
+		}
+		void begin(frame_type type, const Time<T>& t)
+		{
+			buf.assign(1,(char)type);
+			adevs_write_time<T>(t.t,buf);
+			append(&(t.c),sizeof(t.c));
+		}
+		// Put the frames from src into the queues of the local process.
+		// Nothing is read from a process that is at a barrier that this
+		// process has not passed.
+		void take(int src)
+		{
+			LogicalProcess<X,T>* lp = all_lps[rank];
+			while (barriers[src] <= epoch && transport->recv(src,frame))
+			{
+				const char* p = &(frame[0]);
+				char type = *p++;
+				if (type == BARRIER)
+				{
+					barriers[src]++;
+					continue;
+				}
+				Time<T> t;
+				t.t = adevs_read_time<T>(p);
+				memcpy(&(t.c),p,sizeof(t.c));
+				p += sizeof(t.c);
+				if (type == EIT)
+				{
+					lp->sendEIT(src,t);
+					continue;
+				}
+				uint32_t id;
+				memcpy(&id,p,sizeof(id));
+				p += sizeof(id);
+				Message<X,T> msg(msg_manager->deserialize(p,
+					(unsigned int)(frame.size()-(p-&(frame[0])))));
+				msg.t = t;
+				msg.src = all_lps[src];
+				msg.target = models[id];
+				msg.type = Message<X,T>::OUTPUT;
+				lp->sendMessage(msg);
+			}
+		}
+		// Send the frame in buf. The receiver may be waiting to send to us,
+		// so take our input while the transport is full.
+		void put(int dst)
+		{
+			while (!transport->send(dst,&(buf[0]),(unsigned int)buf.size()))
+			{
+				poll();
+				std::this_thread::yield();
+			}
+		}
+};
+
+template <class X, class T>
+ParSimulator<X,T>::ParSimulator(Devs<X,T>* model, Transport* transport,
+		MessageManager<X>* msg_manager):
+	AbstractSimulator<X,T>(),msg_manager(msg_manager),link(NULL),
+	rank(transport->getRank())
+{
+	if (msg_manager == NULL) this->msg_manager = new NullMessageManager<X>();
+	lp_count = transport->getSize();
+	// List the atomic models in the order that they were created
+	std::vector<std::pair<Atomic<X,T>*,int> > atomics;
+	collect(model,-1,atomics);
+	std::sort(atomics.begin(),atomics.end(),
+		[](const std::pair<Atomic<X,T>*,int>& a, const std::pair<Atomic<X,T>*,int>& b)
+		{ return a.first->getSerial() < b.first->getSerial(); });
+	std::vector<Atomic<X,T>*> models;
+	unsigned int unassigned = 0, placed = 0;
+	for (unsigned int i = 0; i < atomics.size(); i++)
+	{
+		models.push_back(atomics[i].first);
+		if (atomics[i].second < 0) unassigned++;
+	}
+	// Put the unassigned models into contiguous blocks
+	for (unsigned int i = 0; i < atomics.size(); i++)
+	{
+		if (atomics[i].second >= 0) continue;
+		atomics[i].first->setProc((int)((placed++*(unsigned long)lp_count)/unassigned));
+	}
+	LpGraph g;
+	for (int i = 0; i < lp_count; i++)
+	{
+		g.addNode(i);
+		for (int j = 0; j < lp_count; j++)
+		{
+			if (i != j) g.addEdge(i,j);
+		}
+	}
+	lp = new LogicalProcess<X,T>*[lp_count];
+	for (int i = 0; i < lp_count; i++)
+	{
+		lp[i] = new LogicalProcess<X,T>(i,g.getI(i),g.getE(i),
+			lp,this,this->msg_manager);
+	}
+	if (omp_get_num_procs() < lp_count) setWaitStrategy(LP_YIELD);
+	init(model);
+	link = new TransportLink<X,T>(transport,this->msg_manager,lp,models);
+	lp[rank]->setLink(link);
+}
+
+} // end of namespace
+
+#endif
@@ -44,7 +44,7 @@ template <class T> class object_pool
 	public:
 		/// Construct a pool with a specific initial population
 		object_pool(unsigned int pop = 0):
-		pool()
+		pool(),created(0)
 		{
 			for (unsigned int i = 0; i < pop; i++)
 				pool.insert(new T());
@@ -53,7 +53,11 @@ template <class T> class object_pool
 		T* make_obj()
 		{
 			T* obj;
-			if (pool.empty()) obj = new T;
+			if (pool.empty())
+			{
+				obj = new T;
+				created++;
+			}
 			else
 			{
 				obj = *((pool.end())--);
@@ -63,6 +67,8 @@ template <class T> class object_pool
 		}
 		/// Return an object to the pool
 		void destroy_obj(T* obj) { pool.insert(obj); }
+		/// Get the number of objects that make_obj() created with new
+		unsigned long getCreated() const { return created; }
 		// Delete all objects in the pool
 		~object_pool()
 		{
@@ -71,6 +77,7 @@ template <class T> class object_pool
 		}
 	private:
 		Bag<T*> pool;
+		unsigned long created;
 };
 
 } // end of namespace
@@ -0,0 +1,186 @@
+/*
+ * Checks that a Simulator with a step arena (setStepArena) gives the same
+ * results as one with the bag pools, and that it stops taking memory from
+ * the heap once its arena is large enough for a step.
+ */
+#include "adevs.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace adevs;
+
+typedef PortValue<long int> IO_Type;
+
+/**
+ * A node that sends its state to the next six nodes, so that the bags of
+ * receivers and of inputs grow past their inline storage. The Digraph
+ * orders the receivers by their addresses, which differ between the two
+ * models, so the inputs are summed exactly.
+ */
+class node: public Atomic<IO_Type>
+{
+	public:
+		node(long int v):Atomic<IO_Type>(),v(v){}
+		double ta() { return 1.0+(double)(v%3); }
+		void delta_int() { v = (v*31+7)%1000003; }
+		void delta_ext(double e, const Bag<IO_Type>& xb)
+		{
+			long int sum = (long int)e;
+			Bag<IO_Type>::const_iterator iter = xb.begin();
+			for (; iter != xb.end(); iter++)
+				sum += (*iter).value;
+			v = (v*17+sum)%1000003;
+		}
+		void delta_conf(const Bag<IO_Type>& xb)
+		{
+			delta_int();
+			delta_ext(0.0,xb);
+		}
+		void output_func(Bag<IO_Type>& yb)
+		{
+			yb.insert(IO_Type(0,v));
+		}
+		void gc_output(Bag<IO_Type>&){}
+		long int v;
+};
+
+const int n = 50;
+const int fan_out = 6;
+
+Digraph<long int>* make_model(std::vector<node*>& nodes)
+{
+	Digraph<long int>* model = new Digraph<long int>();
+	for (int i = 0; i < n; i++)
+	{
+		nodes.push_back(new node(i));
+		model->add(nodes.back());
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int k = 1; k <= fan_out; k++)
+			model->couple(nodes[i],0,nodes[(i+k)%n],0);
+	}
+	return model;
+}
+
+void test(bool arena)
+{
+	std::vector<node*> ref_nodes, nodes;
+	Digraph<long int>* ref_model = make_model(ref_nodes);
+	Digraph<long int>* model = make_model(nodes);
+	Simulator<IO_Type>* ref_sim = new Simulator<IO_Type>(ref_model);
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(model);
+	sim->setStepArena(arena);
+	ref_sim->execUntil(100.0);
+	sim->execUntil(100.0);
+	unsigned long allocs = sim->getAllocationCount();
+	unsigned long events = sim->getEventCount();
+	assert(allocs > 0);
+	ref_sim->execUntil(1000.0);
+	sim->execUntil(1000.0);
+	assert(sim->getEventCount() > events);
+	assert(sim->getEventCount() == ref_sim->getEventCount());
+	// Nothing more comes from the heap once the arena is large enough.
+	// The pools can still grow a bag when they hand a small one to a
+	// model that gets many inputs.
+	if (arena) assert(sim->getAllocationCount() == allocs);
+	for (int i = 0; i < n; i++)
+		assert(nodes[i]->v == ref_nodes[i]->v);
+	std::cout << (arena ? "arena: " : "pools: ") << sim->getAllocationCount() << " allocations for "
+		<< sim->getEventCount() << " events" << std::endl;
+	delete sim;
+	delete ref_sim;
+	delete model;
+	delete ref_model;
+}
+
+/**
+ * A model that sends ten values at each of its internal events.
+ */
+class burst: public Atomic<IO_Type>
+{
+	public:
+		burst():Atomic<IO_Type>(){}
+		double ta() { return 1.0; }
+		void delta_int(){}
+		void delta_ext(double, const Bag<IO_Type>&){}
+		void delta_conf(const Bag<IO_Type>&){}
+		void output_func(Bag<IO_Type>& yb)
+		{
+			for (int i = 0; i < 10; i++)
+				yb.insert(IO_Type(0,i));
+		}
+		void gc_output(Bag<IO_Type>&){}
+};
+
+/**
+ * Counts the allocations of a simulator whose only bag is the output bag
+ * of one model. With the pools the first step creates the bag, which
+ * takes arrays of 8 and then 16 values from the heap, and later steps
+ * reuse it. With the arena the first step takes one block for the bag
+ * and its values, and later steps reuse the block.
+ */
+void test_count(bool arena)
+{
+	burst* model = new burst();
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(model);
+	sim->setStepArena(arena);
+	assert(sim->getAllocationCount() == 0);
+	sim->execNextEvent();
+	assert(sim->getEventCount() == 1);
+	unsigned long first = arena ? 1 : 3;
+	assert(sim->getAllocationCount() == first);
+	for (int i = 0; i < 99; i++)
+		sim->execNextEvent();
+	assert(sim->getEventCount() == 100);
+	assert(sim->getAllocationCount() == first);
+	delete sim;
+	delete model;
+}
+
+/**
+ * A bag in an arena puts its extra elements there and keeps the arena
+ * when its elements are moved away.
+ */
+void test_bag()
+{
+	StepArena arena(64);
+	{
+		Bag<double> b(Bag<double>::inline_capacity,&arena);
+		for (int i = 0; i < 100; i++)
+			b.insert((double)i);
+		assert(b.size() == 100 && b.getArena() == &arena);
+		assert(arena.getBlockCount() > 0);
+		Bag<double> c(std::move(b));
+		assert(c.getArena() == NULL && c.size() == 100 && b.empty());
+		for (int i = 0; i < 100; i++)
+			assert(c.count((double)i) == 1);
+		b.swap(c);
+		assert(b.size() == 100 && c.empty() && b.getArena() == &arena);
+		b.clear();
+	}
+	arena.reset();
+	unsigned long blocks = arena.getBlockCount();
+	// After the reset one block holds everything
+	for (int k = 0; k < 10; k++)
+	{
+		Bag<double> b(Bag<double>::inline_capacity,&arena);
+		for (int i = 0; i < 100; i++)
+			b.insert((double)i);
+		b.clear();
+		arena.reset();
+	}
+	assert(arena.getBlockCount() == blocks);
+}
+
+int main()
+{
+	test_bag();
+	test_count(false);
+	test_count(true);
+	test(false);
+	test(true);
+	std::cout << "step arena test passed" << std::endl;
+	return 0;
+}
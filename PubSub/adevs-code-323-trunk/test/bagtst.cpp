@@ -1,5 +1,7 @@
 #include "adevs.h"
 #include <cassert>
+#include <string>
+#include <utility>
 using namespace adevs;
 
 template <class X> class template_test
@@ -52,9 +54,76 @@ void test2()
 	}
 }
 
+/**
+ * Counts the live instances so that the test can see that only the
+ * slots that hold elements are constructed.
+ */
+struct counted
+{
+	static int live;
+	std::string s;
+	counted(const std::string& s):s(s) { live++; }
+	counted(const counted& src):s(src.s) { live++; }
+	counted(counted&& src):s(std::move(src.s)) { live++; }
+	counted& operator=(const counted& src) { s = src.s; return *this; }
+	counted& operator=(counted&& src) { s = std::move(src.s); return *this; }
+	bool operator==(const counted& other) const { return s == other.s; }
+	~counted() { live--; }
+};
+int counted::live = 0;
+
+/**
+ * Test emplace, copy, move, swap, and erase as the bag moves from its
+ * inline storage to the heap.
+ */
+void test3()
+{
+	{
+		Bag<counted> a;
+		assert(counted::live == 0);
+		for (int i = 0; i < 3; i++)
+			a.emplace(std::string(1,'a'+i));
+		assert(counted::live == 3);
+		// Copy and move a bag in its inline storage
+		Bag<counted> b(a);
+		assert(b.size() == 3 && counted::live == 6);
+		Bag<counted> c(std::move(b));
+		assert(b.empty() && c.size() == 3 && counted::live == 6);
+		// Grow a bag onto the heap and move it
+		for (int i = 3; i < 20; i++)
+			a.insert(counted(std::string(1,'a'+i)));
+		assert(a.size() == 20 && counted::live == 23);
+		for (int i = 0; i < 20; i++)
+			assert(a.count(counted(std::string(1,'a'+i))) == 1);
+		b = std::move(a);
+		assert(a.empty() && b.size() == 20 && counted::live == 23);
+		// Swap a bag on the heap with an inline bag
+		b.swap(c);
+		assert(b.size() == 3 && c.size() == 20 && counted::live == 23);
+		c.swap(b);
+		assert(b.size() == 20 && c.size() == 3 && counted::live == 23);
+		// Insert an element of the bag while it grows
+		Bag<counted> d;
+		for (int i = 0; i < 4; i++)
+			d.insert(counted("x"));
+		d.insert(*(d.begin()));
+		assert(d.size() == 5 && d.count(counted("x")) == 5);
+		// Erase and clear destroy the elements
+		b.erase(counted("a"));
+		assert(b.size() == 19 && b.count(counted("a")) == 0);
+		assert(counted::live == 27);
+		b.clear();
+		assert(counted::live == 8);
+		a = c;
+		assert(a.size() == 3 && counted::live == 11);
+	}
+	assert(counted::live == 0);
+}
+
 int main()
 {
 	test1();
 	test2();
+	test3();
 	return 0;
 }
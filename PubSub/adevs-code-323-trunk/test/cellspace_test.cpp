@@ -0,0 +1,273 @@
+#include "adevs.h"
+#include <cassert>
+#include <iostream>
+using namespace adevs;
+
+typedef CellEvent<int> IO_Type;
+
+/**
+ * A cell that sends its x coordinate to the cell at x+1 once, at t = 1,
+ * and counts the inputs that it receives.
+ */
+class shift_cell: public Atomic<IO_Type>
+{
+	public:
+		shift_cell(long int x, long int y, long int z, bool stencil = false):
+		Atomic<IO_Type>(),x(x),y(y),z(z),stencil(stencil),
+		fired(false),received(-1),count(0){}
+		double ta() { return (fired) ? DBL_MAX : 1.0; }
+		void delta_int() { fired = true; }
+		void delta_ext(double, const Bag<IO_Type>& xb)
+		{
+			Bag<IO_Type>::const_iterator iter = xb.begin();
+			for (; iter != xb.end(); iter++)
+			{
+				assert((*iter).stencil == stencil);
+				if (!stencil)
+					assert((*iter).x == x && (*iter).y == y && (*iter).z == z);
+				received = (*iter).value;
+				count++;
+			}
+		}
+		void delta_conf(const Bag<IO_Type>& xb)
+		{
+			delta_int();
+			delta_ext(0.0,xb);
+		}
+		void output_func(Bag<IO_Type>& yb)
+		{
+			IO_Type e;
+			// A stencil event goes to the neighbors of x,y,z
+			if (stencil)
+			{
+				e.x = x; e.y = y; e.z = z;
+				e.stencil = true;
+			}
+			else
+			{
+				e.x = x+1; e.y = y; e.z = z;
+			}
+			e.value = x;
+			yb.insert(e);
+		}
+		void gc_output(Bag<IO_Type>&){}
+		long int x, y, z;
+		bool stencil, fired;
+		int received, count;
+};
+
+class count_visitor: public Network<IO_Type>::ComponentVisitor
+{
+	public:
+		count_visitor():count(0){}
+		void visit(Devs<IO_Type>* model)
+		{
+			assert(visited.find(model) == visited.end());
+			visited.insert(model);
+			count++;
+		}
+		Set<Devs<IO_Type>*> visited;
+		int count;
+};
+
+/**
+ * A space that is deeper than it is high. The z dimension used to be
+ * allocated with the height.
+ */
+void test1()
+{
+	CellSpace<int> cs(3,2,5);
+	assert(cs.getSize() == 30);
+	for (long int x = 0; x < 3; x++)
+		for (long int y = 0; y < 2; y++)
+			for (long int z = 0; z < 5; z++)
+				assert(cs.getModel(x,y,z) == NULL);
+	for (long int x = 0; x < 3; x++)
+		for (long int y = 0; y < 2; y++)
+			for (long int z = 0; z < 5; z++)
+				cs.add(new shift_cell(x,y,z),x,y,z);
+	for (long int x = 0; x < 3; x++)
+	{
+		for (long int y = 0; y < 2; y++)
+		{
+			for (long int z = 0; z < 5; z++)
+			{
+				shift_cell* c = dynamic_cast<shift_cell*>(cs.getModel(x,y,z));
+				assert(c->x == x && c->y == y && c->z == z);
+				assert(cs.getModelAt(cs.index(x,y,z)) == c);
+				assert(c->getParent() == &cs);
+			}
+		}
+	}
+}
+
+/**
+ * The visitor and the index enumerate the same cells as getComponents().
+ */
+void test2()
+{
+	CellSpace<int> cs(4,3,2);
+	for (long int x = 0; x < 4; x++)
+		for (long int z = 0; z < 2; z++)
+			cs.add(new shift_cell(x,1,z),x,1,z);
+	Set<Devs<IO_Type>*> c;
+	cs.getComponents(c);
+	assert(c.size() == 8);
+	count_visitor v;
+	cs.visitComponents(&v);
+	assert(v.count == 8);
+	assert(v.visited == c);
+	int found = 0;
+	for (long int i = 0; i < cs.getSize(); i++)
+	{
+		if (cs.getModelAt(i) != NULL)
+		{
+			assert(c.find(cs.getModelAt(i)) != c.end());
+			found++;
+		}
+	}
+	assert(found == 8);
+}
+
+/**
+ * Simulate a space with empty cells and events that leave the space.
+ */
+void test3()
+{
+	CellSpace<int>* cs = new CellSpace<int>(5,1,2);
+	for (long int x = 0; x < 5; x++)
+	{
+		// Leave a hole at x = 2 in the first layer
+		if (x != 2) cs->add(new shift_cell(x,0,0),x,0,0);
+		cs->add(new shift_cell(x,0,1),x,0,1);
+	}
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(cs);
+	assert(sim->nextEventTime() == 1.0);
+	sim->execNextEvent();
+	assert(sim->nextEventTime() == DBL_MAX);
+	for (long int z = 0; z < 2; z++)
+	{
+		for (long int x = 0; x < 5; x++)
+		{
+			shift_cell* c = dynamic_cast<shift_cell*>(cs->getModel(x,0,z));
+			if (c == NULL) continue;
+			assert(c->fired);
+			if (x == 0 || (z == 0 && x == 3))
+				assert(c->count == 0);
+			else
+			{
+				assert(c->count == 1);
+				assert(c->received == x-1);
+			}
+		}
+	}
+	delete sim;
+	delete cs;
+}
+
+class output_counter: public EventListener<IO_Type>
+{
+	public:
+		output_counter(Devs<IO_Type>* model):model(model),count(0){}
+		void outputEvent(Event<IO_Type> x, double)
+		{
+			if (x.model == model) count++;
+		}
+		Devs<IO_Type>* model;
+		int count;
+};
+
+/**
+ * Fill a w x h space with stencil cells, use the neighborhood, run one
+ * step, and return the number of outputs from the space. The cells are
+ * left in the space for inspection.
+ */
+int run_stencil(CellSpace<int>* cs, bool moore,
+	CellSpace<int>::Boundary boundary, long int radius = 1)
+{
+	for (long int x = 0; x < cs->getWidth(); x++)
+		for (long int y = 0; y < cs->getHeight(); y++)
+			cs->add(new shift_cell(x,y,0,true),x,y);
+	if (moore) cs->setMooreNeighborhood(boundary,radius);
+	else cs->setVonNeumannNeighborhood(boundary,radius);
+	Simulator<IO_Type> sim(cs);
+	output_counter outputs(cs);
+	sim.addEventListener(&outputs);
+	sim.execNextEvent();
+	return outputs.count;
+}
+
+int count_at(CellSpace<int>* cs, long int x, long int y)
+{
+	return dynamic_cast<shift_cell*>(cs->getModel(x,y))->count;
+}
+
+/**
+ * Stencil events with each kind of boundary.
+ */
+void test4()
+{
+	// Every cell of a torus has all of its neighbors
+	CellSpace<int> torus(5,4);
+	assert(run_stencil(&torus,true,CellSpace<int>::TORUS) == 0);
+	for (long int x = 0; x < 5; x++)
+		for (long int y = 0; y < 4; y++)
+			assert(count_at(&torus,x,y) == 8);
+	// The corner cells lose five neighbors and the edge cells three
+	CellSpace<int> clamp(5,4);
+	assert(run_stencil(&clamp,true,CellSpace<int>::CLAMP) == 0);
+	assert(count_at(&clamp,0,0) == 3);
+	assert(count_at(&clamp,4,3) == 3);
+	assert(count_at(&clamp,2,0) == 5);
+	assert(count_at(&clamp,2,2) == 8);
+	// Every edge cell makes one output
+	CellSpace<int> external(5,4);
+	assert(run_stencil(&external,true,CellSpace<int>::EXTERNAL) == 14);
+	assert(count_at(&external,0,0) == 3);
+	assert(count_at(&external,1,1) == 8);
+	// von Neumann neighborhoods of radius 1 and 2
+	CellSpace<int> vn1(6,6);
+	run_stencil(&vn1,false,CellSpace<int>::TORUS);
+	assert(count_at(&vn1,0,0) == 4);
+	CellSpace<int> vn2(6,6);
+	run_stencil(&vn2,false,CellSpace<int>::CLAMP,2);
+	assert(count_at(&vn2,3,3) == 12);
+	assert(count_at(&vn2,0,0) == 5);
+	// A torus that is too small wraps onto the sender, which is skipped
+	CellSpace<int> tiny(1,3);
+	run_stencil(&tiny,true,CellSpace<int>::TORUS);
+	assert(count_at(&tiny,0,1) == 2);
+}
+
+/**
+ * A stencil event without a neighborhood is an error.
+ */
+void test5()
+{
+	CellSpace<int>* cs = new CellSpace<int>(2);
+	cs->add(new shift_cell(0,0,0,true),0);
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(cs);
+	bool caught = false;
+	try
+	{
+		sim->execNextEvent();
+	}
+	catch(adevs::exception& err)
+	{
+		caught = true;
+	}
+	assert(caught);
+	delete sim;
+	delete cs;
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+	test5();
+	std::cout << "cellspace test passed" << std::endl;
+	return 0;
+}
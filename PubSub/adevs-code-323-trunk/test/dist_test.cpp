@@ -0,0 +1,211 @@
+/*
+ * Runs a ParSimulator in several processes on this host, connected by
+ * shared memory and by sockets, and checks that the final states and the
+ * number of state changes are the same as with the Simulator.
+ */
+#include "ring_fixture.h"
+#include "adevs_shm_transport.h"
+#include "adevs_socket_transport.h"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace adevs;
+
+/**
+ * Writes the fields of a CellEvent as bytes.
+ */
+class cell_manager: public MessageManager<IO_Type>
+{
+	public:
+		IO_Type clone(IO_Type& value) { return value; }
+		void destroy(IO_Type&){}
+		void serialize(const IO_Type& value, std::vector<char>& buf)
+		{
+			long int loc[3] = { value.x, value.y, value.z };
+			buf.insert(buf.end(),(const char*)loc,(const char*)loc+sizeof(loc));
+			buf.insert(buf.end(),(const char*)&(value.value),
+				(const char*)&(value.value)+sizeof(double));
+		}
+		IO_Type deserialize(const char* data, unsigned int size)
+		{
+			assert(size == 3*sizeof(long int)+sizeof(double));
+			IO_Type value;
+			long int loc[3];
+			memcpy(loc,data,sizeof(loc));
+			value.x = loc[0];
+			value.y = loc[1];
+			value.z = loc[2];
+			memcpy(&(value.value),data+sizeof(loc),sizeof(double));
+			return value;
+		}
+};
+
+const long int w = 300;
+const double tend = 100.0;
+
+typedef enum { SHM, SOCKET } transport_t;
+
+/**
+ * Simulate the part of the ring that belongs to process rank. The final
+ * states of its cells and its count of state changes go into result.
+ */
+void run_process(transport_t kind, int rank, int n, const std::string& name,
+	int port, double* result)
+{
+	CellSpace<double>* cs = make_ring(w);
+	Transport* t;
+	if (kind == SHM) t = new ShmTransport(name.c_str(),rank,n);
+	else
+	{
+		std::vector<std::string> addresses;
+		for (int i = 0; i < n; i++)
+		{
+			char buf[100];
+			sprintf(buf,"127.0.0.1:%d",port+i);
+			addresses.push_back(buf);
+		}
+		t = new SocketTransport(rank,addresses);
+	}
+	ParSimulator<IO_Type>* sim = new ParSimulator<IO_Type>(cs,t,new cell_manager());
+	assert(sim->getLPCount() == n);
+	recorder c;
+	sim->addEventListener(&c);
+	sim->execUntil(tend/2.0);
+	sim->execUntil(tend);
+	for (long int x = 0; x < w; x++)
+	{
+		if (cs->getModel(x)->getProc() == rank)
+			result[x] = dynamic_cast<ring_cell*>(cs->getModel(x))->v;
+	}
+	result[w+rank] = (double)c.changes.size();
+	delete sim;
+	delete t;
+	delete cs;
+}
+
+void test(transport_t kind, int n)
+{
+	// The result of the Simulator
+	CellSpace<double>* cs = make_ring(w);
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(cs);
+	recorder c;
+	sim->addEventListener(&c);
+	sim->execUntil(tend);
+	// The processes put their results into shared memory
+	double* result = static_cast<double*>(mmap(NULL,(w+n)*sizeof(double),
+		PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0));
+	assert(result != MAP_FAILED);
+	for (long int i = 0; i < w+n; i++)
+		result[i] = -1.0;
+	char name[100];
+	sprintf(name,"/adevs_dist_test_%d",(int)getpid());
+	int port = 20000+getpid()%20000;
+	std::vector<pid_t> pids;
+	for (int rank = 0; rank < n; rank++)
+	{
+		pid_t pid = fork();
+		assert(pid >= 0);
+		if (pid == 0)
+		{
+			try
+			{
+				run_process(kind,rank,n,name,port,result);
+			}
+			catch(adevs::exception& err)
+			{
+				std::cerr << err.what() << std::endl;
+				_exit(1);
+			}
+			_exit(0);
+		}
+		pids.push_back(pid);
+	}
+	for (int rank = 0; rank < n; rank++)
+	{
+		int status;
+		waitpid(pids[rank],&status,0);
+		assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	long int changes = 0;
+	for (int rank = 0; rank < n; rank++)
+		changes += (long int)result[w+rank];
+	assert(changes == (long int)c.changes.size());
+	for (long int x = 0; x < w; x++)
+		assert(result[x] == dynamic_cast<ring_cell*>(cs->getModel(x))->v);
+	munmap(result,(w+n)*sizeof(double));
+	delete sim;
+	delete cs;
+}
+
+/**
+ * A process that closes its socket after sending a frame. The other
+ * process reads the frame and then recv() throws.
+ */
+void test_closed()
+{
+	int port = 20000+(getpid()+1000)%20000;
+	std::vector<std::string> addresses;
+	for (int i = 0; i < 2; i++)
+	{
+		char buf[100];
+		sprintf(buf,"127.0.0.1:%d",port+i);
+		addresses.push_back(buf);
+	}
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0)
+	{
+		SocketTransport t(1,addresses);
+		t.send(0,"done",4);
+		_exit(0);
+	}
+	SocketTransport t(0,addresses);
+	std::vector<char> frame;
+	while (!t.recv(1,frame));
+	assert(std::string(frame.begin(),frame.end()) == "done");
+	int status;
+	waitpid(pid,&status,0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	bool thrown = false;
+	try
+	{
+		while (!t.recv(1,frame));
+	}
+	catch(adevs::exception&)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+/**
+ * A time type that is not trivially copyable goes through its own
+ * adevs_write_time() and adevs_read_time().
+ */
+void test_time()
+{
+	std::vector<char> buf;
+	adevs_write_time(double_fcmp(1.5),buf);
+	assert(buf.size() == sizeof(double));
+	const char* p = &(buf[0]);
+	assert((double)adevs_read_time<double_fcmp>(p) == 1.5);
+	assert(p == &(buf[0])+sizeof(double));
+}
+
+int main()
+{
+	test_time();
+	test_closed();
+	test(SHM,2);
+	test(SHM,4);
+	test(SOCKET,3);
+	std::cout << "distributed simulator test passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include <list>
+#include <iostream>
+#include <time.h>
+#include "adevs.h"
+#include "SimpleAtomic.h"
+using namespace adevs;
+using namespace std;
+
+/*
+ * Random structure changes as in complex_test, but some of the networks
+ * report their changes with a change log and the others do not. After
+ * each step the number of atomic models that are alive must be the
+ * number in the model, every model must have run once per unit of time,
+ * and the levels of the models must match their places in the tree.
+ */
+class LogNetwork: public Network<SimpleIO>
+{
+	public:
+		LogNetwork(bool logged, int depth = 0):
+		Network<SimpleIO>(),
+		depth(depth)
+		{
+			setChangeLog(logged);
+			int initial_count = rand()%3+1;
+			for (int i = 0; i < initial_count; i++)
+			{
+				add_model();
+			}
+		}
+		void getComponents(Set<Devs<SimpleIO>*>& c)
+		{
+			list<Devs<SimpleIO>*>::iterator iter;
+			for (iter = models.begin(); iter != models.end(); iter++)
+			{
+				c.insert(*iter);
+			}
+		}
+		void route(const SimpleIO&, Devs<SimpleIO>*, Bag<Event<SimpleIO> >&){}
+		bool model_transition()
+		{
+			int choice = rand()%4;
+			if (choice == 0)
+			{
+				add_model();
+				return true;
+			} 
+			else if (choice == 2 && !models.empty())
+			{
+				Devs<SimpleIO>* model = models.back();
+				models.pop_back();
+				model->setParent(NULL);
+				componentRemoved(model);
+				return true;
+			}
+			/*
+			 * Move a component to a sibling, which must be another LogNetwork.
+			 * Moves are not logged. A move by a network without a log is found
+			 * by comparing the components of its parent, so the parent must
+			 * not have a log either.
+			 */
+			else if (choice == 3 && !models.empty() && getParent() != NULL &&
+				(hasChangeLog() || !getParent()->hasChangeLog()))
+			{
+				LogNetwork* parent = dynamic_cast<LogNetwork*>(getParent());
+				LogNetwork* sibling = NULL;
+				list<Devs<SimpleIO>*>::iterator iter;
+				for (iter = parent->models.begin(); iter != parent->models.end(); iter++)
+				{
+					sibling = dynamic_cast<LogNetwork*>(*iter);
+					if (sibling != NULL && sibling != this) break;
+					sibling = NULL;
+				}
+				if (sibling == NULL) return false;
+				Devs<SimpleIO>* model = models.front();
+				models.pop_front();
+				model->setParent(sibling);
+				sibling->models.push_back(model);
+				return true;
+			}
+			return false;
+		}
+		~LogNetwork()
+		{
+			list<Devs<SimpleIO>*>::iterator iter;
+			for (iter = models.begin(); iter != models.end(); iter++)
+			{
+				delete *iter;
+			}
+		}
+		list<Devs<SimpleIO>*> models;
+	private:
+		int depth;
+
+		void add_model()
+		{
+			Devs<SimpleIO>* model = NULL;
+			if (rand()%2 == 0 || depth == 5)
+			{
+				model = new SimpleAtomic();
+			}
+			else 
+			{
+				model = new LogNetwork(rand()%4 != 0,depth+1);
+			}
+			model->setParent(this);
+			models.push_front(model);
+			componentAdded(model);
+		}
+};
+
+// Check the levels and count the atomic models
+int check_tree(Devs<SimpleIO>* model)
+{
+	if (model->getParent() == NULL) assert(model->getLevel() == 0);
+	else assert(model->getLevel() == model->getParent()->getLevel()+1);
+	LogNetwork* network = dynamic_cast<LogNetwork*>(model);
+	if (network == NULL) return 1;
+	int count = 0;
+	list<Devs<SimpleIO>*>::iterator iter;
+	for (iter = network->models.begin(); iter != network->models.end(); iter++)
+	{
+		assert((*iter)->getParent() == network);
+		count += check_tree(*iter);
+	}
+	return count;
+}
+
+void doTest()
+{
+	LogNetwork* model = new LogNetwork(true);
+	Simulator<SimpleIO>* sim = new Simulator<SimpleIO>(model);
+	int count = check_tree(model);
+	assert(count == SimpleAtomic::atomic_number);
+	while (sim->nextEventTime() < 100.0)
+	{
+		SimpleAtomic::internal_execs = 0;
+		sim->execNextEvent();
+		// The models that were there before the step have all run
+		assert(SimpleAtomic::internal_execs == count);
+		count = check_tree(model);
+		assert(count == SimpleAtomic::atomic_number);
+	}
+	delete sim;
+	delete model;
+	assert(SimpleAtomic::atomic_number == 0);
+}
+
+int main()
+{
+	unsigned long seed = (unsigned long)time(NULL);
+	cout << seed << endl;
+	srand(seed);
+	for (int i = 0; i < 100; i++)
+	{
+		cout << "\r" << i << "\t";
+		cout.flush();
+		doTest();
+	}
+	cout << "\rdone\t" << endl;
+	return 0;
+}
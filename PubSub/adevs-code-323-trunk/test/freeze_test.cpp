@@ -0,0 +1,279 @@
+/*
+ * Checks that frozen Digraph and SimpleDigraph models route events as the
+ * unfrozen models do: the same final states, and the same outputs and
+ * state changes as seen by a listener, with nested networks and outputs
+ * that leave them. Then checks that a new coupling discards the tables
+ * and is used.
+ */
+#include "adevs.h"
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace adevs;
+
+typedef PortValue<int> PV;
+
+/**
+ * Sends its count on ports 0 and 1 and hashes the sums of its inputs.
+ */
+class pv_node: public Atomic<PV>
+{
+	public:
+		pv_node(int id, double period):
+		Atomic<PV>(),id(id),period(period),count(0),h(id){}
+		double ta() { return period; }
+		void delta_int() { count++; }
+		void delta_ext(double e, const Bag<PV>& xb)
+		{
+			unsigned long sum = 0;
+			Bag<PV>::const_iterator iter = xb.begin();
+			for (; iter != xb.end(); iter++)
+				sum += (*iter).port*7+(*iter).value;
+			h = h*31+sum;
+		}
+		void delta_conf(const Bag<PV>& xb)
+		{
+			delta_int();
+			delta_ext(0.0,xb);
+		}
+		void output_func(Bag<PV>& yb)
+		{
+			yb.insert(PV(0,id*100+count));
+			yb.insert(PV(1,id*100+count+50));
+		}
+		void gc_output(Bag<PV>&){}
+		int id;
+		double period;
+		int count;
+		unsigned long h;
+};
+
+/**
+ * Records the outputs and state changes as text. Simultaneous events are
+ * reported in an order that depends on the addresses of the models, so
+ * the logs are sorted before they are compared.
+ */
+template <class X> class recorder:
+	public EventListener<X>
+{
+	public:
+		recorder(std::vector<std::string>& log):log(log){}
+		void outputEvent(Event<X,double> x, double t)
+		{
+			std::ostringstream s;
+			s << "y " << name(x.model) << " " << text(x.value) << " @ " << t;
+			log.push_back(s.str());
+		}
+		void stateChange(Atomic<X>* model, double t)
+		{
+			std::ostringstream s;
+			s << "s " << name(model) << " @ " << t;
+			log.push_back(s.str());
+		}
+		std::vector<Devs<X>*> names;
+	private:
+		std::vector<std::string>& log;
+		// Models are named by the order in which they were listed
+		int name(Devs<X>* model)
+		{
+			for (unsigned i = 0; i < names.size(); i++)
+				if (names[i] == model) return i;
+			return -1;
+		}
+		static std::string text(const PV& x)
+		{
+			std::ostringstream s;
+			s << x.port << ":" << x.value;
+			return s.str();
+		}
+		static std::string text(int x)
+		{
+			std::ostringstream s;
+			s << x;
+			return s.str();
+		}
+};
+
+struct pv_model
+{
+	Digraph<int>* top;
+	Digraph<int>* sub;
+	Digraph<int>* subsub;
+	Digraph<int>* pass;
+	std::vector<pv_node*> nodes;
+	std::vector<Devs<PV>*> all;
+};
+
+/**
+ * Node 0 feeds the network sub, which holds nodes 1 and 2 and the
+ * network subsub with node 3. Node 1 sends its output out of sub to
+ * node 4. Node 0 also feeds the network pass, which holds node 5,
+ * and node 5 sends its output out of pass to node 6.
+ */
+pv_model make_pv_model()
+{
+	pv_model m;
+	for (int i = 0; i < 7; i++)
+		m.nodes.push_back(new pv_node(i,1.0+0.25*i));
+	m.top = new Digraph<int>();
+	m.sub = new Digraph<int>();
+	m.subsub = new Digraph<int>();
+	m.pass = new Digraph<int>();
+	m.subsub->couple(m.subsub,0,m.nodes[3],1);
+	m.subsub->couple(m.subsub,1,m.nodes[3],0);
+	m.sub->couple(m.sub,0,m.nodes[1],0);
+	m.sub->couple(m.sub,0,m.subsub,0);
+	m.sub->couple(m.sub,0,m.nodes[2],1);
+	m.sub->couple(m.sub,1,m.subsub,1);
+	m.sub->couple(m.nodes[1],1,m.sub,2);
+	m.sub->couple(m.nodes[2],0,m.nodes[1],1);
+	m.pass->couple(m.pass,0,m.nodes[5],0);
+	m.pass->couple(m.nodes[5],1,m.pass,1);
+	m.top->couple(m.nodes[0],0,m.sub,0);
+	m.top->couple(m.nodes[0],1,m.sub,1);
+	m.top->couple(m.nodes[0],0,m.pass,0);
+	m.top->couple(m.sub,2,m.nodes[4],0);
+	m.top->couple(m.pass,1,m.nodes[6],1);
+	m.top->couple(m.nodes[6],0,m.nodes[0],0);
+	for (int i = 0; i < 7; i++)
+		m.all.push_back(m.nodes[i]);
+	m.all.push_back(m.top);
+	m.all.push_back(m.sub);
+	m.all.push_back(m.subsub);
+	m.all.push_back(m.pass);
+	return m;
+}
+
+void run_pv(bool freeze, std::vector<std::string>& log, std::vector<unsigned long>& h)
+{
+	pv_model m = make_pv_model();
+	if (freeze)
+	{
+		m.top->freeze();
+		assert(m.top->isFrozen() && m.sub->isFrozen() && m.subsub->isFrozen());
+	}
+	Simulator<PV>* sim = new Simulator<PV>(m.top);
+	recorder<PV> r(log);
+	r.names = m.all;
+	sim->addEventListener(&r);
+	sim->execUntil(20.0);
+	// A new coupling inside of a frozen network thaws the networks above it
+	m.subsub->couple(m.subsub,0,m.nodes[3],2);
+	assert(!m.subsub->isFrozen() && !m.sub->isFrozen() && !m.top->isFrozen());
+	sim->execUntil(30.0);
+	if (freeze) m.top->freeze();
+	sim->execUntil(40.0);
+	for (int i = 0; i < 7; i++)
+		h.push_back(m.nodes[i]->h);
+	delete sim;
+	delete m.top;
+}
+
+/**
+ * Sends its count and hashes the sums of its inputs.
+ */
+class int_node: public Atomic<int>
+{
+	public:
+		int_node(int id, double period):
+		Atomic<int>(),id(id),period(period),count(0),h(id){}
+		double ta() { return period; }
+		void delta_int() { count++; }
+		void delta_ext(double e, const Bag<int>& xb)
+		{
+			unsigned long sum = 0;
+			Bag<int>::const_iterator iter = xb.begin();
+			for (; iter != xb.end(); iter++)
+				sum += (*iter);
+			h = h*31+sum;
+		}
+		void delta_conf(const Bag<int>& xb)
+		{
+			delta_int();
+			delta_ext(0.0,xb);
+		}
+		void output_func(Bag<int>& yb) { yb.insert(id*100+count); }
+		void gc_output(Bag<int>&){}
+		int id;
+		double period;
+		int count;
+		unsigned long h;
+};
+
+/**
+ * The same shape as the Digraph model without the ports.
+ */
+void run_int(bool freeze, std::vector<std::string>& log, std::vector<unsigned long>& h)
+{
+	std::vector<int_node*> nodes;
+	for (int i = 0; i < 7; i++)
+		nodes.push_back(new int_node(i,1.0+0.25*i));
+	SimpleDigraph<int>* top = new SimpleDigraph<int>();
+	SimpleDigraph<int>* sub = new SimpleDigraph<int>();
+	SimpleDigraph<int>* subsub = new SimpleDigraph<int>();
+	SimpleDigraph<int>* pass = new SimpleDigraph<int>();
+	subsub->couple(subsub,nodes[3]);
+	sub->couple(sub,nodes[1]);
+	sub->couple(sub,subsub);
+	sub->couple(sub,nodes[2]);
+	sub->couple(nodes[1],sub);
+	sub->couple(nodes[2],nodes[1]);
+	pass->couple(pass,nodes[5]);
+	pass->couple(nodes[5],pass);
+	top->couple(nodes[0],sub);
+	top->couple(nodes[0],pass);
+	top->couple(sub,nodes[4]);
+	top->couple(pass,nodes[6]);
+	top->couple(nodes[6],nodes[0]);
+	if (freeze)
+	{
+		top->freeze();
+		assert(top->isFrozen() && sub->isFrozen() && subsub->isFrozen());
+	}
+	Simulator<int>* sim = new Simulator<int>(top);
+	recorder<int> r(log);
+	for (int i = 0; i < 7; i++)
+		r.names.push_back(nodes[i]);
+	r.names.push_back(top);
+	r.names.push_back(sub);
+	r.names.push_back(subsub);
+	r.names.push_back(pass);
+	sim->addEventListener(&r);
+	sim->execUntil(20.0);
+	subsub->couple(nodes[3],subsub);
+	sub->couple(subsub,nodes[2]);
+	assert(!subsub->isFrozen() && !sub->isFrozen() && !top->isFrozen());
+	sim->execUntil(30.0);
+	if (freeze) top->freeze();
+	sim->execUntil(40.0);
+	for (int i = 0; i < 7; i++)
+		h.push_back(nodes[i]->h);
+	delete sim;
+	delete top;
+}
+
+int main()
+{
+	std::vector<std::string> log1, log2;
+	std::vector<unsigned long> h1, h2;
+	run_pv(false,log1,h1);
+	run_pv(true,log2,h2);
+	assert(log1.size() > 100);
+	std::sort(log1.begin(),log1.end());
+	std::sort(log2.begin(),log2.end());
+	assert(log1 == log2);
+	assert(h1 == h2);
+	log1.clear(); log2.clear(); h1.clear(); h2.clear();
+	run_int(false,log1,h1);
+	run_int(true,log2,h2);
+	assert(log1.size() > 100);
+	std::sort(log1.begin(),log1.end());
+	std::sort(log2.begin(),log2.end());
+	assert(log1 == log2);
+	assert(h1 == h2);
+	std::cout << "frozen network test passed" << std::endl;
+	return 0;
+}
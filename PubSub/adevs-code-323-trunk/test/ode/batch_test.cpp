@@ -0,0 +1,248 @@
+#include "adevs.h"
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace adevs;
+
+typedef PortValue<double> IO;
+
+/**
+ * Bouncing balls with different heights and gravities, simulated as
+ * Hybrid models and as BatchHybrid models with and without a batch
+ * derivative. Every ball is sampled by a pulse at a period that does not
+ * line up with the bounces. The batch is also run by a Simulator that
+ * computes the new states of the models in parallel. The outputs and
+ * states of the models must be the same in every case.
+ */
+class ball:
+	public batch_ode_system<IO>
+{
+	public:
+		ball(int id):
+		batch_ode_system<IO>(3,1),
+		id(id),
+		g(1.0+0.1*(id%7)),
+		h0(0.5+0.05*id),
+		sample(false),
+		fall(true)
+		{
+		}
+		void init(double* q)
+		{
+			q[0] = h0; // Initial height
+			q[1] = 0.0; // Initial velocity
+			q[2] = 0.0; // Time
+		}
+		void der_func(const double* q, double* dq)
+		{
+			dq[0] = q[1];
+			dq[1] = -g;
+			dq[2] = 1.0;
+		}
+		void batch_der_func(const double* q, double* dq, int n,
+			batch_ode_system<IO>* const* sys)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				dq[i] = q[n+i];
+				dq[n+i] = -static_cast<ball*>(sys[i])->g;
+				dq[2*n+i] = 1.0;
+			}
+		}
+		void state_event_func(const double* q, double* z)
+		{
+			if (fall) z[0] = q[0]; // Bounce if it is going down
+			else z[0] = q[1]; // Start falling at apogee
+		}
+		double time_event_func(const double*)
+		{
+			if (sample) return 0.0;
+			else return DBL_MAX;
+		}
+		void internal_event(double* q, const bool* event_flag)
+		{
+			if (event_flag[0])
+			{
+				if (fall) q[1] = -0.9*q[1];
+				fall = !fall;
+			}
+			sample = false;
+		}
+		void external_event(double*, double, const Bag<IO>& xb)
+		{
+			sample = xb.size() > 0;
+		}
+		void confluent_event(double* q, const bool* event_flag, const Bag<IO>& xb)
+		{
+			internal_event(q,event_flag);
+			external_event(q,0.0,xb);
+		}
+		void output_func(const double* q, const bool* event_flag, Bag<IO>& yb)
+		{
+			yb.insert(IO(event_flag[0] ? 1 : 0,q[0]));
+		}
+		void gc_output(Bag<IO>&){}
+		const int id;
+	private:
+		const double g, h0;
+		bool sample, fall;
+};
+
+/**
+ * The same ball without a batch derivative.
+ */
+class plain_ball:
+	public ode_system<IO>
+{
+	public:
+		plain_ball(int id):ode_system<IO>(3,1),b(id){}
+		void init(double* q) { b.init(q); }
+		void der_func(const double* q, double* dq) { b.der_func(q,dq); }
+		void state_event_func(const double* q, double* z) { b.state_event_func(q,z); }
+		double time_event_func(const double* q) { return b.time_event_func(q); }
+		void internal_event(double* q, const bool* event_flag)
+		{
+			b.internal_event(q,event_flag);
+		}
+		void external_event(double* q, double e, const Bag<IO>& xb)
+		{
+			b.external_event(q,e,xb);
+		}
+		void confluent_event(double* q, const bool* event_flag, const Bag<IO>& xb)
+		{
+			b.confluent_event(q,event_flag,xb);
+		}
+		void output_func(const double* q, const bool* event_flag, Bag<IO>& yb)
+		{
+			b.output_func(q,event_flag,yb);
+		}
+		void gc_output(Bag<IO>&){}
+	private:
+		ball b;
+};
+
+class pulse:
+	public Atomic<IO>
+{
+	public:
+		pulse(double dt):Atomic<IO>(),dt(dt){}
+		void delta_int(){}
+		void delta_ext(double, const Bag<IO>&){}
+		void delta_conf(const Bag<IO>&){}
+		double ta() { return dt; }
+		void output_func(Bag<IO>& yb) { yb.insert(IO(0,0.0)); }
+		void gc_output(Bag<IO>&){}
+	private:
+		const double dt;
+};
+
+/**
+ * Records the outputs and states of the balls by their index.
+ */
+class recorder:
+	public EventListener<IO>
+{
+	public:
+		recorder(vector<Devs<IO>*>& balls, vector<string>& log):
+			balls(balls),log(log){}
+		void outputEvent(Event<IO,double> x, double t)
+		{
+			int k = index(x.model);
+			if (k < 0) return;
+			ostringstream s;
+			s.precision(17);
+			s << t << " y " << k << " " << x.value.port << " " << x.value.value;
+			log.push_back(s.str());
+		}
+		void stateChange(Atomic<IO>* model, double t)
+		{
+			int k = index(model);
+			if (k < 0) return;
+			ostringstream s;
+			s.precision(17);
+			s << t << " s " << k;
+			for (int i = 0; i < 3; i++) s << " " << state(model,i);
+			log.push_back(s.str());
+		}
+	private:
+		vector<Devs<IO>*>& balls;
+		vector<string>& log;
+		int index(Devs<IO>* model)
+		{
+			for (unsigned i = 0; i < balls.size(); i++)
+				if (balls[i] == model) return i;
+			return -1;
+		}
+		static double state(Atomic<IO>* model, int i)
+		{
+			Hybrid<IO>* h = dynamic_cast<Hybrid<IO>*>(model);
+			if (h != NULL) return h->getState(i);
+			return dynamic_cast<BatchHybrid<IO>*>(model)->getState(i);
+		}
+};
+
+typedef enum { HYBRID, BATCH, BATCH_PLAIN, BATCH_PAR } kind_t;
+
+const int balls_per_test = 40;
+
+void run(kind_t kind, event_locator_impl<IO>::Mode mode, vector<string>& log)
+{
+	Digraph<double>* model = new Digraph<double>();
+	pulse* p = new pulse(0.37);
+	vector<Devs<IO>*> balls;
+	hybrid_batch<IO>* batch = new hybrid_batch<IO>(1E-8,0.01,1E-7,mode);
+	for (int i = 0; i < balls_per_test; i++)
+	{
+		Atomic<IO>* b;
+		if (kind == HYBRID)
+		{
+			ball* sys = new ball(i);
+			b = new Hybrid<IO>(sys,new rk_45<IO>(sys,1E-8,0.01),
+				new event_locator_impl<IO>(sys,1E-7,mode));
+		}
+		else if (kind == BATCH || kind == BATCH_PAR)
+			b = new BatchHybrid<IO>(new ball(i),batch);
+		else b = new BatchHybrid<IO>(new plain_ball(i),batch);
+		balls.push_back(b);
+		// Only some of the balls are sampled
+		if (i%3 != 0) model->couple(p,0,b,0);
+		else model->add(b);
+	}
+	if (kind == BATCH) assert(batch->usesBatchDerivative());
+	if (kind == BATCH_PLAIN) assert(!batch->usesBatchDerivative());
+	if (kind == HYBRID) delete batch;
+	recorder r(balls,log);
+	Simulator<IO>* sim = new Simulator<IO>(model);
+	if (kind == BATCH_PAR) sim->setParallel(1);
+	sim->addEventListener(&r);
+	while (sim->nextEventTime() < 5.0)
+		sim->execNextEvent();
+	delete sim;
+	delete model;
+	sort(log.begin(),log.end());
+}
+
+int main()
+{
+	omp_set_num_threads(4);
+	event_locator_impl<IO>::Mode modes[2] =
+		{ event_locator_impl<IO>::INTERPOLATE, event_locator_impl<IO>::BISECTION };
+	for (int m = 0; m < 2; m++)
+	{
+		vector<string> a, b, c, d;
+		run(HYBRID,modes[m],a);
+		run(BATCH,modes[m],b);
+		run(BATCH_PLAIN,modes[m],c);
+		run(BATCH_PAR,modes[m],d);
+		assert(a.size() > 1000);
+		assert(a == b);
+		assert(a == c);
+		assert(a == d);
+	}
+	cout << "batch hybrid test passed" << endl;
+	return 0;
+}
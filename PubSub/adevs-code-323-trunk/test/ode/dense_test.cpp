@@ -0,0 +1,171 @@
+#include "adevs.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+using namespace std;
+using namespace adevs;
+
+/**
+ * A falling ball whose derivative calls are counted. Its state events
+ * are located on the interpolant of the solver's last step, which costs
+ * the one derivative at the end of that step, and the state at the
+ * event is found with one more step of the solver.
+ */
+class ball:
+	public ode_system<double>
+{
+	public:
+		ball():ode_system<double>(2,1),calls(0){}
+		void init(double* q)
+		{
+			q[0] = 1.0; // Initial height
+			q[1] = 0.0; // Initial velocity
+		}
+		void der_func(const double* q, double* dq)
+		{
+			calls++;
+			dq[0] = q[1];
+			dq[1] = -9.8;
+		}
+		void state_event_func(const double* q, double* z) { z[0] = q[0]; }
+		double time_event_func(const double*) { return DBL_MAX; }
+		void internal_event(double*, const bool*){}
+		void external_event(double*, double, const Bag<double>&){}
+		void confluent_event(double*, const bool*, const Bag<double>&){}
+		void output_func(const double*, const bool*, Bag<double>&){}
+		void gc_output(Bag<double>&){}
+		int calls;
+};
+
+/**
+ * A height that falls at a rate that oscillates, so that the interpolant
+ * of a step does not match the state of the solver at the event to the
+ * event tolerance.
+ */
+class wave:
+	public ode_system<double>
+{
+	public:
+		wave():ode_system<double>(2,1){}
+		void init(double* q)
+		{
+			q[0] = 1.0; // Initial height
+			q[1] = 0.0; // Time
+		}
+		void der_func(const double* q, double* dq)
+		{
+			dq[0] = -1.0+2.0*cos(7.0*q[1]);
+			dq[1] = 1.0;
+		}
+		void state_event_func(const double* q, double* z) { z[0] = q[0]; }
+		double time_event_func(const double*) { return DBL_MAX; }
+		void internal_event(double*, const bool*){}
+		void external_event(double*, double, const Bag<double>&){}
+		void confluent_event(double*, const bool*, const Bag<double>&){}
+		void output_func(const double*, const bool*, Bag<double>&){}
+		void gc_output(Bag<double>&){}
+};
+
+/**
+ * The event must be an event of the state of the solver and not only of
+ * the interpolant.
+ */
+void test_wave(wave* sys, ode_solver<double>* solver,
+	event_locator<double>* locator, double tol)
+{
+	double q[2], qstart[2], h;
+	bool events[1];
+	sys->init(q);
+	do
+	{
+		qstart[0] = q[0]; qstart[1] = q[1];
+		h = solver->integrate(q,0.5);
+	}
+	while (!locator->find_events(events,qstart,q,solver,h));
+	assert(events[0]);
+	assert(fabs(q[0]) <= tol);
+}
+
+/**
+ * A BatchHybrid finds the same event as a Hybrid.
+ */
+void test_batch_wave(event_locator_impl<double>::Mode mode, double tol)
+{
+	wave* sys = new wave();
+	Hybrid<double> hybrid(sys,new rk_45<double>(sys,1E-4,0.5),
+		new event_locator_impl<double>(sys,tol,mode));
+	BatchHybrid<double> batch(new wave(),
+		new hybrid_batch<double>(1E-4,0.5,tol,mode));
+	do
+	{
+		assert(hybrid.ta() == batch.ta());
+		hybrid.delta_int();
+		batch.delta_int();
+		assert(hybrid.getState(0) == batch.getState(0));
+		assert(hybrid.getState(1) == batch.getState(1));
+	}
+	while (!hybrid.eventHappened());
+	assert(batch.eventHappened());
+	assert(fabs(batch.getState(0)) <= tol);
+}
+
+void test(ode_solver<double>* solver, event_locator<double>* locator,
+	ball* sys, double tol, int stages)
+{
+	double q[2], qstart[2], qh[2], t = 0.0, h = 0.0;
+	bool events[1];
+	sys->init(q);
+	// Step until the ball passes through the floor
+	do
+	{
+		qstart[0] = q[0]; qstart[1] = q[1];
+		t += h;
+		h = solver->integrate(q,1.0);
+	}
+	while (q[0] > 0.0);
+	assert(solver->denseOutput(qstart,h) != NULL);
+	assert(solver->denseOutput(qstart,h/2.0) == NULL);
+	assert(solver->denseOutput(q,h) == NULL);
+	// Locating the event must not integrate the step again
+	sys->calls = 0;
+	assert(locator->find_events(events,qstart,q,solver,h));
+	assert(events[0]);
+	assert(sys->calls == 1+stages);
+	assert(fabs(q[0]) <= tol);
+	// The state is the end of a solver step from qstart to the event
+	hermite_step<double>* step = solver->denseOutput(qstart,h);
+	assert(step != NULL);
+	step->interpolate(qh,h);
+	assert(qh[0] == q[0] && qh[1] == q[1]);
+	assert(fabs(t+h-sqrt(2.0/9.8)) < 1E-6);
+}
+
+int main()
+{
+	ball* sys = new ball();
+	const double tol = 1E-8;
+	rk_45<double> rk(sys,1E-6,0.1);
+	corrected_euler<double> ce(sys,1E-6,0.1);
+	linear_event_locator<double> linear(sys,tol);
+	bisection_event_locator<double> bisect(sys,tol);
+	test(&rk,&linear,sys,tol,6);
+	test(&rk,&bisect,sys,tol,6);
+	test(&ce,&linear,sys,tol,2);
+	test(&ce,&bisect,sys,tol,2);
+	delete sys;
+	wave* w = new wave();
+	const double wave_tol = 1E-12;
+	rk_45<double> wrk(w,1E-4,0.5);
+	corrected_euler<double> wce(w,1E-4,0.5);
+	linear_event_locator<double> wlinear(w,wave_tol);
+	bisection_event_locator<double> wbisect(w,wave_tol);
+	test_wave(w,&wrk,&wlinear,wave_tol);
+	test_wave(w,&wrk,&wbisect,wave_tol);
+	test_wave(w,&wce,&wlinear,wave_tol);
+	test_wave(w,&wce,&wbisect,wave_tol);
+	delete w;
+	test_batch_wave(event_locator_impl<double>::INTERPOLATE,wave_tol);
+	test_batch_wave(event_locator_impl<double>::BISECTION,wave_tol);
+	cout << "dense output test passed" << endl;
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Checks that the OptSimulator gives the same results as the Simulator:
+ * the final states, the state changes seen by a listener, and the
+ * exceptions thrown by models.
+ */
+#include "ring_fixture.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+using namespace adevs;
+
+/**
+ * Run a ring of w cells, with zero time advances, with both simulators,
+ * stopping at each of the times in stops, and compare the results. The
+ * OptSimulator reports the state changes in time order for each thread,
+ * so they are sorted before they are compared.
+ */
+void test1(long int w, double window, unsigned int interval)
+{
+	recorder serial, opt;
+	CellSpace<double>* a = make_ring(w,-1,-1,true);
+	CellSpace<double>* b = make_ring(w,-1,-1,true);
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(a);
+	OptSimulator<IO_Type>* osim = new OptSimulator<IO_Type>(b);
+	if (window > 0.0) osim->setOptimismWindow(window);
+	osim->setGVTInterval(interval);
+	sim->addEventListener(&serial);
+	osim->addEventListener(&opt);
+	double stops[3] = { 10.0, 10.5, 40.0 };
+	for (int i = 0; i < 3; i++)
+	{
+		sim->execUntil(stops[i]);
+		osim->execUntil(stops[i]);
+		assert(sim->nextEventTime() == osim->nextEventTime());
+		assert(ring_states(a) == ring_states(b));
+	}
+	std::sort(serial.changes.begin(),serial.changes.end());
+	std::sort(opt.changes.begin(),opt.changes.end());
+	assert(serial.changes == opt.changes);
+	assert(serial.outputs == opt.outputs);
+	unsigned long committed = 0;
+	for (int i = 0; i < osim->getLPCount(); i++)
+	{
+		const OptStats& s = osim->getLPStats(i);
+		assert(s.events == s.committed+s.rolled_back);
+		committed += s.committed;
+	}
+	assert(committed > 0);
+	// Asking for a logical process that does not exist is an error
+	try
+	{
+		osim->getLPStats(osim->getLPCount());
+		assert(false);
+	}
+	catch(adevs::exception&) {}
+	delete osim;
+	delete sim;
+	delete a;
+	delete b;
+}
+
+/**
+ * A cell fails. Both simulators throw for it, and the OptSimulator
+ * leaves the models in their states before the step that failed.
+ */
+void test2()
+{
+	CellSpace<double>* a = make_ring(100,40,3,true);
+	CellSpace<double>* b = make_ring(100,40,3,true);
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(a);
+	OptSimulator<IO_Type>* osim = new OptSimulator<IO_Type>(b);
+	double t_fail = -1.0;
+	try
+	{
+		while (sim->nextEventTime() <= 50.0)
+		{
+			t_fail = sim->nextEventTime();
+			sim->execNextEvent();
+		}
+		assert(false);
+	}
+	catch(adevs::exception& err)
+	{
+		assert(static_cast<ring_cell*>(err.who())->x == 40);
+	}
+	bool caught = false;
+	try
+	{
+		osim->execUntil(50.0);
+	}
+	catch(adevs::exception& err)
+	{
+		assert(static_cast<ring_cell*>(err.who())->x == 40);
+		caught = true;
+	}
+	assert(caught);
+	assert(osim->nextEventTime() == t_fail);
+	assert(dynamic_cast<ring_cell*>(b->getModel(40))->steps == 3);
+	delete osim;
+	delete sim;
+	delete a;
+	delete b;
+}
+
+/**
+ * A model without save_state() can not be simulated optimistically.
+ */
+class no_save: public Atomic<IO_Type>
+{
+	public:
+		no_save():Atomic<IO_Type>(){}
+		double ta() { return 1.0; }
+		void delta_int(){}
+		void delta_ext(double, const Bag<IO_Type>&){}
+		void delta_conf(const Bag<IO_Type>&){}
+		void output_func(Bag<IO_Type>&){}
+		void gc_output(Bag<IO_Type>&){}
+};
+
+void test3()
+{
+	no_save* model = new no_save();
+	OptSimulator<IO_Type>* osim = new OptSimulator<IO_Type>(model);
+	bool caught = false;
+	try
+	{
+		osim->execUntil(10.0);
+	}
+	catch(method_not_supported_exception& err)
+	{
+		caught = true;
+	}
+	assert(caught);
+	delete osim;
+	delete model;
+}
+
+int main()
+{
+#ifdef _OPENMP
+	omp_set_num_threads(4);
+#endif
+	test1(200,0.0,256);
+	test1(200,2.0,16);
+	test1(1000,0.0,1);
+	test2();
+	test3();
+	std::cout << "opt simulator test passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Throughput of the ParSimulator on a ring of gcd models. There is one
+ * gcd and one LP for each OpenMP thread. The generator of every gcd is
+ * active and its signal goes to the delay of the next gcd in the ring.
+ * The LPs are coupled all to all. Run with increasing values of
+ * OMP_NUM_THREADS.
+ *
+ * Usage: ./a.out [end time]
+ */
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <omp.h>
+#include "adevs.h"
+#include "gcd.h"
+using namespace std;
+
+// The genr and delay of a gcd can not react to an input in less than 0.5
+class ring_gcd: public gcd
+{
+	public:
+		ring_gcd():gcd(1.0,0.5,1000000000,true){}
+		double lookahead() { return 0.5; }
+};
+
+int main(int argc, char** argv)
+{
+	double tend = (argc > 1) ? atof(argv[1]) : 100000.0;
+	int lps = omp_get_max_threads();
+	if (lps < 2) lps = 2;
+	omp_set_num_threads(lps);
+	adevs::Digraph<object*>* model = new adevs::Digraph<object*>();
+	vector<ring_gcd*> g;
+	for (int i = 0; i < lps; i++)
+	{
+		g.push_back(new ring_gcd());
+		g[i]->setProc(i);
+		model->add(g[i]);
+	}
+	for (int i = 0; i < lps; i++)
+		model->couple(g[i],gcd::signal,g[(i+1)%lps],gcd::in);
+	adevs::ParSimulator<PortValue>* sim =
+		new adevs::ParSimulator<PortValue>(model);
+	double start = omp_get_wtime();
+	sim->execUntil(tend);
+	double elapsed = omp_get_wtime()-start;
+	cout << lps << " LPs, " << elapsed << " s, "
+		<< (double)lps*tend/elapsed << " signals/sec" << endl;
+	delete sim;
+	delete model;
+	return 0;
+}
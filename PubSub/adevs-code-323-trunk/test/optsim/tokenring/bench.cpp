@@ -0,0 +1,55 @@
+/*
+ * Throughput of the ParSimulator on a ring of token passing nodes. There
+ * is one node and one LP for each OpenMP thread, every node starts with a
+ * token, and the LPs are coupled all to all. Run with increasing values
+ * of OMP_NUM_THREADS.
+ *
+ * Usage: ./a.out [end time] [spin|yield|park]
+ */
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+#include "node.h"
+#include "MessageManager.h"
+using namespace std;
+
+int main(int argc, char** argv)
+{
+	double tend = (argc > 1) ? atof(argv[1]) : 200000.0;
+	int lps = omp_get_max_threads();
+	if (lps < 2) lps = 2;
+	omp_set_num_threads(lps);
+	adevs::LpWaitStrategy wait = adevs::LP_SPIN;
+	if (argc > 2 && strcmp(argv[2],"yield") == 0) wait = adevs::LP_YIELD;
+	else if (argc > 2 && strcmp(argv[2],"park") == 0) wait = adevs::LP_PARK;
+	adevs::Digraph<token_t*>* model = new adevs::Digraph<token_t*>();
+	vector<node*> nodes;
+	for (int i = 0; i < lps; i++)
+	{
+		nodes.push_back(new node(i,1,new token_t(i)));
+		model->add(nodes[i]);
+	}
+	for (int i = 0; i < lps; i++)
+		model->couple(nodes[i],node::out,nodes[(i+1)%lps],node::in);
+	adevs::ParSimulator<PortValue>* sim =
+		new adevs::ParSimulator<PortValue>(model,new PortValueMessageManager());
+	sim->setWaitStrategy(wait);
+	double start = omp_get_wtime();
+	sim->execUntil(tend);
+	double elapsed = omp_get_wtime()-start;
+	cout << lps << " LPs, " << elapsed << " s, "
+		<< (double)lps*tend/elapsed << " tokens passed/sec" << endl;
+	for (int i = 0; i < sim->getLPCount(); i++)
+	{
+		const adevs::LpStats& stats = sim->getLPStats(i);
+		cout << "LP " << i << ": " << stats.blocked_time << " s blocked, "
+			<< stats.spins << " spins, " << stats.wakeups << " wakeups, "
+			<< stats.messages << " messages, " << stats.null_messages
+			<< " null messages" << endl;
+	}
+	delete sim;
+	delete model;
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include "node.h"
+#include "Listener.h"
+#include "MessageManager.h"
+
+using namespace std;
+
+// Test 1 with threads that park as soon as they must wait for input
+int main () 
+{
+	adevs::Digraph<token_t*>* model = new adevs::Digraph<token_t*>();
+	node* n1 = new node(0,1,new token_t());
+	node* n2 = new node(1,1,NULL);
+	model->add(n1);
+	model->add(n2);
+	model->couple(n1,n1->out,n2,n2->in);
+	model->couple(n2,n2->out,n1,n1->in);  
+	adevs::ParSimulator<PortValue>* sim = new adevs::ParSimulator<PortValue>(model,new PortValueMessageManager());
+	sim->setWaitStrategy(adevs::LP_PARK,0);
+	sim->addEventListener(new Listener());
+	sim->execUntil(10.0);
+	cout << "End of run!" << endl;
+	// The nodes are on the first two threads. With only one thread
+	// there are no messages between logical processes to count.
+	int lps = std::min(2,sim->getLPCount());
+	for (int i = 0; i < lps; i++)
+	{
+		const adevs::LpStats& stats = sim->getLPStats(i);
+		if (lps > 1)
+		{
+			assert(stats.null_messages > 0);
+			assert(stats.messages > 0);
+		}
+		assert(stats.wakeups <= stats.spins);
+		assert(stats.blocked_time >= 0.0);
+	}
+	// Asking for a logical process that does not exist is an error
+	try
+	{
+		sim->getLPStats(sim->getLPCount());
+		assert(false);
+	}
+	catch(adevs::exception& err) {}
+	delete sim;
+	delete model;
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Checks that the parallel steps of the Simulator (setParallel) give the
+ * same results as the serial steps: the final states, the order of the
+ * state changes seen by a listener, and the exceptions thrown by models.
+ */
+#include "ring_fixture.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+using namespace adevs;
+
+/**
+ * Run a ring of w cells until tend. Returns the final states and fills
+ * the record of state changes.
+ */
+std::vector<double> run(long int w, double tend, unsigned int par_min, recorder& rec)
+{
+	CellSpace<double>* cs = make_ring(w);
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(cs);
+	sim->setParallel(par_min);
+	sim->addEventListener(&rec);
+	sim->execUntil(tend);
+	std::vector<double> v = ring_states(cs);
+	delete sim;
+	delete cs;
+	return v;
+}
+
+void test1(long int w, unsigned int par_min)
+{
+	recorder serial, parallel;
+	std::vector<double> a = run(w,50.0,0,serial);
+	std::vector<double> b = run(w,50.0,par_min,parallel);
+	// Compare the bits, not only the values
+	assert(memcmp(&(a[0]),&(b[0]),sizeof(double)*w) == 0);
+	assert(serial.changes == parallel.changes);
+	assert(serial.outputs == parallel.outputs);
+}
+
+/**
+ * Two cells fail in the same step. Both modes throw for the first of
+ * them. Returns the position of the cell that failed.
+ */
+long int fail(unsigned int par_min)
+{
+	CellSpace<double>* cs = make_ring(100,40,2);
+	// A second cell fails in the same step
+	dynamic_cast<ring_cell*>(cs->getModel(70))->fail_at = 2;
+	Simulator<IO_Type>* sim = new Simulator<IO_Type>(cs);
+	sim->setParallel(par_min);
+	long int failed = -1;
+	try
+	{
+		sim->execUntil(50.0);
+	}
+	catch(adevs::exception& err)
+	{
+		failed = static_cast<ring_cell*>(err.who())->x;
+	}
+	assert(failed != -1);
+	delete sim;
+	delete cs;
+	return failed;
+}
+
+void test2()
+{
+	assert(fail(0) == fail(1));
+}
+
+int main()
+{
+#ifdef _OPENMP
+	omp_set_num_threads(4);
+#endif
+	test1(1000,1);
+	test1(1000,100);
+	test1(5000,1000);
+	test2();
+	std::cout << "parallel step test passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * Checks the assignment of models to processors by the LpPartition and
+ * the LpGraph that it builds from the couplings.
+ */
+#include "adevs.h"
+#include <cassert>
+#include <iostream>
+using namespace adevs;
+
+typedef PortValue<int> PV;
+typedef CellEvent<int> CE;
+
+// A model that does nothing; only its couplings matter
+template <class X> class part_atomic: public Atomic<X>
+{
+	public:
+		part_atomic():Atomic<X>(){}
+		double ta() { return DBL_MAX; }
+		void delta_int(){}
+		void delta_ext(double, const Bag<X>&){}
+		void delta_conf(const Bag<X>&){}
+		void output_func(Bag<X>&){}
+		void gc_output(Bag<X>&){}
+		double lookahead() { return 1.0; }
+};
+
+// A network that does not report its couplings
+class opaque_net: public Network<PV>
+{
+	public:
+		opaque_net():Network<PV>(){ a.setParent(this); }
+		void getComponents(Set<Devs<PV>*>& c) { c.insert(&a); }
+		void route(const PV&, Devs<PV>*, Bag<Event<PV> >&){}
+		part_atomic<PV> a;
+};
+
+int edges(LpGraph& g)
+{
+	int n = 0;
+	for (int i = 0; i < g.getLPCount(); i++)
+		n += g.getE(i).size();
+	return n;
+}
+
+/**
+ * A chain of models is cut into four pieces with three links between them.
+ */
+void test1()
+{
+	Digraph<int> model;
+	part_atomic<PV>* prev = NULL;
+	for (int i = 0; i < 100; i++)
+	{
+		part_atomic<PV>* a = new part_atomic<PV>();
+		model.add(a);
+		if (prev != NULL) model.couple(prev,0,a,0);
+		prev = a;
+	}
+	LpPartition<PV> p(&model,4);
+	assert(p.isComplete());
+	assert(p.getModelCount() == 100);
+	assert(p.getCut() == 3);
+	for (int i = 0; i < 4; i++)
+		assert(p.getLoad(i) == 25);
+	LpGraph g;
+	p.getLpGraph(g);
+	assert(g.getLPCount() == 4);
+	assert(edges(g) == 3);
+}
+
+/**
+ * A torus of cells with a Moore neighborhood is split into balanced parts
+ * that cut far fewer links than a random assignment.
+ */
+void test2()
+{
+	CellSpace<int> cs(40,40);
+	for (long int x = 0; x < 40; x++)
+		for (long int y = 0; y < 40; y++)
+			cs.add(new part_atomic<CE>(),x,y);
+	cs.setMooreNeighborhood(CellSpace<int>::TORUS);
+	LpPartition<CE> p(&cs,4);
+	assert(p.isComplete());
+	for (int i = 0; i < 4; i++)
+		assert(p.getLoad(i) >= 400-13 && p.getLoad(i) <= 400+13);
+	// A random assignment cuts three in four of the 12800 links and
+	// four slabs of 10 x 40 cells cut 960
+	assert(p.getCut() <= 960);
+	p.assign();
+	for (long int x = 0; x < 40; x++)
+		for (long int y = 0; y < 40; y++)
+			assert(cs.getModel(x,y)->getProc() >= 0 && cs.getModel(x,y)->getProc() < 4);
+}
+
+/**
+ * Without a neighborhood the couplings of a CellSpace are unknown and
+ * the cells are cut into slabs.
+ */
+void test3()
+{
+	CellSpace<int> cs(40,10);
+	for (long int x = 0; x < 40; x++)
+		for (long int y = 0; y < 10; y++)
+			cs.add(new part_atomic<CE>(),x,y);
+	LpPartition<CE> p(&cs,4);
+	assert(!p.isComplete());
+	p.assign();
+	for (long int x = 0; x < 40; x++)
+		for (long int y = 0; y < 10; y++)
+			assert(cs.getModel(x,y)->getProc() == x/10);
+}
+
+/**
+ * Assigned models keep their processor and count toward its load. The
+ * links pass through the ports of networks.
+ */
+void test4()
+{
+	Digraph<int> model;
+	// a -> net -> b -> net -> c
+	Digraph<int>* net = new Digraph<int>();
+	part_atomic<PV>* a = new part_atomic<PV>();
+	part_atomic<PV>* b = new part_atomic<PV>();
+	part_atomic<PV>* c = new part_atomic<PV>();
+	net->couple(net,0,b,0);
+	net->couple(b,0,net,1);
+	model.couple(a,0,net,0);
+	model.couple(net,1,c,0);
+	a->setProc(0);
+	net->setProc(1);
+	c->setProc(2);
+	// Nine more in the network and 27 outside of it
+	for (int i = 0; i < 9; i++)
+		net->add(new part_atomic<PV>());
+	for (int i = 0; i < 27; i++)
+		model.add(new part_atomic<PV>());
+	LpPartition<PV> p(&model,4);
+	assert(p.isComplete());
+	assert(p.getModelCount() == 39);
+	for (int i = 0; i < 4; i++)
+		assert(p.getLoad(i) == 10 || (i == 3 && p.getLoad(i) == 9));
+	p.assign();
+	assert(a->getProc() == 0);
+	assert(b->getProc() == ADEVS_NOT_ASSIGNED_TO_PROCESSOR);
+	assert(c->getProc() == 2);
+	LpGraph g;
+	p.getLpGraph(g);
+	assert(edges(g) == 2);
+	assert(g.getE(0).size() == 1 && g.getE(0)[0] == 1);
+	assert(g.getE(1).size() == 1 && g.getE(1)[0] == 2);
+}
+
+/**
+ * A network that does not report its couplings.
+ */
+void test5()
+{
+	Digraph<int> model;
+	model.add(new opaque_net());
+	model.add(new part_atomic<PV>());
+	LpPartition<PV> p(&model,2);
+	assert(!p.isComplete());
+	assert(p.getModelCount() == 2);
+	assert(p.getLoad(0) == 1 && p.getLoad(1) == 1);
+}
+
+/**
+ * Returns true if every pair of processors that exchange messages in the
+ * partition has an edge in g.
+ */
+template <class X> bool fits(LpPartition<X>& p, LpGraph& g)
+{
+	LpGraph h;
+	p.getLpGraph(h);
+	for (int i = 0; i < h.getLPCount(); i++)
+		for (unsigned int j = 0; j < h.getE(i).size(); j++)
+			if (!g.hasEdge(i,h.getE(i)[j])) return false;
+	return true;
+}
+
+/**
+ * The parts of a chain are renamed and moved to fit an LpGraph that does
+ * not have the edges of the cut, and the ParSimulator uses the same
+ * assignment.
+ */
+void test6()
+{
+	Digraph<int> model;
+	part_atomic<PV>* first = NULL, *prev = NULL;
+	for (int i = 0; i < 90; i++)
+	{
+		part_atomic<PV>* a = new part_atomic<PV>();
+		model.add(a);
+		if (prev != NULL) model.couple(prev,0,a,0);
+		else first = a;
+		prev = a;
+	}
+	// The chain runs backwards through two processors
+	LpGraph g2;
+	g2.addEdge(1,0);
+	LpPartition<PV> p2(&model,2);
+	assert(!fits(p2,g2));
+	assert(p2.fit(g2));
+	assert(fits(p2,g2));
+	assert(p2.getLoad(0) == 45 && p2.getLoad(1) == 45);
+	// and through three in the order 0, 2, 1
+	LpGraph g3;
+	g3.addEdge(0,2);
+	g3.addEdge(2,1);
+	LpPartition<PV> p3(&model,3);
+	assert(p3.fit(g3));
+	assert(fits(p3,g3));
+	assert(p3.getCut() == 2);
+	omp_set_num_threads(3);
+	ParSimulator<PV>* sim = new ParSimulator<PV>(&model,g3);
+	assert(first->getProc() == 0);
+	assert(prev->getProc() == 1);
+	delete sim;
+}
+
+/**
+ * Models that the user assigned to processors without an edge between
+ * them can not be fit to the LpGraph.
+ */
+void test7()
+{
+	Digraph<int> model;
+	part_atomic<PV>* a = new part_atomic<PV>();
+	part_atomic<PV>* b = new part_atomic<PV>();
+	model.couple(a,0,b,0);
+	a->setProc(0);
+	b->setProc(1);
+	LpGraph g;
+	g.addEdge(1,0);
+	LpPartition<PV> p(&model,2);
+	assert(!p.fit(g));
+	bool thrown = false;
+	try
+	{
+		ParSimulator<PV> sim(&model,g);
+	}
+	catch(adevs::exception&)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+int main()
+{
+	test1();
+	test2();
+	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	std::cout << "partition test passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * A ring of cells and a listener that records their state changes, for
+ * the tests that compare the parallel simulators with the Simulator.
+ */
+#ifndef _ring_fixture_h_
+#define _ring_fixture_h_
+#include "adevs.h"
+#include <cmath>
+#include <vector>
+
+typedef adevs::CellEvent<double> IO_Type;
+
+/**
+ * A cell on a ring that sends its state to both neighbors. The time
+ * advance is 1, 2, or 3 so that many cells change at the same time.
+ * If zero_ta is true, then every fifth internal event is followed by
+ * one at the same time and the lookahead is zero; otherwise the
+ * lookahead is 1. The cell throws an exception at internal event
+ * number fail_at. The inputs are summed so that their order does not
+ * matter.
+ */
+class ring_cell: public adevs::Atomic<IO_Type>
+{
+	public:
+		ring_cell(long int x, long int w, double v, int fail_at = -1, bool zero_ta = false):
+		adevs::Atomic<IO_Type>(),x(x),w(w),v(v),steps(0),fail_at(fail_at),zero_ta(zero_ta){}
+		double ta()
+		{
+			if (zero_ta && steps%5 == 4) return 0.0;
+			return 1.0+(double)(((long int)(fabs(v)*1000.0))%3);
+		}
+		void delta_int()
+		{
+			if (steps++ == fail_at)
+			{
+				adevs::exception err("ring_cell failed",this);
+				throw err;
+			}
+			v = 0.5*v+0.25;
+		}
+		void delta_ext(double e, const adevs::Bag<IO_Type>& xb)
+		{
+			double sum = 0.0;
+			adevs::Bag<IO_Type>::const_iterator iter = xb.begin();
+			for (; iter != xb.end(); iter++)
+				sum += (*iter).value;
+			v = sin(v+e+sum);
+		}
+		void delta_conf(const adevs::Bag<IO_Type>& xb)
+		{
+			delta_int();
+			delta_ext(0.0,xb);
+		}
+		void output_func(adevs::Bag<IO_Type>& yb)
+		{
+			IO_Type e;
+			e.y = e.z = 0;
+			e.value = v*v;
+			e.x = (x+1)%w;
+			yb.insert(e);
+			e.x = (x+w-1)%w;
+			yb.insert(e);
+		}
+		void gc_output(adevs::Bag<IO_Type>&){}
+		double lookahead() { return zero_ta ? 0.0 : 1.0; }
+		void* save_state() { return new state_t(v,steps); }
+		void restore_state(void* data)
+		{
+			v = static_cast<state_t*>(data)->v;
+			steps = static_cast<state_t*>(data)->steps;
+		}
+		void gc_state(void* data) { delete static_cast<state_t*>(data); }
+		long int x, w;
+		double v;
+		int steps, fail_at;
+	private:
+		bool zero_ta;
+		struct state_t
+		{
+			state_t(double v, int steps):v(v),steps(steps){}
+			double v;
+			int steps;
+		};
+};
+
+/**
+ * Make a ring of w cells. The cell at fail_x fails at its internal
+ * event number fail_at.
+ */
+inline adevs::CellSpace<double>* make_ring(long int w, int fail_x = -1,
+	int fail_at = -1, bool zero_ta = false)
+{
+	adevs::CellSpace<double>* cs = new adevs::CellSpace<double>(w);
+	for (long int x = 0; x < w; x++)
+		cs->add(new ring_cell(x,w,(double)x/(double)w,(x == fail_x) ? fail_at : -1,zero_ta),x);
+	return cs;
+}
+
+/// Get the states of the cells in a ring
+inline std::vector<double> ring_states(adevs::CellSpace<double>* cs)
+{
+	std::vector<double> v;
+	for (long int x = 0; x < cs->getWidth(); x++)
+		v.push_back(dynamic_cast<ring_cell*>(cs->getModel(x))->v);
+	return v;
+}
+
+/**
+ * Records the state changes of the cells in the order they are reported
+ * and counts the output events.
+ */
+class recorder: public adevs::EventListener<IO_Type>
+{
+	public:
+		recorder():outputs(0){}
+		void outputEvent(adevs::Event<IO_Type>, double) { outputs++; }
+		void stateChange(adevs::Atomic<IO_Type>* model, double t)
+		{
+			ring_cell* c = dynamic_cast<ring_cell*>(model);
+			changes.push_back(change(c->x,t,c->v));
+		}
+		struct change
+		{
+			change(long int x, double t, double v):x(x),t(t),v(v){}
+			long int x;
+			double t, v;
+			bool operator<(const change& other) const
+			{
+				if (t != other.t) return t < other.t;
+				if (x != other.x) return x < other.x;
+				return v < other.v;
+			}
+			bool operator==(const change& other) const
+			{
+				return x == other.x && t == other.t && v == other.v;
+			}
+		};
+		std::vector<change> changes;
+		long int outputs;
+};
+
+#endif
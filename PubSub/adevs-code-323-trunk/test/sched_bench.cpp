@@ -0,0 +1,115 @@
+/*
+ * Hold model benchmark for the schedulers. A queue of N models is filled
+ * with random event times, then each hold removes the imminent model and
+ * schedules it again at the current time plus a random increment. The
+ * throughput of the Schedule, Heap4Schedule and CalendarSchedule is
+ * reported for queue sizes from 100 to 1000000 and several increment
+ * distributions.
+ *
+ * Usage: ./a.out [holds per run]
+ */
+#include "adevs_sched.h"
+#include "adevs_heap4_sched.h"
+#include "adevs_calendar_sched.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <sys/time.h>
+using namespace adevs;
+
+class bogus_atomic: public Atomic<char>
+{
+	public:
+		bogus_atomic():
+		Atomic<char>(){}
+		void delta_int(){}
+		void delta_ext(double, const Bag<char>&){}
+		void delta_conf(const Bag<char>&){}
+		void output_func(Bag<char>&){}
+		void gc_output(Bag<char>&){}
+		double ta() { return 0.0; }
+};
+
+// A small generator so every queue sees the same increments
+class xorshift
+{
+	public:
+		xorshift():s(88172645463325252ULL){}
+		double uniform()
+		{
+			s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+			return (double)(s >> 11)*(1.0/9007199254740992.0);
+		}
+	private:
+		unsigned long long s;
+};
+
+typedef enum { EXPONENTIAL, UNIFORM, TRIANGULAR, BIMODAL, LOCKSTEP } dist_t;
+static const char* dist_names[] =
+	{ "exponential", "uniform", "triangular", "bimodal", "lockstep" };
+
+double increment(xorshift& r, dist_t dist)
+{
+	switch (dist)
+	{
+		case EXPONENTIAL: return -log(1.0-r.uniform());
+		case UNIFORM: return 2.0*r.uniform();
+		case TRIANGULAR: return 1.5*(r.uniform()+r.uniform());
+		// Mostly short increments and a few very long ones
+		case BIMODAL:
+			return (r.uniform() < 0.9) ? 0.1*r.uniform() : 100.0+900.0*r.uniform();
+		// Every model advances by the same step, like a cell space
+		default: return 1.0;
+	}
+}
+
+double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return tv.tv_sec+tv.tv_usec*1E-6;
+}
+
+// Returns millions of holds per second
+template <class Q> double hold(std::vector<bogus_atomic>& m, dist_t dist, long holds)
+{
+	Q q;
+	xorshift r;
+	for (unsigned int i = 0; i < m.size(); i++)
+		q.schedule(&(m[i]),increment(r,dist));
+	// Let the event times settle into the steady state
+	for (unsigned int i = 0; i < m.size(); i++)
+		q.schedule(q.getMinimum(),q.minPriority()+increment(r,dist));
+	double start = now();
+	for (long i = 0; i < holds; i++)
+		q.schedule(q.getMinimum(),q.minPriority()+increment(r,dist));
+	double elapsed = now()-start;
+	for (unsigned int i = 0; i < m.size(); i++)
+		q.schedule(&(m[i]),DBL_MAX);
+	return holds/elapsed/1E6;
+}
+
+int main(int argc, char** argv)
+{
+	long holds = (argc > 1) ? atol(argv[1]) : 2000000;
+	std::cout << "Millions of holds per second, " << holds << " holds per run" << std::endl;
+	std::cout << std::setw(12) << "dist" << std::setw(9) << "size"
+		<< std::setw(10) << "heap" << std::setw(10) << "heap4"
+		<< std::setw(10) << "calendar" << std::endl;
+	for (int d = EXPONENTIAL; d <= LOCKSTEP; d++)
+	{
+		for (unsigned int n = 100; n <= 1000000; n *= 10)
+		{
+			std::vector<bogus_atomic> m(n);
+			std::cout << std::setw(12) << dist_names[d] << std::setw(9) << n
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(10) << hold<Schedule<char> >(m,(dist_t)d,holds)
+				<< std::setw(10) << hold<Heap4Schedule<char> >(m,(dist_t)d,holds)
+				<< std::setw(10) << hold<CalendarSchedule<char> >(m,(dist_t)d,holds)
+				<< std::endl;
+		}
+	}
+	return 0;
+}
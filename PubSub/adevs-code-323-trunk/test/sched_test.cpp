@@ -1,4 +1,6 @@
 #include "adevs_sched.h"
+#include "adevs_heap4_sched.h"
+#include "adevs_calendar_sched.h"
 #include <iostream>
 #include <cassert>
 using namespace adevs;
@@ -16,9 +18,9 @@ class bogus_atomic: public Atomic<char>
 		double ta() { return 0.0; }
 };
 	
-void testa()
+template <class Q> void testa()
 {
-	Schedule<char> q;
+	Q q;
 	bogus_atomic m;
 	q.schedule(&m,0.0);
 	q.removeMinimum();
@@ -27,11 +29,11 @@ void testa()
 	assert(q.minPriority() == 1.0);
 }
 
-void test1()
+template <class Q> void test1()
 {
 	int i;
 	bogus_atomic m[10];
-	Schedule<char> q;
+	Q q;
 	for (i = 0; i < 10; i++)
 	{
 		q.schedule(&(m[i]),(double)i);
@@ -46,10 +48,10 @@ void test1()
 	}
 }
 
-void test2()
+template <class Q> void test2()
 {
 	bogus_atomic m[5];
-	Schedule<char> q;
+	Q q;
 	q.schedule(&(m[0]),1.0);
 	q.schedule(&(m[1]),10.0);
 	q.schedule(&(m[2]),5.0);
@@ -68,10 +70,10 @@ void test2()
 	q.removeMinimum();
 }
 
-void test3()
+template <class Q> void test3()
 {
 	bogus_atomic m[3];
-	Schedule<char> q;
+	Q q;
 	q.schedule(&(m[0]),5.0);
 	q.schedule(&(m[1]),10.0);
 	q.schedule(&(m[2]),1.0);
@@ -81,9 +83,9 @@ void test3()
 	assert(q.minPriority() == 10.0);
 }
 
-void test4()
+template <class Q> void test4()
 {
-	Schedule<char> q;
+	Q q;
 	assert(q.minPriority() == DBL_MAX);
 	assert(q.getMinimum() == NULL);
 	bogus_atomic m[200];
@@ -107,10 +109,10 @@ void test4()
 	assert(q.minPriority() == DBL_MAX);
 }
 
-void test5()
+template <class Q> void test5()
 {
 	bogus_atomic m[2];
-	Schedule<char> q;
+	Q q;
 	q.schedule(&(m[0]),2.0);
 	q.schedule(&(m[1]),3.0);
 	q.schedule(&(m[1]),DBL_MAX);
@@ -118,10 +120,10 @@ void test5()
 	assert(q.getMinimum() == &(m[0]));
 }
 
-void test6()
+template <class Q> void test6()
 {
 	bogus_atomic m[2];
-	Schedule<char> q;
+	Q q;
 	q.schedule(&(m[0]),1.0);
 	q.schedule(&(m[1]),1.0);
 	q.schedule(&(m[0]),DBL_MAX);
@@ -129,10 +131,10 @@ void test6()
 	assert(q.minPriority() == 1.0);
 }
 
-void test7()
+template <class Q> void test7()
 {
 	bogus_atomic m[2];
-	Schedule<char> q;
+	Q q;
 	q.schedule(&(m[0]),2.0);
 	q.schedule(&(m[1]),3.0);
 	q.schedule(&(m[0]),4.0);
@@ -144,10 +146,10 @@ void test7()
 	assert(q.getMinimum() == &(m[1]));
 }
 
-void test8()
+template <class Q> void test8()
 {
 	bogus_atomic m[2000];
-	Schedule<char> q;
+	Q q;
 	for (int i = 0; i < 2000; i++)
 	{
 		q.schedule(&(m[i]),(double)i);
@@ -159,11 +161,11 @@ void test8()
 	}
 }
 
-void test9()
+template <class Q> void test9()
 {
 	int i;
 	bogus_atomic m[20];
-	Schedule<char> q;
+	Q q;
 	for (i = 0; i < 10; i++)
 	{
 		q.schedule(&(m[i]),1.0);
@@ -189,11 +191,11 @@ class test10visitor:
 		Bag<Atomic<char>*>& imm;
 };
 
-void test10()
+template <class Q> void test10()
 {
 	int i;
 	bogus_atomic m[20];
-	Schedule<char> q;
+	Q q;
 	Bag<Atomic<char>*> imm;
 	test10visitor* visitor = new test10visitor(imm);
 	q.visitImminent(visitor);
@@ -227,18 +229,67 @@ void test10()
 	}
 }
 
+// Random moves and removals must give the same event times as the Schedule
+template <class Q> void test11()
+{
+	bogus_atomic m[500], r[500];
+	Q q;
+	Schedule<char> ref;
+	srand(11);
+	for (int i = 0; i < 20000; i++)
+	{
+		int k = rand()%500;
+		double t;
+		switch (rand()%8)
+		{
+			case 0: t = DBL_MAX; break;
+			case 1: t = ref.minPriority(); break;
+			case 2: t = (double)(rand()%10); break;
+			case 3: t = 1E9*(double)rand(); break;
+			default: t = (double)rand()/(double)RAND_MAX; break;
+		}
+		q.schedule(&(m[k]),t);
+		ref.schedule(&(r[k]),t);
+		assert(q.getSize() == ref.getSize());
+		assert(q.minPriority() == ref.minPriority());
+		// Remove the same model from both, ties may be ordered differently
+		if (rand()%4 == 0 && !ref.empty())
+		{
+			k = static_cast<bogus_atomic*>(ref.getMinimum())-r;
+			q.schedule(&(m[k]),DBL_MAX);
+			ref.removeMinimum();
+		}
+	}
+	while (!ref.empty())
+	{
+		assert(q.minPriority() == ref.minPriority());
+		q.removeMinimum();
+		ref.removeMinimum();
+	}
+	assert(q.empty());
+	assert(q.getMinimum() == NULL);
+}
+
+template <class Q> void test_all()
+{
+	testa<Q>();
+	test1<Q>();
+	test2<Q>();
+	test3<Q>();
+	test4<Q>();
+	test5<Q>();
+	test6<Q>();
+	test7<Q>();
+	test8<Q>();
+	test9<Q>();
+	test10<Q>();
+	test11<Q>();
+}
+
 int main () 
 {
-	testa();
-	test1();
-	test2();
-	test3();
-	test4();
-	test5();
-	test6();
-	test7();
-	test8();
-	test9();
-	test10();
+	test_all<Schedule<char> >();
+	test_all<Heap4Schedule<char> >();
+	test_all<CalendarSchedule<char> >();
 	return 0;
 }
@@ -31,6 +31,13 @@
 #include <sys/uio.h>
 #include <math.h>
 
+/* Entries of the iovec array writeToClient() passes to writev(). */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define NET_MAX_IOV IOV_MAX
+#else
+#define NET_MAX_IOV 1024
+#endif
+
 static void setProtocolError(client *c, int pos);
 
 /* Return the size consumed from the allocator, for the specified SDS string,
@@ -120,10 +127,8 @@ client *createClient(int fd) {
     c->woff = 0;
     c->watched_keys = listCreate();
     c->pubsub_channels = dictCreate(&setDictType,NULL);
-    c->pubsub_patterns = listCreate();
+    c->pubsub_patterns = dictCreate(&setDictType,NULL);
     c->peerid = NULL;
-    listSetFreeMethod(c->pubsub_patterns,decrRefCountVoid);
-    listSetMatchMethod(c->pubsub_patterns,listMatchObjects);
     if (fd != -1) listAddNodeTail(server.clients,c);
     initClientMultiState(c);
     return c;
@@ -189,6 +194,18 @@ int prepareClientToWrite(client *c) {
     return C_OK;
 }
 
+/* Return true if the reply list can append to its last object 'tail'. The
+ * object is copied first if it is shared, but never if it is as large as the
+ * PUBLISH frames queued by addReplyShared(): copying those is what sharing
+ * them avoids. */
+static int canAppendToTail(robj *tail, size_t len) {
+    return tail->ptr != NULL &&
+           tail->encoding == OBJ_ENCODING_RAW &&
+           (tail->refcount == 1 ||
+            sdslen(tail->ptr) < PROTO_SHARED_REPLY_MIN) &&
+           sdslen(tail->ptr)+len <= PROTO_REPLY_CHUNK_BYTES;
+}
+
 /* Create a duplicate of the last object in the reply list when
  * it is not exclusively owned by the reply list. */
 robj *dupLastObjectIfNeeded(list *reply) {
@@ -239,10 +256,7 @@ void _addReplyObjectToList(client *c, robj *o) {
         tail = listNodeValue(listLast(c->reply));
 
         /* Append to this object when possible. */
-        if (tail->ptr != NULL &&
-            tail->encoding == OBJ_ENCODING_RAW &&
-            sdslen(tail->ptr)+sdslen(o->ptr) <= PROTO_REPLY_CHUNK_BYTES)
-        {
+        if (canAppendToTail(tail,sdslen(o->ptr))) {
             c->reply_bytes -= sdsZmallocSize(tail->ptr);
             tail = dupLastObjectIfNeeded(c->reply);
             tail->ptr = sdscatlen(tail->ptr,o->ptr,sdslen(o->ptr));
@@ -273,9 +287,7 @@ void _addReplySdsToList(client *c, sds s) {
         tail = listNodeValue(listLast(c->reply));
 
         /* Append to this object when possible. */
-        if (tail->ptr != NULL && tail->encoding == OBJ_ENCODING_RAW &&
-            sdslen(tail->ptr)+sdslen(s) <= PROTO_REPLY_CHUNK_BYTES)
-        {
+        if (canAppendToTail(tail,sdslen(s))) {
             c->reply_bytes -= sdsZmallocSize(tail->ptr);
             tail = dupLastObjectIfNeeded(c->reply);
             tail->ptr = sdscatlen(tail->ptr,s,sdslen(s));
@@ -303,9 +315,7 @@ void _addReplyStringToList(client *c, const char *s, size_t len) {
         tail = listNodeValue(listLast(c->reply));
 
         /* Append to this object when possible. */
-        if (tail->ptr != NULL && tail->encoding == OBJ_ENCODING_RAW &&
-            sdslen(tail->ptr)+len <= PROTO_REPLY_CHUNK_BYTES)
-        {
+        if (canAppendToTail(tail,len)) {
             c->reply_bytes -= sdsZmallocSize(tail->ptr);
             tail = dupLastObjectIfNeeded(c->reply);
             tail->ptr = sdscatlen(tail->ptr,s,len);
@@ -325,6 +335,24 @@ void _addReplyStringToList(client *c, const char *s, size_t len) {
  * The following functions are the ones that commands implementations will call.
  * -------------------------------------------------------------------------- */
 
+/* Queue a reference to 'obj', a raw encoded string holding ready to send
+ * protocol, instead of copying it. The same object can be queued to any
+ * number of clients: PUBLISH encodes a message once and every subscriber
+ * sends it from the same buffer. Each client still accounts for the whole
+ * object in its output buffer limits. */
+void addReplyShared(client *c, robj *obj) {
+    serverAssert(obj->encoding == OBJ_ENCODING_RAW);
+    if (prepareClientToWrite(c) != C_OK) return;
+    if (c->flags & CLIENT_CLOSE_AFTER_REPLY) return;
+
+    /* Anything already in the static buffer is written before the list,
+     * so the order of the replies is kept. */
+    incrRefCount(obj);
+    listAddNodeTail(c->reply,obj);
+    c->reply_bytes += getStringObjectSdsUsedMemory(obj);
+    asyncCloseClientOnOutputBufferLimitReached(c);
+}
+
 void addReply(client *c, robj *obj) {
     if (prepareClientToWrite(c) != C_OK) return;
 
@@ -824,7 +852,7 @@ void freeClient(client *c) {
     pubsubUnsubscribeAllChannels(c,0);
     pubsubUnsubscribeAllPatterns(c,0);
     dictRelease(c->pubsub_channels);
-    listRelease(c->pubsub_patterns);
+    dictRelease(c->pubsub_patterns);
 
     /* Free data structures. */
     listRelease(c->reply);
@@ -896,50 +924,103 @@ void freeClientsInAsyncFreeQueue(void) {
     }
 }
 
+/* Fill 'iov' with the pending output of the client: what is left of the
+ * static buffer, then the objects of the reply list, the first of them
+ * starting at 'sentlen' when the buffer is empty. At most 'iovmax' entries
+ * are used and no more objects are added once 'maxbytes' are gathered.
+ * Returns the number of entries and sets '*len' to the bytes they hold. */
+static int clientReplyToIov(client *c, struct iovec *iov, int iovmax,
+                            size_t maxbytes, size_t *len)
+{
+    size_t offset = c->sentlen, total = 0;
+    int iovcnt = 0;
+    listNode *ln;
+    listIter li;
+
+    if (c->bufpos > 0) {
+        iov[iovcnt].iov_base = c->buf+offset;
+        iov[iovcnt].iov_len = c->bufpos-offset;
+        total += iov[iovcnt++].iov_len;
+        offset = 0;
+    }
+    listRewind(c->reply,&li);
+    while(iovcnt < iovmax && total < maxbytes && (ln = listNext(&li))) {
+        robj *o = listNodeValue(ln);
+        size_t objlen = sdslen(o->ptr);
+
+        if (objlen > offset) {
+            iov[iovcnt].iov_base = ((char*)o->ptr)+offset;
+            iov[iovcnt].iov_len = objlen-offset;
+            total += iov[iovcnt++].iov_len;
+        }
+        offset = 0;
+    }
+    *len = total;
+    return iovcnt;
+}
+
+/* Account 'nwritten' bytes of the pending output as sent: advance
+ * 'sentlen', empty the static buffer and release the reply objects that
+ * were written entirely, together with the empty objects in front of the
+ * first one that was not. */
+static void clientReplyWritten(client *c, size_t nwritten) {
+    if (c->bufpos > 0) {
+        size_t left = c->bufpos-c->sentlen;
+
+        if (nwritten < left) {
+            c->sentlen += nwritten;
+            return;
+        }
+        nwritten -= left;
+        c->bufpos = 0;
+        c->sentlen = 0;
+    }
+    while(listLength(c->reply)) {
+        robj *o = listNodeValue(listFirst(c->reply));
+        size_t left = sdslen(o->ptr)-c->sentlen;
+
+        if (nwritten < left) {
+            c->sentlen += nwritten;
+            return;
+        }
+        nwritten -= left;
+        c->reply_bytes -= getStringObjectSdsUsedMemory(o);
+        listDelNode(c->reply,listFirst(c->reply));
+        c->sentlen = 0;
+    }
+}
+
 /* Write data in output buffers to client. Return C_OK if the client
- * is still valid after the call, C_ERR if it was freed. */
+ * is still valid after the call, C_ERR if it was freed.
+ *
+ * The static buffer and the reply list are sent together with writev(),
+ * so a client with a long reply list, like a busy Pub/Sub subscriber,
+ * needs a single syscall for up to NET_MAX_WRITES_PER_EVENT bytes instead
+ * of one per reply object. */
 int writeToClient(int fd, client *c, int handler_installed) {
     ssize_t nwritten = 0, totwritten = 0;
-    size_t objlen;
-    size_t objmem;
-    robj *o;
+    struct iovec iov[NET_MAX_IOV];
+    size_t len;
+    int iovcnt;
 
     while(clientHasPendingReplies(c)) {
-        if (c->bufpos > 0) {
-            nwritten = write(fd,c->buf+c->sentlen,c->bufpos-c->sentlen);
-            if (nwritten <= 0) break;
-            c->sentlen += nwritten;
-            totwritten += nwritten;
-
-            /* If the buffer was sent, set bufpos to zero to continue with
-             * the remainder of the reply. */
-            if ((int)c->sentlen == c->bufpos) {
-                c->bufpos = 0;
-                c->sentlen = 0;
-            }
-        } else {
-            o = listNodeValue(listFirst(c->reply));
-            objlen = sdslen(o->ptr);
-            objmem = getStringObjectSdsUsedMemory(o);
-
-            if (objlen == 0) {
-                listDelNode(c->reply,listFirst(c->reply));
-                c->reply_bytes -= objmem;
-                continue;
-            }
+        iovcnt = clientReplyToIov(c,iov,NET_MAX_IOV,
+                                  NET_MAX_WRITES_PER_EVENT,&len);
+        if (len == 0) {
+            /* Only empty objects are left. */
+            clientReplyWritten(c,0);
+            continue;
+        }
+        nwritten = writev(fd,iov,iovcnt);
+        server.stat_net_output_writes++;
+        if (nwritten <= 0) break;
+        clientReplyWritten(c,nwritten);
+        totwritten += nwritten;
 
-            nwritten = write(fd, ((char*)o->ptr)+c->sentlen,objlen-c->sentlen);
-            if (nwritten <= 0) break;
-            c->sentlen += nwritten;
-            totwritten += nwritten;
+        /* A short write means the socket buffer is full: the next call
+         * would just fail with EAGAIN. */
+        if ((size_t)nwritten < len) break;
 
-            /* If we fully sent the object on head go to the next one */
-            if (c->sentlen == objlen) {
-                listDelNode(c->reply,listFirst(c->reply));
-                c->sentlen = 0;
-                c->reply_bytes -= objmem;
-            }
-        }
         /* Note that we avoid to send more than NET_MAX_WRITES_PER_EVENT
          * bytes, in a single threaded server it's a good idea to serve
          * other clients as well, even if a very large request comes from
@@ -948,11 +1029,11 @@ int writeToClient(int fd, client *c, int handler_installed) {
          *
          * However if we are over the maxmemory limit we ignore that and
          * just deliver as much data as it is possible to deliver. */
-        server.stat_net_output_bytes += totwritten;
         if (totwritten > NET_MAX_WRITES_PER_EVENT &&
             (server.maxmemory == 0 ||
              zmalloc_used_memory() < server.maxmemory)) break;
     }
+    server.stat_net_output_bytes += totwritten;
     if (nwritten == -1) {
         if (errno == EAGAIN) {
             nwritten = 0;
@@ -1455,7 +1536,7 @@ sds catClientInfoString(sds s, client *client) {
         flags,
         client->db->id,
         (int) dictSize(client->pubsub_channels),
-        (int) listLength(client->pubsub_patterns),
+        (int) dictSize(client->pubsub_patterns),
         (client->flags & CLIENT_MULTI) ? client->mstate.count : -1,
         (unsigned long long) sdslen(client->querybuf),
         (unsigned long long) sdsavail(client->querybuf),
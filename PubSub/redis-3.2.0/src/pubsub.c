@@ -47,10 +47,302 @@ int listMatchPubsubPattern(void *a, void *b) {
            (equalStringObjects(pa->pattern,pb->pattern));
 }
 
+/*-----------------------------------------------------------------------------
+ * Pattern index
+ *
+ * On PUBLISH only the patterns whose literal prefix is a prefix of the
+ * channel can match. The radix tree in server.pubsub_pattern_index is walked
+ * along the channel name, so the cost of a PUBLISH depends on the length of
+ * the channel and on the patterns that share a prefix with it, not on the
+ * total number of patterns. Patterns without glob characters and patterns of
+ * the form "<prefix>*" don't even need stringmatchlen().
+ *----------------------------------------------------------------------------*/
+
+#define PUBSUB_PATTERN_EXACT 0
+#define PUBSUB_PATTERN_PREFIX 1
+#define PUBSUB_PATTERN_GLOB 2
+
+/* Return the length of the literal prefix of 'pattern' and set '*kind' to
+ * one of the PUBSUB_PATTERN_* kinds. */
+static size_t pubsubPatternPrefix(sds pattern, int *kind) {
+    size_t len = sdslen(pattern), j;
+
+    for (j = 0; j < len; j++) {
+        char ch = pattern[j];
+        if (ch == '*' || ch == '?' || ch == '[' || ch == '\\') break;
+    }
+    if (j == len)
+        *kind = PUBSUB_PATTERN_EXACT;
+    else if (j == len-1 && pattern[j] == '*')
+        *kind = PUBSUB_PATTERN_PREFIX;
+    else
+        *kind = PUBSUB_PATTERN_GLOB;
+    return j;
+}
+
+static pubsubPatternNode *pubsubCreatePatternNode(const char *label, size_t len) {
+    pubsubPatternNode *node = zcalloc(sizeof(*node));
+
+    node->label = sdsnewlen(label,len);
+    return node;
+}
+
+static void pubsubFreePatternNode(pubsubPatternNode *node) {
+    sdsfree(node->label);
+    zfree(node->children);
+    zfree(node);
+}
+
+/* Create the empty index. The root has an empty label. */
+pubsubPatternNode *pubsubCreatePatternIndex(void) {
+    return pubsubCreatePatternNode("",0);
+}
+
+static list **pubsubPatternNodeList(pubsubPatternNode *node, int kind) {
+    if (kind == PUBSUB_PATTERN_EXACT) return &node->exact;
+    if (kind == PUBSUB_PATTERN_PREFIX) return &node->prefix;
+    return &node->glob;
+}
+
+/* Return the index of the child whose label starts with 'c', or, if there
+ * is none, -1 minus the position where such a child would be inserted. */
+static int pubsubPatternNodeChild(pubsubPatternNode *node, unsigned char c) {
+    int lo = 0, hi = node->numchildren-1;
+
+    while (lo <= hi) {
+        int mid = (lo+hi)/2;
+        unsigned char m = node->children[mid]->label[0];
+
+        if (m == c) return mid;
+        if (m < c) lo = mid+1;
+        else hi = mid-1;
+    }
+    return -lo-1;
+}
+
+static void pubsubPatternNodeInsertChild(pubsubPatternNode *node, int pos,
+                                         pubsubPatternNode *child)
+{
+    node->children = zrealloc(node->children,
+                              sizeof(child)*(node->numchildren+1));
+    memmove(node->children+pos+1,node->children+pos,
+            sizeof(child)*(node->numchildren-pos));
+    node->children[pos] = child;
+    node->numchildren++;
+}
+
+static void pubsubPatternNodeRemoveChild(pubsubPatternNode *node, int pos) {
+    memmove(node->children+pos,node->children+pos+1,
+            sizeof(node->children[0])*(node->numchildren-pos-1));
+    node->numchildren--;
+}
+
+/* Add a pattern to the index. */
+static void pubsubIndexAddPattern(pubsubPattern *pat) {
+    pubsubPatternNode *node = server.pubsub_pattern_index;
+    sds p = pat->pattern->ptr;
+    int kind;
+    size_t len = pubsubPatternPrefix(p,&kind), i = 0;
+    list **l;
+
+    while (i < len) {
+        int j = pubsubPatternNodeChild(node,p[i]);
+        pubsubPatternNode *child;
+        size_t common = 0, clen;
+
+        if (j < 0) {
+            /* No child shares the next byte: the rest of the prefix
+             * becomes a new leaf. */
+            child = pubsubCreatePatternNode(p+i,len-i);
+            pubsubPatternNodeInsertChild(node,-j-1,child);
+            node = child;
+            break;
+        }
+        child = node->children[j];
+        clen = sdslen(child->label);
+        while (common < clen && i+common < len &&
+               child->label[common] == p[i+common]) common++;
+        if (common < clen) {
+            /* The prefix ends or differs inside of the child's label:
+             * split the child in two. */
+            pubsubPatternNode *mid = pubsubCreatePatternNode(child->label,
+                                                             common);
+            sdsrange(child->label,common,-1);
+            pubsubPatternNodeInsertChild(mid,0,child);
+            node->children[j] = mid;
+            child = mid;
+        }
+        node = child;
+        i += common;
+    }
+    l = pubsubPatternNodeList(node,kind);
+    if (*l == NULL) *l = listCreate();
+    listAddNodeTail(*l,pat);
+    pat->index_node = listLast(*l);
+}
+
+/* Remove a pattern from the subtree of 'node', that stands for the first 'i'
+ * bytes of the prefix. Nodes left without patterns are removed or merged
+ * with their only child, so the tree stays as small as the patterns in it.
+ * Returns 1 if the pattern was found. */
+static int pubsubIndexDeleteFrom(pubsubPatternNode *node, pubsubPattern *pat,
+                                 size_t i, size_t len, int kind)
+{
+    sds p = pat->pattern->ptr;
+    pubsubPatternNode *child;
+    size_t clen;
+    int j;
+
+    if (i == len) {
+        list **l = pubsubPatternNodeList(node,kind);
+
+        if (*l == NULL) return 0;
+        listDelNode(*l,pat->index_node);
+        if (listLength(*l) == 0) {
+            listRelease(*l);
+            *l = NULL;
+        }
+        return 1;
+    }
+    if ((j = pubsubPatternNodeChild(node,p[i])) < 0) return 0;
+    child = node->children[j];
+    clen = sdslen(child->label);
+    if (len-i < clen || memcmp(child->label,p+i,clen) != 0) return 0;
+    if (!pubsubIndexDeleteFrom(child,pat,i+clen,len,kind)) return 0;
+
+    if (child->exact || child->prefix || child->glob) return 1;
+    if (child->numchildren == 0) {
+        pubsubPatternNodeRemoveChild(node,j);
+        pubsubFreePatternNode(child);
+    } else if (child->numchildren == 1) {
+        pubsubPatternNode *grandchild = child->children[0];
+
+        child->label = sdscatsds(child->label,grandchild->label);
+        sdsfree(grandchild->label);
+        grandchild->label = child->label;
+        child->label = NULL;
+        node->children[j] = grandchild;
+        pubsubFreePatternNode(child);
+    }
+    return 1;
+}
+
+static void pubsubIndexDeletePattern(pubsubPattern *pat) {
+    int kind;
+    size_t len = pubsubPatternPrefix(pat->pattern->ptr,&kind);
+
+    serverAssert(pubsubIndexDeleteFrom(server.pubsub_pattern_index,pat,0,
+                                       len,kind));
+}
+
+/* The patterns matching a channel, collected before delivery so they can be
+ * delivered in subscription order. */
+typedef struct pubsubMatches {
+    pubsubPattern **pats;
+    size_t len, size;
+    pubsubPattern *static_pats[16];
+} pubsubMatches;
+
+static void pubsubMatchesAdd(pubsubMatches *m, pubsubPattern *pat) {
+    if (m->len == m->size) {
+        m->size *= 2;
+        if (m->pats == m->static_pats) {
+            m->pats = zmalloc(sizeof(pat)*m->size);
+            memcpy(m->pats,m->static_pats,sizeof(m->static_pats));
+        } else {
+            m->pats = zrealloc(m->pats,sizeof(pat)*m->size);
+        }
+    }
+    m->pats[m->len++] = pat;
+}
+
+static void pubsubMatchList(pubsubMatches *m, list *l, sds channel, int glob) {
+    listNode *ln;
+    listIter li;
+
+    if (l == NULL) return;
+    listRewind(l,&li);
+    while ((ln = listNext(&li)) != NULL) {
+        pubsubPattern *pat = ln->value;
+
+        if (!glob || stringmatchlen((char*)pat->pattern->ptr,
+                                    sdslen(pat->pattern->ptr),
+                                    channel,sdslen(channel),0))
+            pubsubMatchesAdd(m,pat);
+    }
+}
+
+/* Walk the index along the channel name and collect the patterns that
+ * match it. */
+static void pubsubIndexMatch(pubsubMatches *m, sds channel) {
+    pubsubPatternNode *node = server.pubsub_pattern_index;
+    size_t len = sdslen(channel), i = 0, clen;
+    int j;
+
+    while (1) {
+        pubsubMatchList(m,node->prefix,channel,0);
+        pubsubMatchList(m,node->glob,channel,1);
+        if (i == len) {
+            pubsubMatchList(m,node->exact,channel,0);
+            break;
+        }
+        if ((j = pubsubPatternNodeChild(node,channel[i])) < 0) break;
+        node = node->children[j];
+        clen = sdslen(node->label);
+        if (len-i < clen || memcmp(node->label,channel+i,clen) != 0) break;
+        i += clen;
+    }
+}
+
+static int pubsubComparePatternIds(const void *a, const void *b) {
+    const pubsubPattern *pa = *(pubsubPattern**)a, *pb = *(pubsubPattern**)b;
+
+    if (pa->id == pb->id) return 0;
+    return pa->id < pb->id ? -1 : 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * Shared message frames
+ *
+ * A message sent to many subscribers is encoded once into an object that is
+ * queued by reference to every subscriber (see addReplyShared()), so a
+ * PUBLISH copies the message once and not once per subscriber. Frames
+ * smaller than PROTO_SHARED_REPLY_MIN are still copied into the clients'
+ * buffers, which is cheaper than queueing an extra reply object.
+ *----------------------------------------------------------------------------*/
+
+static sds pubsubCatBulk(sds s, robj *o) {
+    o = getDecodedObject(o);
+    s = sdscatfmt(s,"$%U\r\n",(unsigned long long)sdslen(o->ptr));
+    s = sdscatsds(s,o->ptr);
+    s = sdscatlen(s,"\r\n",2);
+    decrRefCount(o);
+    return s;
+}
+
+/* Return the protocol for 'header' followed by the bulk strings 'channel'
+ * and 'message', or NULL if the message is better copied. */
+static robj *pubsubCreateFrame(const char *header, robj *channel,
+                               robj *message)
+{
+    sds s;
+
+    if (stringObjectLen(channel)+stringObjectLen(message) <
+        PROTO_SHARED_REPLY_MIN) return NULL;
+    s = sdsnew(header);
+    s = pubsubCatBulk(s,channel);
+    s = pubsubCatBulk(s,message);
+    return createObject(OBJ_STRING,s);
+}
+
+/*-----------------------------------------------------------------------------
+ * Pubsub subscriptions
+ *----------------------------------------------------------------------------*/
+
 /* Return the number of channels + patterns a client is subscribed to. */
 int clientSubscriptionsCount(client *c) {
     return dictSize(c->pubsub_channels)+
-           listLength(c->pubsub_patterns);
+           dictSize(c->pubsub_patterns);
 }
 
 /* Subscribe a client to a channel. Returns 1 if the operation succeeded, or
@@ -61,19 +353,20 @@ int pubsubSubscribeChannel(client *c, robj *channel) {
     int retval = 0;
 
     /* Add the channel to the client -> channels hash table */
-    if (dictAdd(c->pubsub_channels,channel,NULL) == DICT_OK) {
+    if ((de = dictAddRaw(c->pubsub_channels,channel)) != NULL) {
         retval = 1;
         incrRefCount(channel);
         /* Add the client to the channel -> list of clients hash table */
-        de = dictFind(server.pubsub_channels,channel);
-        if (de == NULL) {
+        clients = dictFetchValue(server.pubsub_channels,channel);
+        if (clients == NULL) {
             clients = listCreate();
             dictAdd(server.pubsub_channels,channel,clients);
             incrRefCount(channel);
-        } else {
-            clients = dictGetVal(de);
         }
+        /* Remember the client's node, so unsubscribing is O(1) even on
+         * channels with many subscribers. */
         listAddNodeTail(clients,c);
+        dictSetVal(c->pubsub_channels,de,listLast(clients));
     }
     /* Notify the client */
     addReply(c,shared.mbulkhdr[3]);
@@ -94,14 +387,15 @@ int pubsubUnsubscribeChannel(client *c, robj *channel, int notify) {
     /* Remove the channel from the client -> channels hash table */
     incrRefCount(channel); /* channel may be just a pointer to the same object
                             we have in the hash tables. Protect it... */
-    if (dictDelete(c->pubsub_channels,channel) == DICT_OK) {
+    if ((de = dictFind(c->pubsub_channels,channel)) != NULL) {
         retval = 1;
+        ln = dictGetVal(de);
+        dictDelete(c->pubsub_channels,channel);
         /* Remove the client from the channel -> clients list hash table */
         de = dictFind(server.pubsub_channels,channel);
         serverAssertWithInfo(c,NULL,de != NULL);
         clients = dictGetVal(de);
-        ln = listSearchKey(clients,c);
-        serverAssertWithInfo(c,NULL,ln != NULL);
+        serverAssertWithInfo(c,NULL,listNodeValue(ln) == c);
         listDelNode(clients,ln);
         if (listLength(clients) == 0) {
             /* Free the list and associated hash entry at all if this was
@@ -116,7 +410,7 @@ int pubsubUnsubscribeChannel(client *c, robj *channel, int notify) {
         addReply(c,shared.unsubscribebulk);
         addReplyBulk(c,channel);
         addReplyLongLong(c,dictSize(c->pubsub_channels)+
-                       listLength(c->pubsub_patterns));
+                       dictSize(c->pubsub_patterns));
 
     }
     decrRefCount(channel); /* it is finally safe to release it */
@@ -125,17 +419,21 @@ int pubsubUnsubscribeChannel(client *c, robj *channel, int notify) {
 
 /* Subscribe a client to a pattern. Returns 1 if the operation succeeded, or 0 if the client was already subscribed to that pattern. */
 int pubsubSubscribePattern(client *c, robj *pattern) {
+    dictEntry *de;
     int retval = 0;
 
-    if (listSearchKey(c->pubsub_patterns,pattern) == NULL) {
+    if ((de = dictAddRaw(c->pubsub_patterns,pattern)) != NULL) {
         retval = 1;
         pubsubPattern *pat;
-        listAddNodeTail(c->pubsub_patterns,pattern);
         incrRefCount(pattern);
         pat = zmalloc(sizeof(*pat));
         pat->pattern = getDecodedObject(pattern);
         pat->client = c;
+        pat->id = server.pubsub_pattern_seq++;
         listAddNodeTail(server.pubsub_patterns,pat);
+        pat->node = listLast(server.pubsub_patterns);
+        pubsubIndexAddPattern(pat);
+        dictSetVal(c->pubsub_patterns,de,pat);
     }
     /* Notify the client */
     addReply(c,shared.mbulkhdr[3]);
@@ -148,18 +446,17 @@ int pubsubSubscribePattern(client *c, robj *pattern) {
 /* Unsubscribe a client from a channel. Returns 1 if the operation succeeded, or
  * 0 if the client was not subscribed to the specified channel. */
 int pubsubUnsubscribePattern(client *c, robj *pattern, int notify) {
-    listNode *ln;
-    pubsubPattern pat;
+    dictEntry *de;
     int retval = 0;
 
     incrRefCount(pattern); /* Protect the object. May be the same we remove */
-    if ((ln = listSearchKey(c->pubsub_patterns,pattern)) != NULL) {
+    if ((de = dictFind(c->pubsub_patterns,pattern)) != NULL) {
+        pubsubPattern *pat = dictGetVal(de);
+
         retval = 1;
-        listDelNode(c->pubsub_patterns,ln);
-        pat.client = c;
-        pat.pattern = pattern;
-        ln = listSearchKey(server.pubsub_patterns,&pat);
-        listDelNode(server.pubsub_patterns,ln);
+        dictDelete(c->pubsub_patterns,pattern);
+        pubsubIndexDeletePattern(pat);
+        listDelNode(server.pubsub_patterns,pat->node);
     }
     /* Notify the client */
     if (notify) {
@@ -167,7 +464,7 @@ int pubsubUnsubscribePattern(client *c, robj *pattern, int notify) {
         addReply(c,shared.punsubscribebulk);
         addReplyBulk(c,pattern);
         addReplyLongLong(c,dictSize(c->pubsub_channels)+
-                       listLength(c->pubsub_patterns));
+                       dictSize(c->pubsub_patterns));
     }
     decrRefCount(pattern);
     return retval;
@@ -191,7 +488,7 @@ int pubsubUnsubscribeAllChannels(client *c, int notify) {
         addReply(c,shared.unsubscribebulk);
         addReply(c,shared.nullbulk);
         addReplyLongLong(c,dictSize(c->pubsub_channels)+
-                       listLength(c->pubsub_patterns));
+                       dictSize(c->pubsub_patterns));
     }
     dictReleaseIterator(di);
     return count;
@@ -200,13 +497,12 @@ int pubsubUnsubscribeAllChannels(client *c, int notify) {
 /* Unsubscribe from all the patterns. Return the number of patterns the
  * client was subscribed from. */
 int pubsubUnsubscribeAllPatterns(client *c, int notify) {
-    listNode *ln;
-    listIter li;
+    dictIterator *di = dictGetSafeIterator(c->pubsub_patterns);
+    dictEntry *de;
     int count = 0;
 
-    listRewind(c->pubsub_patterns,&li);
-    while ((ln = listNext(&li)) != NULL) {
-        robj *pattern = ln->value;
+    while((de = dictNext(di)) != NULL) {
+        robj *pattern = dictGetKey(de);
 
         count += pubsubUnsubscribePattern(c,pattern,notify);
     }
@@ -216,8 +512,9 @@ int pubsubUnsubscribeAllPatterns(client *c, int notify) {
         addReply(c,shared.punsubscribebulk);
         addReply(c,shared.nullbulk);
         addReplyLongLong(c,dictSize(c->pubsub_channels)+
-                       listLength(c->pubsub_patterns));
+                       dictSize(c->pubsub_patterns));
     }
+    dictReleaseIterator(di);
     return count;
 }
 
@@ -225,13 +522,13 @@ int pubsubUnsubscribeAllPatterns(client *c, int notify) {
 int pubsubPublishMessage(robj *channel, robj *message) {
     int receivers = 0;
     dictEntry *de;
-    listNode *ln;
-    listIter li;
 
     /* Send to clients listening for that channel */
     de = dictFind(server.pubsub_channels,channel);
     if (de) {
         list *list = dictGetVal(de);
+        robj *frame = pubsubCreateFrame("*3\r\n$7\r\nmessage\r\n",channel,
+                                        message);
         listNode *ln;
         listIter li;
 
@@ -239,32 +536,50 @@ int pubsubPublishMessage(robj *channel, robj *message) {
         while ((ln = listNext(&li)) != NULL) {
             client *c = ln->value;
 
-            addReply(c,shared.mbulkhdr[3]);
-            addReply(c,shared.messagebulk);
-            addReplyBulk(c,channel);
-            addReplyBulk(c,message);
+            if (frame) {
+                addReplyShared(c,frame);
+            } else {
+                addReply(c,shared.mbulkhdr[3]);
+                addReply(c,shared.messagebulk);
+                addReplyBulk(c,channel);
+                addReplyBulk(c,message);
+            }
             receivers++;
         }
+        if (frame) decrRefCount(frame);
     }
     /* Send to clients listening to matching channels */
     if (listLength(server.pubsub_patterns)) {
-        listRewind(server.pubsub_patterns,&li);
+        pubsubMatches m;
+        robj *frame;
+        size_t j;
+
+        m.pats = m.static_pats;
+        m.len = 0;
+        m.size = sizeof(m.static_pats)/sizeof(m.static_pats[0]);
         channel = getDecodedObject(channel);
-        while ((ln = listNext(&li)) != NULL) {
-            pubsubPattern *pat = ln->value;
-
-            if (stringmatchlen((char*)pat->pattern->ptr,
-                                sdslen(pat->pattern->ptr),
-                                (char*)channel->ptr,
-                                sdslen(channel->ptr),0)) {
-                addReply(pat->client,shared.mbulkhdr[4]);
-                addReply(pat->client,shared.pmessagebulk);
-                addReplyBulk(pat->client,pat->pattern);
+        pubsubIndexMatch(&m,channel->ptr);
+        if (m.len > 1)
+            qsort(m.pats,m.len,sizeof(m.pats[0]),pubsubComparePatternIds);
+        /* Only the pattern differs between the subscribers, the channel and
+         * the message that follow it are shared. */
+        frame = m.len ? pubsubCreateFrame("",channel,message) : NULL;
+        for (j = 0; j < m.len; j++) {
+            pubsubPattern *pat = m.pats[j];
+
+            addReply(pat->client,shared.mbulkhdr[4]);
+            addReply(pat->client,shared.pmessagebulk);
+            addReplyBulk(pat->client,pat->pattern);
+            if (frame) {
+                addReplyShared(pat->client,frame);
+            } else {
                 addReplyBulk(pat->client,channel);
                 addReplyBulk(pat->client,message);
-                receivers++;
             }
+            receivers++;
         }
+        if (frame) decrRefCount(frame);
+        if (m.pats != m.static_pats) zfree(m.pats);
         decrRefCount(channel);
     }
     return receivers;
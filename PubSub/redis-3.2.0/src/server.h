@@ -155,6 +155,7 @@ typedef long long mstime_t; /* millisecond time type. */
 #define PROTO_MAX_QUERYBUF_LEN  (1024*1024*1024) /* 1GB max query buffer. */
 #define PROTO_IOBUF_LEN         (1024*16)  /* Generic I/O buffer size */
 #define PROTO_REPLY_CHUNK_BYTES (16*1024) /* 16k output buffer */
+#define PROTO_SHARED_REPLY_MIN  512 /* Smaller PUBLISH frames are copied. */
 #define PROTO_INLINE_MAX_SIZE   (1024*64) /* Max size of inline reads */
 #define PROTO_MBULK_BIG_ARG     (1024*32)
 #define LONG_STR_SIZE      21          /* Bytes needed for long -> str */
@@ -601,8 +602,11 @@ typedef struct client {
     blockingState bpop;     /* blocking state */
     long long woff;         /* Last write global replication offset. */
     list *watched_keys;     /* Keys WATCHED for MULTI/EXEC CAS */
-    dict *pubsub_channels;  /* channels a client is interested in (SUBSCRIBE) */
-    list *pubsub_patterns;  /* patterns a client is interested in (SUBSCRIBE) */
+    dict *pubsub_channels;  /* channels a client is interested in (SUBSCRIBE),
+                               mapped to the client's node in the list of
+                               subscribers of the channel. */
+    dict *pubsub_patterns;  /* patterns a client is interested in
+                               (PSUBSCRIBE), mapped to their pubsubPattern. */
     sds peerid;             /* Cached peer ID. */
 
     /* Response buffer */
@@ -770,6 +774,7 @@ struct redisServer {
     size_t resident_set_size;       /* RSS sampled in serverCron(). */
     long long stat_net_input_bytes; /* Bytes read from network. */
     long long stat_net_output_bytes; /* Bytes written to network. */
+    long long stat_net_output_writes; /* Write syscalls sending replies. */
     /* The following two are used to track instantaneous metrics, like
      * number of operations per second, network traffic. */
     struct {
@@ -929,6 +934,9 @@ struct redisServer {
     /* Pubsub */
     dict *pubsub_channels;  /* Map channels to list of subscribed clients */
     list *pubsub_patterns;  /* A list of pubsub_patterns */
+    struct pubsubPatternNode *pubsub_pattern_index; /* pubsub_patterns by
+                                                       literal prefix. */
+    unsigned long long pubsub_pattern_seq; /* Next pubsubPattern id. */
     int notify_keyspace_events; /* Events to propagate via Pub/Sub. This is an
                                    xor of NOTIFY_... flags. */
     /* Cluster */
@@ -974,8 +982,25 @@ struct redisServer {
 typedef struct pubsubPattern {
     client *client;
     robj *pattern;
+    unsigned long long id;  /* Subscription order, used to deliver matches
+                               in the order of server.pubsub_patterns. */
+    listNode *node;         /* This pattern in server.pubsub_patterns. */
+    listNode *index_node;   /* This pattern in its pattern index list. */
 } pubsubPattern;
 
+/* Radix tree indexing the subscribed patterns by their literal prefix, that
+ * is the text before the first glob character. A node stands for the prefix
+ * spelled by the labels from the root to the node, and holds the patterns
+ * with exactly that literal prefix in one of three lists: */
+typedef struct pubsubPatternNode {
+    sds label;              /* Bytes added to the prefix by this node. */
+    struct pubsubPatternNode **children; /* Sorted by first label byte. */
+    int numchildren;
+    list *exact;    /* No glob characters: match only the prefix itself. */
+    list *prefix;   /* "<prefix>*": match every channel with the prefix. */
+    list *glob;     /* Anything else, still checked with stringmatchlen(). */
+} pubsubPatternNode;
+
 typedef void redisCommandProc(client *c);
 typedef int *redisGetKeysProc(struct redisCommand *cmd, robj **argv, int argc, int *numkeys);
 struct redisCommand {
@@ -1099,6 +1124,7 @@ void addReplyBulkCString(client *c, const char *s);
 void addReplyBulkCBuffer(client *c, const void *p, size_t len);
 void addReplyBulkLongLong(client *c, long long ll);
 void addReply(client *c, robj *obj);
+void addReplyShared(client *c, robj *obj);
 void addReplySds(client *c, sds s);
 void addReplyBulkSds(client *c, sds s);
 void addReplyError(client *c, const char *err);
@@ -1374,6 +1400,7 @@ int pubsubUnsubscribeAllChannels(client *c, int notify);
 int pubsubUnsubscribeAllPatterns(client *c, int notify);
 void freePubsubPattern(void *p);
 int listMatchPubsubPattern(void *a, void *b);
+pubsubPatternNode *pubsubCreatePatternIndex(void);
 int pubsubPublishMessage(robj *channel, robj *message);
 
 /* Keyspace events notification */
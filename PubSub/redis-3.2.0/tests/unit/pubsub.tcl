@@ -223,6 +223,156 @@ start_server {tags {"pubsub"}} {
         concat $reply1 $reply2
     } {punsubscribe {} 0 unsubscribe {} 0}
 
+    proc read_pmessage_patterns {client count} {
+        set patterns {}
+        for {set i 0} {$i < $count} {incr i} {
+            lappend patterns [lindex [$client read] 1]
+        }
+        return $patterns
+    }
+
+    test "PSUBSCRIBE exact, prefix and glob patterns sharing a prefix" {
+        set rd1 [redis_deferring_client]
+        set patterns {foo foo* foo.* foo.b?r f* * {fo[o]x} {foo\*}}
+        assert_equal {1 2 3 4 5 6 7 8} [psubscribe $rd1 $patterns]
+
+        # Matches are delivered in subscription order
+        assert_equal 4 [r publish foo hello]
+        assert_equal {foo foo* f* *} [read_pmessage_patterns $rd1 4]
+        assert_equal 5 [r publish foo.bar hello]
+        assert_equal {foo* foo.* foo.b?r f* *} [read_pmessage_patterns $rd1 5]
+        assert_equal 4 [r publish foox hello]
+        assert_equal {foo* f* * {fo[o]x}} [read_pmessage_patterns $rd1 4]
+        assert_equal 4 [r publish foo* hello]
+        assert_equal {foo* f* * {foo\*}} [read_pmessage_patterns $rd1 4]
+        assert_equal 1 [r publish bar hello]
+        assert_equal {*} [read_pmessage_patterns $rd1 1]
+        assert_equal 1 [r publish {} hello]
+        assert_equal {*} [read_pmessage_patterns $rd1 1]
+
+        # clean up clients
+        $rd1 close
+    }
+
+    test "PUNSUBSCRIBE keeps the other patterns with the same prefix" {
+        set rd1 [redis_deferring_client]
+        set rd2 [redis_deferring_client]
+        assert_equal {1 2 3} [psubscribe $rd1 {abc.def* abc.d* abc.x}]
+        assert_equal {1} [psubscribe $rd2 {abc.d*}]
+
+        assert_equal {2} [punsubscribe $rd1 {abc.d*}]
+        assert_equal 2 [r publish abc.def1 hello]
+        assert_equal {pmessage abc.def* abc.def1 hello} [$rd1 read]
+        assert_equal {pmessage abc.d* abc.def1 hello} [$rd2 read]
+        assert_equal 1 [r publish abc.x hello]
+        assert_equal {pmessage abc.x abc.x hello} [$rd1 read]
+        assert_equal 1 [r publish abc.dz hello]
+        assert_equal {pmessage abc.d* abc.dz hello} [$rd2 read]
+
+        assert_equal {1} [punsubscribe $rd1 {abc.def*}]
+        assert_equal {0} [punsubscribe $rd2 {abc.d*}]
+        assert_equal 0 [r publish abc.def1 hello]
+        assert_equal 1 [r publish abc.x hello]
+        assert_equal {pmessage abc.x abc.x hello} [$rd1 read]
+
+        assert_equal {2} [psubscribe $rd1 {abc.d*}]
+        assert_equal 1 [r publish abc.dz hello]
+        assert_equal {pmessage abc.d* abc.dz hello} [$rd1 read]
+        assert_equal 2 [r pubsub numpat]
+
+        # clean up clients
+        $rd1 close
+        $rd2 close
+    }
+
+    test "PUBLISH of large messages to channel and pattern subscribers" {
+        set rd1 [redis_deferring_client]
+        set rd2 [redis_deferring_client]
+        assert_equal {1 2} [subscribe $rd1 {big small}]
+        assert_equal {1} [subscribe $rd2 {big}]
+        assert_equal {2 3} [psubscribe $rd2 {b* *}]
+
+        # Large messages are queued shared, small ones copied, both in order
+        set big [string repeat x 20000]
+        set mid [string repeat y 600]
+        assert_equal 4 [r publish big $big]
+        assert_equal 2 [r publish small hello]
+        assert_equal 4 [r publish big $mid]
+        assert_equal "message big $big" [$rd1 read]
+        assert_equal {message small hello} [$rd1 read]
+        assert_equal "message big $mid" [$rd1 read]
+        assert_equal "message big $big" [$rd2 read]
+        assert_equal "pmessage b* big $big" [$rd2 read]
+        assert_equal "pmessage * big $big" [$rd2 read]
+        assert_equal {pmessage * small hello} [$rd2 read]
+        assert_equal "message big $mid" [$rd2 read]
+        assert_equal "pmessage b* big $mid" [$rd2 read]
+        assert_equal "pmessage * big $mid" [$rd2 read]
+
+        # clean up clients
+        $rd1 close
+        $rd2 close
+    }
+
+    test "UNSUBSCRIBE and disconnects keep the other subscribers in order" {
+        set clients {}
+        for {set j 0} {$j < 4} {incr j} {
+            set rd [redis_deferring_client]
+            assert_equal {1 2} [subscribe $rd {chan1 chan2}]
+            assert_equal {3} [psubscribe $rd {chan*}]
+            lappend clients $rd
+        }
+        lassign $clients rd1 rd2 rd3 rd4
+
+        assert_equal {2} [unsubscribe $rd2 {chan1}]
+        $rd3 close
+        # Wait for the server to notice that the client is gone
+        wait_for_condition 50 100 {
+            [r pubsub numpat] == 3
+        } else {
+            fail "Client close not processed"
+        }
+        assert_equal {chan1 2 chan2 3} [r pubsub numsub chan1 chan2]
+        assert_equal 5 [r publish chan1 hello]
+        assert_equal {message chan1 hello} [$rd1 read]
+        assert_equal {pmessage chan* chan1 hello} [$rd1 read]
+        assert_equal {pmessage chan* chan1 hello} [$rd2 read]
+        assert_equal {message chan1 hello} [$rd4 read]
+        assert_equal {pmessage chan* chan1 hello} [$rd4 read]
+
+        assert_equal {2} [punsubscribe $rd1 {chan*}]
+        assert_equal {1 0} [unsubscribe $rd1 {chan1 chan2}]
+        assert_equal 4 [r publish chan2 hello]
+        assert_equal {message chan2 hello} [$rd2 read]
+        assert_equal {pmessage chan* chan2 hello} [$rd2 read]
+        assert_equal {message chan2 hello} [$rd4 read]
+        assert_equal {pmessage chan* chan2 hello} [$rd4 read]
+
+        # clean up clients
+        $rd1 close
+        $rd2 close
+        $rd4 close
+    }
+
+    test "PUBLISH more than the socket buffer holds to a slow subscriber" {
+        set rd1 [redis_deferring_client]
+        assert_equal {1} [subscribe $rd1 {chan}]
+
+        # The reply list is written in parts as the subscriber reads it
+        for {set j 0} {$j < 200} {incr j} {
+            r publish chan "$j [string repeat x [expr {$j*97}]]"
+            r publish chan $j
+        }
+        for {set j 0} {$j < 200} {incr j} {
+            assert_equal "message chan {$j [string repeat x [expr {$j*97}]]}" \
+                [$rd1 read]
+            assert_equal "message chan $j" [$rd1 read]
+        }
+
+        # clean up clients
+        $rd1 close
+    }
+
     ### Keyspace events notification tests
 
     test "Keyspace notifications: we receive keyspace notifications" {
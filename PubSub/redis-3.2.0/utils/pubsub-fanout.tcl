@@ -0,0 +1,132 @@
+#!/usr/bin/env tclsh8.5
+# Released under the BSD license like Redis itself
+#
+# Measure how the server writes a PUBLISH fan-out: N subscribers (1000 by
+# default) listen to the same channel while redis-benchmark publishes to
+# it, and the script reports the write syscalls the server made (INFO
+# total_net_output_writes), the bytes per syscall, and the output and
+# message throughput. The publisher pipelines its commands, so every event
+# loop iteration queues several messages to each subscriber.
+#
+# Start a server, then from the 'utils' directory run:
+#
+#   ./pubsub-fanout.tcl [--port 6379] [--subscribers 1000]
+#                       [--requests 10000] [--size 64] [--pipeline 16]
+
+source ../tests/support/redis.tcl
+set ::host 127.0.0.1
+set ::port 6379
+set ::subscribers 1000
+set ::requests 10000
+set ::size 64
+set ::pipeline 16
+
+proc info-field {r field} {
+    regexp "$field:(\[0-9\]+)" [$r info] -> value
+    return $value
+}
+
+proc drain fd {
+    read $fd
+    if {[eof $fd]} {
+        close $fd
+        incr ::subscribers -1
+    }
+}
+
+proc benchmark-done fd {
+    read $fd
+    if {[eof $fd]} {
+        close $fd
+        set ::done 1
+    }
+}
+
+proc main {} {
+    set r [redis $::host $::port]
+    set limits [lindex [$r config get client-output-buffer-limit] 1]
+    $r config set client-output-buffer-limit "pubsub 0 0 0"
+
+    # Raw sockets: the subscribers read and discard the protocol.
+    set fds {}
+    for {set j 0} {$j < $::subscribers} {incr j} {
+        set fd [socket $::host $::port]
+        fconfigure $fd -translation binary -blocking 1
+        puts -nonewline $fd "*2\r\n\$9\r\nsubscribe\r\n\$6\r\nfanout\r\n"
+        flush $fd
+        gets $fd; gets $fd; gets $fd; gets $fd; gets $fd; gets $fd
+        fconfigure $fd -blocking 0 -buffersize 65536
+        fileevent $fd readable [list drain $fd]
+        lappend fds $fd
+    }
+
+    set writes [info-field $r total_net_output_writes]
+    set bytes [info-field $r total_net_output_bytes]
+    set start [clock milliseconds]
+    set ::done 0
+    set bench [open [list |../src/redis-benchmark -h $::host -p $::port \
+        -n $::requests -c 1 -P $::pipeline -q \
+        publish fanout [string repeat x $::size]] r]
+    fconfigure $bench -blocking 0
+    fileevent $bench readable [list benchmark-done $bench]
+    vwait ::done
+
+    # Wait for the subscribers to receive everything.
+    while {[$r client list] ne {} &&
+           [regexp {omem=[1-9]} [$r client list]]} {
+        after 10 {set ::tick 1}
+        vwait ::tick
+    }
+    set elapsed [expr {([clock milliseconds]-$start)/1000.0}]
+    set writes [expr {[info-field $r total_net_output_writes]-$writes}]
+    set bytes [expr {[info-field $r total_net_output_bytes]-$bytes}]
+    set messages [expr {$::requests*$::subscribers}]
+
+    puts [format "%d subscribers, %d messages of %d bytes" \
+        $::subscribers $::requests $::size]
+    puts [format "  %12.0f write syscalls/sec" [expr {$writes/$elapsed}]]
+    puts [format "  %12.0f bytes per syscall" [expr {double($bytes)/$writes}]]
+    puts [format "  %12.1f MB/sec" [expr {$bytes/$elapsed/1e6}]]
+    puts [format "  %12.0f messages delivered/sec" [expr {$messages/$elapsed}]]
+
+    foreach fd $fds {close $fd}
+    $r config set client-output-buffer-limit $limits
+    $r close
+}
+
+# Force the user to run the script from the 'utils' directory.
+if {![file exists pubsub-fanout.tcl]} {
+    puts "Please make sure to run pubsub-fanout.tcl while inside /utils."
+    puts "Example: cd utils; ./pubsub-fanout.tcl"
+    exit 1
+}
+
+# parse arguments
+for {set j 0} {$j < [llength $argv]} {incr j} {
+    set opt [lindex $argv $j]
+    set arg [lindex $argv [expr $j+1]]
+    if {$opt eq {--host}} {
+        set ::host $arg
+        incr j
+    } elseif {$opt eq {--port}} {
+        set ::port $arg
+        incr j
+    } elseif {$opt eq {--subscribers}} {
+        set ::subscribers $arg
+        incr j
+    } elseif {$opt eq {--requests}} {
+        set ::requests $arg
+        incr j
+    } elseif {$opt eq {--size}} {
+        set ::size $arg
+        incr j
+    } elseif {$opt eq {--pipeline}} {
+        set ::pipeline $arg
+        incr j
+    } else {
+        puts "Wrong argument: $opt"
+        exit 1
+    }
+}
+
+main
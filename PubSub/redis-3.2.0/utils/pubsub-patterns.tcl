@@ -0,0 +1,97 @@
+#!/usr/bin/env tclsh8.5
+# Released under the BSD license like Redis itself
+#
+# Measure PUBLISH throughput while the number of PSUBSCRIBE patterns grows
+# from 10 to 100k. The patterns are a mix of the kinds the pattern index
+# handles differently: exact names, "<prefix>*" and other globs, each with
+# its own literal prefix. Every PUBLISH matches a single pattern.
+#
+# Start a server, then from the 'utils' directory run:
+#
+#   ./pubsub-patterns.tcl [--port 6379] [--requests 100000]
+
+source ../tests/support/redis.tcl
+set ::host 127.0.0.1
+set ::port 6379
+set ::requests 100000
+set ::counts {10 100 1000 10000 100000}
+
+# The i-th pattern of the benchmark.
+proc pattern i {
+    switch [expr {$i % 4}] {
+        0 {return "news.$i"}
+        1 {return "user.$i.*"}
+        2 {return "room.$i.*.msg"}
+        3 {return "dev.$i.\[ab\]"}
+    }
+}
+
+# Subscribe the patterns first..last-1 in batches.
+proc add-patterns {sub first last} {
+    for {set i $first} {$i < $last} {incr i 1000} {
+        set batch {}
+        for {set j $i} {$j < $last && $j < $i+1000} {incr j} {
+            lappend batch [pattern $j]
+        }
+        $sub psubscribe {*}$batch
+        # Skip the messages of the previous PUBLISH run
+        set pending [llength $batch]
+        while {$pending > 0} {
+            if {[lindex [$sub read] 0] eq {psubscribe}} {incr pending -1}
+        }
+    }
+}
+
+proc publish-rate {} {
+    set output [exec ../src/redis-benchmark -h $::host -p $::port \
+        -n $::requests -P 16 -q publish user.1.login hello]
+    regexp {([0-9.]+) requests per second} $output -> rate
+    return $rate
+}
+
+proc main {} {
+    set r [redis $::host $::port]
+    set sub [redis $::host $::port 1]
+    # The subscriber never reads its messages, don't disconnect it.
+    set limits [lindex [$r config get client-output-buffer-limit] 1]
+    $r config set client-output-buffer-limit "pubsub 0 0 0"
+
+    puts [format "%10s %16s" patterns publish/sec]
+    set subscribed 0
+    foreach count $::counts {
+        add-patterns $sub $subscribed $count
+        set subscribed $count
+        puts [format "%10d %16s" [$r pubsub numpat] [publish-rate]]
+    }
+    $sub close
+    $r config set client-output-buffer-limit $limits
+    $r close
+}
+
+# Force the user to run the script from the 'utils' directory.
+if {![file exists pubsub-patterns.tcl]} {
+    puts "Please make sure to run pubsub-patterns.tcl while inside /utils."
+    puts "Example: cd utils; ./pubsub-patterns.tcl"
+    exit 1
+}
+
+# parse arguments
+for {set j 0} {$j < [llength $argv]} {incr j} {
+    set opt [lindex $argv $j]
+    set arg [lindex $argv [expr $j+1]]
+    if {$opt eq {--host}} {
+        set ::host $arg
+        incr j
+    } elseif {$opt eq {--port}} {
+        set ::port $arg
+        incr j
+    } elseif {$opt eq {--requests}} {
+        set ::requests $arg
+        incr j
+    } else {
+        puts "Wrong argument: $opt"
+        exit 1
+    }
+}
+
+main